@@ -0,0 +1,47 @@
+# Release+LTO and profile guided optimization flags shared by every mrklang target
+
+include(CheckIPOSupported)
+
+set(MRK_LTO_SUPPORTED OFF)
+if(MRK_ENABLE_LTO)
+	check_ipo_supported(RESULT MRK_LTO_SUPPORTED OUTPUT _mrk_lto_output LANGUAGES CXX)
+	if(NOT MRK_LTO_SUPPORTED)
+		message(STATUS "mrklang: LTO not supported by this toolchain (${_mrk_lto_output})")
+	endif()
+endif()
+
+string(TOUPPER "${MRK_PGO}" MRK_PGO)
+if(NOT MRK_PGO STREQUAL "OFF")
+	if(NOT CMAKE_CXX_COMPILER_ID MATCHES "GNU|Clang")
+		message(FATAL_ERROR "mrklang: MRK_PGO is only wired up for GCC and Clang")
+	endif()
+	file(MAKE_DIRECTORY "${MRK_PGO_DIR}")
+	message(STATUS "mrklang: PGO stage ${MRK_PGO}, profile directory ${MRK_PGO_DIR}")
+endif()
+
+function(mrk_optimize target)
+	if(MRK_LTO_SUPPORTED)
+		set_property(TARGET ${target} PROPERTY INTERPROCEDURAL_OPTIMIZATION_RELEASE ON)
+		set_property(TARGET ${target} PROPERTY INTERPROCEDURAL_OPTIMIZATION_RELWITHDEBINFO ON)
+	endif()
+
+	if(MRK_PGO STREQUAL "GENERATE")
+		if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+			set(_flags -fprofile-generate -fprofile-dir=${MRK_PGO_DIR} -fprofile-update=single)
+		else()
+			set(_flags -fprofile-instr-generate=${MRK_PGO_DIR}/mrk-%p.profraw)
+		endif()
+		target_compile_options(${target} PRIVATE ${_flags})
+		target_link_options(${target} PRIVATE ${_flags})
+	elseif(MRK_PGO STREQUAL "USE")
+		if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+			# the optimize stage reuses the instrumented build tree, so the .gcda
+			# names line up with the objects they were recorded for
+			set(_flags -fprofile-use -fprofile-dir=${MRK_PGO_DIR} -fprofile-partial-training -Wno-missing-profile)
+		else()
+			set(_flags -fprofile-instr-use=${MRK_PGO_DIR}/mrk.profdata -Wno-profile-instr-unprofiled)
+		endif()
+		target_compile_options(${target} PRIVATE ${_flags})
+		target_link_options(${target} PRIVATE ${_flags})
+	endif()
+endfunction()
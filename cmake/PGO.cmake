@@ -0,0 +1,133 @@
+# Two stage profile guided build of mrklang
+#
+#   cmake -P cmake/PGO.cmake                    (or: cmake --build <dir> --target pgo)
+#
+# 1. builds a Release+LTO baseline and times the front-end benchmark
+# 2. builds an instrumented tree and trains it on the bundled corpus
+# 3. rebuilds the same tree with the recorded profile and times it again
+#
+# Optional -D variables: MRK_SOURCE_DIR, MRK_PGO_BINARY_DIR, MRK_CXX_COMPILER,
+# MRK_GENERATOR, MRK_CORPUS_DIR, MRK_PGO_TRAIN_ITERATIONS, MRK_PGO_ITERATIONS,
+# MRK_PGO_RUNS
+
+cmake_minimum_required(VERSION 3.16)
+
+if(NOT MRK_SOURCE_DIR)
+	get_filename_component(MRK_SOURCE_DIR "${CMAKE_CURRENT_LIST_DIR}/.." ABSOLUTE)
+endif()
+if(NOT MRK_PGO_BINARY_DIR)
+	set(MRK_PGO_BINARY_DIR "${MRK_SOURCE_DIR}/_pgo_build")
+endif()
+if(NOT MRK_CORPUS_DIR)
+	set(MRK_CORPUS_DIR "${MRK_SOURCE_DIR}/corpus")
+endif()
+if(NOT MRK_PGO_TRAIN_ITERATIONS)
+	set(MRK_PGO_TRAIN_ITERATIONS 100)
+endif()
+if(NOT MRK_PGO_ITERATIONS)
+	set(MRK_PGO_ITERATIONS 400)
+endif()
+if(NOT MRK_PGO_RUNS)
+	set(MRK_PGO_RUNS 5)
+endif()
+
+set(_base_dir "${MRK_PGO_BINARY_DIR}/base")
+set(_pgo_dir "${MRK_PGO_BINARY_DIR}/pgo")
+set(_profile_dir "${_pgo_dir}/profile")
+
+set(_configure_args -DCMAKE_BUILD_TYPE=Release -DMRK_ENABLE_LTO=ON "-DMRK_CORPUS_DIR=${MRK_CORPUS_DIR}")
+if(MRK_CXX_COMPILER)
+	list(APPEND _configure_args "-DCMAKE_CXX_COMPILER=${MRK_CXX_COMPILER}")
+endif()
+if(MRK_GENERATOR)
+	list(APPEND _configure_args -G "${MRK_GENERATOR}")
+endif()
+
+function(mrk_run)
+	execute_process(COMMAND ${ARGN} RESULT_VARIABLE _result)
+	if(NOT _result EQUAL 0)
+		string(REPLACE ";" " " _cmd "${ARGN}")
+		message(FATAL_ERROR "PGO: '${_cmd}' failed (${_result})")
+	endif()
+endfunction()
+
+function(mrk_configure dir)
+	mrk_run(${CMAKE_COMMAND} -S "${MRK_SOURCE_DIR}" -B "${dir}" ${_configure_args} ${ARGN})
+endfunction()
+
+function(mrk_build dir)
+	mrk_run(${CMAKE_COMMAND} --build "${dir}" --target mrk_bench --config Release)
+endfunction()
+
+function(mrk_find_bench dir out)
+	foreach(_candidate "${dir}/mrk_bench" "${dir}/mrk_bench.exe" "${dir}/Release/mrk_bench.exe")
+		if(EXISTS "${_candidate}")
+			set(${out} "${_candidate}" PARENT_SCOPE)
+			return()
+		endif()
+	endforeach()
+	message(FATAL_ERROR "PGO: mrk_bench not found in ${dir}")
+endfunction()
+
+# best of MRK_PGO_RUNS, the minimum is the least noisy estimator for a cpu bound loop
+function(mrk_time dir out)
+	mrk_find_bench("${dir}" _bench)
+	set(_best "")
+	foreach(_run RANGE 1 ${MRK_PGO_RUNS})
+		execute_process(COMMAND "${_bench}" --iterations ${MRK_PGO_ITERATIONS} --summary "${MRK_CORPUS_DIR}"
+			OUTPUT_VARIABLE _output RESULT_VARIABLE _result)
+		if(NOT _result EQUAL 0)
+			message(FATAL_ERROR "PGO: benchmark failed (${_result})\n${_output}")
+		endif()
+		string(REGEX MATCH "mrk_bench_total_ms ([0-9.]+)" _match "${_output}")
+		set(_ms "${CMAKE_MATCH_1}")
+		if(_best STREQUAL "" OR _ms LESS _best)
+			set(_best "${_ms}")
+		endif()
+	endforeach()
+	set(${out} "${_best}" PARENT_SCOPE)
+endfunction()
+
+message(STATUS "PGO: [1/3] Release+LTO baseline")
+mrk_configure("${_base_dir}" -DMRK_PGO=OFF)
+mrk_build("${_base_dir}")
+mrk_time("${_base_dir}" _base_ms)
+
+message(STATUS "PGO: [2/3] instrumented build, training on ${MRK_CORPUS_DIR}")
+file(REMOVE_RECURSE "${_profile_dir}")
+mrk_configure("${_pgo_dir}" -DMRK_PGO=GENERATE "-DMRK_PGO_DIR=${_profile_dir}")
+mrk_build("${_pgo_dir}")
+mrk_find_bench("${_pgo_dir}" _bench)
+mrk_run("${_bench}" --iterations ${MRK_PGO_TRAIN_ITERATIONS} "${MRK_CORPUS_DIR}")
+
+file(GLOB _profraw "${_profile_dir}/*.profraw")
+if(_profraw)
+	find_program(_profdata NAMES llvm-profdata)
+	if(NOT _profdata)
+		message(FATAL_ERROR "PGO: llvm-profdata is required to merge clang profiles")
+	endif()
+	mrk_run("${_profdata}" merge -output=${_profile_dir}/mrk.profdata ${_profraw})
+endif()
+
+message(STATUS "PGO: [3/3] optimized build")
+mrk_configure("${_pgo_dir}" -DMRK_PGO=USE "-DMRK_PGO_DIR=${_profile_dir}")
+mrk_build("${_pgo_dir}")
+mrk_time("${_pgo_dir}" _pgo_ms)
+
+message(STATUS "PGO: Release+LTO     ${_base_ms} ms (best of ${MRK_PGO_RUNS})")
+message(STATUS "PGO: Release+LTO+PGO ${_pgo_ms} ms (best of ${MRK_PGO_RUNS})")
+
+# cmake's math() is integer only, report the gain in tenths of a percent
+string(REGEX REPLACE "\\..*" "" _base_int "${_base_ms}")
+string(REGEX REPLACE "\\..*" "" _pgo_int "${_pgo_ms}")
+if(_base_int GREATER 0)
+	math(EXPR _gain "(${_base_int} - ${_pgo_int}) * 1000 / ${_base_int}")
+	set(_sign "")
+	if(_gain LESS 0)
+		set(_sign "-")
+		math(EXPR _gain "0 - ${_gain}")
+	endif()
+	math(EXPR _whole "${_gain} / 10")
+	math(EXPR _frac "${_gain} % 10")
+	message(STATUS "PGO: front-end gain ${_sign}${_whole}.${_frac}%")
+endif()
@@ -0,0 +1,1115 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Common.h"
+
+#ifdef MRK_BENCH
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32) || defined(__linux__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
+#include "Tokens.h"
+#include "Parser.h"
+#include "Trace.h"
+#include "PerfCounters.h"
+#include "Json.h"
+#include "Statistics.h"
+#include "Corpus.h"
+#include "Model.h"
+#include "EmitPipeline.h"
+#include "Semantic.h"
+#include "Reachability.h"
+#include "Bytecode.h"
+#include "VM.h"
+#include "Unicode.h"
+#include "StructuralIndex.h"
+#include "Diagnostics.h"
+
+#ifndef MRK_BENCH_CORPUS_DIR
+#define MRK_BENCH_CORPUS_DIR "corpus"
+#endif
+
+#define MRK_BENCH_RESULT_VERSION 1
+#define MRK_BENCH_EXIT_REGRESSION 3
+#define MRK_BENCH_NESTED_DEPTH 64
+#define MRK_BENCH_BROKEN_FIELDS 16 //per class of --broken
+
+//every heap allocation of the benchmark goes through here, so samples can report
+//allocation counts and the peak of live heap bytes
+namespace {
+	mrks atomic<unsigned long long> g_Allocations(0);
+	mrks atomic<long long> g_LiveBytes(0);
+	mrks atomic<long long> g_PeakBytes(0);
+
+	size_t UsableSize(void* ptr) {
+#if defined(_WIN32)
+		return _msize(ptr);
+#elif defined(__linux__)
+		return malloc_usable_size(ptr);
+#elif defined(__APPLE__)
+		return malloc_size(ptr);
+#else
+		return 0;
+#endif
+	}
+
+	void* TrackedAlloc(size_t size) {
+		void* ptr = malloc(size ? size : 1);
+		if (!ptr)
+			return 0;
+
+		g_Allocations.fetch_add(1, mrks memory_order_relaxed);
+		long long live = g_LiveBytes.fetch_add((long long)UsableSize(ptr), mrks memory_order_relaxed) + (long long)UsableSize(ptr);
+		long long peak = g_PeakBytes.load(mrks memory_order_relaxed);
+		while (live > peak && !g_PeakBytes.compare_exchange_weak(peak, live, mrks memory_order_relaxed))
+			;
+
+		return ptr;
+	}
+
+	void TrackedFree(void* ptr) {
+		if (!ptr)
+			return;
+
+		g_LiveBytes.fetch_sub((long long)UsableSize(ptr), mrks memory_order_relaxed);
+		free(ptr);
+	}
+}
+
+void* operator new(size_t size) {
+	void* ptr = TrackedAlloc(size);
+	if (!ptr)
+		throw mrks bad_alloc();
+	return ptr;
+}
+
+void* operator new[](size_t size) {
+	void* ptr = TrackedAlloc(size);
+	if (!ptr)
+		throw mrks bad_alloc();
+	return ptr;
+}
+
+void* operator new(size_t size, const mrks nothrow_t&) noexcept {
+	return TrackedAlloc(size);
+}
+
+void* operator new[](size_t size, const mrks nothrow_t&) noexcept {
+	return TrackedAlloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+	TrackedFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+	TrackedFree(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	TrackedFree(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+	TrackedFree(ptr);
+}
+
+namespace {
+	enum class BenchCommand {
+		Run,
+		Save,
+		Compare
+	};
+
+	struct BenchOptions {
+		BenchCommand Command = BenchCommand::Run;
+		mrks string BaselineName;
+		mrks string BaselineDir = "bench-baselines";
+		mrks string JsonPath;
+		int Iterations = 200;
+		int Samples = 0; //0 = command default
+		double Threshold = 5.0; //percent
+		double Alpha = 0.05;
+		bool Summary = false;
+		bool Memory = false;
+		bool Perf = false;
+		mrku32 EmitClasses = 0; //0 = no code generation benchmarks
+		mrku32 VMInvocations = 0; //0 = no interpreter benchmarks
+		mrku32 UnicodeClasses = 0; //0 = no UTF-8 benchmarks
+		mrku32 NestedClasses = 0; //0 = no brace matching benchmarks
+		mrku32 BrokenClasses = 0; //0 = no diagnostic benchmarks
+		mrks string EmitDir;
+		mrk PlatformSet Platforms;
+		mrks string TracePath;
+		mrks vector<mrks string> Paths;
+	};
+
+	bool LoadFile(const mrks filesystem::path& path, mrks vector<mrk Source>& sources) {
+		mrk TraceSpan span("Load", path.string());
+
+		mrks ifstream stream(path, mrks ios::binary);
+		if (!stream)
+			return false;
+
+		mrks stringstream buffer;
+		buffer << stream.rdbuf();
+		sources.push_back(mrk Source{ path.string(), buffer.str() });
+		span.Arg("bytes", sources.back().Code.size());
+		return true;
+	}
+
+	bool LoadCorpus(const mrks vector<mrks string>& paths, mrks vector<mrk Source>& sources) {
+		for (const mrks string& path : paths) {
+			mrks error_code ec;
+			if (mrks filesystem::is_directory(path, ec)) {
+				mrks vector<mrks filesystem::path> files;
+				for (auto& entry : mrks filesystem::recursive_directory_iterator(path, ec))
+					if (entry.is_regular_file() && entry.path().extension() == ".mrk")
+						files.push_back(entry.path());
+
+				//directory order is unspecified, keep runs comparable
+				mrks sort(files.begin(), files.end());
+				for (auto& file : files)
+					if (!LoadFile(file, sources))
+						return false;
+			}
+			else if (!LoadFile(path, sources)) {
+				mrks cerr << "Cannot read " << path << '\n';
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	double ElapsedMs(mrks chrono::steady_clock::time_point start) {
+		return mrks chrono::duration<double, mrks milli>(mrks chrono::steady_clock::now() - start).count();
+	}
+
+	struct PhaseCounters {
+		unsigned long long Values[MRK_PERF_COUNTER_COUNT];
+		double Ms;
+	};
+
+	void PrintPerCounter(const mrk PerfCounters& counters, mrk PerfCounter counter, const char* name, double value) {
+		mrks cout << ", " << name << ' ';
+		if (counters.IsAvailable(counter))
+			mrks cout << value;
+		else
+			mrks cout << "n/a";
+	}
+
+	//hardware counters around each front-end phase, wall clock only when they can't be opened
+	void RunPerf(mrks vector<mrk Source>& sources, const mrk PlatformSet& platforms, int iterations, size_t bytes) {
+		mrk PerfCounters counters;
+		bool hardware = counters.Open();
+
+		mrks cout << "Phase counters:\n";
+		if (!hardware)
+			mrks cout << "  hardware counters unavailable (" << counters.GetError() << "), wall clock only\n";
+
+		PhaseCounters phases[MRK_PARSE_PHASE_COUNT] = {};
+		unsigned long long begin[MRK_PERF_COUNTER_COUNT];
+		unsigned long long end[MRK_PERF_COUNTER_COUNT];
+		mrks chrono::steady_clock::time_point beginTime;
+
+		for (int i = 0; i < iterations; i++) {
+			mrk Parser parser(sources);
+			parser.SetPlatforms(platforms);
+			mrk ParserResult result;
+			parser.SetPhaseCallback([&](mrk ParsePhase phase, bool isBegin) {
+				if (isBegin) {
+					beginTime = mrks chrono::steady_clock::now();
+					if (hardware)
+						counters.Read(begin);
+					return;
+				}
+
+				PhaseCounters& stats = phases[(mrku32)phase];
+				if (hardware) {
+					counters.Read(end);
+					for (mrku32 c = 0; c < MRK_PERF_COUNTER_COUNT; c++)
+						stats.Values[c] += end[c] - begin[c];
+				}
+				stats.Ms += ElapsedMs(beginTime);
+			});
+			parser.Start(result);
+		}
+
+		double kb = (double)bytes * iterations / 1024.0;
+		for (mrku32 i = 0; i < MRK_PARSE_PHASE_COUNT; i++) {
+			PhaseCounters& stats = phases[i];
+			mrks cout << "  " << mrk GetPhaseName((mrk ParsePhase)i) << ": " << stats.Ms << " ms";
+
+			if (hardware) {
+				unsigned long long* v = stats.Values;
+				double ipc = v[(mrku32)mrk PerfCounter::Cycles] ? (double)v[(mrku32)mrk PerfCounter::Instructions] / v[(mrku32)mrk PerfCounter::Cycles] : 0;
+				bool hasIpc = counters.IsAvailable(mrk PerfCounter::Cycles) && counters.IsAvailable(mrk PerfCounter::Instructions);
+
+				mrks cout << ", cycles " << v[(mrku32)mrk PerfCounter::Cycles]
+					<< ", instructions " << v[(mrku32)mrk PerfCounter::Instructions]
+					<< ", IPC ";
+				if (hasIpc)
+					mrks cout << ipc;
+				else
+					mrks cout << "n/a";
+
+				PrintPerCounter(counters, mrk PerfCounter::BranchMisses, "branch-misses/KB", v[(mrku32)mrk PerfCounter::BranchMisses] / kb);
+				PrintPerCounter(counters, mrk PerfCounter::L1dMisses, "L1d-misses/KB", v[(mrku32)mrk PerfCounter::L1dMisses] / kb);
+				PrintPerCounter(counters, mrk PerfCounter::LLCMisses, "LLC-misses/KB", v[(mrku32)mrk PerfCounter::LLCMisses] / kb);
+			}
+
+			mrks cout << '\n';
+		}
+	}
+
+	void Report(const char* name, double ms, size_t bytes, int iterations) {
+		double mb = (double)bytes * iterations / (1024.0 * 1024.0);
+		mrks cout << "  " << name << ": " << ms << " ms total, "
+			<< ms / iterations << " ms/iter, "
+			<< (ms > 0 ? mb / (ms / 1000.0) : 0) << " MB/s\n";
+	}
+
+	struct BenchCase {
+		mrks string Name;
+		size_t Bytes;
+		mrks function<void()> Run;
+		double Operations = 0; //work units per run for cases without input bytes, see Unit
+		const char* Unit = "";
+	};
+
+	//interpreter microprograms: straight-line arithmetic on locals, read-modify-write of fields,
+	//and a call per node of a recursive Fib
+	const char* g_VMPrograms =
+		"c Arith {\n"
+		"	m long Run {\n"
+		"		p { long n }\n"
+		"		v long a\n"
+		"		v long b\n"
+		"		v long c\n"
+		"		a = n + 1\n"
+		"		b = 3\n"
+		"		c = a * 3 + b - n\n"
+		"		a = (c ^ b) + 7\n"
+		"		b = a % 13 + c / 5\n"
+		"		c = (a << 3) - (b >> 1)\n"
+		"		a = a * b + c * 7 - n\n"
+		"		b = (a & 1023) | (c & 7)\n"
+		"		c = c + a - b * 2\n"
+		"		a = (a - c) * (b + 1) / 3\n"
+		"		b = ~b + (a ^ c)\n"
+		"		c = c * 5 % 1000003 + n\n"
+		"		a = a + b + c\n"
+		"		b = b * 3 - a / 7\n"
+		"		r a + b + c\n"
+		"	}\n"
+		"}\n"
+		"c Fields {\n"
+		"	v long x\n"
+		"	v long y\n"
+		"	v int z\n"
+		"	v Node next\n"
+		"	m .{ next = Node() }\n"
+		"	m long Run {\n"
+		"		p { long n }\n"
+		"		x = x + n\n"
+		"		y += x * 2\n"
+		"		z = z + 1\n"
+		"		x = y - z\n"
+		"		next.x = x + next.y\n"
+		"		next.y += next.x\n"
+		"		next.z = z ^ 5\n"
+		"		y = next.y % 65536\n"
+		"		x -= next.z\n"
+		"		r x + y + z\n"
+		"	}\n"
+		"}\n"
+		"c Node {\n"
+		"	v long x\n"
+		"	v long y\n"
+		"	v int z\n"
+		"}\n"
+		"c Calls {\n"
+		"	m long Fib {\n"
+		"		p { long n }\n"
+		"		v long result\n"
+		"		result = n\n"
+		"		n > 1 && (result = Fib(n - 1) + Fib(n - 2)) >= 0\n"
+		"		r result\n"
+		"	}\n"
+		"}\n";
+
+	double CountFibCalls(int n) {
+		return n > 1 ? 1 + CountFibCalls(n - 1) + CountFibCalls(n - 2) : 1;
+	}
+
+	struct BenchSamples {
+		mrks string Name;
+		size_t Bytes;
+		int Iterations;
+		mrks vector<double> TimeMs; //per iteration
+		mrks vector<double> Allocations; //per iteration
+		mrks vector<double> PeakBytes; //live heap peak above the sample start
+	};
+
+	const char* g_Metrics[] = { "time_ms", "allocations", "peak_bytes" };
+
+	mrks vector<double>& GetMetric(BenchSamples& samples, int metric) {
+		switch (metric) {
+
+		case 0:
+			return samples.TimeMs;
+
+		case 1:
+			return samples.Allocations;
+
+		}
+
+		return samples.PeakBytes;
+	}
+
+	BenchSamples Sample(BenchCase& bench, int samples, int iterations) {
+		BenchSamples result{ bench.Name, bench.Bytes, iterations };
+
+		for (int s = 0; s < samples; s++) {
+			unsigned long long allocations = g_Allocations.load();
+			long long live = g_LiveBytes.load();
+			g_PeakBytes.store(live);
+
+			auto start = mrks chrono::steady_clock::now();
+			for (int i = 0; i < iterations; i++)
+				bench.Run();
+			double ms = ElapsedMs(start);
+
+			result.TimeMs.push_back(ms / iterations);
+			result.Allocations.push_back((double)(g_Allocations.load() - allocations) / iterations);
+			result.PeakBytes.push_back((double)(g_PeakBytes.load() - live));
+		}
+
+		return result;
+	}
+
+	mrk JsonValue ToJson(mrks vector<BenchSamples>& results, const BenchOptions& options) {
+		mrk JsonValue root = mrk JsonValue::MakeObject();
+		root.Set("version", MRK_BENCH_RESULT_VERSION);
+#if defined(__VERSION__)
+		root.Set("compiler", __VERSION__);
+#elif defined(_MSC_FULL_VER)
+		root.Set("compiler", "msvc " + mrks to_string(_MSC_FULL_VER));
+#endif
+		root.Set("samples", (int)results.front().TimeMs.size());
+		root.Set("iterations", options.Iterations);
+
+		mrk JsonValue& benchmarks = root.Set("benchmarks", mrk JsonValue::MakeArray());
+		for (BenchSamples& samples : results) {
+			mrk JsonValue bench = mrk JsonValue::MakeObject();
+			bench.Set("name", samples.Name);
+			bench.Set("bytes", (unsigned long long)samples.Bytes);
+
+			mrk JsonValue& metrics = bench.Set("metrics", mrk JsonValue::MakeObject());
+			for (int m = 0; m < 3; m++) {
+				mrk JsonValue values = mrk JsonValue::MakeArray();
+				for (double v : GetMetric(samples, m))
+					values.Push(v);
+				metrics.Set(g_Metrics[m], values);
+			}
+
+			benchmarks.Push(bench);
+		}
+
+		return root;
+	}
+
+	bool FromJson(const mrk JsonValue& root, mrks vector<BenchSamples>& results, mrks string& error) {
+		if (root.Get("version").AsInt() != MRK_BENCH_RESULT_VERSION) {
+			error = "unsupported result version";
+			return false;
+		}
+
+		for (const mrk JsonValue& bench : root.Get("benchmarks").GetItems()) {
+			BenchSamples samples{ bench.Get("name").AsString(), (size_t)bench.Get("bytes").AsInt(), (int)root.Get("iterations").AsInt() };
+			for (int m = 0; m < 3; m++)
+				for (const mrk JsonValue& v : bench.Get("metrics").Get(g_Metrics[m]).GetItems())
+					GetMetric(samples, m).push_back(v.AsNumber());
+
+			results.push_back(samples);
+		}
+
+		return true;
+	}
+
+	bool WriteJson(const mrks string& path, const mrk JsonValue& value) {
+		mrks error_code ec;
+		mrks filesystem::path parent = mrks filesystem::path(path).parent_path();
+		if (!parent.empty())
+			mrks filesystem::create_directories(parent, ec);
+
+		mrks ofstream stream(path, mrks ios::binary);
+		if (!stream)
+			return false;
+
+		value.Write(stream);
+		stream << '\n';
+		return (bool)stream;
+	}
+
+	bool ReadJson(const mrks string& path, mrk JsonValue& value, mrks string& error) {
+		mrks ifstream stream(path, mrks ios::binary);
+		if (!stream) {
+			error = "cannot read " + path;
+			return false;
+		}
+
+		mrks stringstream buffer;
+		buffer << stream.rdbuf();
+		return mrk JsonValue::Parse(buffer.str(), value, &error);
+	}
+
+	mrks string GetBaselinePath(const BenchOptions& options) {
+		return (mrks filesystem::path(options.BaselineDir) / (options.BaselineName + ".json")).string();
+	}
+
+	//every metric is lower-is-better, a regression needs both significance and size
+	int Compare(mrks vector<BenchSamples>& baseline, mrks vector<BenchSamples>& current, const BenchOptions& options) {
+		int regressions = 0;
+
+		mrks cout << "Comparing against '" << options.BaselineName << "' (threshold " << options.Threshold
+			<< "%, alpha " << options.Alpha << ")\n";
+
+		for (BenchSamples& cur : current) {
+			auto base = mrks find_if(baseline.begin(), baseline.end(), [&](BenchSamples& b) { return b.Name == cur.Name; });
+			if (base == baseline.end()) {
+				mrks cout << "  " << cur.Name << ": not in baseline, skipped\n";
+				continue;
+			}
+
+			for (int m = 0; m < 3; m++) {
+				mrks vector<double>& now = GetMetric(cur, m);
+				mrks vector<double>& before = GetMetric(*base, m);
+				if (now.empty() || before.empty())
+					continue;
+
+				double medianBefore = mrk Median(before);
+				double medianNow = mrk Median(now);
+				double change = medianBefore != 0 ? (medianNow - medianBefore) * 100.0 / medianBefore : (medianNow != 0 ? 100.0 : 0.0);
+				mrk MannWhitneyResult test = mrk MannWhitneyU(now, before);
+
+				const char* verdict = "same";
+				if (test.PGreater < options.Alpha && change > options.Threshold) {
+					verdict = "REGRESSION";
+					regressions++;
+				}
+				else if (test.PTwoSided < options.Alpha && change < -options.Threshold)
+					verdict = "improved";
+				else if (test.PTwoSided < options.Alpha)
+					verdict = "within threshold";
+
+				mrks cout << "  " << cur.Name << ' ' << g_Metrics[m] << ": " << medianBefore << " -> " << medianNow
+					<< " (" << (change >= 0 ? "+" : "") << change << "%, p=" << test.PGreater
+					<< (test.Exact ? " exact" : "") << ") " << verdict << '\n';
+			}
+		}
+
+		if (regressions)
+			mrks cout << regressions << " significant regression(s)\n";
+
+		return regressions ? MRK_BENCH_EXIT_REGRESSION : 0;
+	}
+
+	void PrintUsage() {
+		mrks cout << "usage: mrk_bench [run|save <name>|compare <name>] [options] [file|dir...]\n"
+			"  --iterations N       iterations per sample (default 200)\n"
+			"  --samples N          samples per benchmark (run: 1, save/compare: 10)\n"
+			"  --json FILE          write the samples as JSON\n"
+			"  --baseline-dir DIR   where named baselines live (default bench-baselines)\n"
+			"  --threshold PCT      smallest median change reported as regression (default 5)\n"
+			"  --alpha P            significance level of the Mann-Whitney test (default 0.05)\n"
+			"  --summary            print the total for cmake/PGO.cmake\n"
+			"  --memory             print the memory report of one parse\n"
+			"  --perf               hardware counters per front-end phase\n"
+			"  --emit N             also parse and emit C++, C# and Java for a generated corpus of N classes\n"
+			"                       and parse a method body of N generated 64 operand statements\n"
+			"  --emit-dir DIR       output tree of --emit (default <tmp>/mrk_bench_emit)\n"
+			"  --vm N               also interpret the arithmetic, field and call microprograms N times\n"
+			"                       per iteration, with threaded and switch dispatch\n"
+			"  --unicode N          also validate and lex a generated corpus of N classes, with ASCII names\n"
+			"                       and with Arabic, Greek, Cyrillic, Japanese and Korean ones\n"
+			"  --nested N           also match braces of N generated classes nested 64 deep, from the bytes\n"
+			"                       alone and with each scope pass\n"
+			"  --broken N           also parse N generated classes with 16 broken fields each and report\n"
+			"                       their diagnostics as text and JSON lines\n"
+			"  --platform NAME      keep $NAME regions, skip the other platforms (repeatable)\n"
+			"  -ftime-trace[=FILE]  write a Chrome trace of the front end\n";
+	}
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+
+	int first = 1;
+	if (argc > 1) {
+		mrks string command = argv[1];
+		if (command == "run")
+			first = 2;
+		else if ((command == "save" || command == "compare") && argc > 2) {
+			options.Command = command == "save" ? BenchCommand::Save : BenchCommand::Compare;
+			options.BaselineName = argv[2];
+			first = 3;
+		}
+	}
+
+	for (int i = first; i < argc; i++) {
+		mrks string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if ((arg == "-n" || arg == "--iterations") && hasValue)
+			options.Iterations = mrks max(1, atoi(argv[++i]));
+		else if (arg == "--samples" && hasValue)
+			options.Samples = mrks max(1, atoi(argv[++i]));
+		else if (arg == "--json" && hasValue)
+			options.JsonPath = argv[++i];
+		else if (arg == "--baseline-dir" && hasValue)
+			options.BaselineDir = argv[++i];
+		else if (arg == "--threshold" && hasValue)
+			options.Threshold = atof(argv[++i]);
+		else if (arg == "--alpha" && hasValue)
+			options.Alpha = atof(argv[++i]);
+		else if (arg == "--summary")
+			options.Summary = true;
+		else if (arg == "--memory")
+			options.Memory = true;
+		else if (arg == "--perf")
+			options.Perf = true;
+		else if (arg == "--emit" && hasValue)
+			options.EmitClasses = (mrku32)mrks max(0, atoi(argv[++i]));
+		else if (arg == "--emit-dir" && hasValue)
+			options.EmitDir = argv[++i];
+		else if (arg == "--vm" && hasValue)
+			options.VMInvocations = (mrku32)mrks max(0, atoi(argv[++i]));
+		else if (arg == "--unicode" && hasValue)
+			options.UnicodeClasses = (mrku32)mrks max(0, atoi(argv[++i]));
+		else if (arg == "--nested" && hasValue)
+			options.NestedClasses = (mrku32)mrks max(0, atoi(argv[++i]));
+		else if (arg == "--broken" && hasValue)
+			options.BrokenClasses = (mrku32)mrks max(0, atoi(argv[++i]));
+		else if (arg == "--platform" && hasValue)
+			options.Platforms.Enable(argv[++i]);
+		else if (arg == "-ftime-trace")
+			options.TracePath = "mrk_trace.json";
+		else if (arg.rfind("-ftime-trace=", 0) == 0)
+			options.TracePath = arg.substr(13);
+		else if (arg == "-h" || arg == "--help" || arg[0] == '-') {
+			PrintUsage();
+			return arg[0] == '-' && arg != "-h" && arg != "--help" ? 1 : 0;
+		}
+		else
+			options.Paths.push_back(arg);
+	}
+
+	if (!options.Samples)
+		options.Samples = options.Command == BenchCommand::Run ? 1 : 10;
+
+	if (options.Paths.empty())
+		options.Paths.push_back(MRK_BENCH_CORPUS_DIR);
+
+	if (!options.TracePath.empty()) {
+		mrk Trace::Enable();
+		mrk Trace::NameThread("mrk_bench");
+	}
+
+	mrks vector<mrk Source> sources;
+	if (!LoadCorpus(options.Paths, sources) || sources.empty()) {
+		mrks cerr << "No sources to benchmark\n";
+		return 1;
+	}
+
+	size_t bytes = 0;
+	for (mrk Source& src : sources)
+		bytes += src.Code.size();
+
+	mrks cout << "Front-end benchmark, " << sources.size() << " sources, "
+		<< bytes << " bytes, " << options.Samples << " x " << options.Iterations << " iterations\n";
+
+	size_t tokenCount = 0;
+	size_t errorCount = 0;
+
+	//one lexer for every lex case, like a worker going through a build
+	mrk Lexer lexer;
+
+	mrks vector<BenchCase> cases = {
+		//lexer only
+		BenchCase{ "lex", bytes, [&]() {
+			for (mrk Source& src : sources)
+				tokenCount += lexer.Lex(src.Code, false, &options.Platforms).GetCount();
+		} },
+
+		//full front end, lex + scopes + parse
+		BenchCase{ "parse", bytes, [&]() {
+			mrk Parser parser(sources);
+			parser.SetPlatforms(options.Platforms);
+			mrk ParserResult result;
+			parser.Start(result);
+			errorCount += result.Errors.size();
+		} }
+	};
+
+	//the same classes with ASCII and with mixed-script names, ASCII input must not pay for Unicode
+	mrks string asciiCorpus;
+	mrks string mixedCorpus;
+
+	if (options.UnicodeClasses) {
+		asciiCorpus = mrk GenerateCorpus(options.UnicodeClasses);
+		mixedCorpus = mrk GenerateMixedScriptCorpus(options.UnicodeClasses);
+
+		for (mrks string* text : { &asciiCorpus, &mixedCorpus }) {
+			const char* script = text == &asciiCorpus ? "ascii" : "mixed";
+			cases.push_back(BenchCase{ mrks string("utf8-") + script, text->size(), [&, text]() {
+				if (mrk ValidateUtf8(text->data(), text->size()) != text->size())
+					errorCount++;
+			} });
+
+			cases.push_back(BenchCase{ mrks string("lex-") + script, text->size(), [&, text]() {
+				tokenCount += lexer.Lex(*text, false, &options.Platforms).GetCount();
+			} });
+		}
+
+		mrks cout << "Unicode corpus: " << options.UnicodeClasses << " classes, " << asciiCorpus.size()
+			<< " bytes ASCII, " << mixedCorpus.size() << " bytes mixed-script\n";
+	}
+
+	//deep, brace heavy nesting, the scope passes differ only in the Scopes phase
+	mrks vector<mrk Source> nested;
+	mrk StructuralIndex structuralIndex;
+	mrks vector<mrk BracePair> bracePairs;
+	double scopesMs[3] = {}; //by mrk ScopePass
+
+	if (options.NestedClasses) {
+		nested.push_back(mrk Source{ "nested.mrk", mrk GenerateNestedCorpus(options.NestedClasses, MRK_BENCH_NESTED_DEPTH) });
+		const mrks string& text = nested.front().Code;
+
+		//stage 1 and brace pairing alone, the scope tree before there are tokens
+		cases.push_back(BenchCase{ "index-nested", text.size(), [&]() {
+			mrk BuildStructuralIndex(text.data(), text.size(), structuralIndex);
+			errorCount += mrk MatchBraces(text.data(), structuralIndex, bracePairs);
+		} });
+
+		cases.push_back(BenchCase{ "lex-nested", text.size(), [&]() {
+			tokenCount += lexer.Lex(text, false, &options.Platforms).GetCount();
+		} });
+
+		for (mrk ScopePass pass : { mrk ScopePass::Braces, mrk ScopePass::Index, mrk ScopePass::Tokens }) {
+			const char* name = pass == mrk ScopePass::Braces ? "parse-nested" : (pass == mrk ScopePass::Index ? "parse-nested-index" : "parse-nested-tokens");
+			cases.push_back(BenchCase{ name, text.size(), [&, pass]() {
+				mrk Parser parser(nested);
+				parser.SetPlatforms(options.Platforms);
+				parser.SetScopePass(pass);
+
+				mrks chrono::steady_clock::time_point begin;
+				parser.SetPhaseCallback([&](mrk ParsePhase phase, bool isBegin) {
+					if (phase != mrk ParsePhase::Scopes)
+						return;
+
+					if (isBegin)
+						begin = mrks chrono::steady_clock::now();
+					else
+						scopesMs[(mrku32)pass] += ElapsedMs(begin);
+				});
+
+				mrk ParserResult result;
+				parser.Start(result);
+				errorCount += result.Errors.size();
+			} });
+		}
+
+		mrks cout << "Nested corpus: " << options.NestedClasses << " classes, " << MRK_BENCH_NESTED_DEPTH
+			<< " deep, " << text.size() << " bytes\n";
+	}
+
+	//error heavy input, the parse stores plain errors and the text is only built when reported
+	mrks vector<mrk Source> broken;
+	mrks unique_ptr<mrk Parser> brokenParser;
+	mrk ParserResult brokenResult;
+	size_t brokenCount = 0; //expected, kept out of errorCount
+	size_t reportedBytes = 0;
+	mrk DiagnosticSink countSink = [&reportedBytes](const mrks string& line) { reportedBytes += line.size(); };
+
+	if (options.BrokenClasses) {
+		broken.push_back(mrk Source{ "broken.mrk", mrk GenerateBrokenCorpus(options.BrokenClasses, MRK_BENCH_BROKEN_FIELDS) });
+		const mrks string& text = broken.front().Code;
+
+		cases.push_back(BenchCase{ "parse-broken", text.size(), [&]() {
+			mrk Parser parser(broken);
+			mrk ParserResult result;
+			parser.Start(result);
+			brokenCount += result.Errors.size();
+		} });
+
+		//reported from one kept parse, its errors point at the parser's sources
+		brokenParser = mrks make_unique<mrk Parser>(broken);
+		brokenParser->Start(brokenResult);
+
+		for (mrk DiagnosticFormat format : { mrk DiagnosticFormat::Text, mrk DiagnosticFormat::JsonLines }) {
+			const char* name = format == mrk DiagnosticFormat::Text ? "report-broken" : "report-broken-jsonl";
+			cases.push_back(BenchCase{ name, text.size(), [&, format]() {
+				mrk DiagnosticWriter writer(format, 0, countSink);
+				for (const mrk Error& err : brokenResult.Errors)
+					writer.Report(err, "broken.mrk");
+				writer.Finish();
+			} });
+		}
+
+		mrks cout << "Broken corpus: " << options.BrokenClasses << " classes, " << text.size() << " bytes, "
+			<< brokenResult.Errors.size() << " errors\n";
+	}
+
+	//code generation runs on a synthetic corpus, corpus/ is too small to measure output throughput
+	mrks vector<mrk Source> generated;
+	mrks vector<mrk Source> expressions;
+	mrk OutputWriter writer;
+	mrks unique_ptr<mrk Parser> emitParser;
+	mrk Model model;
+	mrk Semantic emitSemantic;
+	mrk Model reachableModel;
+	mrks vector<mrks string> emitRoots;
+	mrks vector<mrk EmitRequest> requests;
+	mrks vector<mrk EmitRequest> reachableRequests;
+	mrks unique_ptr<mrk WorkPool> pool;
+	mrks unique_ptr<mrk WorkPool> serialPool;
+
+	if (options.EmitClasses) {
+		generated.push_back(mrk Source{ "generated.mrk", mrk GenerateCorpus(options.EmitClasses) });
+		pool = mrks make_unique<mrk WorkPool>();
+		serialPool = mrks make_unique<mrk WorkPool>(1);
+
+		if (options.EmitDir.empty())
+			options.EmitDir = (mrks filesystem::temp_directory_path() / "mrk_bench_emit").string();
+
+		for (mrku32 i = 0; i < MRK_EMIT_TARGET_COUNT; i++) {
+			mrk EmitTarget target = (mrk EmitTarget)i;
+			requests.push_back(mrk EmitRequest{ target, (mrks filesystem::path(options.EmitDir) / mrk GetTargetName(target)).string() });
+
+			mrks error_code ec;
+			mrks filesystem::create_directories(requests.back().OutputDir, ec);
+		}
+
+		cases.push_back(BenchCase{ "parse-generated", generated.front().Code.size(), [&]() {
+			mrk Parser parser(generated);
+			parser.SetPlatforms(options.Platforms);
+			mrk ParserResult result;
+			parser.Start(result);
+			errorCount += result.Errors.size();
+		} });
+
+		//one body of N long statements, parsing has to stay linear in the operand count
+		expressions.push_back(mrk Source{ "expressions.mrk", mrk GenerateExpressions(options.EmitClasses, 64) });
+		cases.push_back(BenchCase{ "parse-expressions", expressions.front().Code.size(), [&]() {
+			mrk Parser parser(expressions);
+			mrk ParserResult result;
+			parser.Start(result);
+			errorCount += result.Errors.size();
+		} });
+
+		//parse once, the emit cases measure the backends alone
+		mrk ParserResult result;
+		emitParser = mrks make_unique<mrk Parser>(generated);
+		emitParser->SetPlatforms(options.Platforms);
+		emitParser->Start(result);
+		errorCount += result.Errors.size();
+
+		cases.push_back(BenchCase{ "resolve", generated.front().Code.size(), [&]() {
+			mrk Model resolved;
+			mrk ResolveModel(*emitParser, resolved);
+		} });
+
+		mrk ResolveModel(*emitParser, model);
+
+		//the emitted model carries folded constants, like a real build
+		mrks vector<mrk Error> semanticErrors;
+		emitSemantic.Analyze(model, semanticErrors);
+		errorCount += semanticErrors.size();
+
+		//name resolution on the resolved model, rebuilds every table per run
+		cases.push_back(BenchCase{ "semantic", generated.front().Code.size(), [&]() {
+			mrk Semantic semantic;
+			mrks vector<mrk Error> errors;
+			semantic.Analyze(model, errors);
+			errorCount += errors.size();
+		} });
+
+		//bytes of one run, throughput is reported for the generated output
+		for (mrk EmitRequest& request : requests) {
+			BenchCase emit{ mrks string("emit-") + mrk GetTargetName(request.Target), 0, [&]() {
+				mrks unique_ptr<mrk Emitter> emitter = mrk CreateEmitter(request.Target, writer, request.OutputDir);
+				if (!emitter->Emit(model.Modules.front()))
+					errorCount++;
+			} };
+
+			unsigned long long before = writer.GetBytesWritten();
+			emit.Run();
+			emit.Bytes = (size_t)(writer.GetBytesWritten() - before);
+			cases.push_back(emit);
+		}
+
+		//every backend at once, one job per top-level class on a pool with a thread per core, then on one thread
+		BenchCase all{ "emit-all", 0, [&]() {
+			for (mrk EmitResult& emitted : mrk EmitTargets(model, requests, *pool))
+				if (!emitted.Success)
+					errorCount++;
+		} };
+
+		for (mrk EmitResult& emitted : mrk EmitTargets(model, requests, *pool))
+			all.Bytes += (size_t)emitted.Bytes;
+		cases.push_back(all);
+
+		BenchCase serial{ "emit-all-serial", all.Bytes, [&]() {
+			for (mrk EmitResult& emitted : mrk EmitTargets(model, requests, *serialPool))
+				if (!emitted.Success)
+					errorCount++;
+		} };
+		cases.push_back(serial);
+
+		//regenerating an unchanged model, every root is hashed and found in the manifest
+		mrks vector<mrk EmitRequest> incremental = requests;
+		for (mrk EmitRequest& request : incremental) {
+			request.OutputDir += "-incremental";
+			request.Incremental = true;
+		}
+
+		mrk EmitTargets(model, incremental, *pool);
+		BenchCase unchanged{ "emit-unchanged", generated.front().Code.size(), [&, incremental]() {
+			for (mrk EmitResult& emitted : mrk EmitTargets(model, incremental, *pool))
+				if (!emitted.Success || emitted.Written)
+					errorCount++;
+		} };
+		cases.push_back(unchanged);
+
+		//one class a tenth of the way in as the root, it reaches a part of the classes declared before it
+		emitRoots.push_back("Gen" + mrks to_string(options.EmitClasses / 10));
+		cases.push_back(BenchCase{ "reachability", generated.front().Code.size(), [&]() {
+			mrk Reachability reachability(emitSemantic);
+			mrks vector<mrk Error> errors;
+			reachability.Analyze(model, emitRoots, 1, errors);
+			errorCount += errors.size();
+		} });
+
+		mrk Reachability reachability(emitSemantic);
+		mrks vector<mrk Error> rootErrors;
+		reachability.Analyze(model, emitRoots, 1, rootErrors);
+		errorCount += rootErrors.size();
+		reachableModel = model;
+		reachability.Prune(reachableModel);
+
+		reachableRequests = requests;
+		for (mrk EmitRequest& request : reachableRequests)
+			request.OutputDir += "-reachable";
+
+		//output scales with what the root uses
+		BenchCase reachable{ "emit-reachable", 0, [&]() {
+			for (mrk EmitResult& emitted : mrk EmitTargets(reachableModel, reachableRequests, *pool))
+				if (!emitted.Success)
+					errorCount++;
+		} };
+
+		for (mrk EmitResult& emitted : mrk EmitTargets(reachableModel, reachableRequests, *pool))
+			reachable.Bytes += (size_t)emitted.Bytes;
+		cases.push_back(reachable);
+
+		mrks cout << "Reachable from " << emitRoots.front() << ": " << reachability.GetKept().Classes << " of " << reachability.GetTotal().Classes
+			<< " classes, emitting " << reachable.Bytes << " of " << all.Bytes << " bytes\n";
+
+		mrks cout << "Generated corpus: " << options.EmitClasses << " classes, " << generated.front().Code.size()
+			<< " bytes, emitting " << all.Bytes << " bytes for " << requests.size() << " targets into " << options.EmitDir
+			<< ", " << pool->GetWorkerCount() << " worker(s)\n";
+	}
+
+	//interpreter throughput, compiled once, one VM per dispatch mode
+	mrks unique_ptr<mrk Parser> vmParser;
+	mrk Model vmModel;
+	mrk Semantic vmSemantic;
+	mrk Program program;
+	mrks vector<mrks unique_ptr<mrk VM>> machines;
+
+	if (options.VMInvocations) {
+		mrks vector<mrk Error> vmErrors;
+		mrk ParserResult result;
+		vmParser = mrks make_unique<mrk Parser>(mrks vector<mrk Source> { mrk Source{ "vm.mrk", g_VMPrograms } });
+		vmParser->Start(result);
+		mrk ResolveModel(*vmParser, vmModel);
+		vmSemantic.Analyze(vmModel, vmErrors);
+		mrk BytecodeCompiler(vmSemantic).Compile(vmModel, program, vmErrors);
+		errorCount += result.Errors.size() + vmErrors.size();
+
+		const int fibArgument = 12;
+		mrku32 count = options.VMInvocations;
+
+		for (mrk Dispatch dispatch : { mrk Dispatch::Threaded, mrk Dispatch::Switch }) {
+			machines.push_back(mrks make_unique<mrk VM>(program));
+			mrk VM& vm = *machines.back();
+			vm.SetDispatch(dispatch);
+			mrks string suffix = dispatch == mrk Dispatch::Switch ? "-switch" : "";
+
+			const char* names[] = { "Arith", "Fields", "Calls" };
+			for (const char* name : names) {
+				mrku32 _class = program.FindClass(name);
+				mrku32 method = program.FindMethod(_class, name == names[2] ? "Fib" : "Run");
+				mrk Object* self = vm.New(_class);
+				if (name == names[1])
+					vm.Invoke(program.Classes[_class].Methods[0], self, 0, 0);
+
+				//straight-line bodies run every instruction once, Fib is measured in calls
+				long long fixed = name == names[2] ? fibArgument : -1;
+				BenchCase bench{ mrks string("vm-") + (name == names[0] ? "arith" : (name == names[1] ? "fields" : "calls")) + suffix, 0, [&vm, method, self, count, fixed, &errorCount]() {
+					mrk Value arg, result;
+					for (mrku32 i = 0; i < count; i++) {
+						arg.Int = fixed >= 0 ? fixed : (long long)i;
+						if (!vm.Invoke(method, self, &arg, &result))
+							errorCount++;
+					}
+				} };
+
+				bench.Operations = name == names[2] ? CountFibCalls(fibArgument) * count : (double)program.Methods[method].CodeLength * count;
+				bench.Unit = name == names[2] ? "calls" : "instructions";
+				cases.push_back(bench);
+			}
+		}
+
+		mrks cout << "VM microprograms: " << program.Code.size() << " instructions, "
+			<< options.VMInvocations << " invocations per iteration, Fib(" << fibArgument << ")\n";
+	}
+
+	mrks vector<BenchSamples> results;
+	double totalMs = 0;
+	for (BenchCase& bench : cases) {
+		results.push_back(Sample(bench, options.Samples, options.Iterations));
+
+		BenchSamples& samples = results.back();
+		double ms = mrk Median(samples.TimeMs) * options.Iterations;
+		totalMs += ms;
+		Report(bench.Name.c_str(), ms, bench.Bytes, options.Iterations);
+		if (bench.Operations > 0)
+			mrks cout << "    " << bench.Operations * options.Iterations / (ms * 1000.0) << " M " << bench.Unit << "/s\n";
+		mrks cout << "    allocations/iter: " << mrk Median(samples.Allocations)
+			<< ", peak heap: " << mrk Median(samples.PeakBytes) << " B\n";
+	}
+
+	int runs = options.Samples * options.Iterations;
+	mrks cout << "  tokens/iter: " << tokenCount / runs
+		<< ", errors/iter: " << errorCount / runs << '\n';
+
+	if (options.BrokenClasses)
+		mrks cout << "  broken errors/iter: " << brokenCount / runs << ", reported bytes/iter: " << reportedBytes / runs << '\n';
+
+	if (options.NestedClasses)
+		mrks cout << "  nested Scopes phase/iter: " << scopesMs[(mrku32)mrk ScopePass::Braces] / runs << " ms from lexer braces, "
+			<< scopesMs[(mrku32)mrk ScopePass::Index] / runs << " ms from the structural index, "
+			<< scopesMs[(mrku32)mrk ScopePass::Tokens] / runs << " ms walking tokens\n";
+
+	if (options.Perf)
+		RunPerf(sources, options.Platforms, options.Iterations, bytes);
+
+	if (options.Memory) {
+		//one extra parse with accounting on, kept out of the timed loop
+		mrk MemoryReport report;
+		mrk Parser parser(sources);
+		parser.SetPlatforms(options.Platforms);
+		mrk ParserResult result;
+		parser.SetMemoryReport(&report);
+		parser.Start(result);
+
+		mrks cout << "Memory report:\n";
+		report.Print(mrks cout);
+	}
+
+	//single machine readable line, consumed by cmake/PGO.cmake
+	if (options.Summary)
+		mrks cout << "mrk_bench_total_ms " << totalMs << '\n';
+
+	if (!options.TracePath.empty()) {
+		if (!mrk Trace::Write(options.TracePath)) {
+			mrks cerr << "Cannot write trace " << options.TracePath << '\n';
+			return 1;
+		}
+		mrks cout << "Trace written to " << options.TracePath << '\n';
+	}
+
+	mrk JsonValue json = ToJson(results, options);
+	if (!options.JsonPath.empty() && !WriteJson(options.JsonPath, json)) {
+		mrks cerr << "Cannot write " << options.JsonPath << '\n';
+		return 1;
+	}
+
+	int status = errorCount ? 2 : 0;
+
+	switch (options.Command) {
+
+	case BenchCommand::Save:
+		if (!WriteJson(GetBaselinePath(options), json)) {
+			mrks cerr << "Cannot write baseline " << GetBaselinePath(options) << '\n';
+			return 1;
+		}
+		mrks cout << "Baseline '" << options.BaselineName << "' saved to " << GetBaselinePath(options) << '\n';
+		break;
+
+	case BenchCommand::Compare: {
+		mrk JsonValue baselineJson;
+		mrks vector<BenchSamples> baseline;
+		mrks string error;
+		if (!ReadJson(GetBaselinePath(options), baselineJson, error) || !FromJson(baselineJson, baseline, error)) {
+			mrks cerr << "Cannot load baseline '" << options.BaselineName << "': " << error << '\n';
+			return 1;
+		}
+
+		int compared = Compare(baseline, results, options);
+		if (compared)
+			status = compared;
+		break;
+	}
+
+	default:
+		break;
+
+	}
+
+	return status;
+}
+
+#endif
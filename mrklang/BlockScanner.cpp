@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "BlockScanner.h"
+
+#include <cstring>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace MRK {
+	namespace {
+		const uint64_t g_Ones = 0x0101010101010101ull;
+		const uint64_t g_Highs = 0x8080808080808080ull;
+
+		//high bit set in every byte of v equal to c, exact for the lowest match
+		inline uint64_t MatchByte(uint64_t v, unsigned char c) {
+			uint64_t x = v ^ (g_Ones * c);
+			return (x - g_Ones) & ~x & g_Highs;
+		}
+
+		inline unsigned LowestByte(uint64_t mask) {
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward64(&index, mask);
+			return (unsigned)index >> 3;
+#else
+			return (unsigned)__builtin_ctzll(mask) >> 3;
+#endif
+		}
+
+		inline bool IsSpecial(char c) {
+			return c == '{' || c == '}' || c == '"' || c == '\'' || c == '/';
+		}
+
+		//memchr for the five characters that matter, eight bytes per step
+		const char* FindSpecial(const char* p, const char* end) {
+			while (end - p >= 8) {
+				uint64_t v;
+				memcpy(&v, p, 8);
+
+				uint64_t mask = MatchByte(v, '{') | MatchByte(v, '}') | MatchByte(v, '"') | MatchByte(v, '\'') | MatchByte(v, '/');
+				if (mask)
+					return p + LowestByte(mask);
+
+				p += 8;
+			}
+
+			while (p < end && !IsSpecial(*p))
+				p++;
+
+			return p;
+		}
+
+		//p is after the opening quote, returns after the closing one
+		//an unterminated literal stops at the end of its line
+		const char* SkipQuoted(const char* p, const char* end, char quote) {
+			const char* line = (const char*)memchr(p, '\n', end - p);
+			if (!line)
+				line = end;
+
+			while (p < line) {
+				const char* hit = (const char*)memchr(p, quote, line - p);
+				if (!hit)
+					return line;
+
+				//count the backslashes in front, an even number leaves the quote unescaped
+				const char* back = hit;
+				while (back > p && back[-1] == '\\')
+					back--;
+
+				if ((hit - back) % 2 == 0)
+					return hit + 1;
+
+				p = hit + 1;
+			}
+
+			return line;
+		}
+
+		//R"delim( ... )delim", p is after the quote
+		const char* SkipRawString(const char* p, const char* end) {
+			const char* open = (const char*)memchr(p, '(', end - p);
+			if (!open || open - p > 16)
+				return SkipQuoted(p, end, '"');
+
+			size_t delimLen = open - p;
+			for (const char* q = open + 1; q < end; q++) {
+				q = (const char*)memchr(q, ')', end - q);
+				if (!q)
+					return end;
+
+				if ((size_t)(end - q) > delimLen + 1 && memcmp(q + 1, p, delimLen) == 0 && q[1 + delimLen] == '"')
+					return q + delimLen + 2;
+			}
+
+			return end;
+		}
+
+		//@"..." with "" as the only escape
+		const char* SkipVerbatim(const char* p, const char* end) {
+			while (p < end) {
+				const char* hit = (const char*)memchr(p, '"', end - p);
+				if (!hit)
+					return end;
+
+				if (hit + 1 < end && hit[1] == '"') {
+					p = hit + 2;
+					continue;
+				}
+
+				return hit + 1;
+			}
+
+			return end;
+		}
+
+		//"""...""", p is after the three quotes
+		const char* SkipTextBlock(const char* p, const char* end) {
+			while (p < end) {
+				const char* hit = (const char*)memchr(p, '"', end - p);
+				if (!hit || end - hit < 3)
+					return end;
+
+				if (hit[1] == '"' && hit[2] == '"' && (hit == p || hit[-1] != '\\'))
+					return hit + 3;
+
+				p = hit + 1;
+			}
+
+			return end;
+		}
+
+		bool IsWordChar(char c) {
+			return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+		}
+
+		//' inside a number literal such as 1'000'000
+		bool IsDigitSeparator(const char* text, const char* quote) {
+			const char* p = quote;
+			while (p > text && (IsWordChar(p[-1]) || p[-1] == '\'' || p[-1] == '.'))
+				p--;
+
+			return p < quote && *p >= '0' && *p <= '9';
+		}
+	}
+
+	size_t FindBlockEnd(const char* text, size_t size, size_t pos, BlockSyntax syntax, bool* closed) {
+		if (closed)
+			*closed = false;
+
+		const char* end = text + size;
+		const char* p = text + pos;
+		int depth = 0;
+
+		while ((p = FindSpecial(p, end)) < end) {
+			const char* at = p++;
+
+			switch (*at) {
+
+			case '{':
+				depth++;
+				break;
+
+			case '}':
+				if (depth == 0)
+					return at - text;
+
+				if (--depth == 0) {
+					if (closed)
+						*closed = true;
+					return p - text;
+				}
+				break;
+
+			case '/':
+				if (p < end && *p == '/') {
+					p = (const char*)memchr(p, '\n', end - p);
+					if (!p)
+						p = end;
+				}
+				else if (p < end && *p == '*') {
+					p++;
+					while (p < end) {
+						p = (const char*)memchr(p, '*', end - p);
+						if (!p) {
+							p = end;
+							break;
+						}
+
+						if (++p < end && *p == '/') {
+							p++;
+							break;
+						}
+					}
+				}
+				break;
+
+			case '\'':
+				if (syntax == BlockSyntax::Cpp && IsDigitSeparator(text, at))
+					break;
+
+				p = SkipQuoted(p, end, '\'');
+				break;
+
+			case '"':
+				if (syntax == BlockSyntax::Cpp && at > text && at[-1] == 'R')
+					p = SkipRawString(p, end);
+				else if (syntax == BlockSyntax::Cs && at > text && (at[-1] == '@' || (at[-1] == '$' && at - 1 > text && at[-2] == '@')))
+					p = SkipVerbatim(p, end);
+				else if (syntax == BlockSyntax::Java && end - p >= 2 && p[0] == '"' && p[1] == '"')
+					p = SkipTextBlock(p + 2, end);
+				else
+					p = SkipQuoted(p, end, '"');
+				break;
+
+			}
+		}
+
+		return size;
+	}
+	size_t FindDirectiveEnd(const char* text, size_t size, size_t pos) {
+		//words that start a declaration, the first one after the directive belongs to it
+		//with the number of type and name words that follow it, never keywords even if spelled like one
+		//an include runs to its ';' and a return to the end of the block around it
+		static const struct {
+			const char* Word;
+			size_t Operands;
+		} keywords[] = {
+			{ "i", SIZE_MAX }, { "c", 1 }, { "m", 2 }, { "v", 2 }, { "r", SIZE_MAX }, { "p", 0 },
+			{ "__cpp", 0 }, { "__cs", 0 }, { "__java", 0 }
+		};
+
+		BlockSyntax syntax = BlockSyntax::Mrk;
+		bool declared = false;
+		size_t operands = 0;
+		size_t p = pos;
+		while (p < size) {
+			char c = text[p];
+			if (c == '{')
+				return FindBlockEnd(text, size, p, syntax);
+
+			if (c == '}' || (c == '$' && declared))
+				return p;
+
+			if (c == ';')
+				return p + 1;
+
+			if (c == '"' || c == '\'') {
+				p = SkipQuoted(text + p + 1, text + size, c) - text;
+				continue;
+			}
+
+			if (c == '/' && p + 1 < size && text[p + 1] == '/') {
+				const char* line = (const char*)memchr(text + p, '\n', size - p);
+				p = line ? line - text + 1 : size;
+				continue;
+			}
+
+			if (c == '/' && p + 1 < size && text[p + 1] == '*') {
+				p += 2;
+				while (p + 1 < size && !(text[p] == '*' && text[p + 1] == '/'))
+					p++;
+
+				p = p + 1 < size ? p + 2 : size;
+				continue;
+			}
+
+			if (!IsWordChar(c) && (unsigned char)c < 0x80) {
+				p++;
+				continue;
+			}
+
+			size_t start = p;
+			while (p < size && (IsWordChar(text[p]) || (unsigned char)text[p] >= 0x80))
+				p++;
+
+			if (operands) {
+				if (operands != SIZE_MAX)
+					operands--;
+
+				continue;
+			}
+
+			for (const auto& keyword : keywords) {
+				if (strlen(keyword.Word) != p - start || memcmp(keyword.Word, text + start, p - start) != 0)
+					continue;
+
+				//a declaration without a block ends where the next one starts
+				if (declared)
+					return start;
+
+				declared = true;
+				operands = keyword.Operands;
+				if (strcmp(keyword.Word, "__cpp") == 0)
+					syntax = BlockSyntax::Cpp;
+				else if (strcmp(keyword.Word, "__cs") == 0)
+					syntax = BlockSyntax::Cs;
+				else if (strcmp(keyword.Word, "__java") == 0)
+					syntax = BlockSyntax::Java;
+				break;
+			}
+		}
+
+		return size;
+	}
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "Common.h"
+
+namespace MRK {
+	//lexical rules of the text being skipped, on top of the shared C family ones
+	//("..." and '...' with escapes, // and /* */ comments)
+	enum class BlockSyntax : mrku32 {
+		Mrk,
+		Cpp, //R"delim(...)delim", 1'000 digit separators
+		Cs, //@"..."" verbatim strings
+		Java //"""...""" text blocks
+	};
+
+	//scans from pos for the end of a brace block, never looking inside strings, chars or comments
+	//returns the index right after the brace closing the first block opened at or after pos,
+	//the index of a '}' closing an enclosing block if one comes first, or size if the text ends
+	//closed tells whether a block was actually closed
+	size_t FindBlockEnd(const char* text, size_t size, size_t pos, BlockSyntax syntax, bool* closed = 0);
+
+	//scans from pos, right after a $PLATFORM directive, for the end of the declaration it guards:
+	//after the brace closing its first block, or where the next declaration starts if it has no
+	//block before it. A '}' closing an enclosing block ends it too, its index is returned
+	size_t FindDirectiveEnd(const char* text, size_t size, size_t pos);
+}
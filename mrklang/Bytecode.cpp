@@ -0,0 +1,1006 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Bytecode.h"
+#include "Semantic.h"
+#include "Trace.h"
+
+#include <climits>
+#include <iomanip>
+
+namespace MRK {
+	namespace {
+		const char* g_OpcodeNames[] = {
+#define MRK_VM_NAME(name) #name,
+			MRK_VM_OPCODES(MRK_VM_NAME)
+#undef MRK_VM_NAME
+		};
+
+		bool IsNumeric(ValueKind kind) {
+			return kind == ValueKind::Int || kind == ValueKind::ULong || kind == ValueKind::Float;
+		}
+
+		bool IsInteger(ValueKind kind) {
+			return kind == ValueKind::Int || kind == ValueKind::ULong;
+		}
+
+		bool FitsImmediate(long long value) {
+			return value >= INT_MIN && value <= INT_MAX;
+		}
+	}
+
+	const char* GetOpcodeName(Opcode op) {
+		return op < Opcode::Count ? g_OpcodeNames[(mrku32)op] : "?";
+	}
+
+	mrku32 Program::FindClass(const mrks string& name) const {
+		for (size_t i = 0; i < Classes.size(); i++)
+			if (Classes[i].Name == name)
+				return (mrku32)i;
+
+		return MRK_VM_NONE;
+	}
+
+	mrku32 Program::FindMethod(mrku32 _class, const mrks string& name) const {
+		if (_class >= Classes.size())
+			return MRK_VM_NONE;
+
+		for (mrku32 method : Classes[_class].Methods)
+			if (Methods[method].Name == name)
+				return method;
+
+		return MRK_VM_NONE;
+	}
+
+	void Program::Disassemble(mrks ostream& stream) const {
+		for (const ProgramMethod& method : Methods) {
+			stream << Classes[method.Class].Name << "::" << (method.IsCtor ? Classes[method.Class].Name : method.Name)
+				<< " params=" << method.ParamCount << " registers=" << method.RegisterCount << '\n';
+
+			if (method.Code == MRK_VM_NONE) {
+				stream << "\t<not compiled>\n";
+				continue;
+			}
+
+			for (mrku32 i = 0; i < method.CodeLength; i++) {
+				const Instruction& ins = Code[method.Code + i];
+				stream << '\t' << mrks setw(4) << i << ' ' << mrks left << mrks setw(10) << GetOpcodeName(ins.Op) << mrks right
+					<< " r" << ins.A << ", " << ins.B << ", " << ins.C << '\n';
+			}
+		}
+	}
+
+	BytecodeCompiler::BytecodeCompiler(const Semantic& semantic) : m_Semantic(semantic), m_Model(0), m_Program(0), m_Errors(0),
+		m_Module(-1), m_Class(0), m_Method(0), m_MethodId(0), m_Arena(0), m_Locals(0), m_Top(0), m_MaxTop(0), m_Depth(0), m_Failed(false) {
+	}
+
+	void BytecodeCompiler::Fail(ErrorCode code, const mrks string& detail) {
+		//first error of a method only, the rest would be follow-ups
+		if (m_Failed)
+			return;
+
+		m_Failed = true;
+		if (code == ErrorCode::None)
+			return;
+
+		ErrorArgs& names = m_Semantic.GetErrorArgs();
+		mrku32 context = names.Join(names.Intern(m_Program->Classes[m_Program->Methods[m_MethodId].Class].Name), names.Intern(m_Method->IsCtor ? m_Class->Name : m_Method->Name));
+		m_Errors->push_back(MakeError(names, m_Model->Modules[m_Module].Origin, code, m_Method->Offset, names.Intern(detail), context));
+	}
+
+	ValueKind BytecodeCompiler::GetKind(const ModelType& type, mrku32* _class) const {
+		*_class = MRK_VM_NONE;
+
+		switch (type.Builtin) {
+
+		case BuiltinType::None:
+			*_class = GetClassId(type.TypeId);
+			return *_class == MRK_VM_NONE ? ValueKind::Void : ValueKind::Object;
+
+		case BuiltinType::Void: return ValueKind::Void;
+		case BuiltinType::Bool: return ValueKind::Bool;
+		case BuiltinType::ULong: return ValueKind::ULong;
+		case BuiltinType::Float:
+		case BuiltinType::Double: return ValueKind::Float;
+		case BuiltinType::String: return ValueKind::String;
+		default: return ValueKind::Int;
+
+		}
+	}
+
+	mrku32 BytecodeCompiler::GetClassId(mrku32 typeId) const {
+		if (typeId == MRK_TYPE_UNRESOLVED)
+			return MRK_VM_NONE;
+
+		const TypeInfo& type = m_Semantic.GetType(typeId);
+		return type.Module < 0 ? MRK_VM_NONE : m_ClassBase[type.Module] + type.Class;
+	}
+
+	mrku32 BytecodeCompiler::AddConstant(Value value) {
+		m_Program->Constants.push_back(value);
+		return (mrku32)m_Program->Constants.size() - 1;
+	}
+
+	mrku32 BytecodeCompiler::AddString(const mrks string& str) {
+		m_Program->Strings.push_back(str);
+
+		Value value;
+		value.Ref = &m_Program->Strings.back();
+		return AddConstant(value);
+	}
+
+	void BytecodeCompiler::Emit(Opcode op, mrku32 a, mrku32 b, mrku32 c) {
+		m_Program->Code.push_back(Instruction{ op, (unsigned short)a, (unsigned short)b, (unsigned short)c });
+	}
+
+	void BytecodeCompiler::EmitBC(Opcode op, mrku32 a, mrku32 bc) {
+		Emit(op, a, bc & 0xFFFF, bc >> 16);
+	}
+
+	void BytecodeCompiler::PatchJump(mrku32 jump) {
+		//relative to the instruction after the jump
+		mrku32 offset = (mrku32)(m_Program->Code.size() - jump - 1);
+		Instruction& ins = m_Program->Code[jump];
+		ins.B = offset & 0xFFFF;
+		ins.C = offset >> 16;
+	}
+
+	mrku32 BytecodeCompiler::AllocTemp() {
+		if (m_Top >= MRK_VM_MAX_REGISTERS) {
+			Fail(ErrorCode::VMLimit, "registers");
+			return 0;
+		}
+
+		mrku32 reg = m_Top++;
+		if (m_Top > m_MaxTop)
+			m_MaxTop = m_Top;
+
+		return reg;
+	}
+
+	void BytecodeCompiler::LoadConstant(mrku32 reg, const ModelConstant& constant, ValueKind kind) {
+		Value value;
+
+		switch (kind) {
+
+		case ValueKind::Bool:
+			EmitBC(Opcode::LoadI, reg, constant.Bool ? 1 : 0);
+			return;
+
+		case ValueKind::String:
+			EmitBC(Opcode::LoadK, reg, AddString(constant.String));
+			return;
+
+		case ValueKind::Float:
+			value.Float = constant.Float;
+			break;
+
+		default:
+			if (kind == ValueKind::Int && FitsImmediate(constant.Int)) {
+				EmitBC(Opcode::LoadI, reg, (mrku32)(int)constant.Int);
+				return;
+			}
+
+			value.Int = constant.Int;
+			break;
+
+		}
+
+		EmitBC(Opcode::LoadK, reg, AddConstant(value));
+	}
+
+	void BytecodeCompiler::Narrow(mrku32 reg, BuiltinType type) {
+		//registers are 64 bits wide, stores wrap like the targets do
+		switch (type) {
+
+		case BuiltinType::Byte:
+		case BuiltinType::Char:
+		case BuiltinType::Short:
+		case BuiltinType::UShort:
+		case BuiltinType::Int:
+		case BuiltinType::UInt:
+			Emit(Opcode::Narrow, reg, (mrku32)type);
+			break;
+
+		case BuiltinType::Float:
+			Emit(Opcode::NarrowF, reg);
+			break;
+
+		default:
+			break;
+
+		}
+	}
+
+	bool BytecodeCompiler::IsNarrowed(BuiltinType type) {
+		return (type >= BuiltinType::Byte && type <= BuiltinType::UInt) || type == BuiltinType::Float;
+	}
+
+	bool BytecodeCompiler::Convert(Operand& value, ValueKind kind, mrku32 _class) {
+		if (value.Kind == kind) {
+			if (kind != ValueKind::Object || value.Class == _class)
+				return true;
+		}
+		else if (IsInteger(value.Kind) && IsInteger(kind)) {
+			//same bits, only the operations change
+			value.Kind = kind;
+			return true;
+		}
+		else if (IsInteger(value.Kind) && kind == ValueKind::Float) {
+			mrku32 reg = IsTemp(value.Reg) ? value.Reg : AllocTemp();
+			Emit(value.Kind == ValueKind::ULong ? Opcode::U2F : Opcode::I2F, reg, value.Reg);
+			value = Operand{ reg, ValueKind::Float, MRK_VM_NONE };
+			return true;
+		}
+
+		Fail(ErrorCode::TypeMismatch);
+		return false;
+	}
+
+	mrku32 BytecodeCompiler::ResolveTypePath(mrku32 node) const {
+		//Type or Type.Nested, names of values shadow types
+		const ExprNode& expr = m_Arena->Get(node);
+
+		if (expr.Kind == ExprKind::Name) {
+			if (m_Semantic.Lookup(m_Method->Scope, expr.Text))
+				return MRK_VM_NONE;
+
+			const Symbol* member = m_Semantic.Lookup(m_Class->Scope, expr.Text);
+			if (member && member->Kind != SymbolKind::Type)
+				return MRK_VM_NONE;
+
+			return GetClassId(m_Semantic.FindType(m_Model->Modules[m_Module], *m_Class, expr.Text));
+		}
+
+		if (expr.Kind != ExprKind::Member)
+			return MRK_VM_NONE;
+
+		mrku32 outer = ResolveTypePath(expr.Left);
+		if (outer == MRK_VM_NONE)
+			return MRK_VM_NONE;
+
+		const Symbol* nested = m_Semantic.Lookup(m_Classes[outer]->Scope, expr.Text);
+		return nested && nested->Kind == SymbolKind::Type ? GetClassId(nested->TypeId) : MRK_VM_NONE;
+	}
+
+	BytecodeCompiler::Operand BytecodeCompiler::Compile(mrku32 node) {
+		const Operand none{ 0, ValueKind::Void, MRK_VM_NONE };
+		if (m_Failed)
+			return none;
+
+		//trees from the parser can be arbitrarily deep, the compiler recurses
+		if (m_Depth >= MRK_VM_MAX_DEPTH) {
+			Fail(ErrorCode::VMLimit, "nesting");
+			return none;
+		}
+
+		m_Depth++;
+		const ExprNode& expr = m_Arena->Get(node);
+		Operand result = none;
+
+		switch (expr.Kind) {
+
+		case ExprKind::Int:
+		case ExprKind::UInt: {
+			result = Operand{ AllocTemp(), expr.Kind == ExprKind::UInt ? ValueKind::ULong : ValueKind::Int, MRK_VM_NONE };
+			if (expr.Kind == ExprKind::Int && FitsImmediate(expr.Int))
+				EmitBC(Opcode::LoadI, result.Reg, (mrku32)(int)expr.Int);
+			else {
+				Value value;
+				value.Int = expr.Int;
+				EmitBC(Opcode::LoadK, result.Reg, AddConstant(value));
+			}
+			break;
+		}
+
+		case ExprKind::Bool:
+			result = Operand{ AllocTemp(), ValueKind::Bool, MRK_VM_NONE };
+			EmitBC(Opcode::LoadI, result.Reg, expr.Int ? 1 : 0);
+			break;
+
+		case ExprKind::String:
+			result = Operand{ AllocTemp(), ValueKind::String, MRK_VM_NONE };
+			EmitBC(Opcode::LoadK, result.Reg, AddString(expr.Text));
+			break;
+
+		case ExprKind::Name:
+			result = CompileName(node);
+			break;
+
+		case ExprKind::Member:
+			result = CompileMember(node);
+			break;
+
+		case ExprKind::Unary:
+			result = CompileUnary(expr);
+			break;
+
+		case ExprKind::Binary: {
+			if (expr.Op == ExprOp::And || expr.Op == ExprOp::Or) {
+				result = CompileLogical(expr);
+				break;
+			}
+
+			mrku32 dest = m_Top;
+			Operand lhs = Compile(expr.Left);
+			Operand rhs = Compile(expr.Right);
+			result = CompileBinary(expr.Op, lhs, rhs, dest);
+			break;
+		}
+
+		case ExprKind::Assign:
+			result = CompileAssign(expr);
+			break;
+
+		case ExprKind::Call:
+			result = CompileCall(expr);
+			break;
+
+		case ExprKind::Index:
+			Fail(ErrorCode::VMUnsupported, "[]");
+			break;
+
+		default:
+			Fail(ErrorCode::VMUnsupported);
+			break;
+
+		}
+
+		m_Depth--;
+		return m_Failed ? none : result;
+	}
+
+	BytecodeCompiler::Operand BytecodeCompiler::CompileInto(mrku32 node, mrku32 reg) {
+		//temporaries restart at reg, most values then land there without a move
+		m_Top = reg;
+		Operand value = Compile(node);
+		if (!m_Failed && value.Reg != reg)
+			Emit(Opcode::Move, reg, value.Reg);
+
+		m_Top = reg + 1;
+		value.Reg = reg;
+		return value;
+	}
+
+	BytecodeCompiler::Operand BytecodeCompiler::CompileName(mrku32 node) {
+		//params and locals live in registers, fields of this are loaded through register 0
+		const char* name = m_Arena->Get(node).Text;
+		const Symbol* symbol = m_Semantic.Lookup(m_Method->Scope, name);
+		Operand result{ 0, ValueKind::Void, MRK_VM_NONE };
+
+		if (symbol) {
+			const ModelVar& var = symbol->Kind == SymbolKind::Param ? m_Method->Params[symbol->Member] : m_Method->Locals[symbol->Member];
+			result.Reg = 1 + (mrku32)symbol->Member + (symbol->Kind == SymbolKind::Local ? (mrku32)m_Method->Params.size() : 0);
+			result.Kind = GetKind(var.Type, &result.Class);
+			return result;
+		}
+
+		const ModelModule& module = m_Model->Modules[m_Module];
+		for (const ModelClass* scope = m_Class; scope; scope = scope->Parent >= 0 ? &module.Classes[scope->Parent] : 0) {
+			symbol = m_Semantic.Lookup(scope->Scope, name);
+			if (!symbol)
+				continue;
+
+			if (symbol->Kind == SymbolKind::Method)
+				return Fail(ErrorCode::VMUnsupported, mrks string(name) + " without ()"), result;
+
+			if (symbol->Kind != SymbolKind::Field)
+				return Fail(ErrorCode::NotAValue, name), result;
+
+			const ModelVar& field = scope->Fields[symbol->Member];
+			result.Kind = GetKind(field.Type, &result.Class);
+			result.Reg = AllocTemp();
+
+			if (field.IsConstant())
+				LoadConstant(result.Reg, field.Constant, result.Kind);
+			else if (scope == m_Class)
+				Emit(Opcode::GetField, result.Reg, 0, symbol->Member);
+			else
+				Fail(ErrorCode::InstanceRequired, name);
+
+			return result;
+		}
+
+		Fail(m_Semantic.FindType(module, *m_Class, name) != MRK_TYPE_UNRESOLVED ? ErrorCode::NotAValue : ErrorCode::UndefinedName, name);
+		return result;
+	}
+
+	BytecodeCompiler::Operand BytecodeCompiler::CompileMember(mrku32 node) {
+		const ExprNode& expr = m_Arena->Get(node);
+		Operand result{ 0, ValueKind::Void, MRK_VM_NONE };
+
+		//Type.constant
+		mrku32 typeClass = ResolveTypePath(expr.Left);
+		if (typeClass != MRK_VM_NONE) {
+			const ModelClass& _class = *m_Classes[typeClass];
+			const Symbol* symbol = m_Semantic.Lookup(_class.Scope, expr.Text);
+			if (!symbol || symbol->Kind != SymbolKind::Field)
+				return Fail(symbol ? ErrorCode::NotAValue : ErrorCode::UndefinedName, expr.Text), result;
+
+			const ModelVar& field = _class.Fields[symbol->Member];
+			if (!field.IsConstant())
+				return Fail(ErrorCode::InstanceRequired, expr.Text), result;
+
+			result.Kind = GetKind(field.Type, &result.Class);
+			result.Reg = AllocTemp();
+			LoadConstant(result.Reg, field.Constant, result.Kind);
+			return result;
+		}
+
+		//object.field
+		Operand object = Compile(expr.Left);
+		if (m_Failed)
+			return result;
+
+		if (object.Kind != ValueKind::Object)
+			return Fail(ErrorCode::TypeMismatch, expr.Text), result;
+
+		const ModelClass& _class = *m_Classes[object.Class];
+		const Symbol* symbol = m_Semantic.Lookup(_class.Scope, expr.Text);
+		if (!symbol || symbol->Kind != SymbolKind::Field)
+			return Fail(symbol ? ErrorCode::NotAValue : ErrorCode::UndefinedName, expr.Text), result;
+
+		const ModelVar& field = _class.Fields[symbol->Member];
+		result.Kind = GetKind(field.Type, &result.Class);
+		result.Reg = IsTemp(object.Reg) ? object.Reg : AllocTemp();
+
+		if (field.IsConstant())
+			LoadConstant(result.Reg, field.Constant, result.Kind);
+		else
+			Emit(Opcode::GetField, result.Reg, object.Reg, symbol->Member);
+
+		return result;
+	}
+
+	BytecodeCompiler::Operand BytecodeCompiler::CompileUnary(const ExprNode& expr) {
+		Operand value = Compile(expr.Left);
+		if (m_Failed)
+			return value;
+
+		Opcode op = Opcode::Count;
+		switch (expr.Op) {
+
+		case ExprOp::Plus:
+			if (IsNumeric(value.Kind))
+				return value;
+			break;
+
+		case ExprOp::Neg:
+			if (IsNumeric(value.Kind))
+				op = value.Kind == ValueKind::Float ? Opcode::NegF : Opcode::NegI;
+			break;
+
+		case ExprOp::Not:
+			if (value.Kind == ValueKind::Bool)
+				op = Opcode::Not;
+			break;
+
+		case ExprOp::Complement:
+			if (IsInteger(value.Kind))
+				op = Opcode::BitNot;
+			break;
+
+		default:
+			break;
+
+		}
+
+		if (op == Opcode::Count)
+			return Fail(ErrorCode::TypeMismatch, GetOperatorText(expr.Op)), value;
+
+		mrku32 dest = IsTemp(value.Reg) ? value.Reg : AllocTemp();
+		Emit(op, dest, value.Reg);
+		value.Reg = dest;
+		return value;
+	}
+
+	BytecodeCompiler::Operand BytecodeCompiler::CompileBinary(ExprOp op, Operand lhs, Operand rhs, mrku32 dest) {
+		Operand result{ dest, ValueKind::Void, MRK_VM_NONE };
+		if (m_Failed)
+			return result;
+
+		//common kind of the operands, float wins over ulong wins over int
+		ValueKind kind = lhs.Kind;
+		if (IsNumeric(lhs.Kind) && IsNumeric(rhs.Kind))
+			kind = lhs.Kind == ValueKind::Float || rhs.Kind == ValueKind::Float ? ValueKind::Float
+				: (lhs.Kind == ValueKind::ULong || rhs.Kind == ValueKind::ULong ? ValueKind::ULong : ValueKind::Int);
+
+		bool shift = op == ExprOp::Shl || op == ExprOp::Shr;
+		if (shift ? !IsInteger(lhs.Kind) || !IsInteger(rhs.Kind) : !Convert(lhs, kind, lhs.Class) || !Convert(rhs, kind, lhs.Class)) {
+			Fail(ErrorCode::TypeMismatch, GetOperatorText(op));
+			return result;
+		}
+
+		bool isFloat = kind == ValueKind::Float;
+		bool isUnsigned = kind == ValueKind::ULong;
+		Opcode code = Opcode::Count;
+		result.Kind = kind;
+
+		switch (op) {
+
+		case ExprOp::Add:
+			if (kind == ValueKind::String)
+				code = Opcode::Concat;
+			else if (IsNumeric(kind))
+				code = isFloat ? Opcode::AddF : Opcode::AddI;
+			break;
+
+		case ExprOp::Sub: if (IsNumeric(kind)) code = isFloat ? Opcode::SubF : Opcode::SubI; break;
+		case ExprOp::Mul: if (IsNumeric(kind)) code = isFloat ? Opcode::MulF : Opcode::MulI; break;
+		case ExprOp::Div: if (IsNumeric(kind)) code = isFloat ? Opcode::DivF : (isUnsigned ? Opcode::DivU : Opcode::DivI); break;
+		case ExprOp::Mod: if (IsNumeric(kind)) code = isFloat ? Opcode::ModF : (isUnsigned ? Opcode::ModU : Opcode::ModI); break;
+
+		case ExprOp::Shl:
+			code = Opcode::Shl;
+			result.Kind = lhs.Kind;
+			break;
+
+		case ExprOp::Shr:
+			code = lhs.Kind == ValueKind::ULong ? Opcode::ShrU : Opcode::Shr;
+			result.Kind = lhs.Kind;
+			break;
+
+		case ExprOp::BitAnd:
+		case ExprOp::BitOr:
+		case ExprOp::Xor:
+			//on bools these are the non short-circuiting logical operators
+			if (IsInteger(kind) || kind == ValueKind::Bool)
+				code = op == ExprOp::BitAnd ? Opcode::BitAnd : (op == ExprOp::BitOr ? Opcode::BitOr : Opcode::Xor);
+			break;
+
+		case ExprOp::Lt:
+		case ExprOp::Le:
+		case ExprOp::Gt:
+		case ExprOp::Ge: {
+			if (!IsNumeric(kind))
+				break;
+
+			bool less = op == ExprOp::Lt || op == ExprOp::Gt;
+			code = isFloat ? (less ? Opcode::LtF : Opcode::LeF) : (isUnsigned ? (less ? Opcode::LtU : Opcode::LeU) : (less ? Opcode::LtI : Opcode::LeI));
+
+			//a > b is b < a
+			if (op == ExprOp::Gt || op == ExprOp::Ge)
+				mrks swap(lhs, rhs);
+
+			result.Kind = ValueKind::Bool;
+			break;
+		}
+
+		case ExprOp::Eq:
+		case ExprOp::Ne:
+			if (kind == ValueKind::Void)
+				break;
+
+			if (isFloat)
+				code = op == ExprOp::Eq ? Opcode::EqF : Opcode::NeF;
+			else if (kind == ValueKind::String)
+				code = op == ExprOp::Eq ? Opcode::EqS : Opcode::NeS;
+			else
+				code = op == ExprOp::Eq ? Opcode::EqI : Opcode::NeI;
+
+			result.Kind = ValueKind::Bool;
+			break;
+
+		default:
+			break;
+
+		}
+
+		if (code == Opcode::Count) {
+			Fail(ErrorCode::TypeMismatch, GetOperatorText(op));
+			return result;
+		}
+
+		//operands are dead once read, the result takes the lowest temporary
+		m_Top = dest;
+		result.Reg = AllocTemp();
+		Emit(code, result.Reg, lhs.Reg, rhs.Reg);
+		return result;
+	}
+
+	BytecodeCompiler::Operand BytecodeCompiler::CompileLogical(const ExprNode& expr) {
+		//a && b: dest = a, skip b when dest is false
+		mrku32 dest = AllocTemp();
+		Operand lhs = CompileInto(expr.Left, dest);
+		if (!m_Failed && lhs.Kind != ValueKind::Bool)
+			Fail(ErrorCode::TypeMismatch, GetOperatorText(expr.Op));
+
+		mrku32 jump = (mrku32)m_Program->Code.size();
+		EmitBC(expr.Op == ExprOp::And ? Opcode::JmpIfNot : Opcode::JmpIf, dest, 0);
+
+		Operand rhs = CompileInto(expr.Right, dest);
+		if (!m_Failed && rhs.Kind != ValueKind::Bool)
+			Fail(ErrorCode::TypeMismatch, GetOperatorText(expr.Op));
+
+		PatchJump(jump);
+		return Operand{ dest, ValueKind::Bool, MRK_VM_NONE };
+	}
+
+	BytecodeCompiler::Operand BytecodeCompiler::CompileAssign(const ExprNode& expr) {
+		Operand result{ 0, ValueKind::Void, MRK_VM_NONE };
+		const ExprNode& target = m_Arena->Get(expr.Left);
+
+		//where the value goes, a register or a field of an object register
+		mrku32 reg = MRK_VM_NONE;
+		mrku32 object = MRK_VM_NONE;
+		mrku32 slot = 0;
+		const ModelVar* var = 0;
+
+		if (target.Kind == ExprKind::Name) {
+			const Symbol* symbol = m_Semantic.Lookup(m_Method->Scope, target.Text);
+			if (symbol) {
+				var = symbol->Kind == SymbolKind::Param ? &m_Method->Params[symbol->Member] : &m_Method->Locals[symbol->Member];
+				reg = 1 + (mrku32)symbol->Member + (symbol->Kind == SymbolKind::Local ? (mrku32)m_Method->Params.size() : 0);
+			}
+			else if ((symbol = m_Semantic.Lookup(m_Class->Scope, target.Text)) && symbol->Kind == SymbolKind::Field) {
+				var = &m_Class->Fields[symbol->Member];
+				object = 0;
+				slot = symbol->Member;
+			}
+			else
+				return Fail(symbol ? ErrorCode::NotAssignable : ErrorCode::UndefinedName, target.Text), result;
+		}
+		else {
+			if (ResolveTypePath(target.Left) != MRK_VM_NONE)
+				return Fail(ErrorCode::NotAssignable, target.Text), result;
+
+			Operand owner = Compile(target.Left);
+			if (m_Failed)
+				return result;
+
+			if (owner.Kind != ValueKind::Object)
+				return Fail(ErrorCode::TypeMismatch, target.Text), result;
+
+			const ModelClass& _class = *m_Classes[owner.Class];
+			const Symbol* symbol = m_Semantic.Lookup(_class.Scope, target.Text);
+			if (!symbol || symbol->Kind != SymbolKind::Field)
+				return Fail(symbol ? ErrorCode::NotAssignable : ErrorCode::UndefinedName, target.Text), result;
+
+			var = &_class.Fields[symbol->Member];
+			object = owner.Reg;
+			slot = symbol->Member;
+		}
+
+		//folded vars are emitted as constants
+		if (var->IsConstant())
+			return Fail(ErrorCode::NotAssignable, var->Name), result;
+
+		mrku32 _class;
+		ValueKind kind = GetKind(var->Type, &_class);
+
+		Operand value;
+		if (expr.Op == ExprOp::None)
+			value = Compile(expr.Right);
+		else {
+			//a op= b is a = a op b with a evaluated once
+			mrku32 dest = m_Top;
+			Operand current{ reg, kind, _class };
+			if (reg == MRK_VM_NONE) {
+				current.Reg = AllocTemp();
+				Emit(Opcode::GetField, current.Reg, object, slot);
+			}
+
+			value = CompileBinary(expr.Op, current, Compile(expr.Right), dest);
+		}
+
+		if (m_Failed || !Convert(value, kind, _class))
+			return result;
+
+		if (reg != MRK_VM_NONE) {
+			if (value.Reg != reg)
+				Emit(Opcode::Move, reg, value.Reg);
+			Narrow(reg, var->Type.Builtin);
+			return Operand{ reg, kind, _class };
+		}
+
+		//narrowing works in place, never on someone else's register
+		if (!IsTemp(value.Reg) && IsNarrowed(var->Type.Builtin)) {
+			mrku32 temp = AllocTemp();
+			Emit(Opcode::Move, temp, value.Reg);
+			value.Reg = temp;
+		}
+
+		Narrow(value.Reg, var->Type.Builtin);
+		Emit(Opcode::SetField, object, slot, value.Reg);
+		return Operand{ value.Reg, kind, _class };
+	}
+
+	BytecodeCompiler::Operand BytecodeCompiler::CompileCall(const ExprNode& expr) {
+		Operand result{ 0, ValueKind::Void, MRK_VM_NONE };
+		const ExprNode& callee = m_Arena->Get(expr.Left);
+
+		//Type(...) and Type.Nested(...) construct
+		mrku32 construct = ResolveTypePath(expr.Left);
+		if (construct != MRK_VM_NONE) {
+			//objects start as their constant defaults, field initializers that run code are left to the backends
+			for (const ModelVar& field : m_Classes[construct]->Fields)
+				if (field.Constant.State == ConstantState::Runtime)
+					return Fail(ErrorCode::VMUnsupported, m_Program->Classes[construct].Name + "::" + field.Name + " default"), result;
+
+			mrku32 base = AllocTemp();
+			EmitBC(Opcode::New, base, construct);
+
+			for (mrku32 method : m_Program->Classes[construct].Methods) {
+				const ProgramMethod& ctor = m_Program->Methods[method];
+				if (ctor.IsCtor && ctor.ParamCount == expr.Count) {
+					CompileInvoke(method, base, expr.Right, expr.Count);
+					return Operand{ base, ValueKind::Object, construct };
+				}
+			}
+
+			//without ctors an object is its field defaults
+			if (expr.Count)
+				Fail(ErrorCode::NoConstructor, m_Program->Classes[construct].Name + " with " + mrks to_string(expr.Count) + " argument(s)");
+
+			return Operand{ base, ValueKind::Object, construct };
+		}
+
+		//Method(...) on this, object.Method(...) on an object
+		mrku32 base = AllocTemp();
+		const ModelClass* _class = m_Class;
+		mrku32 classId = m_Program->Methods[m_MethodId].Class;
+
+		if (callee.Kind == ExprKind::Name)
+			Emit(Opcode::Move, base, 0);
+		else if (callee.Kind == ExprKind::Member) {
+			if (ResolveTypePath(callee.Left) != MRK_VM_NONE)
+				return Fail(ErrorCode::InstanceRequired, callee.Text), result;
+
+			Operand object = CompileInto(callee.Left, base);
+			if (m_Failed)
+				return result;
+
+			if (object.Kind != ValueKind::Object)
+				return Fail(ErrorCode::TypeMismatch, callee.Text), result;
+
+			classId = object.Class;
+			_class = m_Classes[classId];
+		}
+		else
+			return Fail(ErrorCode::VMUnsupported, "call"), result;
+
+		const Symbol* symbol = m_Semantic.Lookup(_class->Scope, callee.Text);
+		if (!symbol || symbol->Kind != SymbolKind::Method)
+			return Fail(ErrorCode::UndefinedMethod, callee.Text), result;
+
+		return CompileInvoke(m_MethodBase[classId] + symbol->Member, base, expr.Right, expr.Count);
+	}
+
+	BytecodeCompiler::Operand BytecodeCompiler::CompileInvoke(mrku32 method, mrku32 base, mrku32 firstArg, mrku32 argCount) {
+		//arguments go right after the receiver, the callee sees them as its params
+		const ProgramMethod& target = m_Program->Methods[method];
+		const ModelMethod& model = m_Classes[target.Class]->Methods[method - m_MethodBase[target.Class]];
+		Operand result{ base, target.Returns, MRK_VM_NONE };
+
+		if (argCount != target.ParamCount)
+			return Fail(ErrorCode::ArgumentCount, target.Name), result;
+
+		mrku32 arg = firstArg;
+		for (mrku32 i = 0; i < argCount && !m_Failed; i++, arg = m_Arena->Get(arg).Next) {
+			mrku32 reg = AllocTemp();
+			Operand value = CompileInto(arg, reg);
+
+			mrku32 _class;
+			ValueKind kind = GetKind(model.Params[i].Type, &_class);
+			if (m_Failed || !Convert(value, kind, _class))
+				return result;
+
+			if (value.Reg != reg)
+				Emit(Opcode::Move, reg, value.Reg);
+
+			Narrow(reg, model.Params[i].Type.Builtin);
+			m_Top = reg + 1;
+		}
+
+		EmitBC(Opcode::Call, base, method);
+		m_Top = base + 1;
+
+		if (!target.IsCtor)
+			GetKind(model.ReturnType, &result.Class);
+
+		return result;
+	}
+
+	void BytecodeCompiler::CompileMethod(int module, const ModelClass& _class, const ModelMethod& method, mrku32 id) {
+		m_Module = module;
+		m_Class = &_class;
+		m_Method = &method;
+		m_MethodId = id;
+		m_Arena = m_Model->Modules[module].Expressions;
+		m_Locals = 1 + (mrku32)(method.Params.size() + method.Locals.size());
+		m_Top = m_MaxTop = m_Locals;
+		m_Depth = 0;
+		m_Failed = false;
+
+		ProgramMethod& target = m_Program->Methods[id];
+		target.Code = (mrku32)m_Program->Code.size();
+
+		if (m_Locals > MRK_VM_MAX_REGISTERS)
+			Fail(ErrorCode::VMLimit, "registers");
+
+		//locals start at zero, constants at their value
+		for (size_t i = 0; i < method.Locals.size() && !m_Failed; i++) {
+			const ModelVar& local = method.Locals[i];
+			mrku32 reg = 1 + (mrku32)(method.Params.size() + i);
+			mrku32 _class;
+			ValueKind kind = GetKind(local.Type, &_class);
+
+			if (local.IsConstant())
+				LoadConstant(reg, local.Constant, kind);
+			else
+				EmitBC(Opcode::LoadI, reg, 0);
+		}
+
+		//runtime defaults in declaration order, once every local holds zero or its constant
+		for (size_t i = 0; i < method.Locals.size() && !m_Failed; i++) {
+			const ModelVar& local = method.Locals[i];
+			if (local.Constant.State != ConstantState::Runtime)
+				continue;
+
+			mrku32 reg = 1 + (mrku32)(method.Params.size() + i);
+			mrku32 _class;
+			ValueKind kind = GetKind(local.Type, &_class);
+
+			m_Top = m_Locals;
+			Operand value = Compile(local.Default);
+			if (m_Failed || !Convert(value, kind, _class))
+				break;
+
+			if (value.Reg != reg)
+				Emit(Opcode::Move, reg, value.Reg);
+			Narrow(reg, local.Type.Builtin);
+		}
+
+		m_Top = m_Locals;
+
+		mrku32 returnClass;
+		ValueKind returns = GetKind(method.ReturnType, &returnClass);
+
+		for (mrku32 statement : method.Body) {
+			if (m_Failed)
+				break;
+
+			const ExprNode& node = m_Arena->Get(statement);
+			if (node.Kind != ExprKind::Return) {
+				Compile(statement);
+				m_Top = m_Locals;
+				continue;
+			}
+
+			if (node.Left == MRK_EXPR_NONE) {
+				if (returns != ValueKind::Void && !method.IsCtor)
+					Fail(ErrorCode::TypeMismatch, "r");
+				Emit(Opcode::RetVoid);
+				continue;
+			}
+
+			if (returns == ValueKind::Void || method.IsCtor) {
+				Fail(ErrorCode::TypeMismatch, "r");
+				break;
+			}
+
+			Operand value = Compile(node.Left);
+			if (m_Failed || !Convert(value, returns, returnClass))
+				break;
+
+			if (!IsTemp(value.Reg) && IsNarrowed(method.ReturnType.Builtin)) {
+				mrku32 temp = AllocTemp();
+				Emit(Opcode::Move, temp, value.Reg);
+				value.Reg = temp;
+			}
+
+			Narrow(value.Reg, method.ReturnType.Builtin);
+			Emit(Opcode::Ret, value.Reg);
+			m_Top = m_Locals;
+		}
+
+		//falling off the end returns zero
+		if (returns == ValueKind::Void || method.IsCtor)
+			Emit(Opcode::RetVoid);
+		else {
+			mrku32 temp = AllocTemp();
+			EmitBC(Opcode::LoadI, temp, 0);
+			Emit(Opcode::Ret, temp);
+		}
+
+		if (m_Failed) {
+			m_Program->Code.resize(target.Code);
+			target.Code = MRK_VM_NONE;
+			return;
+		}
+
+		target.RegisterCount = m_MaxTop;
+		target.CodeLength = (mrku32)m_Program->Code.size() - target.Code;
+	}
+
+	void BytecodeCompiler::Compile(const Model& model, Program& program, mrks vector<mrk Error>& errors) {
+		TraceSpan span("Bytecode", "");
+
+		m_Model = &model;
+		m_Program = &program;
+		m_Errors = &errors;
+		m_ClassBase.clear();
+		m_MethodBase.clear();
+		m_Classes.clear();
+		program = Program();
+
+		//ids first, bodies may reference any class or method
+		for (const ModelModule& module : model.Modules) {
+			m_ClassBase.push_back((mrku32)m_Classes.size());
+			for (const ModelClass& _class : module.Classes)
+				m_Classes.push_back(&_class);
+		}
+
+		program.Classes.reserve(m_Classes.size());
+		for (mrku32 id = 0; id < m_Classes.size(); id++) {
+			const ModelClass& _class = *m_Classes[id];
+			program.Classes.push_back(ProgramClass{ m_Semantic.GetType(_class.TypeId).FullName });
+			ProgramClass& target = program.Classes.back();
+			m_MethodBase.push_back((mrku32)program.Methods.size());
+
+			for (const ModelVar& field : _class.Fields) {
+				FieldLayout layout{ field.Name, ValueKind::Void, field.Type.Builtin, MRK_VM_NONE, field.IsConstant() };
+				layout.Kind = GetKind(field.Type, &layout.Class);
+				target.Fields.push_back(layout);
+
+				Value value;
+				value.Int = 0;
+				if (field.IsConstant()) {
+					if (layout.Kind == ValueKind::String) {
+						program.Strings.push_back(field.Constant.String);
+						value.Ref = &program.Strings.back();
+					}
+					else if (layout.Kind == ValueKind::Bool)
+						value.Int = field.Constant.Bool;
+					else
+						value.Int = field.Constant.Int; //shares storage with UInt and Float
+				}
+
+				target.Defaults.push_back(value);
+			}
+
+			for (const ModelMethod& method : _class.Methods) {
+				mrku32 returnClass;
+				target.Methods.push_back((mrku32)program.Methods.size());
+				program.Methods.push_back(ProgramMethod{ method.Name, id, method.IsCtor, method.IsCtor ? ValueKind::Void : GetKind(method.ReturnType, &returnClass),
+					(mrku32)method.Params.size(), 0, MRK_VM_NONE, 0 });
+			}
+		}
+
+		size_t compiled = 0;
+		for (size_t m = 0; m < model.Modules.size(); m++) {
+			for (const ModelClass& _class : model.Modules[m].Classes) {
+				mrku32 classId = m_ClassBase[m] + _class.Index;
+				for (size_t i = 0; i < _class.Methods.size(); i++) {
+					CompileMethod((int)m, _class, _class.Methods[i], m_MethodBase[classId] + (mrku32)i);
+					compiled += !m_Failed;
+				}
+			}
+		}
+
+		span.Arg("methods", compiled);
+		span.Arg("instructions", program.Code.size());
+	}
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <ostream>
+
+#include "Common.h"
+#include "Error.h"
+#include "Model.h"
+
+#define MRK_VM_NONE 0xFFFFFFFFu
+#define MRK_VM_MAX_REGISTERS 0xFFFF
+#define MRK_VM_MAX_DEPTH 4096 //expression nesting the compiler accepts
+
+//X(name) for every opcode, operands are A, B, C or A and BC (32 bits)
+#define MRK_VM_OPCODES(X) \
+	X(Move) /* A = B */ \
+	X(LoadK) /* A = constants[BC] */ \
+	X(LoadI) /* A = (int)BC */ \
+	X(I2F) /* A = (double)B */ \
+	X(U2F) \
+	X(Narrow) /* A = (BuiltinType B)A */ \
+	X(NarrowF) /* A = (float)A */ \
+	X(AddI) X(SubI) X(MulI) X(DivI) X(ModI) X(DivU) X(ModU) /* A = B op C */ \
+	X(Shl) X(Shr) X(ShrU) X(BitAnd) X(BitOr) X(Xor) \
+	X(AddF) X(SubF) X(MulF) X(DivF) X(ModF) \
+	X(NegI) X(NegF) X(Not) X(BitNot) /* A = op B */ \
+	X(EqI) X(NeI) X(LtI) X(LeI) X(LtU) X(LeU) \
+	X(EqF) X(NeF) X(LtF) X(LeF) \
+	X(EqS) X(NeS) X(Concat) \
+	X(Jmp) /* ip += (int)BC */ \
+	X(JmpIf) /* if A, ip += (int)BC */ \
+	X(JmpIfNot) \
+	X(GetField) /* A = B.fields[C] */ \
+	X(SetField) /* A.fields[B] = C */ \
+	X(New) /* A = new classes[BC] */ \
+	X(Call) /* A = methods[BC](A, A + 1...), the callee's window starts at A */ \
+	X(Ret) /* window[0] = A */ \
+	X(RetVoid)
+
+namespace MRK {
+	class Semantic;
+
+	enum class Opcode : unsigned short {
+#define MRK_VM_ENUM(name) name,
+		MRK_VM_OPCODES(MRK_VM_ENUM)
+#undef MRK_VM_ENUM
+		Count
+	};
+
+	struct Instruction {
+		Opcode Op;
+		unsigned short A;
+		unsigned short B;
+		unsigned short C;
+
+		mrku32 GetBC() const { return B | ((mrku32)C << 16); }
+		int GetOffset() const { return (int)GetBC(); }
+	};
+
+	//one register or field, the kind is known statically
+	union Value {
+		long long Int;
+		unsigned long long UInt;
+		double Float;
+		const void* Ref; //Object or mrks string, 0 for null
+	};
+
+	static_assert(sizeof(Instruction) == 8 && sizeof(Value) == 8, "fixed-size instructions and slots");
+
+	enum class ValueKind : unsigned char {
+		Void,
+		Int, //every signed integer, char and uint, 64 bits wide in registers
+		ULong,
+		Float, //float and double
+		Bool,
+		String,
+		Object
+	};
+
+	struct FieldLayout {
+		mrks string Name;
+		ValueKind Kind;
+		BuiltinType Builtin;
+		mrku32 Class; //Object fields, MRK_VM_NONE otherwise
+		bool Constant; //folded var, reads are compiled to loads of the value
+	};
+
+	//field layout table, slot i is Fields[i]
+	struct ProgramClass {
+		mrks string Name; //Outer.Inner
+		mrks vector<FieldLayout> Fields;
+		mrks vector<Value> Defaults; //copied into every new object, constants hold their value
+		mrks vector<mrku32> Methods; //declaration order, ctors included
+	};
+
+	struct ProgramMethod {
+		mrks string Name;
+		mrku32 Class;
+		bool IsCtor;
+		ValueKind Returns;
+		mrku32 ParamCount;
+		mrku32 RegisterCount; //this, params, locals and temporaries
+		mrku32 Code; //first instruction
+		mrku32 CodeLength;
+	};
+
+	struct Program {
+		mrks vector<Instruction> Code;
+		mrks vector<Value> Constants;
+		mrks deque<mrks string> Strings; //string constants, referenced by Value::Ref
+		mrks vector<ProgramClass> Classes;
+		mrks vector<ProgramMethod> Methods;
+
+		mrku32 FindClass(const mrks string& name) const;
+		mrku32 FindMethod(mrku32 _class, const mrks string& name) const;
+		void Disassemble(mrks ostream& stream) const;
+	};
+
+	const char* GetOpcodeName(Opcode op);
+
+	//lowers an analyzed model (see Semantic) and its method bodies to register bytecode
+	//Registers of a method are this, params, locals then temporaries, a call passes its arguments
+	//in consecutive registers that become the start of the callee's window
+	class BytecodeCompiler {
+	private:
+		struct Operand {
+			mrku32 Reg;
+			ValueKind Kind;
+			mrku32 Class; //Object operands
+		};
+
+		const Semantic& m_Semantic;
+		const Model* m_Model;
+		Program* m_Program;
+		mrks vector<mrk Error>* m_Errors;
+		mrks vector<mrku32> m_ClassBase; //first class id of every module
+		mrks vector<mrku32> m_MethodBase; //first method id of every class
+		mrks vector<const ModelClass*> m_Classes; //by class id
+
+		//method being compiled
+		int m_Module;
+		const ModelClass* m_Class;
+		const ModelMethod* m_Method;
+		mrku32 m_MethodId;
+		const ExprArena* m_Arena;
+		mrku32 m_Locals; //first temporary
+		mrku32 m_Top;
+		mrku32 m_MaxTop;
+		mrku32 m_Depth;
+		bool m_Failed;
+
+		void Fail(ErrorCode code, const mrks string& detail = "");
+		bool IsTemp(mrku32 reg) const { return reg >= m_Locals; }
+		ValueKind GetKind(const ModelType& type, mrku32* _class) const;
+		mrku32 GetClassId(mrku32 typeId) const;
+		mrku32 AddConstant(Value value);
+		mrku32 AddString(const mrks string& str);
+		void Emit(Opcode op, mrku32 a = 0, mrku32 b = 0, mrku32 c = 0);
+		void EmitBC(Opcode op, mrku32 a, mrku32 bc);
+		void PatchJump(mrku32 jump);
+		mrku32 AllocTemp();
+		void LoadConstant(mrku32 reg, const ModelConstant& constant, ValueKind kind);
+		void Narrow(mrku32 reg, BuiltinType type);
+		static bool IsNarrowed(BuiltinType type);
+		bool Convert(Operand& value, ValueKind kind, mrku32 _class);
+
+		mrku32 ResolveTypePath(mrku32 node) const;
+		Operand Compile(mrku32 node);
+		Operand CompileInto(mrku32 node, mrku32 reg);
+		Operand CompileName(mrku32 node);
+		Operand CompileMember(mrku32 node);
+		Operand CompileUnary(const ExprNode& node);
+		Operand CompileBinary(ExprOp op, Operand lhs, Operand rhs, mrku32 dest);
+		Operand CompileLogical(const ExprNode& node);
+		Operand CompileAssign(const ExprNode& node);
+		Operand CompileCall(const ExprNode& node);
+		Operand CompileInvoke(mrku32 method, mrku32 base, mrku32 firstArg, mrku32 argCount);
+		void CompileMethod(int module, const ModelClass& _class, const ModelMethod& method, mrku32 id);
+
+	public:
+		BytecodeCompiler(const Semantic& semantic);
+
+		//program is replaced, errors are appended, a method that fails to compile gets no code (Code is MRK_VM_NONE)
+		void Compile(const Model& model, Program& program, mrks vector<mrk Error>& errors);
+	};
+}
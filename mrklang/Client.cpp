@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Common.h"
+
+#ifdef MRK_CLIENT
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstring>
+#include <filesystem>
+
+#include "CompileServer.h"
+
+//mrk_client [--socket PATH] [--stats | --shutdown | compile arguments]
+//the arguments go to the server untouched, relative paths are resolved against this cwd
+int main(int argc, char** argv) {
+	mrks string path, error;
+	bool found = mrk GetDefaultCompileSocket(path, error);
+	mrks string command = "compile";
+	mrks vector<mrks string> args;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--socket") && i + 1 < argc) {
+			path = argv[++i];
+			found = true;
+		}
+		else if (!strcmp(argv[i], "--stats"))
+			command = "stats";
+		else if (!strcmp(argv[i], "--shutdown"))
+			command = "shutdown";
+		else
+			args.push_back(argv[i]);
+	}
+
+	if (!found) {
+		mrks cout << "mrk: " << error << '\n';
+		return 2;
+	}
+
+	return mrk RunCompileClient(path, command, mrks filesystem::current_path().string(), args, mrks cout);
+}
+
+#endif
@@ -26,12 +26,31 @@
 
 #pragma once
 
+// The Visual Studio project links every translation unit into a single executable
+// and selects its entry point here, CMake defines MRK_ENTRY_DEFINED and gives each
+// target its own entry macro instead
+#ifndef MRK_ENTRY_DEFINED
 //#define MRK_TEST_TOKENS
 #define MRK_TEST_PARSER
+#endif
+
+#include <cstddef>
+
+#ifndef _STD
+#define _STD ::std::
+#endif
 
 #define mrk ::MRK::
 #define mrks ::std::
 
 #define mrku32 unsigned int
 
+//byte offsets and token indices, as wide as any input that fits in memory
+#define mrkpos ::std::size_t
+//indices into the parse tables, -1 for none
+#define mrkidx ::std::ptrdiff_t
+
+//part of every output hash, bump when generated code changes
+#define MRK_VERSION "0.1.1"
+
 #define MRK_VEC_CONTAIN(vector, element) mrks find(vector.begin(), vector.end(), element) != vector.end()
\ No newline at end of file
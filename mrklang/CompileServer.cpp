@@ -0,0 +1,377 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "CompileServer.h"
+#include "Trace.h"
+
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif
+
+namespace MRK {
+#ifdef _WIN32
+	bool GetDefaultCompileSocket(mrks string& path, mrks string& error) {
+		path.clear();
+		error = "the compile server needs Unix domain sockets";
+		return false;
+	}
+
+	CompileServer::CompileServer(mrks string path) : m_Path(mrks move(path)), m_Fd(-1), m_Clients(0), m_Stopping(false) {
+	}
+
+	CompileServer::~CompileServer() {
+	}
+
+	bool CompileServer::Handle(int) {
+		return false;
+	}
+
+	void CompileServer::Stop() {
+	}
+
+	bool CompileServer::Listen(mrks string& error) {
+		error = "the compile server needs Unix domain sockets";
+		return false;
+	}
+
+	void CompileServer::Serve() {
+	}
+
+	int RunCompileClient(const mrks string&, const mrks string&, const mrks string&, const mrks vector<mrks string>&, mrks ostream& out) {
+		out << "mrk: the compile server needs Unix domain sockets\n";
+		return 2;
+	}
+#else
+	namespace {
+		bool SendAll(int fd, const char* data, size_t len) {
+			while (len) {
+				long long sent = send(fd, data, len, MSG_NOSIGNAL);
+				if (sent < 0) {
+					if (errno == EINTR)
+						continue;
+					return false;
+				}
+
+				data += sent;
+				len -= (size_t)sent;
+			}
+
+			return true;
+		}
+
+		bool ReceiveAll(int fd, char* data, size_t len) {
+			while (len) {
+				long long got = recv(fd, data, len, 0);
+				if (got < 0 && errno == EINTR)
+					continue;
+				if (got <= 0)
+					return false;
+
+				data += got;
+				len -= (size_t)got;
+			}
+
+			return true;
+		}
+
+		bool WriteFrame(int fd, const mrks string& payload) {
+			unsigned char header[4];
+			for (int i = 0; i < 4; i++)
+				header[i] = (unsigned char)(payload.size() >> (i * 8));
+
+			return SendAll(fd, (const char*)header, 4) && SendAll(fd, payload.data(), payload.size());
+		}
+
+		bool ReadFrame(int fd, mrks string& payload) {
+			unsigned char header[4];
+			if (!ReceiveAll(fd, (char*)header, 4))
+				return false;
+
+			//the length comes from the peer, it is checked before anything is allocated for it
+			size_t len = header[0] | (header[1] << 8) | (header[2] << 16) | ((size_t)header[3] << 24);
+			if (len > MRK_SERVER_MAX_FRAME)
+				return false;
+
+			payload.resize(len);
+			return !len || ReceiveAll(fd, &payload[0], len);
+		}
+
+		bool MakeAddress(const mrks string& path, sockaddr_un& address) {
+			memset(&address, 0, sizeof(address));
+			address.sun_family = AF_UNIX;
+			if (path.empty() || path.size() >= sizeof(address.sun_path))
+				return false;
+
+			memcpy(address.sun_path, path.c_str(), path.size());
+			return true;
+		}
+
+		//the uid of the process at the other end of a connected socket
+		bool IsSameUser(int fd) {
+#ifdef SO_PEERCRED
+			ucred cred;
+			socklen_t len = sizeof(cred);
+			return !getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) && cred.uid == getuid();
+#else
+			uid_t uid;
+			gid_t gid;
+			return !getpeereid(fd, &uid, &gid) && uid == getuid();
+#endif
+		}
+
+		int Connect(const mrks string& path) {
+			sockaddr_un address;
+			if (!MakeAddress(path, address))
+				return -1;
+
+			int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (fd < 0)
+				return -1;
+
+			if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0 || !IsSameUser(fd)) {
+				close(fd);
+				return -1;
+			}
+
+			return fd;
+		}
+	}
+
+	bool GetDefaultCompileSocket(mrks string& path, mrks string& error) {
+		const char* env = getenv("MRK_SERVER_SOCKET");
+		if (env && *env) {
+			path = env;
+			return true;
+		}
+
+		env = getenv("XDG_RUNTIME_DIR");
+		if (env && *env) {
+			path = mrks string(env) + "/mrk-server.sock";
+			return true;
+		}
+
+		//anyone can create /tmp/mrk-<uid> first, so it is only used when it is a real directory,
+		//ours and closed to everyone else
+		mrks string dir = "/tmp/mrk-" + mrks to_string(getuid());
+		if (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST) {
+			error = "cannot create " + dir + ": " + strerror(errno);
+			return false;
+		}
+
+		struct stat info;
+		if (lstat(dir.c_str(), &info) < 0 || !S_ISDIR(info.st_mode) || info.st_uid != getuid() || (info.st_mode & 077)) {
+			error = dir + " is not a directory private to this user";
+			return false;
+		}
+
+		path = dir + "/server.sock";
+		return true;
+	}
+
+	CompileServer::CompileServer(mrks string path) : m_Path(mrks move(path)), m_Fd(-1), m_Clients(0), m_Stopping(false) {
+	}
+
+	CompileServer::~CompileServer() {
+		if (m_Fd >= 0) {
+			close(m_Fd);
+			unlink(m_Path.c_str());
+		}
+	}
+
+	bool CompileServer::Listen(mrks string& error) {
+		sockaddr_un address;
+		if (!MakeAddress(m_Path, address)) {
+			error = "invalid socket path '" + m_Path + "'";
+			return false;
+		}
+
+		//a socket file nobody answers on was left by a server that died
+		int running = Connect(m_Path);
+		if (running >= 0) {
+			close(running);
+			error = "a server is already listening on " + m_Path;
+			return false;
+		}
+
+		unlink(m_Path.c_str());
+
+		m_Fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (m_Fd < 0 || bind(m_Fd, (sockaddr*)&address, sizeof(address)) < 0 || chmod(m_Path.c_str(), 0600) < 0 || listen(m_Fd, 16) < 0) {
+			error = "cannot listen on " + m_Path + ": " + strerror(errno);
+			if (m_Fd >= 0)
+				close(m_Fd);
+
+			m_Fd = -1;
+			return false;
+		}
+
+		return true;
+	}
+
+	bool CompileServer::Handle(int client) {
+		mrks string command, cwd, arg;
+		mrks vector<mrks string> args;
+		if (!ReadFrame(client, command) || !ReadFrame(client, cwd))
+			return true;
+
+		for (;;) {
+			if (!ReadFrame(client, arg))
+				return true;
+			if (arg.empty())
+				break;
+
+			args.push_back(mrks move(arg));
+		}
+
+		mrks lock_guard<mrks mutex> lock(m_CompilerLock);
+		TraceSpan span("Request", command);
+
+		//a client that stopped reading costs one send timeout, not one per line
+		bool connected = true;
+		auto diagnostic = [client, &connected](const mrks string& line) { connected = connected && WriteFrame(client, "D" + line); };
+
+		int status = 0;
+		if (command == "compile") {
+			CompileOptions options;
+			mrks string error;
+			if (ParseCompileArguments(args, cwd, options, error))
+				status = m_Compiler.Compile(options, diagnostic);
+			else {
+				diagnostic("mrk: " + error);
+				status = 2;
+			}
+		}
+		else if (command == "stats") {
+			const CompileStats& stats = m_Compiler.GetStats();
+			diagnostic("requests " + mrks to_string(stats.Requests));
+			diagnostic("parsed " + mrks to_string(stats.Parsed));
+			diagnostic("reused " + mrks to_string(stats.Reused));
+			diagnostic("cached " + mrks to_string(m_Compiler.GetCachedCount()));
+			diagnostic("last-ms " + mrks to_string(stats.LastMs));
+		}
+		else if (command != "shutdown") {
+			diagnostic("mrk: unknown command '" + command + "'");
+			status = 2;
+		}
+
+		if (connected)
+			WriteFrame(client, "S" + mrks to_string(status));
+		return command != "shutdown";
+	}
+
+	void CompileServer::Stop() {
+		//wakes the accept in Serve
+		m_Stopping = true;
+		shutdown(m_Fd, SHUT_RDWR);
+	}
+
+	void CompileServer::Serve() {
+		while (m_Fd >= 0 && !m_Stopping) {
+			int client = accept(m_Fd, 0, 0);
+			if (client < 0) {
+				if (errno == EINTR || errno == ECONNABORTED)
+					continue;
+				break;
+			}
+
+			if (m_Stopping || !IsSameUser(client)) {
+				close(client);
+				continue;
+			}
+
+			timeval timeout{ MRK_SERVER_TIMEOUT, 0 };
+			setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+			setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+			{
+				mrks unique_lock<mrks mutex> lock(m_ClientLock);
+				m_ClientsChanged.wait(lock, [this]() { return m_Clients < MRK_SERVER_MAX_CLIENTS; });
+				m_Clients++;
+			}
+
+			mrks thread([this, client]() {
+				if (!Handle(client))
+					Stop();
+				close(client);
+
+				mrks lock_guard<mrks mutex> lock(m_ClientLock);
+				m_Clients--;
+				m_ClientsChanged.notify_all();
+			}).detach();
+		}
+
+		{
+			mrks unique_lock<mrks mutex> lock(m_ClientLock);
+			m_ClientsChanged.wait(lock, [this]() { return !m_Clients; });
+		}
+
+		//later clients fail to connect instead of waiting in the backlog
+		if (m_Fd >= 0) {
+			close(m_Fd);
+			unlink(m_Path.c_str());
+			m_Fd = -1;
+		}
+	}
+
+	int RunCompileClient(const mrks string& path, const mrks string& command, const mrks string& cwd,
+		const mrks vector<mrks string>& args, mrks ostream& out) {
+		int fd = Connect(path);
+		if (fd < 0) {
+			out << "mrk: no server listening on " << path << '\n';
+			return 2;
+		}
+
+		bool sent = WriteFrame(fd, command) && WriteFrame(fd, cwd);
+		//an empty frame ends the arguments
+		for (size_t i = 0; sent && i < args.size(); i++)
+			sent = args[i].empty() || WriteFrame(fd, args[i]);
+
+		int status = 2;
+		mrks string frame;
+		if (sent && WriteFrame(fd, "")) {
+			while (ReadFrame(fd, frame)) {
+				if (!frame.empty() && frame[0] == 'D')
+					out.write(frame.data() + 1, frame.size() - 1) << '\n' << mrks flush;
+				else if (!frame.empty() && frame[0] == 'S') {
+					status = atoi(frame.c_str() + 1);
+					break;
+				}
+			}
+		}
+
+		close(fd);
+		return status;
+	}
+#endif
+}
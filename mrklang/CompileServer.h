@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "Compiler.h"
+
+#define MRK_SERVER_MAX_FRAME (64u << 20) //bytes, a longer frame drops the connection
+#define MRK_SERVER_TIMEOUT 30 //seconds a peer may stall one read or write
+#define MRK_SERVER_MAX_CLIENTS 16 //connections read at once, later ones wait in the backlog
+
+namespace MRK {
+	//$MRK_SERVER_SOCKET, otherwise mrk-server.sock in $XDG_RUNTIME_DIR or in a 0700 /tmp/mrk-<uid>
+	//directory, created if missing; false when that directory is not private to the user
+	bool GetDefaultCompileSocket(mrks string& path, mrks string& error);
+
+	//Compilation daemon on a Unix domain socket, every connection is read on its own thread but
+	//requests run one at a time on a single Compiler so each finds the sources, names and workers
+	//left by the previous one, a client that stalls only holds up its own connection
+	//Both ends hang up on a peer running as another user
+	//Frames are a little endian uint32 length and the payload. A request is the command
+	//("compile", "stats" or "shutdown"), the client cwd, its arguments and an empty frame
+	//The reply is one "D<line>" frame per diagnostic, streamed as produced, then "S<status>"
+	class CompileServer {
+	private:
+		mrks string m_Path;
+		int m_Fd;
+		Compiler m_Compiler;
+		mrks mutex m_CompilerLock;
+
+		mrks mutex m_ClientLock;
+		mrks condition_variable m_ClientsChanged;
+		unsigned m_Clients;
+		mrks atomic<bool> m_Stopping;
+
+		bool Handle(int client);
+		void Stop();
+
+	public:
+		CompileServer(mrks string path);
+		~CompileServer();
+
+		//fails when the socket cannot be bound or another server already answers on it
+		bool Listen(mrks string& error);
+
+		//until a shutdown request, returns once the requests still running are answered
+		void Serve();
+
+		const Compiler& GetCompiler() const { return m_Compiler; }
+	};
+
+	//sends one request and writes the replied lines to out, the status of the request
+	//or 2 when no server answers
+	int RunCompileClient(const mrks string& path, const mrks string& command, const mrks string& cwd,
+		const mrks vector<mrks string>& args, mrks ostream& out);
+}
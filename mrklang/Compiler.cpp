@@ -0,0 +1,491 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Compiler.h"
+#include "EmitPipeline.h"
+#include "Reachability.h"
+#include "Trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <unordered_set>
+#include <mutex>
+#include <cctype>
+
+#define MRK_RESPONSE_FILE_DEPTH 16
+
+namespace MRK {
+	namespace {
+		unsigned long long HashContents(const mrks string& str) {
+			unsigned long long hash = 0xcbf29ce484222325ull;
+			for (unsigned char c : str) {
+				hash ^= c;
+				hash *= 0x100000001b3ull;
+			}
+			return hash;
+		}
+
+		mrks string DescribePlatforms(const PlatformSet& platforms) {
+			if (platforms.All)
+				return "*";
+
+			mrks string out;
+			for (const mrks string& platform : platforms.Active)
+				out += platform + ',';
+			return out;
+		}
+
+		bool ReadSource(const mrks string& path, mrks string& code) {
+			mrks ifstream stream(path, mrks ios::binary | mrks ios::ate);
+			if (!stream)
+				return false;
+
+			//sized up front, a stringstream would double its buffer and copy it out
+			code.resize((size_t)stream.tellg());
+			stream.seekg(0);
+			return (bool)stream.read(&code[0], (mrks streamsize)code.size());
+		}
+
+		//i a.b; is a/b.mrk or a.b.mrk, next to the including source first
+		mrks string ResolveInclude(const mrks string& name, const mrks string& from, const mrks vector<mrks string>& dirs) {
+			mrks string nested = name;
+			mrks replace(nested.begin(), nested.end(), '.', '/');
+
+			mrks vector<mrks filesystem::path> roots{ mrks filesystem::path(from).parent_path() };
+			roots.insert(roots.end(), dirs.begin(), dirs.end());
+
+			mrks error_code ec;
+			for (const mrks filesystem::path& root : roots)
+				for (const mrks string& file : { nested, name })
+					if (mrks filesystem::is_regular_file(root / (file + ".mrk"), ec))
+						return (root / (file + ".mrk")).lexically_normal().string();
+
+			return "";
+		}
+
+		//whitespace separated, "quoted" or 'quoted' when an argument holds spaces
+		bool ReadResponseFile(const mrks string& path, mrks vector<mrks string>& args) {
+			mrks string text;
+			if (!ReadSource(path, text))
+				return false;
+
+			for (size_t i = 0; i < text.size();) {
+				if (isspace((unsigned char)text[i])) {
+					i++;
+					continue;
+				}
+
+				mrks string arg;
+				char quote = 0;
+				for (; i < text.size() && (quote || !isspace((unsigned char)text[i])); i++) {
+					if (quote ? text[i] == quote : text[i] == '"' || text[i] == '\'') {
+						quote = quote ? 0 : text[i];
+						continue;
+					}
+
+					arg += text[i];
+				}
+
+				args.push_back(mrks move(arg));
+			}
+
+			return true;
+		}
+
+		//@file arguments replaced by their contents, response files may name other ones
+		bool ExpandResponseFiles(const mrks vector<mrks string>& args, const mrks filesystem::path& base, mrks vector<mrks string>& out, mrks string& error, int depth = 0) {
+			for (const mrks string& arg : args) {
+				if (arg.size() < 2 || arg[0] != '@') {
+					out.push_back(arg);
+					continue;
+				}
+
+				mrks vector<mrks string> inner;
+				if (depth == MRK_RESPONSE_FILE_DEPTH) {
+					error = "response files nested too deeply at '" + arg + "'";
+					return false;
+				}
+
+				if (!ReadResponseFile((base / arg.substr(1)).string(), inner)) {
+					error = "cannot read the response file '" + arg.substr(1) + "'";
+					return false;
+				}
+
+				if (!ExpandResponseFiles(inner, base, out, error, depth + 1))
+					return false;
+			}
+
+			return true;
+		}
+
+		//a directory is every .mrk file below it, in path order
+		void AddInput(const mrks filesystem::path& path, mrks unordered_set<mrks string>& seen, mrks vector<mrks string>& inputs) {
+			mrks error_code ec;
+			if (!mrks filesystem::is_directory(path, ec)) {
+				if (seen.insert(path.string()).second)
+					inputs.push_back(path.string());
+				return;
+			}
+
+			mrks vector<mrks string> found;
+			for (mrks filesystem::recursive_directory_iterator it(path, ec), end; !ec && it != end; it.increment(ec))
+				if (it->path().extension() == ".mrk" && it->is_regular_file(ec))
+					found.push_back(it->path().lexically_normal().string());
+
+			mrks sort(found.begin(), found.end());
+			for (mrks string& file : found)
+				if (seen.insert(file).second)
+					inputs.push_back(mrks move(file));
+		}
+	}
+
+	bool ParseCompileArguments(const mrks vector<mrks string>& given, const mrks string& cwd, CompileOptions& options, mrks string& error) {
+		mrks filesystem::path base(cwd);
+		options.OutputDir = (base / "mrk-out").string();
+
+		mrks vector<mrks string> args;
+		if (!ExpandResponseFiles(given, base, args, error))
+			return false;
+
+		mrks unordered_set<mrks string> seen;
+
+		for (size_t i = 0; i < args.size(); i++) {
+			const mrks string& arg = args[i];
+			bool hasValue = i + 1 < args.size();
+
+			if (arg == "--target" && hasValue) {
+				EmitTarget target;
+				if (!ParseTargetName(args[++i], target)) {
+					error = "unknown target '" + args[i] + "'";
+					return false;
+				}
+
+				if (!(MRK_VEC_CONTAIN(options.Targets, target)))
+					options.Targets.push_back(target);
+			}
+			else if (arg == "-o" && hasValue)
+				options.OutputDir = (base / args[++i]).lexically_normal().string();
+			else if (arg == "-I" && hasValue)
+				options.IncludeDirs.push_back((base / args[++i]).lexically_normal().string());
+			else if (arg == "-j" && hasValue)
+				options.Threads = (unsigned)mrks max(0, atoi(args[++i].c_str()));
+			else if (arg == "--full")
+				options.Incremental = false;
+			else if (arg == "--platform" && hasValue)
+				options.Platforms.Enable(args[++i]);
+			else if (arg == "--diagnostics-format" && hasValue) {
+				if (!ParseDiagnosticFormat(args[++i], options.Format)) {
+					error = "unknown diagnostics format '" + args[i] + "'";
+					return false;
+				}
+			}
+			else if (arg == "--error-limit" && hasValue)
+				options.ErrorLimit = (size_t)mrks max(0, atoi(args[++i].c_str()));
+			else if (arg == "--root" && hasValue)
+				options.Roots.push_back(args[++i]);
+			else if (arg == "--reachable-only")
+				options.ReachableOnly = true;
+			else if (arg == "--reachability-report" && hasValue)
+				options.ReachabilityReport = (base / args[++i]).lexically_normal().string();
+			else if (arg == "-ftime-trace" && hasValue)
+				options.TimeTrace = (base / args[++i]).lexically_normal().string();
+			else if (!arg.compare(0, 13, "-ftime-trace=")) //as mrk_bench spells it
+				options.TimeTrace = (base / arg.substr(13)).lexically_normal().string();
+			else if (!arg.empty() && arg[0] == '-') {
+				error = "unknown option '" + arg + "'";
+				return false;
+			}
+			else
+				AddInput((base / arg).lexically_normal(), seen, options.Inputs);
+		}
+
+		if (options.Inputs.empty()) {
+			error = "no input files";
+			return false;
+		}
+
+		return true;
+	}
+
+	Compiler::Compiler() : m_PoolThreads(0), m_Stats() {
+		m_Semantic.SetKeepNames(true);
+	}
+
+	Compiler::LoadResult Compiler::Load(CachedSource& entry, const mrks string& path, const PlatformSet& platforms) {
+		mrks error_code ec;
+		unsigned long long size = mrks filesystem::file_size(path, ec);
+		long long time = ec ? 0 : (long long)mrks filesystem::last_write_time(path, ec).time_since_epoch().count();
+		if (ec)
+			return LoadResult::Failed;
+
+		//same size and time, then same contents, keep the parse
+		mrks string describe = DescribePlatforms(platforms);
+		bool cached = entry.Owner && entry.Platforms == describe;
+		if (cached && entry.Size == size && entry.Time == time)
+			return LoadResult::Reused;
+
+		mrks string code;
+		if (!ReadSource(path, code))
+			return LoadResult::Failed;
+
+		unsigned long long hash = HashContents(code);
+		if (cached && entry.Hash == hash) {
+			entry.Size = size;
+			entry.Time = time;
+			return LoadResult::Reused;
+		}
+
+		TraceSpan span("Load", path);
+
+		//generated code names the file, not where it was built
+		entry = CachedSource{ size, time, hash, describe };
+		entry.Owner = mrks make_unique<Parser>(mrks vector<Source> { Source{ mrks filesystem::path(path).filename().string(), mrks move(code) } });
+		entry.Owner->SetPlatforms(platforms);
+
+		ParserResult result;
+		entry.Owner->Start(result);
+		entry.Errors = mrks move(result.Errors);
+
+		Model model;
+		ResolveModel(*entry.Owner, model);
+		if (!model.Modules.empty())
+			entry.Module = mrks move(model.Modules.front());
+
+		return LoadResult::Parsed;
+	}
+
+	void Compiler::Invalidate(const mrks string& path) {
+		auto it = m_Sources.find(path);
+		if (it != m_Sources.end())
+			it->second.Time = -1;
+	}
+
+	int Compiler::Compile(const CompileOptions& options, const DiagnosticSink& sink) {
+		//a trace of this compilation only, whatever an earlier one recorded is dropped
+		bool tracing = Trace::IsEnabled();
+		if (!options.TimeTrace.empty() && !tracing) {
+			Trace::Clear();
+			Trace::Enable();
+		}
+
+		TraceSpan span("Compile", "");
+		auto start = mrks chrono::steady_clock::now();
+		m_Stats.Requests++;
+		m_ErrorArgs.Clear();
+
+		//diagnostics name the path that was given, sources only know their file name
+		DiagnosticWriter writer(options.Format, options.ErrorLimit, sink);
+		mrks unordered_map<const Source*, mrks string> paths;
+		auto report = [&](const mrk Error& err) {
+			auto path = paths.find(err.Source);
+			writer.Report(err, path != paths.end() ? path->second : mrks string(err.Source ? err.Source->Filename : "mrk"));
+		};
+
+		int status = 0;
+		size_t errorCount = 0;
+		Model model;
+
+		if (!m_Pool || m_PoolThreads != options.Threads) {
+			m_Pool.reset();
+			m_Pool = mrks make_unique<WorkPool>(options.Threads);
+			m_PoolThreads = options.Threads;
+		}
+
+		//the inputs, then the modules their includes resolve to, one parallel batch per level
+		m_LastSources = options.Inputs;
+		mrks unordered_set<mrks string> seen(options.Inputs.begin(), options.Inputs.end());
+		mrks vector<const CachedSource*> loaded;
+		mrks mutex sinkLock;
+
+		for (size_t first = 0; first < m_LastSources.size();) {
+			size_t count = m_LastSources.size() - first;
+
+			//entries are made here, jobs only touch their own
+			mrks vector<CachedSource*> entries(count);
+			for (size_t i = 0; i < count; i++)
+				entries[i] = &m_Sources[m_LastSources[first + i]];
+
+			mrks vector<LoadResult> results(count);
+			mrks vector<mrks vector<mrks string>> includes(count);
+			m_Pool->Run(count, [&](size_t job, unsigned) {
+				const mrks string& path = m_LastSources[first + job];
+				CachedSource& entry = *entries[job];
+
+				results[job] = Load(entry, path, options.Platforms);
+				if (results[job] != LoadResult::Failed)
+					for (const mrks string& include : entry.Module.Includes)
+						includes[job].push_back(ResolveInclude(include, path, options.IncludeDirs));
+
+				//streamed as each source is done, its diagnostics kept together
+				mrks lock_guard<mrks mutex> lock(sinkLock);
+				if (results[job] == LoadResult::Failed) {
+					writer.Report(mrk Error{ 0, ErrorCode::CannotRead }, path);
+					return;
+				}
+
+				for (const mrk Error& err : entry.Errors)
+					writer.Report(err, path);
+				errorCount += entry.Errors.size();
+			});
+
+			for (size_t i = 0; i < count; i++) {
+				if (results[i] == LoadResult::Failed) {
+					m_Sources.erase(m_LastSources[first + i]);
+					loaded.push_back(0);
+					status = 2;
+					continue;
+				}
+
+				(results[i] == LoadResult::Parsed ? m_Stats.Parsed : m_Stats.Reused)++;
+				loaded.push_back(entries[i]);
+
+				for (mrks string& resolved : includes[i])
+					if (!resolved.empty() && seen.insert(resolved).second)
+						m_LastSources.push_back(mrks move(resolved));
+			}
+
+			first += count;
+		}
+
+		//sources this closure no longer reaches would stay cached for the life of a server
+		for (auto it = m_Sources.begin(); it != m_Sources.end();)
+			it = seen.count(it->first) ? mrks next(it) : m_Sources.erase(it);
+
+		//the model keeps the order of the inputs whichever source finished first
+		size_t inputModules = 0;
+		for (size_t i = 0; i < loaded.size(); i++) {
+			if (!loaded[i])
+				continue;
+
+			paths[&loaded[i]->Owner->GetSources().front()] = m_LastSources[i];
+			if (loaded[i]->Module.Origin) {
+				model.Modules.push_back(loaded[i]->Module);
+				inputModules += i < options.Inputs.size();
+			}
+		}
+
+		auto phase = mrks chrono::steady_clock::now();
+		m_Stats.ParseMs = mrks chrono::duration<double, mrks milli>(phase - start).count();
+		m_Stats.AnalyzeMs = m_Stats.EmitMs = 0;
+
+		if (!status) {
+			mrks vector<mrk Error> errors;
+			m_Semantic.Analyze(model, errors);
+			for (const mrk Error& err : errors)
+				report(err);
+
+			errorCount += errors.size();
+			status = errorCount ? 1 : 0;
+
+			//included modules are emitted whole unless asked otherwise
+			if (!status && (options.ReachableOnly || !options.Roots.empty() || !options.ReachabilityReport.empty())) {
+				Reachability reachability(m_Semantic);
+				errors.clear();
+				reachability.Analyze(model, options.Roots, inputModules, errors);
+				for (const mrk Error& err : errors)
+					report(err);
+
+				errorCount += errors.size();
+				status = errorCount ? 1 : 0;
+
+				if (!status) {
+					ReachabilityCounts total = reachability.GetTotal();
+					ReachabilityCounts kept = reachability.GetKept();
+					writer.Note("reachability: " + mrks to_string(kept.Classes) + " of " + mrks to_string(total.Classes) + " classes, "
+						+ mrks to_string(kept.Methods) + " of " + mrks to_string(total.Methods) + " methods, "
+						+ mrks to_string(kept.Fields) + " of " + mrks to_string(total.Fields) + " fields reached"
+						+ (options.ReachableOnly ? ", the rest not emitted" : ""));
+
+					//before pruning, the report names what the model still has
+					if (!options.ReachabilityReport.empty()) {
+						mrks error_code ec;
+						mrks filesystem::create_directories(mrks filesystem::path(options.ReachabilityReport).parent_path(), ec);
+						mrks ofstream file(options.ReachabilityReport, mrks ios::binary);
+						reachability.WriteReport(file);
+						if (!file) {
+							writer.Report(MakeError(m_ErrorArgs, 0, ErrorCode::CannotWrite, MRK_NO_OFFSET, "reachability report"), options.ReachabilityReport);
+							status = 2;
+						}
+					}
+
+					if (options.ReachableOnly)
+						reachability.Prune(model);
+				}
+			}
+
+			auto analyzed = mrks chrono::steady_clock::now();
+			m_Stats.AnalyzeMs = mrks chrono::duration<double, mrks milli>(analyzed - phase).count();
+			phase = analyzed;
+		}
+
+		//nothing is generated from sources with errors
+		if (!status) {
+			mrks vector<EmitRequest> requests;
+			for (mrku32 i = 0; i < MRK_EMIT_TARGET_COUNT; i++) {
+				EmitTarget target = (EmitTarget)i;
+				if (options.Targets.empty() || MRK_VEC_CONTAIN(options.Targets, target))
+					requests.push_back(EmitRequest{ target, (mrks filesystem::path(options.OutputDir) / GetTargetName(target)).string(), options.Incremental });
+			}
+
+			for (EmitResult& result : EmitTargets(model, requests, *m_Pool)) {
+				writer.Note(mrks string(GetTargetName(result.Target)) + ": " + mrks to_string(result.Written) + " written, "
+					+ mrks to_string(result.Unchanged) + " unchanged, " + mrks to_string(result.Skipped) + " skipped");
+
+				if (!result.Success) {
+					writer.Report(MakeError(m_ErrorArgs, 0, ErrorCode::CannotWrite, MRK_NO_OFFSET, GetTargetName(result.Target)), options.OutputDir);
+					status = 2;
+				}
+			}
+
+			m_Stats.EmitMs = mrks chrono::duration<double, mrks milli>(mrks chrono::steady_clock::now() - phase).count();
+		}
+		else if (errorCount)
+			writer.Note(mrks to_string(errorCount) + " error(s)" + (writer.GetSuppressed() ? ", " + mrks to_string(writer.GetSuppressed()) + " not shown" : ""));
+
+		if (!options.TimeTrace.empty()) {
+			span.End();
+
+			mrks error_code ec;
+			mrks filesystem::create_directories(mrks filesystem::path(options.TimeTrace).parent_path(), ec);
+			if (!Trace::Write(options.TimeTrace)) {
+				writer.Report(MakeError(m_ErrorArgs, 0, ErrorCode::CannotWrite, MRK_NO_OFFSET, "time trace"), options.TimeTrace);
+				status = 2;
+			}
+
+			if (!tracing) {
+				Trace::Disable();
+				Trace::Clear();
+			}
+		}
+
+		writer.Finish();
+
+		m_Stats.LastMs = mrks chrono::duration<double, mrks milli>(mrks chrono::steady_clock::now() - start).count();
+		return status;
+	}
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+
+#include "Common.h"
+#include "Diagnostics.h"
+#include "Error.h"
+#include "Model.h"
+#include "Parser.h"
+#include "Platform.h"
+#include "Semantic.h"
+#include "WorkPool.h"
+
+namespace MRK {
+	struct CompileOptions {
+		mrks vector<mrks string> Inputs; //absolute paths of the .mrk sources, directories expanded
+		mrks vector<EmitTarget> Targets; //every target when empty
+		mrks string OutputDir; //one subdirectory per target
+		mrks vector<mrks string> IncludeDirs; //searched for included modules after the including source's directory
+		unsigned Threads = 0; //loading, parsing and emission, 0 = one per hardware thread
+		bool Incremental = true;
+		PlatformSet Platforms;
+		DiagnosticFormat Format = DiagnosticFormat::Text;
+		size_t ErrorLimit = MRK_ERROR_LIMIT; //per source, 0 = unlimited
+		mrks vector<mrks string> Roots; //reachability roots, every class of the inputs when empty
+		bool ReachableOnly = false; //emit only what the roots reach
+		mrks string ReachabilityReport; //what is not reached, written when not empty
+		mrks string TimeTrace; //Chrome trace of this compilation, written when not empty
+	};
+
+	//files, directories (every .mrk below), @file (more arguments), --target NAME (repeatable), -o DIR,
+	//-I DIR (repeatable), -j N, --full, --platform NAME, --diagnostics-format text|jsonl|sarif, --error-limit N,
+	//--root NAME (repeatable), --reachable-only, --reachability-report FILE, -ftime-trace FILE (or =FILE)
+	//relative paths are taken from cwd, false with a message on bad arguments
+	bool ParseCompileArguments(const mrks vector<mrks string>& args, const mrks string& cwd, CompileOptions& options, mrks string& error);
+
+	struct CompileStats {
+		size_t Requests;
+		size_t Parsed; //sources parsed and resolved
+		size_t Reused; //sources taken from the cache
+		double LastMs;
+		double ParseMs; //phases of the last compilation
+		double AnalyzeMs;
+		double EmitMs;
+	};
+
+	//front end and backends with state kept between compilations: every source stays parsed and
+	//resolved until its contents change or a compilation no longer reaches it, the names of the
+	//last analysis stay interned and the worker pool stays up. Analysis and emission run again,
+	//they depend on every source
+	class Compiler {
+	private:
+		struct CachedSource {
+			unsigned long long Size;
+			long long Time; //modification time, ticks of the file clock
+			unsigned long long Hash; //contents
+			mrks string Platforms;
+			mrks unique_ptr<mrk Parser> Owner;
+			mrks vector<mrk Error> Errors;
+			ModelModule Module; //pristine, every compilation analyzes a copy
+		};
+
+		mrks unordered_map<mrks string, CachedSource> m_Sources;
+		Semantic m_Semantic;
+		ErrorArgs m_ErrorArgs; //of the errors the driver reports itself
+		mrks unique_ptr<WorkPool> m_Pool;
+		unsigned m_PoolThreads;
+		CompileStats m_Stats;
+		mrks vector<mrks string> m_LastSources;
+
+		enum class LoadResult {
+			Failed,
+			Reused,
+			Parsed
+		};
+
+		//touches nothing but entry, a new entry has no Owner
+		LoadResult Load(CachedSource& entry, const mrks string& path, const PlatformSet& platforms);
+
+	public:
+		Compiler();
+
+		//0 on success, 1 on errors in the sources, 2 when a source cannot be read or written
+		int Compile(const CompileOptions& options, const DiagnosticSink& sink);
+
+		//the next compilation compares the contents even if size and time did not change
+		void Invalidate(const mrks string& path);
+
+		const CompileStats& GetStats() const { return m_Stats; }
+		size_t GetCachedCount() const { return m_Sources.size(); }
+
+		//inputs and the included modules found for them by the last compilation
+		const mrks vector<mrks string>& GetLastSources() const { return m_LastSources; }
+	};
+}
@@ -0,0 +1,662 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Constants.h"
+#include "Semantic.h"
+#include "Trace.h"
+
+#include <climits>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace MRK {
+	namespace {
+		ModelConstant MakeConstant(BuiltinType type) {
+			ModelConstant value{ ConstantState::Folded, type };
+			value.Int = 0;
+			return value;
+		}
+
+		ModelConstant MakeInt(long long val) {
+			ModelConstant value = MakeConstant(BuiltinType::Long);
+			value.Int = val;
+			return value;
+		}
+
+		ModelConstant MakeUInt(unsigned long long val) {
+			ModelConstant value = MakeConstant(BuiltinType::ULong);
+			value.UInt = val;
+			return value;
+		}
+
+		ModelConstant MakeBool(bool val) {
+			ModelConstant value = MakeConstant(BuiltinType::Bool);
+			value.Bool = val;
+			return value;
+		}
+
+		ModelConstant MakeFloat(double val) {
+			ModelConstant value = MakeConstant(BuiltinType::Double);
+			value.Float = val;
+			return value;
+		}
+
+		bool IsInteger(const ModelConstant& value) {
+			return value.Type == BuiltinType::Long || value.Type == BuiltinType::ULong;
+		}
+
+		double ToFloat(const ModelConstant& value) {
+			return value.Type == BuiltinType::ULong ? (double)value.UInt : (value.Type == BuiltinType::Long ? (double)value.Int : value.Float);
+		}
+
+		//checked signed 64-bit arithmetic, false on overflow
+		bool Add(long long a, long long b, long long& r) {
+			if ((b > 0 && a > LLONG_MAX - b) || (b < 0 && a < LLONG_MIN - b))
+				return false;
+			r = a + b;
+			return true;
+		}
+
+		bool Sub(long long a, long long b, long long& r) {
+			if ((b < 0 && a > LLONG_MAX + b) || (b > 0 && a < LLONG_MIN + b))
+				return false;
+			r = a - b;
+			return true;
+		}
+
+		bool Mul(long long a, long long b, long long& r) {
+			if (a > 0 ? (b > 0 ? a > LLONG_MAX / b : b < LLONG_MIN / a) : (b > 0 ? a < LLONG_MIN / b : a != 0 && b < LLONG_MAX / a))
+				return false;
+			r = a * b;
+			return true;
+		}
+
+		bool Range(BuiltinType type, long long& min, unsigned long long& max) {
+			switch (type) {
+
+			case BuiltinType::Byte: min = 0; max = UCHAR_MAX; return true;
+			case BuiltinType::Char: min = 0; max = SCHAR_MAX; return true; //the range every target's char agrees on
+			case BuiltinType::Short: min = SHRT_MIN; max = SHRT_MAX; return true;
+			case BuiltinType::UShort: min = 0; max = USHRT_MAX; return true;
+			case BuiltinType::Int: min = INT_MIN; max = INT_MAX; return true;
+			case BuiltinType::UInt: min = 0; max = UINT_MAX; return true;
+			case BuiltinType::Long: min = LLONG_MIN; max = LLONG_MAX; return true;
+			case BuiltinType::ULong: min = 0; max = ULLONG_MAX; return true;
+			default: return false;
+
+			}
+		}
+	}
+
+	Constants::Constants(const Semantic& semantic) : m_Semantic(semantic), m_Model(0), m_Errors(0), m_Frame{ -1, 0, 0, 0, false, false } {
+	}
+
+	void Constants::Fail(ErrorCode code, const mrks string& detail) {
+		//first error of an expression only, the rest would be follow-ups
+		if (m_Frame.Failed)
+			return;
+
+		m_Frame.Failed = true;
+		if (code == ErrorCode::None)
+			return;
+
+		//Type::method::var, joined when the error is formatted
+		ErrorArgs& names = m_Semantic.GetErrorArgs();
+		const ModelMethod* method = m_Frame.Method;
+		mrku32 context = names.Intern(m_Semantic.GetType(m_Frame.Class->TypeId).FullName);
+		if (method)
+			context = names.Join(context, names.Intern(method->IsCtor ? m_Frame.Class->Name : method->Name));
+		context = names.Join(context, names.Intern(m_Frame.Var->Name));
+
+		m_Errors->push_back(MakeError(names, m_Model->Modules[m_Frame.Module].Origin, code, m_Frame.Var->Offset, names.Intern(detail), context));
+	}
+
+	void Constants::Defer() {
+		if (m_Frame.Failed)
+			return;
+
+		m_Frame.Failed = true;
+		m_Frame.Runtime = true;
+	}
+
+	const ExprArena& Constants::GetArena() const {
+		return *m_Model->Modules[m_Frame.Module].Expressions;
+	}
+
+	ModelConstant Constants::FoldExpression(mrku32 root) {
+		const ExprArena& arena = GetArena();
+		size_t visitBase = m_Visits.size();
+		size_t valueBase = m_Values.size();
+
+		m_Visits.push_back(Visit{ root, false });
+		while (m_Visits.size() > visitBase && !m_Frame.Failed) {
+			Visit visit = m_Visits.back();
+			m_Visits.pop_back();
+
+			const ExprNode& node = arena.Get(visit.Node);
+			switch (node.Kind) {
+
+			case ExprKind::Int:
+				m_Values.push_back(MakeInt(node.Int));
+				break;
+
+			case ExprKind::UInt:
+				m_Values.push_back(MakeUInt(node.UInt));
+				break;
+
+			case ExprKind::Bool:
+				m_Values.push_back(MakeBool(node.Int != 0));
+				break;
+
+			case ExprKind::String: {
+				ModelConstant value = MakeConstant(BuiltinType::String);
+				value.String = node.Text;
+				m_Values.push_back(mrks move(value));
+				break;
+			}
+
+			case ExprKind::Name:
+			case ExprKind::Member:
+				m_Values.push_back(FoldReference(visit.Node));
+				break;
+
+			case ExprKind::Unary:
+			case ExprKind::Binary:
+				if (!visit.Operands) {
+					//right is pushed first so left is evaluated first
+					m_Visits.push_back(Visit{ visit.Node, true });
+					if (node.Kind == ExprKind::Binary)
+						m_Visits.push_back(Visit{ node.Right, false });
+					m_Visits.push_back(Visit{ node.Left, false });
+					break;
+				}
+
+				if (node.Kind == ExprKind::Unary)
+					m_Values.back() = Apply(node.Op, m_Values.back());
+				else {
+					ModelConstant rhs = mrks move(m_Values.back());
+					m_Values.pop_back();
+					m_Values.back() = Apply(node.Op, m_Values.back(), rhs);
+				}
+				break;
+
+			//calls, construction and indexing run with the object
+			default:
+				Defer();
+				break;
+
+			}
+		}
+
+		ModelConstant value = m_Frame.Failed || m_Values.size() == valueBase ? MakeInt(0) : m_Values.back();
+		m_Visits.erase(m_Visits.begin() + visitBase, m_Visits.end());
+		m_Values.erase(m_Values.begin() + valueBase, m_Values.end());
+		return value;
+	}
+
+	ModelConstant Constants::Apply(ExprOp op, const ModelConstant& operand) {
+		ModelConstant value = operand;
+		switch (op) {
+
+		case ExprOp::Not:
+			if (value.Type != BuiltinType::Bool)
+				break;
+			value.Bool = !value.Bool;
+			return value;
+
+		case ExprOp::Complement:
+			if (!IsInteger(value))
+				break;
+			value.UInt = ~value.UInt;
+			return value;
+
+		case ExprOp::Plus:
+			if (!IsInteger(value) && value.Type != BuiltinType::Double)
+				break;
+			return value;
+
+		case ExprOp::Neg:
+			if (value.Type == BuiltinType::Double)
+				return MakeFloat(-value.Float);
+
+			if (value.Type == BuiltinType::ULong) {
+				if (value.UInt > LLONG_MAX)
+					return Fail(ErrorCode::ConstantOverflow), value;
+				value = MakeInt((long long)value.UInt);
+			}
+
+			if (value.Type != BuiltinType::Long)
+				break;
+
+			if (value.Int == LLONG_MIN)
+				return Fail(ErrorCode::ConstantOverflow), value;
+
+			value.Int = -value.Int;
+			return value;
+
+		default:
+			break;
+
+		}
+
+		Fail(ErrorCode::ConstantType, GetOperatorText(op));
+		return value;
+	}
+
+	ModelConstant Constants::FoldReference(mrku32 node) {
+		//name or Type.Nested.name, locals and params first, then fields up the class chain
+		const ExprArena& arena = GetArena();
+		mrks vector<const char*> names;
+		for (; arena.Get(node).Kind == ExprKind::Member; node = arena.Get(node).Left)
+			names.push_back(arena.Get(node).Text);
+
+		if (arena.Get(node).Kind != ExprKind::Name) {
+			Defer();
+			return MakeInt(0);
+		}
+
+		mrks string name = arena.Get(node).Text;
+
+		const ModelModule* module = &m_Model->Modules[m_Frame.Module];
+		const ModelClass* _class = m_Frame.Class;
+		const Symbol* symbol = 0;
+
+		if (m_Frame.Method)
+			symbol = m_Semantic.Lookup(m_Frame.Method->Scope, name);
+
+		for (const ModelClass* scope = _class; !symbol && scope; scope = scope->Parent >= 0 ? &module->Classes[scope->Parent] : 0)
+			symbol = m_Semantic.Lookup(scope->Scope, name);
+
+		mrks string path = name;
+		mrku32 typeId = symbol ? (symbol->Kind == SymbolKind::Type ? symbol->TypeId : MRK_TYPE_UNRESOLVED) : m_Semantic.FindType(*module, *_class, name);
+
+		//walk qualified names through nested types, collected innermost last
+		for (; !names.empty(); names.pop_back()) {
+			const char* member = names.back();
+
+			//a member of a value is read at run time
+			const TypeInfo* type = typeId != MRK_TYPE_UNRESOLVED ? &m_Semantic.GetType(typeId) : 0;
+			if (symbol && symbol->Kind != SymbolKind::Type) {
+				Defer();
+				return MakeInt(0);
+			}
+
+			if (!type || type->Module < 0) {
+				Fail(ErrorCode::UndefinedName, path);
+				return MakeInt(0);
+			}
+
+			path += mrks string(".") + member;
+			module = &m_Model->Modules[type->Module];
+			_class = &module->Classes[type->Class];
+			symbol = m_Semantic.Lookup(_class->Scope, member);
+			typeId = symbol && symbol->Kind == SymbolKind::Type ? symbol->TypeId : MRK_TYPE_UNRESOLVED;
+		}
+
+		if (!symbol || symbol->Kind == SymbolKind::Type) {
+			Fail(symbol || typeId != MRK_TYPE_UNRESOLVED ? ErrorCode::NotAValue : ErrorCode::UndefinedName, path);
+			return MakeInt(0);
+		}
+
+		ModelVar* var = 0;
+		const ModelMethod* method = 0;
+		if (symbol->Kind == SymbolKind::Field)
+			var = &m_Model->Modules[symbol->Module].Classes[symbol->Class].Fields[symbol->Member];
+		else if (symbol->Kind == SymbolKind::Local && m_Frame.Method) {
+			method = m_Frame.Method;
+			var = const_cast<ModelVar*>(&method->Locals[symbol->Member]);
+		}
+
+		//params, methods and vars without a constant default are only known at run time
+		if (!var || var->Constant.State == ConstantState::None || var->Constant.State == ConstantState::Runtime) {
+			Defer();
+			return MakeInt(0);
+		}
+
+		if (var->Constant.State == ConstantState::Evaluating) {
+			Fail(ErrorCode::ConstantCycle, path);
+			return MakeInt(0);
+		}
+
+		const ModelClass& owner = m_Model->Modules[symbol->Module].Classes[symbol->Class];
+		const ModelConstant* value = Fold(symbol->Module, owner, method, *var);
+
+		//already reported where it was declared
+		if (!value) {
+			if (var->Constant.State == ConstantState::Runtime)
+				Defer();
+			else
+				Fail(ErrorCode::None);
+			return MakeInt(0);
+		}
+
+		//back to the evaluator's domain, the declared type is only a range
+		switch (value->Type) {
+
+		case BuiltinType::ULong: return MakeUInt(value->UInt);
+		case BuiltinType::Float:
+		case BuiltinType::Double: return MakeFloat(value->Float);
+		case BuiltinType::Bool:
+		case BuiltinType::String: return *value;
+		default: return MakeInt(value->Int);
+
+		}
+	}
+
+	ModelConstant Constants::Apply(ExprOp op, const ModelConstant& lhs, const ModelConstant& rhs) {
+		if (lhs.Type == BuiltinType::String || rhs.Type == BuiltinType::String) {
+			if (lhs.Type == rhs.Type) {
+				switch (op) {
+
+				case ExprOp::Add: {
+					ModelConstant value = lhs;
+					value.String += rhs.String;
+					return value;
+				}
+
+				case ExprOp::Eq: return MakeBool(lhs.String == rhs.String);
+				case ExprOp::Ne: return MakeBool(lhs.String != rhs.String);
+
+				}
+			}
+		}
+		else if (lhs.Type == BuiltinType::Bool || rhs.Type == BuiltinType::Bool) {
+			if (lhs.Type == rhs.Type) {
+				switch (op) {
+
+				case ExprOp::And: return MakeBool(lhs.Bool && rhs.Bool);
+				case ExprOp::Or: return MakeBool(lhs.Bool || rhs.Bool);
+				case ExprOp::Eq: return MakeBool(lhs.Bool == rhs.Bool);
+				case ExprOp::Ne: return MakeBool(lhs.Bool != rhs.Bool);
+
+				}
+			}
+		}
+		else if (lhs.Type == BuiltinType::Double || rhs.Type == BuiltinType::Double) {
+			double a = ToFloat(lhs);
+			double b = ToFloat(rhs);
+
+			switch (op) {
+
+			case ExprOp::Add: return MakeFloat(a + b);
+			case ExprOp::Sub: return MakeFloat(a - b);
+			case ExprOp::Mul: return MakeFloat(a * b);
+
+			case ExprOp::Div:
+				if (b == 0)
+					return Fail(ErrorCode::DivideByZero), lhs;
+				return MakeFloat(a / b);
+
+			case ExprOp::Lt: return MakeBool(a < b);
+			case ExprOp::Le: return MakeBool(a <= b);
+			case ExprOp::Gt: return MakeBool(a > b);
+			case ExprOp::Ge: return MakeBool(a >= b);
+			case ExprOp::Eq: return MakeBool(a == b);
+			case ExprOp::Ne: return MakeBool(a != b);
+
+			}
+		}
+		else if (lhs.Type == BuiltinType::ULong || rhs.Type == BuiltinType::ULong) {
+			//a negative operand has no unsigned value
+			if ((lhs.Type == BuiltinType::Long && lhs.Int < 0) || (rhs.Type == BuiltinType::Long && rhs.Int < 0))
+				return Fail(ErrorCode::ConstantOverflow), lhs;
+
+			unsigned long long a = lhs.UInt;
+			unsigned long long b = rhs.UInt;
+
+			switch (op) {
+
+			case ExprOp::Add:
+				if (a + b < a)
+					break;
+				return MakeUInt(a + b);
+
+			case ExprOp::Sub:
+				if (a < b)
+					break;
+				return MakeUInt(a - b);
+
+			case ExprOp::Mul:
+				if (a && (a * b) / a != b)
+					break;
+				return MakeUInt(a * b);
+
+			case ExprOp::Div:
+			case ExprOp::Mod:
+				if (!b)
+					return Fail(ErrorCode::DivideByZero), lhs;
+				return MakeUInt(op == ExprOp::Div ? a / b : a % b);
+
+			case ExprOp::Shl:
+				if (b >= 64 || a > (ULLONG_MAX >> b))
+					break;
+				return MakeUInt(a << b);
+
+			case ExprOp::Shr:
+				if (b >= 64)
+					break;
+				return MakeUInt(a >> b);
+
+			case ExprOp::BitAnd: return MakeUInt(a & b);
+			case ExprOp::BitOr: return MakeUInt(a | b);
+			case ExprOp::Xor: return MakeUInt(a ^ b);
+			case ExprOp::Lt: return MakeBool(a < b);
+			case ExprOp::Le: return MakeBool(a <= b);
+			case ExprOp::Gt: return MakeBool(a > b);
+			case ExprOp::Ge: return MakeBool(a >= b);
+			case ExprOp::Eq: return MakeBool(a == b);
+			case ExprOp::Ne: return MakeBool(a != b);
+
+			default:
+				Fail(ErrorCode::ConstantType);
+				return lhs;
+
+			}
+
+			Fail(ErrorCode::ConstantOverflow);
+			return lhs;
+		}
+		else {
+			long long a = lhs.Int;
+			long long b = rhs.Int;
+			long long r = 0;
+
+			switch (op) {
+
+			case ExprOp::Add:
+				if (!Add(a, b, r))
+					break;
+				return MakeInt(r);
+
+			case ExprOp::Sub:
+				if (!Sub(a, b, r))
+					break;
+				return MakeInt(r);
+
+			case ExprOp::Mul:
+				if (!Mul(a, b, r))
+					break;
+				return MakeInt(r);
+
+			case ExprOp::Div:
+			case ExprOp::Mod:
+				if (!b)
+					return Fail(ErrorCode::DivideByZero), lhs;
+				if (a == LLONG_MIN && b == -1)
+					break;
+				return MakeInt(op == ExprOp::Div ? a / b : a % b);
+
+			case ExprOp::Shl:
+				//a shift has to be a multiplication that fits
+				if (b < 0 || b >= 63 || a > (LLONG_MAX >> b) || a < (LLONG_MIN >> b))
+					break;
+				return MakeInt((long long)((unsigned long long)a << b));
+
+			case ExprOp::Shr:
+				if (b < 0 || b >= 64)
+					break;
+				return MakeInt(a >> b);
+
+			case ExprOp::BitAnd: return MakeInt(a & b);
+			case ExprOp::BitOr: return MakeInt(a | b);
+			case ExprOp::Xor: return MakeInt(a ^ b);
+			case ExprOp::Lt: return MakeBool(a < b);
+			case ExprOp::Le: return MakeBool(a <= b);
+			case ExprOp::Gt: return MakeBool(a > b);
+			case ExprOp::Ge: return MakeBool(a >= b);
+			case ExprOp::Eq: return MakeBool(a == b);
+			case ExprOp::Ne: return MakeBool(a != b);
+
+			default:
+				Fail(ErrorCode::ConstantType);
+				return lhs;
+
+			}
+
+			Fail(ErrorCode::ConstantOverflow);
+			return lhs;
+		}
+
+		Fail(ErrorCode::ConstantType);
+		return lhs;
+	}
+
+	bool Constants::Convert(ModelConstant& value, BuiltinType type) {
+		switch (type) {
+
+		case BuiltinType::Bool:
+		case BuiltinType::String:
+			if (value.Type != type)
+				return Fail(ErrorCode::ConstantType), false;
+			return true;
+
+		case BuiltinType::Float:
+		case BuiltinType::Double: {
+			if (!IsInteger(value) && value.Type != BuiltinType::Double)
+				return Fail(ErrorCode::ConstantType), false;
+
+			double val = ToFloat(value);
+			if (!mrks isfinite(val) || (type == BuiltinType::Float && mrks fabs(val) > FLT_MAX))
+				return Fail(ErrorCode::ConstantOverflow), false;
+
+			value.Type = type;
+			value.Float = type == BuiltinType::Float ? (double)(float)val : val;
+			return true;
+		}
+
+		default:
+			break;
+
+		}
+
+		long long min;
+		unsigned long long max;
+		if (!Range(type, min, max) || !IsInteger(value))
+			return Fail(ErrorCode::ConstantType), false;
+
+		bool fits = value.Type == BuiltinType::ULong ? value.UInt <= max
+			: value.Int >= min && (value.Int < 0 || (unsigned long long)value.Int <= max);
+		if (!fits)
+			return Fail(ErrorCode::ConstantOverflow), false;
+
+		//Int and UInt share storage, only the tag changes
+		value.Type = type;
+		return true;
+	}
+
+	const ModelConstant* Constants::Fold(int module, const ModelClass& _class, const ModelMethod* method, ModelVar& var) {
+		ModelConstant& constant = var.Constant;
+		if (constant.State == ConstantState::Folded)
+			return &constant;
+
+		if (constant.State != ConstantState::Pending)
+			return 0;
+
+		Frame saved = m_Frame;
+		m_Frame = Frame{ module, &_class, method, &var, false, false };
+
+		constant.State = ConstantState::Evaluating;
+
+		//a user type is built at run time, a default of one that folds is a constant of the wrong type
+		ModelConstant value = MakeInt(0);
+		if (var.Type.Builtin == BuiltinType::Void)
+			Fail(ErrorCode::ConstantType);
+		else {
+			value = FoldExpression(var.Default);
+			if (!m_Frame.Failed && var.Type.IsUser())
+				Fail(ErrorCode::ConstantType);
+			else if (!m_Frame.Failed)
+				Convert(value, var.Type.Builtin);
+		}
+
+		bool failed = m_Frame.Failed;
+		bool runtime = m_Frame.Runtime;
+		m_Frame = saved;
+
+		if (failed) {
+			constant.State = runtime ? ConstantState::Runtime : ConstantState::Failed;
+			return 0;
+		}
+
+		value.State = ConstantState::Folded;
+		constant = value;
+		return &constant;
+	}
+
+	void Constants::Evaluate(Model& model, mrks vector<mrk Error>& errors) {
+		TraceSpan span("Constants", "");
+
+		m_Model = &model;
+		m_Errors = &errors;
+
+		//a model analyzed before is folded again from its expressions
+		for (ModelModule& module : model.Modules) {
+			for (ModelClass& _class : module.Classes) {
+				for (ModelVar& field : _class.Fields)
+					field.Constant.State = field.Default != MRK_EXPR_NONE ? ConstantState::Pending : ConstantState::None;
+
+				for (ModelMethod& method : _class.Methods)
+					for (ModelVar& local : method.Locals)
+						local.Constant.State = local.Default != MRK_EXPR_NONE ? ConstantState::Pending : ConstantState::None;
+			}
+		}
+
+		size_t folded = 0;
+		for (size_t m = 0; m < model.Modules.size(); m++) {
+			for (ModelClass& _class : model.Modules[m].Classes) {
+				for (ModelVar& field : _class.Fields)
+					folded += Fold((int)m, _class, 0, field) != 0;
+
+				for (ModelMethod& method : _class.Methods)
+					for (ModelVar& local : method.Locals)
+						folded += Fold((int)m, _class, &method, local) != 0;
+			}
+		}
+
+		span.Arg("folded", folded);
+	}
+}
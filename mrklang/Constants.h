@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common.h"
+#include "Error.h"
+#include "Model.h"
+#include "Expression.h"
+
+namespace MRK {
+	class Semantic;
+
+	//folds var defaults, v type name { r expression }, into compile-time constants
+	//Literals, arithmetic, bitwise, comparison and logical operators and references to other
+	//constants are evaluated with checked 64-bit arithmetic, the result has to fit the declared type
+	//A default that calls, constructs or reads a runtime value stays a runtime initializer, only
+	//faults in what is evaluated (overflow, division by zero, cycles, mismatched constants) are errors
+	class Constants {
+	private:
+		//var being folded, swapped out while a referenced constant is folded
+		struct Frame {
+			int Module;
+			const ModelClass* Class;
+			const ModelMethod* Method;
+			const ModelVar* Var; //error context and location, only formatted on failure
+			bool Failed;
+			bool Runtime; //stopped at something only known at run time, not an error
+		};
+
+		//post-order walk, operands are visited before their operator
+		struct Visit {
+			mrku32 Node;
+			bool Operands; //operands already evaluated
+		};
+
+		const Semantic& m_Semantic;
+		Model* m_Model;
+		mrks vector<mrk Error>* m_Errors;
+		Frame m_Frame;
+		mrks vector<Visit> m_Visits; //shared by nested folds, each works above its own base
+		mrks vector<ModelConstant> m_Values;
+
+		void Fail(ErrorCode code, const mrks string& detail = "");
+		void Defer();
+		const ExprArena& GetArena() const;
+
+		ModelConstant FoldExpression(mrku32 root);
+		ModelConstant FoldReference(mrku32 node);
+		ModelConstant Apply(ExprOp op, const ModelConstant& value);
+		ModelConstant Apply(ExprOp op, const ModelConstant& lhs, const ModelConstant& rhs);
+		bool Convert(ModelConstant& value, BuiltinType type);
+		const ModelConstant* Fold(int module, const ModelClass& _class, const ModelMethod* method, ModelVar& var);
+
+	public:
+		Constants(const Semantic& semantic);
+
+		//called by Semantic::Analyze once every type and scope is known
+		void Evaluate(Model& model, mrks vector<mrk Error>& errors);
+	};
+}
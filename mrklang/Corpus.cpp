@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Corpus.h"
+
+#include <cstring>
+#include <cctype>
+
+namespace MRK {
+	namespace {
+		const char* g_Builtins[] = { "int", "long", "float", "double", "bool", "byte", "string" };
+		const mrku32 g_BuiltinCount = sizeof(g_Builtins) / sizeof(g_Builtins[0]);
+
+		//defaults that do not parse, each a different diagnostic
+		const char* g_BrokenDefaults[] = { "(1 + 2", "1 + * 2", "values[1", "3 = 4", "f(1, )", ")" };
+		const mrku32 g_BrokenDefaultCount = sizeof(g_BrokenDefaults) / sizeof(g_BrokenDefaults[0]);
+
+		struct Random {
+			mrku32 State;
+
+			mrku32 Next(mrku32 bound) {
+				//xorshift32, reproducible across platforms
+				State ^= State << 13;
+				State ^= State >> 17;
+				State ^= State << 5;
+				return State % bound;
+			}
+		};
+
+		mrks string ClassName(mrku32 index) {
+			return "Gen" + mrks to_string(index);
+		}
+
+		//builtin or one of the classes declared so far
+		mrks string PickType(Random& rng, mrku32 declared) {
+			if (declared && rng.Next(4) == 0)
+				return ClassName(rng.Next(declared));
+
+			return g_Builtins[rng.Next(g_BuiltinCount)];
+		}
+
+		void AppendMembers(mrks string& out, Random& rng, mrku32 declared, const char* indent) {
+			mrku32 fields = 2 + rng.Next(5);
+			for (mrku32 i = 0; i < fields; i++)
+				out += mrks string(indent) + "v " + PickType(rng, declared) + " field" + mrks to_string(i) + '\n';
+
+			out += mrks string(indent) + "m .{\n" + indent + "\tp {\n";
+			out += mrks string(indent) + "\t\tint seed\n" + indent + "\t}\n" + indent + "}\n";
+
+			mrku32 methods = 1 + rng.Next(4);
+			for (mrku32 i = 0; i < methods; i++) {
+				out += mrks string(indent) + "m " + (rng.Next(3) ? PickType(rng, declared) : "void") + " Method" + mrks to_string(i) + " {\n";
+
+				mrku32 params = rng.Next(4);
+				if (params) {
+					out += mrks string(indent) + "\tp {\n";
+					for (mrku32 j = 0; j < params; j++)
+						out += mrks string(indent) + "\t\t" + PickType(rng, declared) + " arg" + mrks to_string(j) + '\n';
+					out += mrks string(indent) + "\t}\n";
+				}
+
+				mrku32 vars = rng.Next(3);
+				for (mrku32 j = 0; j < vars; j++)
+					out += mrks string(indent) + "\tv " + PickType(rng, declared) + " local" + mrks to_string(j) + '\n';
+
+				out += mrks string(indent) + "}\n";
+			}
+		}
+
+		const char* g_Names[] = { "a", "b", "c", "x", "y", "acc" };
+		const char* g_BinaryOperators[] = { "+", "-", "*", "/", "%", "<<", ">>", "&", "|", "^", "<", "<=", "==", "!=", "&&", "||" };
+
+		void AppendOperand(mrks string& out, Random& rng) {
+			const char* name = g_Names[rng.Next(6)];
+			switch (rng.Next(6)) {
+
+			case 0: out += mrks to_string(rng.Next(1000)); break;
+			case 1: out += mrks string("(") + name + " + " + mrks to_string(1 + rng.Next(9)) + ")"; break;
+			case 2: out += mrks string("Math.Min(") + name + ", " + g_Names[rng.Next(6)] + ")"; break;
+			case 3: out += mrks string("data[") + name + " % 16]"; break;
+			case 4: out += mrks string("-") + name; break;
+			default: out += name; break;
+
+			}
+		}
+	}
+
+	mrks string GenerateCorpus(mrku32 classCount, mrku32 seed) {
+		Random rng{ seed ? seed : 1 };
+		mrks string out = "i mrk;\ni mrk.generated;\n";
+		out.reserve(classCount * 640);
+
+		for (mrku32 i = 0; i < classCount; i++) {
+			out += "\nc " + ClassName(i) + " {\n";
+			AppendMembers(out, rng, i, "\t");
+
+			//constant chained to the previous class, folded by the semantic pass
+			out += "\tv int Limit {\n\t\tr " + (i ? ClassName(i - 1) + ".Limit % 1000 + " + mrks to_string(i) + " * 3" : mrks string("16 << 2")) + "\n\t}\n";
+
+			if (i % 5 == 4) {
+				out += "\n\tc Nested {\n";
+				AppendMembers(out, rng, i, "\t\t");
+				out += "\t}\n";
+			}
+
+			out += "}\n";
+		}
+
+		return out;
+	}
+
+	mrks string GenerateMixedScriptCorpus(mrku32 classCount, mrku32 seed) {
+		//every generated name is one of these prefixes and a number
+		const char* names[][2] = {
+			{ "Gen", "\xd9\x81\xd8\xa6\xd8\xa9" },
+			{ "Nested", "\xd9\x85\xd8\xb6\xd9\x85\xd9\x86" },
+			{ "Limit", "\xcf\x8c\xcf\x81\xce\xb9\xce\xbf" },
+			{ "field", "\xd0\xbf\xd0\xbe\xd0\xbb\xd0\xb5" },
+			{ "Method", "\xe3\x83\xa1\xe3\x82\xbd\xe3\x83\x83\xe3\x83\x89" },
+			{ "arg", "\xe5\xbc\x95\xe6\x95\xb0" },
+			{ "local", "\xec\xa7\x80\xec\x97\xad" }
+		};
+
+		mrks string ascii = GenerateCorpus(classCount, seed);
+		mrks string out;
+		out.reserve(ascii.size() * 5 / 4);
+
+		for (size_t i = 0; i < ascii.size();) {
+			bool replaced = false;
+			for (auto& name : names) {
+				size_t length = strlen(name[0]);
+				if (!ascii.compare(i, length, name[0]) && (i == 0 || !isalnum((unsigned char)ascii[i - 1]))) {
+					out += name[1];
+					i += length;
+					replaced = true;
+					break;
+				}
+			}
+
+			if (!replaced)
+				out += ascii[i++];
+		}
+
+		return out;
+	}
+
+	mrks string GenerateNestedCorpus(mrku32 classCount, mrku32 depth, mrku32 seed) {
+		Random rng{ seed ? seed : 1 };
+		mrks string out = "i mrk;\ni mrk.generated;\n";
+		out.reserve((size_t)classCount * depth * 700);
+
+		for (mrku32 i = 0; i < classCount; i++) {
+			out += "\nc " + ClassName(i) + " {\n";
+
+			mrks string indent = "\t";
+			for (mrku32 level = 0; level < depth; level++) {
+				out += indent + "// level " + mrks to_string(level) + " { of " + mrks to_string(depth) + " }\n";
+				AppendMembers(out, rng, i, indent.c_str());
+				out += indent + "v string Path {\n" + indent + "\tr \"{" + mrks to_string(level) + "}\\\"}\"\n" + indent + "}\n";
+				out += indent + "c Nested" + mrks to_string(level) + " {\n";
+				indent += '\t';
+			}
+
+			for (mrku32 level = depth; level > 0; level--) {
+				indent.pop_back();
+				out += indent + "}\n";
+			}
+
+			out += "}\n";
+		}
+
+		return out;
+	}
+
+	mrks string GenerateBrokenCorpus(mrku32 classCount, mrku32 brokenPerClass, mrku32 seed) {
+		Random rng{ seed ? seed : 1 };
+		mrks string out = "i mrk;\ni mrk.generated;\n";
+		out.reserve((size_t)classCount * (600 + brokenPerClass * 40));
+
+		for (mrku32 i = 0; i < classCount; i++) {
+			out += "\nc " + ClassName(i) + " {\n";
+			AppendMembers(out, rng, i, "\t");
+
+			for (mrku32 j = 0; j < brokenPerClass; j++)
+				out += "\tv int broken" + mrks to_string(j) + " {\n\t\tr " + g_BrokenDefaults[rng.Next(g_BrokenDefaultCount)] + "\n\t}\n";
+
+			out += "}\n";
+		}
+
+		return out;
+	}
+
+	mrks string GenerateExpressions(mrku32 statementCount, mrku32 termCount, mrku32 seed) {
+		Random rng{ seed ? seed : 1 };
+		mrks string out = "i mrk;\n\nc Expressions {\n\tv int a\n\tv int b\n\tv int c\n\n\tm int Evaluate {\n\t\tp {\n\t\t\tint x\n\t\t\tint y\n\t\t}\n\n\t\tv int acc\n";
+		out.reserve(out.size() + (size_t)statementCount * termCount * 12);
+
+		for (mrku32 i = 0; i < statementCount; i++) {
+			out += i % 4 == 3 ? "\t\tacc += " : "\t\tacc = ";
+			for (mrku32 j = 0; j < termCount; j++) {
+				if (j)
+					out += mrks string(" ") + g_BinaryOperators[rng.Next(16)] + ' ';
+				AppendOperand(out, rng);
+			}
+			out += '\n';
+		}
+
+		out += "\t\tr acc\n\t}\n}\n";
+		return out;
+	}
+}
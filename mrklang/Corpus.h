@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "Common.h"
+
+namespace MRK {
+	//deterministic synthetic mrklang source, used to benchmark on corpora far larger than corpus/
+	//every class gets fields, a ctor, methods with params and locals, every fifth one a nested class
+	mrks string GenerateCorpus(mrku32 classCount, mrku32 seed = 1);
+
+	//GenerateCorpus with its class, member and local names in Arabic, Greek, Cyrillic, Japanese and Korean,
+	//keywords and builtin types stay ASCII
+	mrks string GenerateMixedScriptCorpus(mrku32 classCount, mrku32 seed = 1);
+
+	//classCount classes, each the root of a chain of depth nested classes with the members of
+	//GenerateCorpus at every level, brace heavy with comments and strings holding braces
+	mrks string GenerateNestedCorpus(mrku32 classCount, mrku32 depth, mrku32 seed = 1);
+
+	//GenerateCorpus with brokenPerClass fields per class whose defaults do not parse,
+	//generated code caught in a broken state
+	mrks string GenerateBrokenCorpus(mrku32 classCount, mrku32 brokenPerClass, mrku32 seed = 1);
+
+	//one class whose method body holds statementCount assignments of termCount operands each,
+	//mixing every operator, groups, calls, member access and indexing
+	mrks string GenerateExpressions(mrku32 statementCount, mrku32 termCount, mrku32 seed = 1);
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CppEmitter.h"
+
+#include <climits>
+
+namespace MRK {
+	namespace {
+		const char* g_CppTypes[MRK_BUILTIN_TYPE_COUNT] = {
+			"", "void", "bool", "unsigned char", "char", "short", "unsigned short", "int", "unsigned int",
+			"long long", "unsigned long long", "float", "double", "std::string"
+		};
+	}
+
+	CppEmitter::CppEmitter(OutputWriter& writer, mrks string outputDir) : Emitter(writer, outputDir) {
+	}
+
+	const char* CppEmitter::GetTypename(const ModelType& type) {
+		return type.IsUser() ? type.Name.c_str() : g_CppTypes[(mrku32)type.Builtin];
+	}
+
+	void CppEmitter::EmitConstant(const ModelConstant& value) {
+		switch (value.Type) {
+
+		case BuiltinType::Bool:
+			m_Writer << (value.Bool ? "true" : "false");
+			break;
+
+		case BuiltinType::Float:
+		case BuiltinType::Double:
+			WriteFloat(value);
+			break;
+
+		case BuiltinType::String:
+			WriteString(value.String);
+			break;
+
+		case BuiltinType::Long:
+			//9223372036854775808 has no signed type, the minimum has to be spelled out
+			if (value.Int == LLONG_MIN)
+				m_Writer << "(-9223372036854775807LL - 1)";
+			else
+				WriteInteger(value);
+			break;
+
+		case BuiltinType::UInt:
+			WriteInteger(value);
+			m_Writer << 'u';
+			break;
+
+		case BuiltinType::ULong:
+			WriteInteger(value);
+			m_Writer << "ull";
+			break;
+
+		default:
+			WriteInteger(value);
+			break;
+
+		}
+	}
+
+	void CppEmitter::WriteLiteral(const ModelConstant& value) {
+		//"a" + "b" has to concatenate like it does in the other targets
+		if (value.Type == BuiltinType::String) {
+			m_Writer << "std::string(";
+			WriteString(value.String);
+			m_Writer << ')';
+		}
+		else
+			EmitConstant(value);
+	}
+
+	void CppEmitter::EmitSignature(const ModelClass& _class, const ModelMethod& method, const mrks string& qualifier) {
+		if (method.IsCtor)
+			m_Writer << qualifier << _class.Name << '(';
+		else
+			m_Writer << GetTypename(method.ReturnType) << ' ' << qualifier << method.Name << '(';
+
+		for (size_t i = 0; i < method.Params.size(); i++) {
+			if (i)
+				m_Writer << ", ";
+			m_Writer << GetTypename(method.Params[i].Type) << ' ' << method.Params[i].Name;
+		}
+
+		m_Writer << ')';
+	}
+
+	void CppEmitter::EmitClass(const ModelClass& _class, mrku32 depth) {
+		m_Writer.WriteIndent(depth);
+		m_Writer << "class " << _class.Name << " {\n";
+		m_Writer.WriteIndent(depth);
+		m_Writer << "public:\n";
+
+		//nested types first, members may use them
+		for (int nested : _class.Nested) {
+			EmitClass(GetClass(nested), depth + 1);
+			m_Writer << '\n';
+		}
+
+		for (const ModelVar& field : _class.Fields) {
+			m_Writer.WriteIndent(depth + 1);
+
+			//std::string is not a literal type, it still gets one shared instance
+			if (field.IsConstant()) {
+				m_Writer << (field.Type.Builtin == BuiltinType::String ? "static inline const " : "static constexpr ")
+					<< GetTypename(field.Type) << ' ' << field.Name << " = ";
+				EmitConstant(field.Constant);
+				m_Writer << ";\n";
+			}
+			else if (field.Constant.State == ConstantState::Runtime) {
+				m_Writer << GetTypename(field.Type) << ' ' << field.Name << " = ";
+				WriteExpression(_class, 0, field.Default);
+				m_Writer << ";\n";
+			}
+			else
+				m_Writer << GetTypename(field.Type) << ' ' << field.Name << ";\n";
+		}
+
+		if (!_class.Fields.empty() && !_class.Methods.empty())
+			m_Writer << '\n';
+
+		//a ctor with params hides the implicit default one, fields and locals still need it
+		bool hasCtor = false;
+		bool hasDefaultCtor = false;
+		for (const ModelMethod& method : _class.Methods) {
+			if (method.IsCtor) {
+				hasCtor = true;
+				hasDefaultCtor |= method.Params.empty();
+			}
+		}
+
+		if (hasCtor && !hasDefaultCtor) {
+			m_Writer.WriteIndent(depth + 1);
+			m_Writer << _class.Name << "() = default;\n";
+		}
+
+		for (const ModelMethod& method : _class.Methods) {
+			m_Writer.WriteIndent(depth + 1);
+			EmitSignature(_class, method, "");
+			m_Writer << ";\n";
+		}
+
+		WriteForeign(_class.ForeignBlocks);
+
+		m_Writer.WriteIndent(depth);
+		m_Writer << "};\n";
+	}
+
+	void CppEmitter::EmitDefinitions(const ModelClass& _class, const mrks string& qualifier) {
+		mrks string scope = qualifier + _class.Name + "::";
+
+		for (const ModelMethod& method : _class.Methods) {
+			m_Writer << '\n';
+			EmitSignature(_class, method, scope);
+			m_Writer << " {\n";
+
+			for (const ModelVar& local : method.Locals) {
+				if (local.IsConstant()) {
+					m_Writer << (local.Type.Builtin == BuiltinType::String ? "\tconst " : "\tconstexpr ") << GetTypename(local.Type) << ' ' << local.Name << " = ";
+					EmitConstant(local.Constant);
+					m_Writer << ";\n";
+				}
+				else if (local.Constant.State == ConstantState::Runtime) {
+					m_Writer << '\t' << GetTypename(local.Type) << ' ' << local.Name << " = ";
+					WriteExpression(_class, &method, local.Default);
+					m_Writer << ";\n";
+				}
+				else
+					m_Writer << '\t' << GetTypename(local.Type) << ' ' << local.Name << "{};\n";
+			}
+
+			WriteForeign(method.ForeignBlocks);
+
+			if (!WriteBody(_class, method, 1) && !method.IsCtor && method.ReturnType.Builtin != BuiltinType::Void)
+				m_Writer << "\treturn {};\n";
+
+			m_Writer << "}\n";
+		}
+
+		for (int nested : _class.Nested)
+			EmitDefinitions(GetClass(nested), scope);
+	}
+
+	void CppEmitter::EmitHeader(const ModelClass& root) {
+		WriteBanner("//");
+		m_Writer << "#pragma once\n\n";
+
+		bool usesString = root.BuiltinMask & (1u << (mrku32)BuiltinType::String);
+		if (usesString)
+			m_Writer << "#include <string>\n";
+
+		for (const mrks string& type : root.Dependencies)
+			m_Writer << "#include \"" << type << ".h\"\n";
+
+		if (usesString || !root.Dependencies.empty())
+			m_Writer << '\n';
+
+		EmitClass(root, 0);
+	}
+
+	void CppEmitter::EmitSource(const ModelClass& root) {
+		WriteBanner("//");
+		m_Writer << "#include \"" << root.Name << ".h\"\n";
+
+		//types only the method bodies name stay out of the header
+		for (const mrks string& type : root.BodyDependencies)
+			m_Writer << "#include \"" << type << ".h\"\n";
+
+		EmitDefinitions(root, "");
+	}
+
+	void CppEmitter::EmitRoot(const ModelClass& root) {
+		BeginFile(root.Name + ".h");
+		EmitHeader(root);
+		EndFile();
+
+		BeginFile(root.Name + ".cpp");
+		EmitSource(root);
+		EndFile();
+	}
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CsEmitter.h"
+
+namespace MRK {
+	namespace {
+		const char* g_CsTypes[MRK_BUILTIN_TYPE_COUNT] = {
+			"", "void", "bool", "byte", "char", "short", "ushort", "int", "uint", "long", "ulong", "float", "double", "string"
+		};
+	}
+
+	CsEmitter::CsEmitter(OutputWriter& writer, mrks string outputDir) : Emitter(writer, outputDir) {
+	}
+
+	const char* CsEmitter::GetTypename(const ModelType& type) {
+		return type.IsUser() ? type.Name.c_str() : g_CsTypes[(mrku32)type.Builtin];
+	}
+
+	void CsEmitter::EmitConstant(const ModelConstant& value) {
+		switch (value.Type) {
+
+		case BuiltinType::Bool:
+			m_Writer << (value.Bool ? "true" : "false");
+			break;
+
+		case BuiltinType::Float:
+		case BuiltinType::Double:
+			WriteFloat(value);
+			break;
+
+		case BuiltinType::String:
+			WriteString(value.String);
+			break;
+
+		//no implicit conversion from an integer constant to char
+		case BuiltinType::Char:
+			m_Writer << "(char)";
+			WriteInteger(value);
+			break;
+
+		case BuiltinType::UInt:
+			WriteInteger(value);
+			m_Writer << 'U';
+			break;
+
+		case BuiltinType::ULong:
+			WriteInteger(value);
+			m_Writer << "UL";
+			break;
+
+		default:
+			WriteInteger(value);
+			break;
+
+		}
+	}
+
+	void CsEmitter::WriteDiscarded(const ModelClass& _class, const ModelMethod& method, mrku32 node) {
+		m_Writer << "_ = ";
+		WriteExpression(_class, &method, node);
+	}
+
+	void CsEmitter::EmitFieldDefaults(const ModelClass& _class, mrku32 depth) {
+		//field initializers cannot read this, so defaults that run are assigned by every ctor
+		for (const ModelVar& field : _class.Fields) {
+			if (field.Constant.State != ConstantState::Runtime)
+				continue;
+
+			m_Writer.WriteIndent(depth);
+			m_Writer << field.Name << " = ";
+			WriteExpression(_class, 0, field.Default);
+			m_Writer << ";\n";
+		}
+	}
+
+	void CsEmitter::EmitMethod(const ModelClass& _class, const ModelMethod& method, mrku32 depth) {
+		m_Writer.WriteIndent(depth);
+		if (method.IsCtor)
+			m_Writer << "public " << _class.Name << '(';
+		else
+			m_Writer << "public " << GetTypename(method.ReturnType) << ' ' << method.Name << '(';
+
+		for (size_t i = 0; i < method.Params.size(); i++) {
+			if (i)
+				m_Writer << ", ";
+			m_Writer << GetTypename(method.Params[i].Type) << ' ' << method.Params[i].Name;
+		}
+
+		m_Writer << ") {\n";
+
+		if (method.IsCtor)
+			EmitFieldDefaults(_class, depth + 1);
+
+		for (const ModelVar& local : method.Locals) {
+			m_Writer.WriteIndent(depth + 1);
+			if (local.IsConstant()) {
+				m_Writer << "const " << GetTypename(local.Type) << ' ' << local.Name << " = ";
+				EmitConstant(local.Constant);
+				m_Writer << ";\n";
+			}
+			else if (local.Constant.State == ConstantState::Runtime) {
+				m_Writer << GetTypename(local.Type) << ' ' << local.Name << " = ";
+				WriteExpression(_class, &method, local.Default);
+				m_Writer << ";\n";
+			}
+			else
+				m_Writer << GetTypename(local.Type) << ' ' << local.Name << " = default;\n";
+		}
+
+		WriteForeign(method.ForeignBlocks);
+
+		if (!WriteBody(_class, method, depth + 1) && !method.IsCtor && method.ReturnType.Builtin != BuiltinType::Void) {
+			m_Writer.WriteIndent(depth + 1);
+			m_Writer << "return default;\n";
+		}
+
+		m_Writer.WriteIndent(depth);
+		m_Writer << "}\n";
+	}
+
+	void CsEmitter::EmitClass(const ModelClass& _class, mrku32 depth) {
+		m_Writer.WriteIndent(depth);
+		m_Writer << "public class " << _class.Name << " {\n";
+
+		for (int nested : _class.Nested) {
+			EmitClass(GetClass(nested), depth + 1);
+			m_Writer << '\n';
+		}
+
+		for (const ModelVar& field : _class.Fields) {
+			m_Writer.WriteIndent(depth + 1);
+			if (field.IsConstant()) {
+				m_Writer << "public const " << GetTypename(field.Type) << ' ' << field.Name << " = ";
+				EmitConstant(field.Constant);
+				m_Writer << ";\n";
+			}
+			else
+				m_Writer << "public " << GetTypename(field.Type) << ' ' << field.Name << ";\n";
+		}
+
+		for (size_t i = 0; i < _class.Methods.size(); i++) {
+			if (i || !_class.Fields.empty())
+				m_Writer << '\n';
+			EmitMethod(_class, _class.Methods[i], depth + 1);
+		}
+
+		//without a ctor of its own the class still needs one to run its defaults
+		bool runtime = false, ctor = false;
+		for (const ModelVar& field : _class.Fields)
+			runtime |= field.Constant.State == ConstantState::Runtime;
+		for (const ModelMethod& method : _class.Methods)
+			ctor |= method.IsCtor;
+
+		if (runtime && !ctor) {
+			m_Writer << '\n';
+			m_Writer.WriteIndent(depth + 1);
+			m_Writer << "public " << _class.Name << "() {\n";
+			EmitFieldDefaults(_class, depth + 2);
+			m_Writer.WriteIndent(depth + 1);
+			m_Writer << "}\n";
+		}
+
+		WriteForeign(_class.ForeignBlocks);
+
+		m_Writer.WriteIndent(depth);
+		m_Writer << "}\n";
+	}
+
+	void CsEmitter::EmitRoot(const ModelClass& root) {
+		BeginFile(root.Name + ".cs");
+		WriteBanner("//");
+		EmitClass(root, 0);
+		EndFile();
+	}
+}
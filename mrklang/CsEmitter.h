@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "Common.h"
+#include "Emitter.h"
+
+namespace MRK {
+	//C# backend, one .cs file per top-level class
+	class CsEmitter : public Emitter {
+	private:
+		void EmitFieldDefaults(const ModelClass& _class, mrku32 depth);
+		void EmitClass(const ModelClass& _class, mrku32 depth);
+		void EmitMethod(const ModelClass& _class, const ModelMethod& method, mrku32 depth);
+
+	protected:
+		void EmitConstant(const ModelConstant& value) override;
+		void WriteDiscarded(const ModelClass& _class, const ModelMethod& method, mrku32 node) override;
+		void EmitRoot(const ModelClass& root) override;
+
+	public:
+		CsEmitter(OutputWriter& writer, mrks string outputDir);
+
+		EmitTarget GetTarget() const override { return EmitTarget::Cs; }
+
+		static const char* GetTypename(const ModelType& type);
+	};
+}
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Diagnostics.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#define MRK_SARIF_SCHEMA "https://json.schemastore.org/sarif-2.1.0.json"
+
+namespace MRK {
+	bool ParseDiagnosticFormat(const mrks string& name, DiagnosticFormat& format) {
+		if (name == "text")
+			format = DiagnosticFormat::Text;
+		else if (name == "jsonl")
+			format = DiagnosticFormat::JsonLines;
+		else if (name == "sarif")
+			format = DiagnosticFormat::Sarif;
+		else
+			return false;
+
+		return true;
+	}
+
+	bool DiagnosticLimiter::Key::operator==(const Key& other) const {
+		return Source == other.Source && Offset == other.Offset && Code == other.Code && Names == other.Names && Args[0] == other.Args[0] && Args[1] == other.Args[1];
+	}
+
+	size_t DiagnosticLimiter::KeyHash::operator()(const Key& key) const {
+		size_t hash = mrks hash<const void*>()(key.Source);
+		for (size_t part : { (size_t)key.Offset, (size_t)key.Code, mrks hash<const void*>()(key.Names), (size_t)key.Args[0], (size_t)key.Args[1] })
+			hash = (hash ^ part) * 0x100000001B3ull;
+		return hash;
+	}
+
+	DiagnosticLimiter::DiagnosticLimiter(size_t limit) : m_Limit(limit), m_Suppressed(0) {
+	}
+
+	bool DiagnosticLimiter::Accept(const Error& err) {
+		//a located error is keyed by its location alone, follow-ups at the same token are noise
+		bool located = err.Offset != MRK_NO_OFFSET;
+		Key key{ err.Source, err.Offset, located ? 0 : (mrku32)err.Code, located ? 0 : err.Names,
+			{ located ? MRK_ERROR_ARG_NONE : err.Args[0], located ? MRK_ERROR_ARG_NONE : err.Args[1] } };
+
+		if (!m_Seen.insert(key).second)
+			return false;
+
+		size_t& count = m_Counts[err.Source];
+		if (m_Limit && count >= m_Limit) {
+			m_Suppressed++;
+			return false;
+		}
+
+		count++;
+		return true;
+	}
+
+	void DiagnosticLimiter::Reset() {
+		m_Suppressed = 0;
+		m_Seen.clear();
+		m_Counts.clear();
+	}
+
+	DiagnosticWriter::DiagnosticWriter(DiagnosticFormat format, size_t limit, const DiagnosticSink& sink)
+		: m_Format(format), m_Sink(sink), m_Limiter(limit), m_Reported(0), m_Results(JsonValue::MakeArray()) {
+	}
+
+	bool DiagnosticWriter::Locate(const Error& err, size_t& line, size_t& column) {
+		if (!err.Source || err.Offset == MRK_NO_OFFSET || err.Offset > err.Source->Code.size())
+			return false;
+
+		const mrks string& code = err.Source->Code;
+		auto it = m_Lines.find(err.Source);
+		if (it == m_Lines.end()) {
+			mrks vector<mrkpos> starts{ 0 };
+			for (size_t i = 0; i < code.size(); i++)
+				if (code[i] == '\n')
+					starts.push_back(i + 1);
+
+			it = m_Lines.emplace(err.Source, mrks move(starts)).first;
+		}
+
+		const mrks vector<mrkpos>& starts = it->second;
+		size_t index = mrks upper_bound(starts.begin(), starts.end(), err.Offset) - starts.begin() - 1;
+		line = index + 1;
+
+		//continuation bytes do not start a code point
+		column = 1;
+		for (size_t i = starts[index]; i < err.Offset; i++)
+			column += ((unsigned char)code[i] & 0xC0) != 0x80;
+
+		return true;
+	}
+
+	void DiagnosticWriter::Report(const Error& err, const mrks string& path) {
+		if (!m_Limiter.Accept(err))
+			return;
+
+		m_Reported++;
+		size_t line, column;
+		bool located = Locate(err, line, column);
+
+		if (m_Format == DiagnosticFormat::Text) {
+			if (located)
+				m_Sink(path + ':' + mrks to_string(line) + ':' + mrks to_string(column) + ": error: " + FormatError(err));
+			else
+				m_Sink(path + ": error: " + FormatError(err));
+			return;
+		}
+
+		//written straight to one reused stream, a DOM per line costs more than the formatting
+		if (m_Format == DiagnosticFormat::JsonLines) {
+			m_Line.str("");
+			m_Line << "{\"file\":";
+			WriteJsonString(m_Line, path);
+			if (located)
+				m_Line << ",\"line\":" << line << ",\"column\":" << column << ",\"offset\":" << err.Offset;
+			m_Line << ",\"severity\":\"error\",\"code\":\"" << GetErrorRuleId(err.Code) << "\",\"message\":";
+			WriteJsonString(m_Line, FormatError(err));
+			m_Line << '}';
+			m_Sink(m_Line.str());
+			return;
+		}
+
+		JsonValue physical = JsonValue::MakeObject();
+		JsonValue artifact = JsonValue::MakeObject();
+		artifact.Set("uri", ToFileUri(path));
+		physical.Set("artifactLocation", mrks move(artifact));
+		if (located) {
+			JsonValue region = JsonValue::MakeObject();
+			region.Set("startLine", (double)line);
+			region.Set("startColumn", (double)column);
+			region.Set("charOffset", (double)err.Offset);
+			physical.Set("region", mrks move(region));
+		}
+
+		JsonValue location = JsonValue::MakeObject();
+		location.Set("physicalLocation", mrks move(physical));
+		JsonValue locations = JsonValue::MakeArray();
+		locations.Push(mrks move(location));
+
+		JsonValue message = JsonValue::MakeObject();
+		message.Set("text", FormatError(err));
+
+		JsonValue result = JsonValue::MakeObject();
+		result.Set("ruleId", GetErrorRuleId(err.Code));
+		result.Set("ruleIndex", (int)err.Code - 1);
+		result.Set("level", "error");
+		result.Set("message", mrks move(message));
+		result.Set("locations", mrks move(locations));
+		m_Results.Push(mrks move(result));
+	}
+
+	void DiagnosticWriter::Note(const mrks string& line) {
+		if (m_Format == DiagnosticFormat::Text)
+			m_Sink(line);
+	}
+
+	void DiagnosticWriter::Finish() {
+		if (m_Format != DiagnosticFormat::Sarif)
+			return;
+
+		//every code is a rule, ruleIndex is the code - 1
+		JsonValue rules = JsonValue::MakeArray();
+		for (mrku32 i = 1; i < (mrku32)ErrorCode::Count; i++) {
+			JsonValue text = JsonValue::MakeObject();
+			text.Set("text", GetErrorText((ErrorCode)i));
+
+			JsonValue rule = JsonValue::MakeObject();
+			rule.Set("id", GetErrorRuleId((ErrorCode)i));
+			rule.Set("shortDescription", mrks move(text));
+			rules.Push(mrks move(rule));
+		}
+
+		JsonValue driver = JsonValue::MakeObject();
+		driver.Set("name", "mrkc");
+		driver.Set("rules", mrks move(rules));
+
+		JsonValue tool = JsonValue::MakeObject();
+		tool.Set("driver", mrks move(driver));
+
+		JsonValue run = JsonValue::MakeObject();
+		run.Set("tool", mrks move(tool));
+		run.Set("columnKind", "unicodeCodePoints");
+		run.Set("results", mrks move(m_Results));
+		m_Results = JsonValue::MakeArray();
+
+		JsonValue runs = JsonValue::MakeArray();
+		runs.Push(mrks move(run));
+
+		JsonValue log = JsonValue::MakeObject();
+		log.Set("$schema", MRK_SARIF_SCHEMA);
+		log.Set("version", "2.1.0");
+		log.Set("runs", mrks move(runs));
+		m_Sink(log.ToString());
+	}
+
+	mrks string ToFileUri(const mrks string& path) {
+		static const char* hex = "0123456789ABCDEF";
+
+		//C:\dir becomes file:///C:/dir, reserved and non ASCII bytes are escaped
+		mrks string uri = "file://";
+		if (path.empty() || (path[0] != '/' && path[0] != '\\'))
+			uri += '/';
+
+		for (unsigned char c : path) {
+			if (c == '\\')
+				uri += '/';
+			else if (isalnum(c) || (c && strchr("/-._~:", c)))
+				uri += (char)c;
+			else {
+				uri += '%';
+				uri += hex[c >> 4];
+				uri += hex[c & 15];
+			}
+		}
+
+		return uri;
+	}
+}
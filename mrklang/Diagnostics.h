@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Common.h"
+#include "Error.h"
+#include "Json.h"
+
+#define MRK_ERROR_LIMIT 100 //per source, 0 = unlimited
+
+namespace MRK {
+	//one line per diagnostic or summary, calls never overlap but the diagnostics of a source
+	//come from the worker that loaded it
+	typedef mrks function<void(const mrks string& line)> DiagnosticSink;
+
+	enum class DiagnosticFormat {
+		Text, //path: error: message
+		JsonLines, //one object per diagnostic
+		Sarif //one SARIF 2.1.0 log once everything is reported
+	};
+
+	bool ParseDiagnosticFormat(const mrks string& name, DiagnosticFormat& format);
+
+	//lets the first error at a location through (errors without one by code and arguments)
+	//and at most limit errors per source, the rest are only counted
+	class DiagnosticLimiter {
+	private:
+		struct Key {
+			const mrk Source* Source;
+			mrkpos Offset;
+			mrku32 Code;
+			const ErrorArgs* Names;
+			mrku32 Args[2];
+
+			bool operator==(const Key& other) const;
+		};
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const;
+		};
+
+		size_t m_Limit;
+		size_t m_Suppressed;
+		mrks unordered_set<Key, KeyHash> m_Seen;
+		mrks unordered_map<const Source*, size_t> m_Counts;
+
+	public:
+		DiagnosticLimiter(size_t limit = MRK_ERROR_LIMIT);
+
+		bool Accept(const Error& err);
+		size_t GetSuppressed() const { return m_Suppressed; } //over the limit, repeats are not counted
+		void Reset();
+	};
+
+	//formats the errors that pass the limiter, not thread safe
+	//nothing but diagnostics goes to the sink in the machine readable formats, notes are dropped
+	class DiagnosticWriter {
+	private:
+		DiagnosticFormat m_Format;
+		DiagnosticSink m_Sink;
+		DiagnosticLimiter m_Limiter;
+		size_t m_Reported;
+		mrks ostringstream m_Line; //json lines
+		JsonValue m_Results; //sarif
+		mrks unordered_map<const Source*, mrks vector<mrkpos>> m_Lines; //line starts, built on first use
+
+		//1 based, columns in code points
+		bool Locate(const Error& err, size_t& line, size_t& column);
+
+	public:
+		DiagnosticWriter(DiagnosticFormat format, size_t limit, const DiagnosticSink& sink);
+
+		//path as given by the user, err.Source may be null
+		void Report(const Error& err, const mrks string& path);
+		void Note(const mrks string& line);
+		void Finish();
+
+		size_t GetReported() const { return m_Reported; }
+		size_t GetSuppressed() const { return m_Limiter.GetSuppressed(); }
+	};
+
+	mrks string ToFileUri(const mrks string& path);
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "EmitPipeline.h"
+#include "CppEmitter.h"
+#include "CsEmitter.h"
+#include "JavaEmitter.h"
+#include "Trace.h"
+
+#include <chrono>
+#include <filesystem>
+
+namespace MRK {
+	namespace {
+		struct EmitJob {
+			mrku32 Request;
+			int Module;
+			int Root;
+		};
+
+		struct EmitJobResult {
+			mrks vector<mrks string> Files;
+			unsigned long long Bytes;
+			double Ms;
+			bool Success;
+			unsigned long long Hash;
+			bool Skipped;
+			size_t Written;
+			size_t Unchanged;
+		};
+
+		//reused by every job of one worker, the writer keeps its buffer between files
+		struct EmitWorker {
+			OutputWriter Writer;
+			mrks vector<mrks unique_ptr<Emitter>> Emitters; //by request
+		};
+	}
+
+	mrks unique_ptr<Emitter> CreateEmitter(EmitTarget target, OutputWriter& writer, mrks string outputDir) {
+		switch (target) {
+
+		case EmitTarget::Cs:
+			return mrks make_unique<CsEmitter>(writer, outputDir);
+
+		case EmitTarget::Java:
+			return mrks make_unique<JavaEmitter>(writer, outputDir);
+
+		default:
+			return mrks make_unique<CppEmitter>(writer, outputDir);
+
+		}
+	}
+
+	mrks vector<EmitResult> EmitTargets(const Model& model, const mrks vector<EmitRequest>& requests, WorkPool& pool) {
+		TraceSpan span("EmitTargets", "");
+
+		mrks vector<EmitResult> results(requests.size());
+		mrks vector<EmitManifest> manifests(requests.size());
+		mrks vector<size_t> loaded(requests.size(), 0);
+		mrks vector<EmitJob> jobs;
+		bool incremental = false;
+
+		for (mrku32 r = 0; r < requests.size(); r++) {
+			results[r] = EmitResult{ requests[r].Target, true, {}, 0, 0, 0, 0, 0 };
+
+			mrks error_code ec;
+			mrks filesystem::create_directories(requests[r].OutputDir, ec);
+
+			if (requests[r].Incremental) {
+				manifests[r].Load(requests[r].OutputDir, requests[r].Target);
+				loaded[r] = manifests[r].GetCount();
+				incremental = true;
+			}
+
+			for (size_t m = 0; m < model.Modules.size(); m++)
+				for (int root : model.Modules[m].Roots)
+					jobs.push_back(EmitJob{ r, (int)m, root });
+		}
+
+		//a root hashes the same for every target, once per root
+		mrks vector<EmitJob> roots;
+		mrks vector<unsigned long long> hashes;
+		if (incremental) {
+			for (size_t m = 0; m < model.Modules.size(); m++)
+				for (int root : model.Modules[m].Roots)
+					roots.push_back(EmitJob{ 0, (int)m, root });
+
+			hashes.resize(roots.size());
+			pool.Run(roots.size(), [&](size_t index, unsigned) {
+				const ModelModule& module = model.Modules[roots[index].Module];
+				hashes[index] = HashRoot(module, module.Classes[roots[index].Root]);
+			});
+		}
+
+		mrks vector<EmitJobResult> done(jobs.size());
+		mrks vector<mrks unique_ptr<EmitWorker>> workers(pool.GetWorkerCount());
+
+		pool.Run(jobs.size(), [&](size_t index, unsigned worker) {
+			mrks unique_ptr<EmitWorker>& state = workers[worker];
+			if (!state) {
+				state = mrks make_unique<EmitWorker>();
+				for (const EmitRequest& request : requests)
+					state->Emitters.push_back(CreateEmitter(request.Target, state->Writer, request.OutputDir));
+			}
+
+			auto start = mrks chrono::steady_clock::now();
+			const EmitJob& job = jobs[index];
+			const EmitRequest& request = requests[job.Request];
+			const ModelModule& module = model.Modules[job.Module];
+			EmitJobResult& result = done[index];
+			result = EmitJobResult{ {}, 0, 0, true, 0, false, 0, 0 };
+
+			//same hash and files still there, the root is not regenerated at all
+			if (request.Incremental) {
+				const ModelClass& root = module.Classes[job.Root];
+				result.Hash = hashes[index % roots.size()]; //jobs repeat the roots once per request
+
+				const ManifestEntry* entry = manifests[job.Request].FindCurrent(EmitManifest::GetKey(module, root), result.Hash);
+				if (entry) {
+					result.Skipped = true;
+					for (const mrks string& file : entry->Files)
+						result.Files.push_back((mrks filesystem::path(request.OutputDir) / file).string());
+					return;
+				}
+			}
+
+			OutputWriter& writer = state->Writer;
+			unsigned long long before = writer.GetBytesWritten();
+			size_t changed = writer.GetFilesChanged();
+			size_t unchanged = writer.GetFilesUnchanged();
+
+			writer.SetSkipUnchanged(request.Incremental);
+			result.Success = state->Emitters[job.Request]->Emit(module, job.Root, &result.Files);
+			result.Bytes = writer.GetBytesWritten() - before;
+			result.Written = writer.GetFilesChanged() - changed;
+			result.Unchanged = writer.GetFilesUnchanged() - unchanged;
+			result.Ms = mrks chrono::duration<double, mrks milli>(mrks chrono::steady_clock::now() - start).count();
+		});
+
+		//jobs are numbered in request then declaration order
+		for (EmitManifest& manifest : manifests)
+			manifest.Clear();
+
+		for (size_t i = 0; i < jobs.size(); i++) {
+			const EmitRequest& request = requests[jobs[i].Request];
+			EmitResult& result = results[jobs[i].Request];
+			EmitJobResult& job = done[i];
+
+			result.Success &= job.Success;
+			result.Bytes += job.Bytes;
+			result.Ms += job.Ms;
+			result.Written += job.Written;
+			result.Unchanged += job.Unchanged;
+			result.Skipped += job.Skipped;
+
+			//a failed root is left out of the manifest, the next run retries it
+			if (request.Incremental && job.Success) {
+				const ModelModule& module = model.Modules[jobs[i].Module];
+				ManifestEntry entry{ job.Hash, {} };
+				for (const mrks string& file : job.Files)
+					entry.Files.push_back(mrks filesystem::path(file).filename().string());
+				manifests[jobs[i].Request].Set(EmitManifest::GetKey(module, module.Classes[jobs[i].Root]), mrks move(entry));
+			}
+
+			for (mrks string& file : job.Files)
+				result.Files.push_back(mrks move(file));
+		}
+
+		//every root skipped and none gone, the manifest on disk is still exact
+		for (size_t r = 0; r < requests.size(); r++) {
+			bool current = results[r].Success && results[r].Skipped == manifests[r].GetCount() && loaded[r] == manifests[r].GetCount();
+			if (requests[r].Incremental && !current && !manifests[r].Save(requests[r].OutputDir, requests[r].Target))
+				results[r].Success = false;
+		}
+
+		span.Arg("jobs", jobs.size());
+		span.Arg("workers", pool.GetWorkerCount());
+		return results;
+	}
+
+	mrks vector<EmitResult> EmitTargets(const Model& model, const mrks vector<EmitRequest>& requests, unsigned threads) {
+		WorkPool pool(threads);
+		return EmitTargets(model, requests, pool);
+	}
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "Common.h"
+#include "Model.h"
+#include "Emitter.h"
+#include "WorkPool.h"
+#include "Manifest.h"
+
+namespace MRK {
+	struct EmitRequest {
+		EmitTarget Target;
+		mrks string OutputDir;
+		bool Incremental = false; //skip roots whose hash is in the manifest, write only files whose bytes changed
+	};
+
+	struct EmitResult {
+		EmitTarget Target;
+		bool Success;
+		mrks vector<mrks string> Files; //the whole tree, skipped roots included
+		unsigned long long Bytes; //generated, skipped roots excluded
+		double Ms; //summed over the target's jobs, whatever thread ran them
+		size_t Written; //files whose bytes were written
+		size_t Unchanged; //files regenerated with the same bytes, left untouched
+		size_t Skipped; //roots not regenerated, their hash matched the manifest
+	};
+
+	mrks unique_ptr<Emitter> CreateEmitter(EmitTarget target, OutputWriter& writer, mrks string outputDir);
+
+	//every top-level class of every target is one job on the pool, each worker has its own writer
+	//and emitters and the model is only read. A root owns its files, so the output does not depend on
+	//the thread count; results come back in request order with files in declaration order
+	//Incremental requests keep a manifest of root hashes (see Manifest.h) in their output directory
+	mrks vector<EmitResult> EmitTargets(const Model& model, const mrks vector<EmitRequest>& requests, WorkPool& pool);
+
+	//0 threads = one per hardware thread
+	mrks vector<EmitResult> EmitTargets(const Model& model, const mrks vector<EmitRequest>& requests, unsigned threads = 0);
+}
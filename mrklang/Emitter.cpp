@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Emitter.h"
+#include "Expression.h"
+#include "Trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+
+namespace MRK {
+	namespace {
+		const char* g_TargetNames[MRK_EMIT_TARGET_COUNT] = { "cpp", "cs", "java" };
+	}
+
+	const char* GetTargetName(EmitTarget target) {
+		return g_TargetNames[(mrku32)target];
+	}
+
+	bool ParseTargetName(const mrks string& name, EmitTarget& target) {
+		for (mrku32 i = 0; i < MRK_EMIT_TARGET_COUNT; i++) {
+			if (name == g_TargetNames[i]) {
+				target = (EmitTarget)i;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	Emitter::Emitter(OutputWriter& writer, mrks string outputDir) : m_Writer(writer), m_OutputDir(outputDir), m_Module(0), m_Files(0), m_Success(true) {
+		if (!m_OutputDir.empty() && m_OutputDir.back() != '/' && m_OutputDir.back() != '\\')
+			m_OutputDir += '/';
+	}
+
+	void Emitter::BeginFile(const mrks string& filename) {
+		mrks string path = m_OutputDir + filename;
+		m_Writer.Open(path);
+
+		if (m_Files)
+			m_Files->push_back(path);
+	}
+
+	void Emitter::EndFile() {
+		m_Success &= m_Writer.Close();
+	}
+
+	void Emitter::WriteBanner(const char* comment) {
+		m_Writer << comment << " Generated by mrklang from " << m_Module->Filename << ", do not edit\n\n";
+	}
+
+	//blocks of this target only, written as they are minus surrounding blank space
+	void Emitter::WriteForeign(const mrks vector<ModelForeignBlock>& blocks) {
+		for (const ModelForeignBlock& block : blocks) {
+			if (block.Target != GetTarget())
+				continue;
+
+			const char* begin = block.Data;
+			const char* end = block.Data + block.Length;
+
+			//keep the indentation of the first line, unless it shares the line of the brace
+			const char* p = begin;
+			const char* line = 0;
+			for (; p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'); p++)
+				if (*p == '\n')
+					line = p + 1;
+
+			if (!line)
+				line = p;
+
+			while (end > line && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+				end--;
+
+			if (end > line) {
+				m_Writer.Write(line, end - line);
+				m_Writer << '\n';
+			}
+		}
+	}
+
+	void Emitter::WriteInteger(const ModelConstant& value) {
+		char buf[32];
+		int len = value.Type == BuiltinType::ULong ? snprintf(buf, sizeof(buf), "%llu", value.UInt) : snprintf(buf, sizeof(buf), "%lld", value.Int);
+		m_Writer.Write(buf, len);
+	}
+
+	void Emitter::WriteFloat(const ModelConstant& value) {
+		//shortest digits that read back to the same value, always with a fraction or exponent
+		bool single = value.Type == BuiltinType::Float;
+		char buf[40];
+		int len = 0;
+		for (int precision = 1; precision <= (single ? 9 : 17); precision++) {
+			len = snprintf(buf, sizeof(buf), "%.*g", precision, value.Float);
+			double back = strtod(buf, 0);
+			if (single ? (float)back == (float)value.Float : back == value.Float)
+				break;
+		}
+		m_Writer.Write(buf, len);
+
+		if (!strpbrk(buf, ".e"))
+			m_Writer << ".0";
+
+		if (single)
+			m_Writer << 'f';
+	}
+
+	void Emitter::WriteString(const mrks string& value) {
+		//escapes every target reads the same way
+		m_Writer << '"';
+		for (char c : value) {
+			switch (c) {
+
+			case '"': m_Writer << "\\\""; break;
+			case '\\': m_Writer << "\\\\"; break;
+			case '\n': m_Writer << "\\n"; break;
+			case '\r': m_Writer << "\\r"; break;
+			case '\t': m_Writer << "\\t"; break;
+			case '\b': m_Writer << "\\b"; break;
+			case '\f': m_Writer << "\\f"; break;
+
+			default:
+				if ((unsigned char)c < 0x20) {
+					char buf[8];
+					m_Writer.Write(buf, snprintf(buf, sizeof(buf), "\\u%04x", c));
+				}
+				else
+					m_Writer << c;
+				break;
+
+			}
+		}
+		m_Writer << '"';
+	}
+
+	bool Emitter::IsTypePath(const ModelClass& _class, const ModelMethod* method, mrku32 node) const {
+		const ExprArena& arena = *m_Module->Expressions;
+		for (; arena.Get(node).Kind == ExprKind::Member; node = arena.Get(node).Left);
+
+		const ExprNode& base = arena.Get(node);
+		return base.Kind == ExprKind::Name && !IsValueName(*m_Module, _class, method, base.Text);
+	}
+
+	void Emitter::PushOperand(mrku32 node) {
+		ExprKind kind = m_Module->Expressions->Get(node).Kind;
+		bool parens = kind == ExprKind::Unary || kind == ExprKind::Binary || kind == ExprKind::Assign;
+
+		//pushed backwards, written forwards
+		if (parens)
+			m_Parts.push_back(Part{ MRK_EXPR_NONE, ")" });
+		m_Parts.push_back(Part{ node, 0 });
+		if (parens)
+			m_Parts.push_back(Part{ MRK_EXPR_NONE, "(" });
+	}
+
+	void Emitter::WriteExpression(const ModelClass& _class, const ModelMethod* method, mrku32 root) {
+		//an explicit stack, bodies can nest deeper than the C stack allows
+		const ExprArena& arena = *m_Module->Expressions;
+		size_t base = m_Parts.size();
+		m_Parts.push_back(Part{ root, 0 });
+
+		while (m_Parts.size() > base) {
+			Part part = m_Parts.back();
+			m_Parts.pop_back();
+
+			if (part.Text) {
+				m_Writer << part.Text;
+				continue;
+			}
+
+			const ExprNode& node = arena.Get(part.Node);
+			ModelConstant literal{ ConstantState::Folded, BuiltinType::Int };
+			literal.Int = node.Int;
+
+			switch (node.Kind) {
+
+			case ExprKind::Int:
+				if (node.Int > INT_MAX)
+					literal.Type = BuiltinType::Long;
+				WriteLiteral(literal);
+				break;
+
+			case ExprKind::UInt:
+				literal.Type = BuiltinType::ULong;
+				WriteLiteral(literal);
+				break;
+
+			case ExprKind::Bool:
+				literal.Type = BuiltinType::Bool;
+				literal.Bool = node.Int != 0;
+				WriteLiteral(literal);
+				break;
+
+			case ExprKind::String:
+				literal.Type = BuiltinType::String;
+				literal.String = node.Text;
+				WriteLiteral(literal);
+				break;
+
+			case ExprKind::Name:
+				m_Writer << node.Text;
+				break;
+
+			case ExprKind::Unary:
+				PushOperand(node.Left);
+				m_Writer << GetOperatorText(node.Op);
+				break;
+
+			case ExprKind::Binary:
+				PushOperand(node.Right);
+				m_Parts.push_back(Part{ MRK_EXPR_NONE, " " });
+				m_Parts.push_back(Part{ MRK_EXPR_NONE, GetOperatorText(node.Op) });
+				m_Parts.push_back(Part{ MRK_EXPR_NONE, " " });
+				PushOperand(node.Left);
+				break;
+
+			case ExprKind::Assign:
+				PushOperand(node.Right);
+				m_Parts.push_back(Part{ MRK_EXPR_NONE, "= " });
+				if (node.Op != ExprOp::None)
+					m_Parts.push_back(Part{ MRK_EXPR_NONE, GetOperatorText(node.Op) });
+				m_Parts.push_back(Part{ MRK_EXPR_NONE, " " });
+				PushOperand(node.Left);
+				break;
+
+			case ExprKind::Member:
+				m_Parts.push_back(Part{ MRK_EXPR_NONE, node.Text });
+				m_Parts.push_back(Part{ MRK_EXPR_NONE, IsTypePath(_class, method, node.Left) ? GetScopeOperator() : "." });
+				PushOperand(node.Left);
+				break;
+
+			case ExprKind::Call: {
+				m_Args.clear();
+				for (mrku32 arg = node.Right; arg != MRK_EXPR_NONE; arg = arena.Get(arg).Next)
+					m_Args.push_back(arg);
+
+				m_Parts.push_back(Part{ MRK_EXPR_NONE, ")" });
+				for (size_t i = m_Args.size(); i-- > 0;) {
+					m_Parts.push_back(Part{ m_Args[i], 0 });
+					if (i)
+						m_Parts.push_back(Part{ MRK_EXPR_NONE, ", " });
+				}
+				m_Parts.push_back(Part{ MRK_EXPR_NONE, "(" });
+				PushOperand(node.Left);
+
+				//Type(...) builds an object
+				if (IsTypePath(_class, method, node.Left))
+					m_Writer << GetNewOperator();
+				break;
+			}
+
+			case ExprKind::Index:
+				m_Parts.push_back(Part{ MRK_EXPR_NONE, "]" });
+				m_Parts.push_back(Part{ node.Right, 0 });
+				m_Parts.push_back(Part{ MRK_EXPR_NONE, "[" });
+				PushOperand(node.Left);
+				break;
+
+			case ExprKind::Return:
+				if (node.Left != MRK_EXPR_NONE)
+					m_Parts.push_back(Part{ node.Left, 0 });
+				m_Writer << (node.Left != MRK_EXPR_NONE ? "return " : "return");
+				break;
+
+			default:
+				break;
+
+			}
+		}
+	}
+
+	bool Emitter::WriteBody(const ModelClass& _class, const ModelMethod& method, mrku32 depth) {
+		for (mrku32 statement : method.Body) {
+			ExprKind kind = m_Module->Expressions->Get(statement).Kind;
+
+			m_Writer.WriteIndent(depth);
+			if (kind == ExprKind::Call || kind == ExprKind::Assign || kind == ExprKind::Return)
+				WriteExpression(_class, &method, statement);
+			else
+				WriteDiscarded(_class, method, statement);
+			m_Writer << ";\n";
+
+			if (kind == ExprKind::Return)
+				return true;
+		}
+
+		return false;
+	}
+
+	bool Emitter::Emit(const ModelModule& module, mrks vector<mrks string>* files) {
+		TraceSpan span("Emit", mrks string(GetTargetName(GetTarget())) + ' ' + module.Filename);
+
+		m_Module = &module;
+		m_Files = files;
+		m_Success = true;
+		unsigned long long start = m_Writer.GetBytesWritten();
+
+		for (int root : module.Roots)
+			EmitRoot(GetClass(root));
+
+		span.Arg("classes", module.Classes.size());
+		span.Arg("bytes", m_Writer.GetBytesWritten() - start);
+		return m_Success;
+	}
+
+	bool Emitter::Emit(const ModelModule& module, int root, mrks vector<mrks string>* files) {
+		m_Module = &module;
+		m_Files = files;
+		m_Success = true;
+
+		EmitRoot(GetClass(root));
+		return m_Success;
+	}
+}
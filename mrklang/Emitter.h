@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common.h"
+#include "Model.h"
+#include "OutputWriter.h"
+
+namespace MRK {
+	const char* GetTargetName(EmitTarget target);
+	bool ParseTargetName(const mrks string& name, EmitTarget& target);
+
+	//backend base, writes every top-level class of a module into its own output tree
+	class Emitter {
+	private:
+		//what is left to write of an expression, a node or a piece of text
+		struct Part {
+			mrku32 Node;
+			const char* Text;
+		};
+
+		mrks vector<Part> m_Parts;
+		mrks vector<mrku32> m_Args;
+
+		bool IsTypePath(const ModelClass& _class, const ModelMethod* method, mrku32 node) const;
+		void PushOperand(mrku32 node);
+
+	protected:
+		OutputWriter& m_Writer;
+		mrks string m_OutputDir;
+		const ModelModule* m_Module;
+		mrks vector<mrks string>* m_Files;
+		bool m_Success;
+
+		const ModelClass& GetClass(int index) const { return m_Module->Classes[index]; }
+		void BeginFile(const mrks string& filename);
+		void EndFile();
+		void WriteBanner(const char* comment);
+		void WriteForeign(const mrks vector<ModelForeignBlock>& blocks);
+
+		//literals of folded constants, suffixes and casts are up to the backend
+		void WriteInteger(const ModelConstant& value);
+		void WriteFloat(const ModelConstant& value);
+		void WriteString(const mrks string& value);
+		virtual void EmitConstant(const ModelConstant& value) = 0;
+
+		//a default that did not fold or a body statement, in the target's syntax; Type.Nested and
+		//Type(...) are told from values by looking names up like IsValueName does
+		//Operands that are operators themselves are parenthesized, precedence is left as it was parsed
+		void WriteExpression(const ModelClass& _class, const ModelMethod* method, mrku32 root);
+		virtual void WriteLiteral(const ModelConstant& value) { EmitConstant(value); }
+		virtual const char* GetScopeOperator() const { return "."; } //Type.member
+		virtual const char* GetNewOperator() const { return "new "; } //before Type(...)
+
+		//statements up to the first return, what follows it never runs; false if the body falls off its end
+		bool WriteBody(const ModelClass& _class, const ModelMethod& method, mrku32 depth);
+		//a statement that is neither a call, an assignment nor a return, not every target takes it bare
+		virtual void WriteDiscarded(const ModelClass& _class, const ModelMethod& method, mrku32 node) { WriteExpression(_class, &method, node); }
+
+		virtual void EmitRoot(const ModelClass& root) = 0;
+
+	public:
+		Emitter(OutputWriter& writer, mrks string outputDir);
+		virtual ~Emitter() {}
+
+		virtual EmitTarget GetTarget() const = 0;
+
+		//returns false on I/O errors
+		bool Emit(const ModelModule& module, mrks vector<mrks string>* files = 0);
+
+		//one top-level class and its nested classes, the files of a root depend on nothing else
+		bool Emit(const ModelModule& module, int root, mrks vector<mrks string>* files = 0);
+	};
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Error.h"
+
+#include <cstdio>
+
+namespace MRK {
+	namespace {
+		struct ErrorInfo {
+			const char* Text;
+			const char* Suffix; //the second argument replaces %
+		};
+
+		const ErrorInfo g_ErrorInfo[] = {
+			{ "", "" },
+			{ "Expected identifier", " in %" },
+			{ "Expected ';'", " in %" },
+			{ "Unexpected symbol", " in %" },
+			{ "Invalid UTF-8", " in %" },
+			{ "Expected '{'", " in %" },
+			{ "Expected '}'", " in %" },
+			{ "Expected typename or identifier", " in %" },
+			{ "Expected typename", " in %" },
+			{ "No class context found", " in %" },
+			{ "Expected 'r'", " in %" },
+			{ "Expected expression", " in %" },
+			{ "Expected ')'", " in %" },
+			{ "Expected ']'", " in %" },
+			{ "Invalid assignment target", " in %" },
+			{ "Undefined type", " in %" },
+			{ "Not a type", " in %" },
+			{ "Duplicate type", " (first declared in %)" },
+			{ "Duplicate member", " (first declared in %)" },
+			{ "Duplicate member", " with % parameter(s)" },
+			{ "Duplicate parameter or local", " in %" },
+			{ "Not a constant expression", " in %" },
+			{ "Constant overflow", " in %" },
+			{ "Circular constant", " in %" },
+			{ "Division by zero", " in %" },
+			{ "Constant type mismatch", " in %" },
+			{ "Type mismatch", " in %" },
+			{ "Undefined name", " in %" },
+			{ "Undefined method", " in %" },
+			{ "Not a value", " in %" },
+			{ "Not assignable", " in %" },
+			{ "Instance member used without an object", " in %" },
+			{ "No constructor", " in %" },
+			{ "Wrong number of arguments", " in %" },
+			{ "Not supported by the VM", " in %" },
+			{ "Too large for the VM", " in %" },
+			{ "Method has no code", " in %" },
+			{ "Stack overflow", " in %" },
+			{ "Null reference", " in %" },
+			{ "cannot read the source", " in %" },
+			{ "cannot write the output", " in %" },
+			{ "Undefined reachability root", " in %" }
+		};
+
+		static_assert(sizeof(g_ErrorInfo) / sizeof(g_ErrorInfo[0]) == (size_t)ErrorCode::Count, "every error code needs a text");
+	}
+
+	mrku32 ErrorArgs::Intern(const mrks string& text) {
+		return text.empty() ? MRK_ERROR_ARG_NONE : m_Strings.Intern(text);
+	}
+
+	mrku32 ErrorArgs::Join(mrku32 owner, mrku32 name) {
+		//joined ids count down from the top, interned ones up from 1
+		unsigned long long key = (unsigned long long)owner << 32 | name;
+		auto found = m_JoinedIds.find(key);
+		if (found != m_JoinedIds.end())
+			return found->second;
+
+		m_Joined.emplace_back(owner, name);
+		mrku32 id = ~(mrku32)(m_Joined.size() - 1);
+		m_JoinedIds.emplace(key, id);
+		return id;
+	}
+
+	mrks string ErrorArgs::GetString(mrku32 arg) const {
+		if (arg == MRK_ERROR_ARG_NONE)
+			return "";
+
+		if (arg <= m_Strings.GetCount())
+			return m_Strings.GetString(arg);
+
+		const auto& joined = m_Joined[~arg];
+		return GetString(joined.first) + "::" + GetString(joined.second);
+	}
+
+	void ErrorArgs::Clear() {
+		m_Strings.Clear();
+		m_Joined.clear();
+		m_JoinedIds.clear();
+	}
+
+	const char* GetErrorText(ErrorCode code) {
+		return code < ErrorCode::Count ? g_ErrorInfo[(size_t)code].Text : "";
+	}
+
+	mrks string GetErrorRuleId(ErrorCode code) {
+		char id[16];
+		snprintf(id, sizeof(id), "MRK%04u", (unsigned)code);
+		return id;
+	}
+
+	mrks string FormatError(const Error& err) {
+		mrks string text = GetErrorText(err.Code);
+		if (!err.Names)
+			return text;
+
+		if (err.Args[0] != MRK_ERROR_ARG_NONE)
+			text += " '" + err.Names->GetString(err.Args[0]) + "'";
+
+		if (err.Args[1] != MRK_ERROR_ARG_NONE && err.Code < ErrorCode::Count) {
+			mrks string suffix = g_ErrorInfo[(size_t)err.Code].Suffix;
+			size_t mark = suffix.find('%');
+			text += suffix.replace(mark, 1, err.Names->GetString(err.Args[1]));
+		}
+
+		return text;
+	}
+}
@@ -27,22 +27,108 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <unordered_map>
 
 #include "Source.h"
 #include "Common.h"
+#include "Symbols.h"
 
-#define MRK_ERROR_EXPECTED_IDENTIFIER "Expected identifier"
-#define MRK_ERROR_EXPECTED_SEMICOLON "Expected ';'"
-#define MRK_ERROR_UNEXPECTED_SYMBOL "Unexpected symbol"
-#define MRK_ERROR_EXPECTED_OPENBRACE "Expected '{'"
-#define MRK_ERROR_EXPECTED_CLOSEBRACE "Expected '}'"
-#define MRK_ERROR_EXPECTED_TYPENAMEORIDENTIFIER "Expected typename or identifier"
-#define MRK_ERROR_EXPECTED_TYPENAME "Expected typename"
-#define MRK_ERROR_NO_CLASS_CXT "No class context found"
+#define MRK_NO_OFFSET ((mrkpos)-1)
+#define MRK_ERROR_ARG_NONE 0u
 
 namespace MRK {
+	//append only, the value is the published rule id (MRK0001...)
+	enum class ErrorCode : unsigned short {
+		None,
+		ExpectedIdentifier,
+		ExpectedSemicolon,
+		UnexpectedSymbol,
+		InvalidUtf8,
+		ExpectedOpenBrace,
+		ExpectedCloseBrace,
+		ExpectedTypenameOrIdentifier,
+		ExpectedTypename,
+		NoClassContext,
+		ExpectedReturn,
+		ExpectedExpression,
+		ExpectedCloseParen,
+		ExpectedCloseBracket,
+		InvalidAssignment,
+		UndefinedType,
+		NotAType,
+		DuplicateType,
+		DuplicateMember,
+		DuplicateConstructor,
+		DuplicateLocal,
+		NotConstant,
+		ConstantOverflow,
+		ConstantCycle,
+		DivideByZero,
+		ConstantType,
+		TypeMismatch,
+		UndefinedName,
+		UndefinedMethod,
+		NotAValue,
+		NotAssignable,
+		InstanceRequired,
+		NoConstructor,
+		ArgumentCount,
+		VMUnsupported,
+		VMLimit,
+		VMNotCompiled,
+		VMStackOverflow,
+		VMNullReference,
+		CannotRead,
+		CannotWrite,
+		UndefinedRoot,
+
+		Count
+	};
+
+	class ErrorArgs;
+
+	//plain data, the text is only built by FormatError
+	//Arguments are ids in the ErrorArgs of the pass that reported the error, the first is quoted,
+	//the second fills the code's suffix. An error is only formatted while its table lives
 	struct Error {
-		Source* Source;
-		mrks string Message;
+		mrk Source* Source;
+		ErrorCode Code = ErrorCode::None;
+		mrkpos Offset = MRK_NO_OFFSET; //in Source::Code
+		const ErrorArgs* Names = 0; //0 without arguments
+		mrku32 Args[2] = { MRK_ERROR_ARG_NONE, MRK_ERROR_ARG_NONE };
+	};
+
+	//arguments of the errors of one pass, owned by it and cleared when it runs again
+	//Names are interned once however many errors repeat them, a qualified name is a pair of ids
+	//joined with "::" only when it is formatted
+	class ErrorArgs {
+	private:
+		StringInterner m_Strings;
+		mrks vector<mrks pair<mrku32, mrku32>> m_Joined;
+		mrks unordered_map<unsigned long long, mrku32> m_JoinedIds; //owner << 32 | name -> id
+
+	public:
+		mrku32 Intern(const mrks string& text); //MRK_ERROR_ARG_NONE for an empty string
+		mrku32 Join(mrku32 owner, mrku32 name); //owner::name
+
+		mrks string GetString(mrku32 arg) const;
+		void Clear();
 	};
-}
\ No newline at end of file
+
+	const char* GetErrorText(ErrorCode code);
+	mrks string GetErrorRuleId(ErrorCode code); //MRK0001
+	mrks string FormatError(const Error& err);
+
+	inline Error MakeError(mrk Source* source, ErrorCode code, mrkpos offset = MRK_NO_OFFSET) {
+		return Error{ source, code, offset };
+	}
+
+	inline Error MakeError(const ErrorArgs& names, mrk Source* source, ErrorCode code, mrkpos offset, mrku32 arg0, mrku32 arg1 = MRK_ERROR_ARG_NONE) {
+		return Error{ source, code, offset, &names, { arg0, arg1 } };
+	}
+
+	inline Error MakeError(ErrorArgs& names, mrk Source* source, ErrorCode code, mrkpos offset, const mrks string& arg0, const mrks string& arg1 = "") {
+		return Error{ source, code, offset, &names, { names.Intern(arg0), names.Intern(arg1) } };
+	}
+}
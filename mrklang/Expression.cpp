@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Expression.h"
+#include "Error.h"
+
+#include <cstring>
+
+namespace MRK {
+	namespace {
+		struct OperatorInfo {
+			char First;
+			char Second; //0 for single character operators
+			ExprKind Kind;
+			ExprOp Op;
+			mrku32 Power; //binding power, higher binds tighter
+			bool RightAssociative;
+		};
+
+		//two character operators come before their one character prefixes
+		const OperatorInfo g_Operators[] = {
+			{ '+', '=', ExprKind::Assign, ExprOp::Add, 1, true },
+			{ '-', '=', ExprKind::Assign, ExprOp::Sub, 1, true },
+			{ '*', '=', ExprKind::Assign, ExprOp::Mul, 1, true },
+			{ '/', '=', ExprKind::Assign, ExprOp::Div, 1, true },
+			{ '%', '=', ExprKind::Assign, ExprOp::Mod, 1, true },
+			{ '&', '=', ExprKind::Assign, ExprOp::BitAnd, 1, true },
+			{ '|', '=', ExprKind::Assign, ExprOp::BitOr, 1, true },
+			{ '^', '=', ExprKind::Assign, ExprOp::Xor, 1, true },
+			{ '|', '|', ExprKind::Binary, ExprOp::Or, 2, false },
+			{ '&', '&', ExprKind::Binary, ExprOp::And, 3, false },
+			{ '=', '=', ExprKind::Binary, ExprOp::Eq, 7, false },
+			{ '!', '=', ExprKind::Binary, ExprOp::Ne, 7, false },
+			{ '<', '=', ExprKind::Binary, ExprOp::Le, 8, false },
+			{ '>', '=', ExprKind::Binary, ExprOp::Ge, 8, false },
+			{ '<', '<', ExprKind::Binary, ExprOp::Shl, 9, false },
+			{ '>', '>', ExprKind::Binary, ExprOp::Shr, 9, false },
+
+			{ '=', 0, ExprKind::Assign, ExprOp::None, 1, true },
+			{ '|', 0, ExprKind::Binary, ExprOp::BitOr, 4, false },
+			{ '^', 0, ExprKind::Binary, ExprOp::Xor, 5, false },
+			{ '&', 0, ExprKind::Binary, ExprOp::BitAnd, 6, false },
+			{ '<', 0, ExprKind::Binary, ExprOp::Lt, 8, false },
+			{ '>', 0, ExprKind::Binary, ExprOp::Gt, 8, false },
+			{ '+', 0, ExprKind::Binary, ExprOp::Add, 10, false },
+			{ '-', 0, ExprKind::Binary, ExprOp::Sub, 10, false },
+			{ '*', 0, ExprKind::Binary, ExprOp::Mul, 11, false },
+			{ '/', 0, ExprKind::Binary, ExprOp::Div, 11, false },
+			{ '%', 0, ExprKind::Binary, ExprOp::Mod, 11, false },
+
+			//prefix
+			{ '-', 0, ExprKind::Unary, ExprOp::Neg, 12, true },
+			{ '+', 0, ExprKind::Unary, ExprOp::Plus, 12, true },
+			{ '!', 0, ExprKind::Unary, ExprOp::Not, 12, true },
+			{ '~', 0, ExprKind::Unary, ExprOp::Complement, 12, true },
+
+			//postfix
+			{ '.', 0, ExprKind::Member, ExprOp::None, 13, false },
+			{ '(', 0, ExprKind::Call, ExprOp::None, 13, false },
+			{ '[', 0, ExprKind::Index, ExprOp::None, 13, false }
+		};
+
+		const int g_OperatorCount = sizeof(g_Operators) / sizeof(g_Operators[0]);
+
+		//indexed by ExprOp
+		const char* const g_OperatorText[] = {
+			"",
+			"*", "/", "%",
+			"+", "-",
+			"<<", ">>",
+			"<", "<=", ">", ">=",
+			"==", "!=",
+			"&", "^", "|",
+			"&&", "||",
+			"-", "+", "!", "~"
+		};
+
+		bool IsAssignable(const ExprNode& node) {
+			return node.Kind == ExprKind::Name || node.Kind == ExprKind::Member || node.Kind == ExprKind::Index;
+		}
+	}
+
+	ExprArena::ExprArena() : m_Count(0), m_TextUsed(0), m_TextBytes(0) {
+	}
+
+	mrku32 ExprArena::Add(ExprKind kind, ExprOp op, mrku32 left, mrku32 right) {
+		if ((m_Count >> MRK_EXPR_CHUNK_SHIFT) == m_Chunks.size())
+			m_Chunks.emplace_back(new ExprNode[1u << MRK_EXPR_CHUNK_SHIFT]);
+
+		mrku32 index = m_Count++;
+		ExprNode& node = Get(index);
+		node.Kind = kind;
+		node.Op = op;
+		node.Count = 0;
+		node.Left = left;
+		node.Right = right;
+		node.Next = MRK_EXPR_NONE;
+		node.Int = 0;
+		return index;
+	}
+
+	const char* ExprArena::AddText(const char* text) {
+		size_t length = strlen(text) + 1;
+		if (m_Text.empty() || m_TextUsed + length > MRK_EXPR_TEXT_CHUNK) {
+			//oversized text gets a chunk of its own, the next one starts a fresh chunk
+			size_t size = length > MRK_EXPR_TEXT_CHUNK ? length : MRK_EXPR_TEXT_CHUNK;
+			m_Text.emplace_back(new char[size]);
+			m_TextUsed = 0;
+			m_TextBytes += size;
+		}
+
+		char* dest = m_Text.back().get() + m_TextUsed;
+		memcpy(dest, text, length);
+		m_TextUsed += length;
+		return dest;
+	}
+
+	size_t ExprArena::GetBytes() const {
+		return m_Chunks.size() * (sizeof(ExprNode) << MRK_EXPR_CHUNK_SHIFT) + m_TextBytes
+			+ (m_Chunks.capacity() + m_Text.capacity()) * sizeof(void*);
+	}
+
+	ExpressionParser::ExpressionParser(StopFn stop) : m_Arena(0), m_Stop(stop), m_Tokens(0), m_Pos(0), m_End(0), m_Error(ErrorCode::None) {
+	}
+
+	const Token* ExpressionParser::Peek(mrku32 ahead) const {
+		mrkpos pos = m_Pos + ahead;
+		return pos < m_End ? &(*m_Tokens)[pos] : 0;
+	}
+
+	bool ExpressionParser::IsChar(mrku32 ahead, char c) const {
+		const Token* token = Peek(ahead);
+		return token && token->ContextualKind == TOKEN_CONTEXTUAL_KIND_CHAR && token->Value.CharValue == c;
+	}
+
+	int ExpressionParser::PeekOperator(bool prefix) const {
+		//symbols are single characters, two-character operators are two tokens
+		const Token* token = Peek();
+		if (!token || token->ContextualKind != TOKEN_CONTEXTUAL_KIND_CHAR)
+			return -1;
+
+		char c = token->Value.CharValue;
+		for (int i = 0; i < g_OperatorCount; i++) {
+			const OperatorInfo& info = g_Operators[i];
+			if (info.First != c || (info.Kind == ExprKind::Unary) != prefix)
+				continue;
+
+			if (!info.Second || IsChar(1, info.Second))
+				return i;
+		}
+
+		return -1;
+	}
+
+	mrku32 ExpressionParser::ParseAtom() {
+		const Token* token = Peek();
+		if (!token || (m_Stop && m_Stop(*m_Tokens, m_Pos)))
+			return Fail(ErrorCode::ExpectedExpression);
+
+		mrku32 node = MRK_EXPR_NONE;
+		switch (token->ContextualKind) {
+
+		case TOKEN_CONTEXTUAL_KIND_SHORT:
+		case TOKEN_CONTEXTUAL_KIND_USHORT:
+		case TOKEN_CONTEXTUAL_KIND_INT:
+		case TOKEN_CONTEXTUAL_KIND_UINT:
+		case TOKEN_CONTEXTUAL_KIND_LONG:
+		case TOKEN_CONTEXTUAL_KIND_ULONG:
+			if (token->Kind != TOKEN_KIND_NUMBER)
+				break;
+
+			//the lexer flags literals that don't fit their suffix
+			if (token->HasError)
+				return Fail(ErrorCode::ConstantOverflow);
+
+			node = m_Arena->Add(token->ContextualKind == TOKEN_CONTEXTUAL_KIND_ULONG ? ExprKind::UInt : ExprKind::Int);
+			switch (token->ContextualKind) {
+
+			case TOKEN_CONTEXTUAL_KIND_SHORT: m_Arena->Get(node).Int = token->Value.ShortValue; break;
+			case TOKEN_CONTEXTUAL_KIND_USHORT: m_Arena->Get(node).Int = token->Value.UShortValue; break;
+			case TOKEN_CONTEXTUAL_KIND_INT: m_Arena->Get(node).Int = token->Value.IntValue; break;
+			case TOKEN_CONTEXTUAL_KIND_UINT: m_Arena->Get(node).Int = token->Value.UIntValue; break;
+			case TOKEN_CONTEXTUAL_KIND_LONG: m_Arena->Get(node).Int = token->Value.LongValue; break;
+			default: m_Arena->Get(node).UInt = token->Value.ULongValue; break;
+
+			}
+			break;
+
+		case TOKEN_CONTEXTUAL_KIND_STRING:
+			node = m_Arena->Add(ExprKind::String);
+			m_Arena->Get(node).Text = m_Arena->AddText(token->Value.StringValue);
+			break;
+
+		case TOKEN_CONTEXTUAL_KIND_IDENTIFIER: {
+			const char* name = token->Value.IdentifierValue;
+			if (!strcmp(name, "true") || !strcmp(name, "false")) {
+				node = m_Arena->Add(ExprKind::Bool);
+				m_Arena->Get(node).Int = name[0] == 't';
+			}
+			else {
+				node = m_Arena->Add(ExprKind::Name);
+				m_Arena->Get(node).Text = m_Arena->AddText(name);
+			}
+			break;
+		}
+
+		default:
+			break;
+
+		}
+
+		if (node == MRK_EXPR_NONE)
+			return Fail(ErrorCode::ExpectedExpression);
+
+		m_Pos++;
+		return node;
+	}
+
+	mrku32 ExpressionParser::Fail(ErrorCode error) {
+		if (m_Error == ErrorCode::None)
+			m_Error = error;
+
+		return MRK_EXPR_NONE;
+	}
+
+	mrku32 ExpressionParser::Parse(ExprArena& arena, const TokenStore& tokens, mrkpos pos, mrkpos end, mrkpos* next) {
+		m_Arena = &arena;
+		m_Tokens = &tokens;
+		m_Pos = pos;
+		m_End = end < tokens.GetCount() ? end : tokens.GetCount();
+		m_Error = ErrorCode::None;
+		m_Stack.clear();
+
+		mrku32 lhs = MRK_EXPR_NONE;
+		mrku32 minPower = 0;
+		bool operand = true;
+
+		while (m_Error == ErrorCode::None) {
+			if (operand) {
+				//prefix operators and groups wait on the stack for their operand
+				int prefix = PeekOperator(true);
+				if (prefix >= 0) {
+					m_Stack.push_back(Frame{ FrameKind::Operator, (unsigned char)prefix, 0, MRK_EXPR_NONE, minPower });
+					minPower = g_Operators[prefix].Power;
+					m_Pos++;
+					continue;
+				}
+
+				if (IsChar(0, '(')) {
+					m_Stack.push_back(Frame{ FrameKind::Group, 0, 0, MRK_EXPR_NONE, minPower });
+					minPower = 0;
+					m_Pos++;
+					continue;
+				}
+
+				lhs = ParseAtom();
+				operand = false;
+				continue;
+			}
+
+			int op = PeekOperator(false);
+			if (op >= 0 && g_Operators[op].Power >= minPower) {
+				const OperatorInfo& info = g_Operators[op];
+				m_Pos += info.Second ? 2 : 1;
+
+				switch (info.Kind) {
+
+				case ExprKind::Member: {
+					const Token* name = Peek();
+					if (!name || name->ContextualKind != TOKEN_CONTEXTUAL_KIND_IDENTIFIER) {
+						Fail(ErrorCode::ExpectedIdentifier);
+						break;
+					}
+
+					lhs = m_Arena->Add(ExprKind::Member, ExprOp::None, lhs);
+					m_Arena->Get(lhs).Text = m_Arena->AddText(name->Value.IdentifierValue);
+					m_Pos++;
+					break;
+				}
+
+				case ExprKind::Call:
+					if (IsChar(0, ')')) {
+						lhs = m_Arena->Add(ExprKind::Call, ExprOp::None, lhs);
+						m_Pos++;
+						break;
+					}
+
+					m_Stack.push_back(Frame{ FrameKind::Call, 0, 0, lhs, minPower, MRK_EXPR_NONE, MRK_EXPR_NONE });
+					minPower = 0;
+					operand = true;
+					break;
+
+				case ExprKind::Index:
+					m_Stack.push_back(Frame{ FrameKind::Index, 0, 0, lhs, minPower });
+					minPower = 0;
+					operand = true;
+					break;
+
+				default:
+					m_Stack.push_back(Frame{ FrameKind::Operator, (unsigned char)op, 0, lhs, minPower });
+					minPower = info.RightAssociative ? info.Power : info.Power + 1;
+					operand = true;
+					break;
+
+				}
+
+				continue;
+			}
+
+			//nothing binds to lhs anymore, reduce the innermost pending frame
+			if (m_Stack.empty())
+				break;
+
+			Frame frame = m_Stack.back();
+			m_Stack.pop_back();
+			minPower = frame.MinPower;
+
+			switch (frame.Kind) {
+
+			case FrameKind::Operator: {
+				const OperatorInfo& info = g_Operators[frame.Info];
+				if (info.Kind == ExprKind::Assign && !IsAssignable(m_Arena->Get(frame.Left))) {
+					Fail(ErrorCode::InvalidAssignment);
+					break;
+				}
+
+				lhs = info.Kind == ExprKind::Unary ? m_Arena->Add(ExprKind::Unary, info.Op, lhs) : m_Arena->Add(info.Kind, info.Op, frame.Left, lhs);
+				break;
+			}
+
+			case FrameKind::Group:
+				if (!IsChar(0, ')')) {
+					Fail(ErrorCode::ExpectedCloseParen);
+					break;
+				}
+
+				m_Pos++;
+				break;
+
+			case FrameKind::Call:
+				if (frame.Head == MRK_EXPR_NONE)
+					frame.Head = lhs;
+				else
+					m_Arena->Get(frame.Tail).Next = lhs;
+
+				frame.Tail = lhs;
+				frame.Count++;
+
+				if (IsChar(0, ',')) {
+					m_Pos++;
+					m_Stack.push_back(frame);
+					minPower = 0;
+					operand = true;
+					break;
+				}
+
+				if (!IsChar(0, ')')) {
+					Fail(ErrorCode::ExpectedCloseParen);
+					break;
+				}
+
+				m_Pos++;
+				lhs = m_Arena->Add(ExprKind::Call, ExprOp::None, frame.Left, frame.Head);
+				m_Arena->Get(lhs).Count = frame.Count;
+				break;
+
+			case FrameKind::Index:
+				if (!IsChar(0, ']')) {
+					Fail(ErrorCode::ExpectedCloseBracket);
+					break;
+				}
+
+				m_Pos++;
+				lhs = m_Arena->Add(ExprKind::Index, ExprOp::None, frame.Left, lhs);
+				break;
+
+			}
+		}
+
+		*next = m_Pos;
+		return m_Error != ErrorCode::None ? MRK_EXPR_NONE : lhs;
+	}
+
+	const char* GetOperatorText(ExprOp op) {
+		return g_OperatorText[(mrku32)op];
+	}
+}
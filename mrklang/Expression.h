@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "Common.h"
+#include "Error.h"
+#include "Tokens.h"
+
+#define MRK_EXPR_NONE 0xFFFFFFFFu
+#define MRK_EXPR_CHUNK_SHIFT 12 //4096 nodes per chunk
+#define MRK_EXPR_TEXT_CHUNK 16384
+
+namespace MRK {
+	enum class ExprKind : unsigned char {
+		None,
+
+		//leaves
+		Int, //Int, every integer literal but ulong
+		UInt, //UInt
+		Bool, //Int
+		String, //Text
+		Name, //Text
+
+		//operators
+		Unary, //Op Left
+		Binary, //Op Left Right
+		Assign, //Op is None or the compound operator, Left target, Right value
+		Member, //Left.Text
+		Call, //Left(Right...), arguments chained by Next, Count of them
+		Index, //Left[Right]
+
+		//statements, an expression statement is the expression itself
+		Return //Left, MRK_EXPR_NONE without a value
+	};
+
+	enum class ExprOp : unsigned char {
+		None,
+
+		Mul, Div, Mod,
+		Add, Sub,
+		Shl, Shr,
+		Lt, Le, Gt, Ge,
+		Eq, Ne,
+		BitAnd, Xor, BitOr,
+		And, Or,
+
+		//unary
+		Neg, Plus, Not, Complement
+	};
+
+	//24 bytes, children are indices into the owning arena
+	struct ExprNode {
+		ExprKind Kind;
+		ExprOp Op;
+		unsigned short Count;
+		mrku32 Left;
+		mrku32 Right;
+		mrku32 Next;
+
+		union {
+			long long Int;
+			unsigned long long UInt;
+			const char* Text; //owned by the arena
+		};
+	};
+
+	static_assert(sizeof(ExprNode) == 24, "ExprNode is meant to stay compact");
+
+	//bump allocator for expression nodes and their names, nodes are never freed on their own
+	//Storage grows in fixed chunks so indices and text pointers stay valid as it grows
+	class ExprArena {
+	private:
+		mrks vector<mrks unique_ptr<ExprNode[]>> m_Chunks;
+		mrks vector<mrks unique_ptr<char[]>> m_Text;
+		mrku32 m_Count;
+		size_t m_TextUsed; //bytes used of the last text chunk
+		size_t m_TextBytes;
+
+	public:
+		ExprArena();
+		ExprArena(ExprArena&&) = default;
+		ExprArena& operator=(ExprArena&&) = default;
+
+		mrku32 Add(ExprKind kind, ExprOp op = ExprOp::None, mrku32 left = MRK_EXPR_NONE, mrku32 right = MRK_EXPR_NONE);
+		const char* AddText(const char* text);
+
+		ExprNode& Get(mrku32 index) { return m_Chunks[index >> MRK_EXPR_CHUNK_SHIFT][index & ((1u << MRK_EXPR_CHUNK_SHIFT) - 1)]; }
+		const ExprNode& Get(mrku32 index) const { return m_Chunks[index >> MRK_EXPR_CHUNK_SHIFT][index & ((1u << MRK_EXPR_CHUNK_SHIFT) - 1)]; }
+		mrku32 GetCount() const { return m_Count; }
+
+		//reserved bytes, nodes and text
+		size_t GetBytes() const;
+	};
+
+	//operator-precedence (Pratt) parser over a token span
+	//Pending operators live on an explicit stack, so nesting depth is bounded by memory rather
+	//than by the C stack, and every token is looked at a constant number of times
+	class ExpressionParser {
+	public:
+		//true if the token at pos starts a declaration that ends the expression before it
+		typedef bool (*StopFn)(const TokenStore& tokens, mrkpos pos);
+
+	private:
+		enum class FrameKind : unsigned char {
+			Operator, //binary, assignment or prefix operator waiting for its right operand
+			Group,
+			Call,
+			Index
+		};
+
+		struct Frame {
+			FrameKind Kind;
+			unsigned char Info; //g_Operators index of an Operator frame
+			unsigned short Count; //call arguments so far
+			mrku32 Left; //operand, callee or indexed expression
+			mrku32 MinPower; //binding power to restore once reduced
+			mrku32 Head; //call arguments
+			mrku32 Tail;
+		};
+
+		ExprArena* m_Arena;
+		StopFn m_Stop;
+		const TokenStore* m_Tokens;
+		mrkpos m_Pos;
+		mrkpos m_End;
+		mrks vector<Frame> m_Stack;
+		ErrorCode m_Error;
+
+		const Token* Peek(mrku32 ahead = 0) const;
+		bool IsChar(mrku32 ahead, char c) const;
+		int PeekOperator(bool prefix) const;
+		mrku32 ParseAtom();
+		mrku32 Fail(ErrorCode error);
+
+	public:
+		ExpressionParser(StopFn stop = 0);
+
+		//parses one expression from tokens[pos, end) into arena, *next is the first token it didn't take
+		//returns MRK_EXPR_NONE and sets GetError on failure
+		mrku32 Parse(ExprArena& arena, const TokenStore& tokens, mrkpos pos, mrkpos end, mrkpos* next);
+
+		ErrorCode GetError() const { return m_Error; }
+	};
+
+	//source form of an operator, "-" for Sub and Neg
+	const char* GetOperatorText(ExprOp op);
+}
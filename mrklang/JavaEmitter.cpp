@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "JavaEmitter.h"
+
+#include <climits>
+#include <cstdio>
+
+namespace MRK {
+	namespace {
+		//no unsigned types in Java, widened where a wider type exists
+		const char* g_JavaTypes[MRK_BUILTIN_TYPE_COUNT] = {
+			"", "void", "boolean", "byte", "char", "short", "int", "int", "long", "long", "long", "float", "double", "String"
+		};
+
+		//locals must be definitely assigned before use
+		const char* g_JavaDefaults[MRK_BUILTIN_TYPE_COUNT] = {
+			"null", "", "false", "0", "'\\0'", "0", "0", "0", "0", "0", "0", "0", "0", "null"
+		};
+	}
+
+	JavaEmitter::JavaEmitter(OutputWriter& writer, mrks string outputDir) : Emitter(writer, outputDir) {
+	}
+
+	const char* JavaEmitter::GetTypename(const ModelType& type) {
+		return type.IsUser() ? type.Name.c_str() : g_JavaTypes[(mrku32)type.Builtin];
+	}
+
+	void JavaEmitter::EmitConstant(const ModelConstant& value) {
+		switch (value.Type) {
+
+		case BuiltinType::Bool:
+			m_Writer << (value.Bool ? "true" : "false");
+			break;
+
+		case BuiltinType::Float:
+		case BuiltinType::Double:
+			WriteFloat(value);
+			break;
+
+		case BuiltinType::String:
+			WriteString(value.String);
+			break;
+
+		//byte is signed in Java, the cast keeps the bits
+		case BuiltinType::Byte:
+			if (value.Int > SCHAR_MAX)
+				m_Writer << "(byte)";
+			WriteInteger(value);
+			break;
+
+		case BuiltinType::UInt:
+		case BuiltinType::Long:
+			WriteInteger(value);
+			m_Writer << 'L';
+			break;
+
+		//widened to long, values past its range keep their bits as a hex literal
+		case BuiltinType::ULong:
+			if (value.UInt > LLONG_MAX) {
+				char buf[32];
+				m_Writer.Write(buf, snprintf(buf, sizeof(buf), "0x%llXL", value.UInt));
+			}
+			else {
+				WriteInteger(value);
+				m_Writer << 'L';
+			}
+			break;
+
+		default:
+			WriteInteger(value);
+			break;
+
+		}
+	}
+
+	void JavaEmitter::WriteDiscarded(const ModelClass& _class, const ModelMethod& method, mrku32 node) {
+		//Java only takes calls and assignments as statements, hashCode boxes any value and ignores null
+		m_Writer << "java.util.Objects.hashCode(";
+		WriteExpression(_class, &method, node);
+		m_Writer << ')';
+	}
+
+	void JavaEmitter::EmitMethod(const ModelClass& _class, const ModelMethod& method, mrku32 depth) {
+		m_Writer.WriteIndent(depth);
+		if (method.IsCtor)
+			m_Writer << "public " << _class.Name << '(';
+		else
+			m_Writer << "public " << GetTypename(method.ReturnType) << ' ' << method.Name << '(';
+
+		for (size_t i = 0; i < method.Params.size(); i++) {
+			if (i)
+				m_Writer << ", ";
+			m_Writer << GetTypename(method.Params[i].Type) << ' ' << method.Params[i].Name;
+		}
+
+		m_Writer << ") {\n";
+
+		for (const ModelVar& local : method.Locals) {
+			m_Writer.WriteIndent(depth + 1);
+			if (local.IsConstant()) {
+				m_Writer << "final " << GetTypename(local.Type) << ' ' << local.Name << " = ";
+				EmitConstant(local.Constant);
+				m_Writer << ";\n";
+			}
+			else if (local.Constant.State == ConstantState::Runtime) {
+				m_Writer << GetTypename(local.Type) << ' ' << local.Name << " = ";
+				WriteExpression(_class, &method, local.Default);
+				m_Writer << ";\n";
+			}
+			else
+				m_Writer << GetTypename(local.Type) << ' ' << local.Name << " = " << g_JavaDefaults[(mrku32)local.Type.Builtin] << ";\n";
+		}
+
+		WriteForeign(method.ForeignBlocks);
+
+		if (!WriteBody(_class, method, depth + 1) && !method.IsCtor && method.ReturnType.Builtin != BuiltinType::Void) {
+			m_Writer.WriteIndent(depth + 1);
+			m_Writer << "return " << g_JavaDefaults[(mrku32)method.ReturnType.Builtin] << ";\n";
+		}
+
+		m_Writer.WriteIndent(depth);
+		m_Writer << "}\n";
+	}
+
+	void JavaEmitter::EmitClass(const ModelClass& _class, mrku32 depth) {
+		m_Writer.WriteIndent(depth);
+		m_Writer << (_class.Parent >= 0 ? "public static class " : "public class ") << _class.Name << " {\n";
+
+		for (int nested : _class.Nested) {
+			EmitClass(GetClass(nested), depth + 1);
+			m_Writer << '\n';
+		}
+
+		for (const ModelVar& field : _class.Fields) {
+			m_Writer.WriteIndent(depth + 1);
+			if (field.IsConstant()) {
+				m_Writer << "public static final " << GetTypename(field.Type) << ' ' << field.Name << " = ";
+				EmitConstant(field.Constant);
+				m_Writer << ";\n";
+			}
+			else if (field.Constant.State == ConstantState::Runtime) {
+				m_Writer << "public " << GetTypename(field.Type) << ' ' << field.Name << " = ";
+				WriteExpression(_class, 0, field.Default);
+				m_Writer << ";\n";
+			}
+			else
+				m_Writer << "public " << GetTypename(field.Type) << ' ' << field.Name << ";\n";
+		}
+
+		for (size_t i = 0; i < _class.Methods.size(); i++) {
+			if (i || !_class.Fields.empty())
+				m_Writer << '\n';
+			EmitMethod(_class, _class.Methods[i], depth + 1);
+		}
+
+		WriteForeign(_class.ForeignBlocks);
+
+		m_Writer.WriteIndent(depth);
+		m_Writer << "}\n";
+	}
+
+	void JavaEmitter::EmitRoot(const ModelClass& root) {
+		BeginFile(root.Name + ".java");
+		WriteBanner("//");
+		EmitClass(root, 0);
+		EndFile();
+	}
+}
@@ -0,0 +1,507 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Json.h"
+
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <cstdio>
+
+namespace MRK {
+	namespace {
+		const JsonValue g_Null;
+		const mrks string g_EmptyString;
+
+		class JsonReader {
+		private:
+			const mrks string& m_Text;
+			size_t m_Pos;
+			mrks string m_Error;
+
+			void SkipSpace() {
+				while (m_Pos < m_Text.size() && (m_Text[m_Pos] == ' ' || m_Text[m_Pos] == '\t' || m_Text[m_Pos] == '\n' || m_Text[m_Pos] == '\r'))
+					m_Pos++;
+			}
+
+			bool Fail(const char* message) {
+				if (m_Error.empty())
+					m_Error = mrks string(message) + " at offset " + mrks to_string(m_Pos);
+				return false;
+			}
+
+			bool Expect(const char* literal) {
+				for (const char* c = literal; *c; c++, m_Pos++)
+					if (m_Pos >= m_Text.size() || m_Text[m_Pos] != *c)
+						return Fail("Invalid literal");
+
+				return true;
+			}
+
+			static void AppendUtf8(mrks string& out, mrku32 cp) {
+				if (cp < 0x80)
+					out += (char)cp;
+				else if (cp < 0x800) {
+					out += (char)(0xC0 | (cp >> 6));
+					out += (char)(0x80 | (cp & 0x3F));
+				}
+				else if (cp < 0x10000) {
+					out += (char)(0xE0 | (cp >> 12));
+					out += (char)(0x80 | ((cp >> 6) & 0x3F));
+					out += (char)(0x80 | (cp & 0x3F));
+				}
+				else {
+					out += (char)(0xF0 | (cp >> 18));
+					out += (char)(0x80 | ((cp >> 12) & 0x3F));
+					out += (char)(0x80 | ((cp >> 6) & 0x3F));
+					out += (char)(0x80 | (cp & 0x3F));
+				}
+			}
+
+			bool ReadHex4(mrku32& value) {
+				if (m_Pos + 4 > m_Text.size())
+					return Fail("Truncated escape");
+
+				value = 0;
+				for (int i = 0; i < 4; i++) {
+					char c = m_Text[m_Pos++];
+					value <<= 4;
+					if (c >= '0' && c <= '9')
+						value |= c - '0';
+					else if (c >= 'a' && c <= 'f')
+						value |= c - 'a' + 10;
+					else if (c >= 'A' && c <= 'F')
+						value |= c - 'A' + 10;
+					else
+						return Fail("Invalid escape");
+				}
+
+				return true;
+			}
+
+			bool ReadString(mrks string& out) {
+				m_Pos++; //opening quote
+				while (m_Pos < m_Text.size()) {
+					char c = m_Text[m_Pos++];
+					if (c == '"')
+						return true;
+
+					if (c != '\\') {
+						out += c;
+						continue;
+					}
+
+					if (m_Pos >= m_Text.size())
+						break;
+
+					char esc = m_Text[m_Pos++];
+					switch (esc) {
+
+					case '"': out += '"'; break;
+					case '\\': out += '\\'; break;
+					case '/': out += '/'; break;
+					case 'b': out += '\b'; break;
+					case 'f': out += '\f'; break;
+					case 'n': out += '\n'; break;
+					case 'r': out += '\r'; break;
+					case 't': out += '\t'; break;
+
+					case 'u': {
+						mrku32 cp = 0;
+						if (!ReadHex4(cp))
+							return false;
+
+						//surrogate pair, a high surrogate followed by anything else is read again on its own
+						if (cp >= 0xD800 && cp < 0xDC00 && m_Pos + 1 < m_Text.size() && m_Text[m_Pos] == '\\' && m_Text[m_Pos + 1] == 'u') {
+							size_t next = m_Pos;
+							m_Pos += 2;
+							mrku32 low = 0;
+							if (!ReadHex4(low))
+								return false;
+
+							if (low >= 0xDC00 && low < 0xE000)
+								cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+							else
+								m_Pos = next;
+						}
+
+						//unpaired surrogates have no UTF-8 form
+						if (cp >= 0xD800 && cp < 0xE000)
+							cp = 0xFFFD;
+
+						AppendUtf8(out, cp);
+						break;
+					}
+
+					default:
+						return Fail("Invalid escape");
+
+					}
+				}
+
+				return Fail("Unterminated string");
+			}
+
+			bool ReadValue(JsonValue& out, int depth) {
+				if (depth > 512)
+					return Fail("Nesting too deep");
+
+				SkipSpace();
+				if (m_Pos >= m_Text.size())
+					return Fail("Unexpected end");
+
+				char c = m_Text[m_Pos];
+				switch (c) {
+
+				case '{': {
+					out = JsonValue::MakeObject();
+					m_Pos++;
+					SkipSpace();
+					if (m_Pos < m_Text.size() && m_Text[m_Pos] == '}') {
+						m_Pos++;
+						return true;
+					}
+
+					while (true) {
+						SkipSpace();
+						if (m_Pos >= m_Text.size() || m_Text[m_Pos] != '"')
+							return Fail("Expected key");
+
+						mrks string key;
+						if (!ReadString(key))
+							return false;
+
+						SkipSpace();
+						if (m_Pos >= m_Text.size() || m_Text[m_Pos] != ':')
+							return Fail("Expected ':'");
+						m_Pos++;
+
+						JsonValue value;
+						if (!ReadValue(value, depth + 1))
+							return false;
+						out.Set(key, mrks move(value));
+
+						SkipSpace();
+						if (m_Pos < m_Text.size() && m_Text[m_Pos] == ',') {
+							m_Pos++;
+							continue;
+						}
+						if (m_Pos < m_Text.size() && m_Text[m_Pos] == '}') {
+							m_Pos++;
+							return true;
+						}
+						return Fail("Expected ',' or '}'");
+					}
+				}
+
+				case '[': {
+					out = JsonValue::MakeArray();
+					m_Pos++;
+					SkipSpace();
+					if (m_Pos < m_Text.size() && m_Text[m_Pos] == ']') {
+						m_Pos++;
+						return true;
+					}
+
+					while (true) {
+						JsonValue value;
+						if (!ReadValue(value, depth + 1))
+							return false;
+						out.Push(mrks move(value));
+
+						SkipSpace();
+						if (m_Pos < m_Text.size() && m_Text[m_Pos] == ',') {
+							m_Pos++;
+							continue;
+						}
+						if (m_Pos < m_Text.size() && m_Text[m_Pos] == ']') {
+							m_Pos++;
+							return true;
+						}
+						return Fail("Expected ',' or ']'");
+					}
+				}
+
+				case '"': {
+					mrks string str;
+					if (!ReadString(str))
+						return false;
+					out = JsonValue(mrks move(str));
+					return true;
+				}
+
+				case 't':
+					out = JsonValue(true);
+					return Expect("true");
+
+				case 'f':
+					out = JsonValue(false);
+					return Expect("false");
+
+				case 'n':
+					out = JsonValue();
+					return Expect("null");
+
+				default: {
+					const char* begin = m_Text.c_str() + m_Pos;
+					char* end = 0;
+					double number = strtod(begin, &end);
+					if (end == begin)
+						return Fail("Unexpected character");
+
+					m_Pos += end - begin;
+					out = JsonValue(number);
+					return true;
+				}
+
+				}
+			}
+
+		public:
+			JsonReader(const mrks string& text) : m_Text(text), m_Pos(0) {
+			}
+
+			bool Read(JsonValue& out) {
+				if (!ReadValue(out, 0))
+					return false;
+
+				SkipSpace();
+				if (m_Pos != m_Text.size())
+					return Fail("Trailing characters");
+
+				return true;
+			}
+
+			const mrks string& GetError() const {
+				return m_Error;
+			}
+		};
+	}
+
+	JsonValue::JsonValue() : m_Type(JsonType::Null), m_Bool(false), m_Number(0) {
+	}
+
+	JsonValue::JsonValue(bool value) : m_Type(JsonType::Bool), m_Bool(value), m_Number(0) {
+	}
+
+	JsonValue::JsonValue(int value) : m_Type(JsonType::Number), m_Bool(false), m_Number(value) {
+	}
+
+	JsonValue::JsonValue(double value) : m_Type(JsonType::Number), m_Bool(false), m_Number(value) {
+	}
+
+	JsonValue::JsonValue(unsigned long long value) : m_Type(JsonType::Number), m_Bool(false), m_Number((double)value) {
+	}
+
+	JsonValue::JsonValue(const char* value) : m_Type(JsonType::String), m_Bool(false), m_Number(0), m_String(value) {
+	}
+
+	JsonValue::JsonValue(mrks string value) : m_Type(JsonType::String), m_Bool(false), m_Number(0), m_String(mrks move(value)) {
+	}
+
+	JsonValue JsonValue::MakeArray() {
+		JsonValue value;
+		value.m_Type = JsonType::Array;
+		return value;
+	}
+
+	JsonValue JsonValue::MakeObject() {
+		JsonValue value;
+		value.m_Type = JsonType::Object;
+		return value;
+	}
+
+	bool JsonValue::AsBool(bool fallback) const {
+		return m_Type == JsonType::Bool ? m_Bool : fallback;
+	}
+
+	double JsonValue::AsNumber(double fallback) const {
+		return m_Type == JsonType::Number ? m_Number : fallback;
+	}
+
+	long long JsonValue::AsInt(long long fallback) const {
+		return m_Type == JsonType::Number ? (long long)m_Number : fallback;
+	}
+
+	const mrks string& JsonValue::AsString() const {
+		return m_Type == JsonType::String ? m_String : g_EmptyString;
+	}
+
+	size_t JsonValue::Size() const {
+		return m_Type == JsonType::Array ? m_Array.size() : m_Type == JsonType::Object ? m_Object.size() : 0;
+	}
+
+	const JsonValue& JsonValue::operator[](size_t index) const {
+		return m_Type == JsonType::Array && index < m_Array.size() ? m_Array[index] : g_Null;
+	}
+
+	JsonValue& JsonValue::Push(JsonValue value) {
+		m_Type = JsonType::Array;
+		m_Array.push_back(mrks move(value));
+		return m_Array.back();
+	}
+
+	const JsonValue& JsonValue::Get(const mrks string& key) const {
+		if (m_Type == JsonType::Object)
+			for (auto& member : m_Object)
+				if (member.first == key)
+					return member.second;
+
+		return g_Null;
+	}
+
+	bool JsonValue::Has(const mrks string& key) const {
+		if (m_Type == JsonType::Object)
+			for (auto& member : m_Object)
+				if (member.first == key)
+					return true;
+
+		return false;
+	}
+
+	JsonValue& JsonValue::Set(const mrks string& key, JsonValue value) {
+		m_Type = JsonType::Object;
+		for (auto& member : m_Object) {
+			if (member.first == key) {
+				member.second = mrks move(value);
+				return member.second;
+			}
+		}
+
+		m_Object.push_back(mrks make_pair(key, mrks move(value)));
+		return m_Object.back().second;
+	}
+
+	void JsonValue::Write(mrks ostream& stream) const {
+		switch (m_Type) {
+
+		case JsonType::Null:
+			stream << "null";
+			break;
+
+		case JsonType::Bool:
+			stream << (m_Bool ? "true" : "false");
+			break;
+
+		case JsonType::Number:
+			if (!mrks isfinite(m_Number))
+				stream << "null";
+			else if (m_Number == (double)(long long)m_Number && mrks fabs(m_Number) < 9e15)
+				stream << (long long)m_Number;
+			else {
+				char buf[32];
+				snprintf(buf, sizeof(buf), "%.17g", m_Number);
+				stream << buf;
+			}
+			break;
+
+		case JsonType::String:
+			WriteJsonString(stream, m_String);
+			break;
+
+		case JsonType::Array: {
+			stream << '[';
+			bool first = true;
+			for (const JsonValue& value : m_Array) {
+				if (!first)
+					stream << ',';
+				value.Write(stream);
+				first = false;
+			}
+			stream << ']';
+			break;
+		}
+
+		case JsonType::Object: {
+			stream << '{';
+			bool first = true;
+			for (auto& member : m_Object) {
+				if (!first)
+					stream << ',';
+				WriteJsonString(stream, member.first);
+				stream << ':';
+				member.second.Write(stream);
+				first = false;
+			}
+			stream << '}';
+			break;
+		}
+
+		}
+	}
+
+	mrks string JsonValue::ToString() const {
+		mrks stringstream stream;
+		Write(stream);
+		return stream.str();
+	}
+
+	bool JsonValue::Parse(const mrks string& text, JsonValue& out, mrks string* error) {
+		JsonReader reader(text);
+		if (reader.Read(out))
+			return true;
+
+		if (error)
+			*error = reader.GetError();
+		return false;
+	}
+
+	void WriteJsonString(mrks ostream& stream, const mrks string& str) {
+		//plain runs go out in one write, protocol messages carry whole documents
+		stream << '"';
+		size_t run = 0;
+		for (size_t i = 0; i < str.size(); i++) {
+			char c = str[i];
+			const char* escape;
+			char buf[8];
+
+			switch (c) {
+
+			case '"': escape = "\\\""; break;
+			case '\\': escape = "\\\\"; break;
+			case '\n': escape = "\\n"; break;
+			case '\r': escape = "\\r"; break;
+			case '\t': escape = "\\t"; break;
+
+			default:
+				if ((unsigned char)c >= 0x20)
+					continue;
+
+				snprintf(buf, sizeof(buf), "\\u%04x", c);
+				escape = buf;
+				break;
+
+			}
+
+			stream.write(str.data() + run, i - run);
+			stream << escape;
+			run = i + 1;
+		}
+
+		stream.write(str.data() + run, str.size() - run);
+		stream << '"';
+	}
+}
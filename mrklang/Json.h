@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <ostream>
+
+#include "Common.h"
+
+namespace MRK {
+	enum class JsonType {
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	//small DOM for tool output and protocol messages, objects keep insertion order
+	class JsonValue {
+	private:
+		JsonType m_Type;
+		bool m_Bool;
+		double m_Number;
+		mrks string m_String;
+		mrks vector<JsonValue> m_Array;
+		mrks vector<mrks pair<mrks string, JsonValue>> m_Object;
+
+	public:
+		JsonValue();
+		JsonValue(bool value);
+		JsonValue(int value);
+		JsonValue(double value);
+		JsonValue(unsigned long long value);
+		JsonValue(const char* value);
+		JsonValue(mrks string value);
+
+		static JsonValue MakeArray();
+		static JsonValue MakeObject();
+
+		JsonType GetType() const { return m_Type; }
+		bool IsNull() const { return m_Type == JsonType::Null; }
+		bool IsNumber() const { return m_Type == JsonType::Number; }
+		bool IsString() const { return m_Type == JsonType::String; }
+		bool IsArray() const { return m_Type == JsonType::Array; }
+		bool IsObject() const { return m_Type == JsonType::Object; }
+
+		bool AsBool(bool fallback = false) const;
+		double AsNumber(double fallback = 0) const;
+		long long AsInt(long long fallback = 0) const;
+		const mrks string& AsString() const;
+
+		//arrays
+		size_t Size() const;
+		const JsonValue& operator[](size_t index) const;
+		JsonValue& Push(JsonValue value);
+		const mrks vector<JsonValue>& GetItems() const { return m_Array; }
+
+		//objects, Get returns a null value when the key is missing
+		const JsonValue& Get(const mrks string& key) const;
+		bool Has(const mrks string& key) const;
+		JsonValue& Set(const mrks string& key, JsonValue value);
+		const mrks vector<mrks pair<mrks string, JsonValue>>& GetMembers() const { return m_Object; }
+
+		void Write(mrks ostream& stream) const;
+		mrks string ToString() const;
+
+		static bool Parse(const mrks string& text, JsonValue& out, mrks string* error = 0);
+	};
+
+	void WriteJsonString(mrks ostream& stream, const mrks string& str);
+}
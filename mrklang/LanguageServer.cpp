@@ -0,0 +1,684 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "LanguageServer.h"
+#include "Parser.h"
+#include "BlockScanner.h"
+#include "Diagnostics.h"
+#include "Statistics.h"
+#include "Trace.h"
+
+#include <set>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+
+//SymbolKind
+#define MRK_LSP_CLASS 5
+#define MRK_LSP_METHOD 6
+#define MRK_LSP_FIELD 8
+#define MRK_LSP_CONSTRUCTOR 9
+#define MRK_LSP_VARIABLE 13
+
+//ErrorCodes
+#define MRK_LSP_PARSE_ERROR -32700
+#define MRK_LSP_METHOD_NOT_FOUND -32601
+#define MRK_LSP_REQUEST_CANCELLED -32800
+
+namespace MRK {
+	struct LanguageServer::Inbox {
+		struct Message {
+			JsonValue Body; //null when it was not valid JSON
+			mrks chrono::steady_clock::time_point Received;
+		};
+
+		mrks mutex Mutex;
+		mrks condition_variable Ready;
+		mrks deque<Message> Queue;
+		mrks set<mrks string> Cancelled; //ids of queued requests as JSON text, erased when they are handled
+		bool Done = false;
+
+		//a request already answered or being handled can't be cancelled, its id would never be erased
+		void Cancel(const JsonValue& id) {
+			mrks string text = id.ToString();
+			for (const Message& message : Queue)
+				if (message.Body.Has("id") && message.Body.Get("id").ToString() == text) {
+					Cancelled.insert(mrks move(text));
+					return;
+				}
+		}
+	};
+
+	namespace {
+		bool ReadMessage(mrks istream& in, mrks string& body) {
+			size_t length = 0;
+			bool framed = false;
+			mrks string line;
+
+			//headers end with an empty line, only Content-Length matters
+			while (mrks getline(in, line)) {
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+
+				if (line.empty()) {
+					if (framed)
+						break;
+					continue;
+				}
+
+				mrks string name = line.substr(0, line.find(':'));
+				mrks transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)tolower(c); });
+				if (name == "content-length" && name.size() < line.size()) {
+					length = (size_t)strtoull(line.c_str() + name.size() + 1, 0, 10);
+					framed = true;
+				}
+			}
+
+			if (!framed || !in)
+				return false;
+
+			body.resize(length);
+			in.read(&body[0], (mrks streamsize)length);
+			return (size_t)in.gcount() == length;
+		}
+
+		bool IsNameCharacter(unsigned char c) {
+			return isalnum(c) || c == '_' || c >= 0x80;
+		}
+
+		size_t GetNameLength(const mrks string& text, size_t offset) {
+			size_t end = offset;
+			while (end < text.size() && IsNameCharacter(text[end]))
+				end++;
+
+			return end > offset ? end - offset : offset < text.size() ? 1 : 0;
+		}
+
+		//UTF-16 code units of the UTF-8 sequence starting with lead, and its length in bytes
+		size_t GetSequence(unsigned char lead, size_t& units) {
+			size_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+			units = length == 4 ? 2 : 1;
+			return length;
+		}
+
+		mrks string GetFileName(const mrks string& uri) {
+			size_t slash = uri.rfind('/');
+			return slash == mrks string::npos ? uri : uri.substr(slash + 1);
+		}
+
+		JsonValue MakeMessage() {
+			JsonValue message = JsonValue::MakeObject();
+			message.Set("jsonrpc", "2.0");
+			return message;
+		}
+
+		JsonValue MakeError(int code, const char* text) {
+			JsonValue error = JsonValue::MakeObject();
+			error.Set("code", code);
+			error.Set("message", text);
+			return error;
+		}
+	}
+
+	LanguageServer::LanguageServer() : m_Out(0), m_Parses(0), m_Edits(0), m_ShutdownRequested(false), m_Exit(false) {
+	}
+
+	int LanguageServer::Run(mrks istream& in, mrks ostream& out) {
+		m_Out = &out;
+		m_Inbox = mrks make_shared<Inbox>();
+
+		//the reader only shares the inbox, it may outlive the server when the client never closes the input
+		mrks shared_ptr<Inbox> inbox = m_Inbox;
+		mrks thread reader([inbox, &in]() {
+			Trace::NameThread("LSP reader");
+
+			mrks string body;
+			while (ReadMessage(in, body)) {
+				JsonValue message;
+				if (!JsonValue::Parse(body, message) || !message.IsObject())
+					message = JsonValue();
+
+				auto received = mrks chrono::steady_clock::now();
+				mrks lock_guard<mrks mutex> lock(inbox->Mutex);
+				if (message.Get("method").AsString() == "$/cancelRequest")
+					inbox->Cancel(message.Get("params").Get("id"));
+				else
+					inbox->Queue.push_back(Inbox::Message{ mrks move(message), received });
+
+				inbox->Ready.notify_one();
+			}
+
+			mrks lock_guard<mrks mutex> lock(inbox->Mutex);
+			inbox->Done = true;
+			inbox->Ready.notify_one();
+		});
+
+		while (!m_Exit) {
+			bool idle;
+			{
+				mrks lock_guard<mrks mutex> lock(m_Inbox->Mutex);
+				idle = m_Inbox->Queue.empty();
+			}
+
+			//edited documents are parsed once the edits stop coming
+			if (idle)
+				ParsePending();
+
+			mrks unique_lock<mrks mutex> lock(m_Inbox->Mutex);
+			m_Inbox->Ready.wait(lock, [this]() { return !m_Inbox->Queue.empty() || m_Inbox->Done; });
+			if (m_Inbox->Queue.empty())
+				break;
+
+			Inbox::Message message = mrks move(m_Inbox->Queue.front());
+			m_Inbox->Queue.pop_front();
+			lock.unlock();
+
+			Handle(message.Body, message.Received);
+		}
+
+		bool done;
+		{
+			mrks lock_guard<mrks mutex> lock(m_Inbox->Mutex);
+			done = m_Inbox->Done;
+		}
+
+		if (done)
+			reader.join();
+		else
+			reader.detach();
+
+		return m_ShutdownRequested ? 0 : 1;
+	}
+
+	void LanguageServer::Handle(const JsonValue& message, mrks chrono::steady_clock::time_point received) {
+		if (!message.IsObject()) {
+			JsonValue response = MakeMessage();
+			response.Set("id", JsonValue());
+			response.Set("error", MakeError(MRK_LSP_PARSE_ERROR, "Parse error"));
+			Send(response);
+			return;
+		}
+
+		//responses to server requests are never expected
+		const mrks string& method = message.Get("method").AsString();
+		if (method.empty())
+			return;
+
+		bool request = message.Has("id");
+		if (request) {
+			bool cancelled;
+			{
+				mrks lock_guard<mrks mutex> lock(m_Inbox->Mutex);
+				cancelled = m_Inbox->Cancelled.erase(message.Get("id").ToString()) > 0;
+			}
+
+			if (cancelled) {
+				JsonValue response = MakeMessage();
+				response.Set("id", message.Get("id"));
+				response.Set("error", MakeError(MRK_LSP_REQUEST_CANCELLED, "Request cancelled"));
+				Send(response);
+				m_Cancelled[method]++;
+				return;
+			}
+		}
+
+		TraceSpan span("LspRequest", method);
+		bool found = true;
+		JsonValue result = Serve(method, message.Get("params"), found);
+		if (!request)
+			return;
+
+		JsonValue response = MakeMessage();
+		response.Set("id", message.Get("id"));
+		if (found)
+			response.Set("result", mrks move(result));
+		else
+			response.Set("error", MakeError(MRK_LSP_METHOD_NOT_FOUND, "Method not found"));
+
+		Send(response);
+		m_Latencies[method].push_back(mrks chrono::duration<double, mrks milli>(mrks chrono::steady_clock::now() - received).count());
+	}
+
+	JsonValue LanguageServer::Serve(const mrks string& method, const JsonValue& params, bool& found) {
+		if (method == "initialize") {
+			JsonValue sync = JsonValue::MakeObject();
+			sync.Set("openClose", true);
+			sync.Set("change", 2); //incremental
+
+			JsonValue capabilities = JsonValue::MakeObject();
+			capabilities.Set("textDocumentSync", mrks move(sync));
+			capabilities.Set("documentSymbolProvider", true);
+			capabilities.Set("definitionProvider", true);
+
+			JsonValue info = JsonValue::MakeObject();
+			info.Set("name", "mrk_lsp");
+			info.Set("version", MRK_VERSION);
+
+			JsonValue result = JsonValue::MakeObject();
+			result.Set("capabilities", mrks move(capabilities));
+			result.Set("serverInfo", mrks move(info));
+			return result;
+		}
+
+		if (method == "shutdown") {
+			m_ShutdownRequested = true;
+			return JsonValue();
+		}
+
+		if (method == "exit") {
+			m_Exit = true;
+			return JsonValue();
+		}
+
+		if (method == "textDocument/didOpen") {
+			const JsonValue& item = params.Get("textDocument");
+			Document& doc = m_Documents[item.Get("uri").AsString()];
+			doc = Document{ item.Get("uri").AsString(), item.Get("text").AsString(), item.Get("version").AsInt() };
+			doc.Lines.push_back(0);
+			for (size_t i = 0; i < doc.Text.size(); i++)
+				if (doc.Text[i] == '\n')
+					doc.Lines.push_back(i + 1);
+
+			doc.Dirty = true;
+			return JsonValue();
+		}
+
+		if (method == "textDocument/didChange") {
+			Document* doc = FindDocument(params);
+			if (doc) {
+				for (const JsonValue& change : params.Get("contentChanges").GetItems())
+					ApplyChange(*doc, change);
+
+				doc->Version = params.Get("textDocument").Get("version").AsInt(doc->Version);
+				doc->Dirty = true;
+				m_Edits++;
+			}
+
+			return JsonValue();
+		}
+
+		if (method == "textDocument/didClose") {
+			mrks string uri = params.Get("textDocument").Get("uri").AsString();
+			if (m_Documents.erase(uri)) {
+				JsonValue clear = JsonValue::MakeObject();
+				clear.Set("uri", uri);
+				clear.Set("diagnostics", JsonValue::MakeArray());
+
+				JsonValue notification = MakeMessage();
+				notification.Set("method", "textDocument/publishDiagnostics");
+				notification.Set("params", mrks move(clear));
+				Send(notification);
+			}
+
+			return JsonValue();
+		}
+
+		if (method == "textDocument/documentSymbol" || method == "textDocument/definition") {
+			Document* doc = FindDocument(params);
+			if (!doc)
+				return JsonValue();
+
+			if (doc->Dirty)
+				Parse(*doc);
+
+			return method == "textDocument/documentSymbol" ? GetSymbols(*doc) : GetDefinition(*doc, ToOffset(*doc, params.Get("position")));
+		}
+
+		if (method == "mrk/stats") {
+			JsonValue methods = JsonValue::MakeArray();
+			for (const LspMethodStats& stats : GetStats()) {
+				JsonValue item = JsonValue::MakeObject();
+				item.Set("method", stats.Method);
+				item.Set("count", (unsigned long long)stats.Count);
+				item.Set("cancelled", (unsigned long long)stats.Cancelled);
+				item.Set("p50", stats.P50);
+				item.Set("p99", stats.P99);
+				item.Set("max", stats.Max);
+				methods.Push(mrks move(item));
+			}
+
+			JsonValue result = JsonValue::MakeObject();
+			result.Set("parses", (unsigned long long)m_Parses);
+			result.Set("edits", (unsigned long long)m_Edits);
+			result.Set("methods", mrks move(methods));
+			return result;
+		}
+
+		found = method == "initialized" || method.compare(0, 2, "$/") == 0;
+		return JsonValue();
+	}
+
+	void LanguageServer::Send(const JsonValue& message) {
+		mrks string body = message.ToString();
+		*m_Out << "Content-Length: " << body.size() << "\r\n\r\n" << body << mrks flush;
+	}
+
+	void LanguageServer::Parse(Document& doc) {
+		TraceSpan span("LspParse", doc.Uri);
+
+		Parser parser(mrks vector<Source> { Source{ GetFileName(doc.Uri), doc.Text } });
+		ParserResult result;
+		parser.Start(result);
+
+		doc.Declarations.clear();
+		doc.Diagnostics.clear();
+		DiagnosticLimiter limiter;
+		for (const mrk Error& err : result.Errors)
+			if (limiter.Accept(err))
+				doc.Diagnostics.push_back(Diagnostic{ err.Offset, FormatError(err) });
+
+		auto add = [&doc](const mrks string& name, const mrks string& detail, int kind, mrkpos offset, bool block, int parent) {
+			mrkpos length = GetNameLength(doc.Text, offset);
+			mrkpos end = block ? FindBlockEnd(doc.Text.data(), doc.Text.size(), offset + length, BlockSyntax::Mrk) : offset + length;
+			doc.Declarations.push_back(Declaration{ name, detail, kind, offset, length, end, parent });
+			return (int)doc.Declarations.size() - 1;
+		};
+
+		//classes come before their nested classes
+		const SourceParseContext* context = parser.GetParseContext(&parser.GetSources().front());
+		mrks vector<int> classes(context ? context->ParseClasses.size() : 0, -1);
+		for (size_t i = 0; i < classes.size(); i++) {
+			const ParseClass& cls = context->ParseClasses[i];
+			int index = classes[i] = add(cls.Name, "", MRK_LSP_CLASS, cls.Offset, true, cls.ParentIndex >= 0 ? classes[cls.ParentIndex] : -1);
+
+			for (const ParseVar& field : cls.Fields)
+				add(field.Name, field.Typename, MRK_LSP_FIELD, field.Offset, false, index);
+
+			for (const ParseMethod& method : cls.Methods) {
+				bool ctor = method.Name == "cx";
+				int owner = add(ctor ? cls.Name : method.Name, method.Typename, ctor ? MRK_LSP_CONSTRUCTOR : MRK_LSP_METHOD, method.Offset, true, index);
+
+				for (const ParseParam& param : method.Params)
+					add(param.Name, param.Typename, MRK_LSP_VARIABLE, param.Offset, false, owner);
+				for (const ParseVar& var : method.Vars)
+					add(var.Name, var.Typename, MRK_LSP_VARIABLE, var.Offset, false, owner);
+			}
+		}
+
+		doc.Dirty = false;
+		m_Parses++;
+
+		JsonValue diagnostics = JsonValue::MakeArray();
+		for (const Diagnostic& diagnostic : doc.Diagnostics) {
+			bool located = diagnostic.Offset != MRK_NO_OFFSET;
+			JsonValue item = JsonValue::MakeObject();
+			item.Set("range", ToRange(doc, located ? diagnostic.Offset : 0, located ? GetNameLength(doc.Text, diagnostic.Offset) : 0));
+			item.Set("severity", 1);
+			item.Set("source", "mrk");
+			item.Set("message", diagnostic.Message);
+			diagnostics.Push(mrks move(item));
+		}
+
+		JsonValue params = JsonValue::MakeObject();
+		params.Set("uri", doc.Uri);
+		params.Set("version", (double)doc.Version);
+		params.Set("diagnostics", mrks move(diagnostics));
+
+		JsonValue notification = MakeMessage();
+		notification.Set("method", "textDocument/publishDiagnostics");
+		notification.Set("params", mrks move(params));
+		Send(notification);
+	}
+
+	bool LanguageServer::ParsePending() {
+		for (auto& entry : m_Documents) {
+			if (!entry.second.Dirty)
+				continue;
+
+			//a waiting request goes first, its document is parsed on demand
+			{
+				mrks lock_guard<mrks mutex> lock(m_Inbox->Mutex);
+				if (!m_Inbox->Queue.empty())
+					return false;
+			}
+
+			Parse(entry.second);
+		}
+
+		return true;
+	}
+
+	void LanguageServer::ApplyChange(Document& doc, const JsonValue& change) {
+		const mrks string& text = change.Get("text").AsString();
+		if (!change.Has("range")) {
+			doc.Text = text;
+			doc.Lines.assign(1, 0);
+			for (size_t i = 0; i < text.size(); i++)
+				if (text[i] == '\n')
+					doc.Lines.push_back(i + 1);
+
+			return;
+		}
+
+		size_t start = ToOffset(doc, change.Get("range").Get("start"));
+		size_t end = ToOffset(doc, change.Get("range").Get("end"));
+		if (end < start)
+			mrks swap(start, end);
+
+		doc.Text.replace(start, end - start, text);
+
+		//lines inside the replaced span go, the ones after it move
+		auto from = mrks upper_bound(doc.Lines.begin(), doc.Lines.end(), start);
+		auto to = mrks upper_bound(from, doc.Lines.end(), end);
+		for (auto line = to; line != doc.Lines.end(); line++)
+			*line = *line + text.size() - (end - start);
+
+		mrks vector<size_t> inserted;
+		for (size_t i = 0; i < text.size(); i++)
+			if (text[i] == '\n')
+				inserted.push_back(start + i + 1);
+
+		size_t at = from - doc.Lines.begin();
+		doc.Lines.erase(from, to);
+		doc.Lines.insert(doc.Lines.begin() + at, inserted.begin(), inserted.end());
+	}
+
+	LanguageServer::Document* LanguageServer::FindDocument(const JsonValue& params) {
+		auto doc = m_Documents.find(params.Get("textDocument").Get("uri").AsString());
+		return doc == m_Documents.end() ? 0 : &doc->second;
+	}
+
+	size_t LanguageServer::ToOffset(const Document& doc, const JsonValue& position) const {
+		long long line = position.Get("line").AsInt();
+		if (line < 0)
+			return 0;
+		if ((size_t)line >= doc.Lines.size())
+			return doc.Text.size();
+
+		size_t pos = doc.Lines[line];
+		size_t end = (size_t)line + 1 < doc.Lines.size() ? doc.Lines[line + 1] - 1 : doc.Text.size();
+		long long character = position.Get("character").AsInt();
+		for (long long count = 0; pos < end && count < character;) {
+			size_t units;
+			pos += GetSequence(doc.Text[pos], units);
+			count += units;
+		}
+
+		return mrks min(pos, end);
+	}
+
+	JsonValue LanguageServer::ToPosition(const Document& doc, size_t offset) const {
+		offset = mrks min(offset, doc.Text.size());
+		size_t line = mrks upper_bound(doc.Lines.begin(), doc.Lines.end(), offset) - doc.Lines.begin() - 1;
+
+		size_t character = 0;
+		for (size_t pos = doc.Lines[line]; pos < offset;) {
+			size_t units;
+			pos += GetSequence(doc.Text[pos], units);
+			character += units;
+		}
+
+		JsonValue position = JsonValue::MakeObject();
+		position.Set("line", (unsigned long long)line);
+		position.Set("character", (unsigned long long)character);
+		return position;
+	}
+
+	JsonValue LanguageServer::ToRange(const Document& doc, size_t offset, size_t length) const {
+		JsonValue range = JsonValue::MakeObject();
+		range.Set("start", ToPosition(doc, offset));
+		range.Set("end", ToPosition(doc, offset + length));
+		return range;
+	}
+
+	JsonValue LanguageServer::GetSymbols(const Document& doc) const {
+		mrks vector<mrks vector<int>> children(doc.Declarations.size() + 1);
+		for (size_t i = 0; i < doc.Declarations.size(); i++)
+			children[doc.Declarations[i].Parent + 1].push_back((int)i);
+
+		mrks function<JsonValue(int)> list = [&](int parent) {
+			JsonValue symbols = JsonValue::MakeArray();
+			for (int index : children[parent + 1]) {
+				const Declaration& decl = doc.Declarations[index];
+				JsonValue symbol = JsonValue::MakeObject();
+				symbol.Set("name", decl.Name);
+				if (!decl.Detail.empty())
+					symbol.Set("detail", decl.Detail);
+				symbol.Set("kind", decl.Kind);
+				symbol.Set("range", ToRange(doc, decl.Offset, decl.End - decl.Offset));
+				symbol.Set("selectionRange", ToRange(doc, decl.Offset, decl.Length));
+				if (!children[index + 1].empty())
+					symbol.Set("children", list(index));
+				symbols.Push(mrks move(symbol));
+			}
+
+			return symbols;
+		};
+
+		return list(-1);
+	}
+
+	JsonValue LanguageServer::GetDefinition(Document& doc, size_t offset) {
+		const mrks string& text = doc.Text;
+		size_t begin = mrks min(offset, text.size()), end = begin;
+		while (begin > 0 && IsNameCharacter(text[begin - 1]))
+			begin--;
+		while (end < text.size() && IsNameCharacter(text[end]))
+			end++;
+
+		if (begin == end)
+			return JsonValue();
+
+		mrks string name = text.substr(begin, end - begin);
+
+		//Class.member
+		mrks string qualifier;
+		if (begin > 0 && text[begin - 1] == '.') {
+			size_t start = begin - 1;
+			while (start > 0 && IsNameCharacter(text[start - 1]))
+				start--;
+
+			qualifier = text.substr(start, begin - 1 - start);
+		}
+
+		auto find = [](const Document& in, int parent, const mrks string& name) {
+			for (size_t i = 0; i < in.Declarations.size(); i++) {
+				const Declaration& decl = in.Declarations[i];
+				if (decl.Parent == parent && decl.Kind != MRK_LSP_CONSTRUCTOR && decl.Name == name)
+					return (int)i;
+			}
+
+			return -1;
+		};
+
+		auto location = [this](const Document& in, int index) {
+			JsonValue result = JsonValue::MakeObject();
+			result.Set("uri", in.Uri);
+			result.Set("range", ToRange(in, in.Declarations[index].Offset, in.Declarations[index].Length));
+			return result;
+		};
+
+		//this document first, then every other open one
+		mrks vector<Document*> docs{ &doc };
+		for (auto& entry : m_Documents) {
+			if (&entry.second == &doc)
+				continue;
+
+			if (entry.second.Dirty)
+				Parse(entry.second);
+			docs.push_back(&entry.second);
+		}
+
+		if (!qualifier.empty()) {
+			for (Document* in : docs)
+				for (size_t i = 0; i < in->Declarations.size(); i++)
+					if (in->Declarations[i].Kind == MRK_LSP_CLASS && in->Declarations[i].Name == qualifier) {
+						int member = find(*in, (int)i, name);
+						if (member >= 0)
+							return location(*in, member);
+					}
+
+			return JsonValue();
+		}
+
+		//innermost class or method around the cursor, parents come first
+		int scope = -1;
+		for (size_t i = 0; i < doc.Declarations.size(); i++) {
+			const Declaration& decl = doc.Declarations[i];
+			if (decl.Kind != MRK_LSP_FIELD && decl.Kind != MRK_LSP_VARIABLE && decl.Offset <= offset && offset < decl.End)
+				scope = (int)i;
+		}
+
+		for (;; scope = doc.Declarations[scope].Parent) {
+			int found = find(doc, scope, name);
+			if (found >= 0)
+				return location(doc, found);
+			if (scope < 0)
+				break;
+		}
+
+		for (size_t i = 1; i < docs.size(); i++) {
+			int found = find(*docs[i], -1, name);
+			if (found >= 0)
+				return location(*docs[i], found);
+		}
+
+		return JsonValue();
+	}
+
+	mrks vector<LspMethodStats> LanguageServer::GetStats() const {
+		mrks map<mrks string, LspMethodStats> stats;
+		for (auto& entry : m_Latencies) {
+			const mrks vector<double>& ms = entry.second;
+			stats[entry.first] = LspMethodStats{ entry.first, ms.size(), 0, Percentile(ms, 50), Percentile(ms, 99), *mrks max_element(ms.begin(), ms.end()) };
+		}
+
+		for (auto& entry : m_Cancelled) {
+			LspMethodStats& method = stats[entry.first];
+			method.Method = entry.first;
+			method.Cancelled = entry.second;
+		}
+
+		mrks vector<LspMethodStats> result;
+		for (auto& entry : stats)
+			result.push_back(entry.second);
+		return result;
+	}
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <istream>
+#include <ostream>
+
+#include "Common.h"
+#include "Json.h"
+
+namespace MRK {
+	struct LspMethodStats {
+		mrks string Method;
+		size_t Count;
+		size_t Cancelled;
+		double P50; //ms from arrival to response, queueing included
+		double P99;
+		double Max;
+	};
+
+	//Language Server Protocol over a byte stream, JSON-RPC messages framed by Content-Length
+	//Edits are applied as they arrive, a document is parsed again only when a request needs it
+	//or nothing is queued, so a burst of keystrokes costs one parse. A reader thread takes
+	//$/cancelRequest out of band, a cancelled request still queued is never served
+	class LanguageServer {
+	private:
+		struct Declaration {
+			mrks string Name;
+			mrks string Detail; //type
+			int Kind; //LSP SymbolKind
+			mrkpos Offset; //name
+			mrkpos Length;
+			mrkpos End; //after the block, the end of the name without one
+			int Parent; //-1 at the top level
+		};
+
+		struct Diagnostic {
+			mrkpos Offset;
+			mrks string Message;
+		};
+
+		//text as edited by the client and the index of its last parse
+		struct Document {
+			mrks string Uri;
+			mrks string Text;
+			long long Version;
+			mrks vector<size_t> Lines; //line starts
+			bool Dirty; //edited since the last parse
+			mrks vector<Declaration> Declarations; //parents first
+			mrks vector<Diagnostic> Diagnostics;
+		};
+
+		struct Inbox;
+
+		mrks shared_ptr<Inbox> m_Inbox;
+		mrks ostream* m_Out;
+		mrks map<mrks string, Document> m_Documents;
+		mrks map<mrks string, mrks vector<double>> m_Latencies;
+		mrks map<mrks string, size_t> m_Cancelled;
+		size_t m_Parses;
+		size_t m_Edits;
+		bool m_ShutdownRequested;
+		bool m_Exit;
+
+		void Handle(const JsonValue& message, mrks chrono::steady_clock::time_point received);
+		JsonValue Serve(const mrks string& method, const JsonValue& params, bool& found);
+		void Send(const JsonValue& message);
+		void Parse(Document& doc);
+		bool ParsePending(); //false when a message arrived before every document was parsed
+		void ApplyChange(Document& doc, const JsonValue& change);
+		Document* FindDocument(const JsonValue& params);
+		size_t ToOffset(const Document& doc, const JsonValue& position) const;
+		JsonValue ToPosition(const Document& doc, size_t offset) const;
+		JsonValue ToRange(const Document& doc, size_t offset, size_t length) const;
+		JsonValue GetSymbols(const Document& doc) const;
+		JsonValue GetDefinition(Document& doc, size_t offset);
+
+	public:
+		LanguageServer();
+
+		//until exit or the end of the input, 0 after a shutdown request
+		int Run(mrks istream& in, mrks ostream& out);
+
+		mrks vector<LspMethodStats> GetStats() const;
+		size_t GetParseCount() const { return m_Parses; }
+		size_t GetEditCount() const { return m_Edits; }
+	};
+}
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Manifest.h"
+#include "Emitter.h"
+#include "Expression.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+
+namespace MRK {
+	namespace {
+		//64-bit FNV-1a, strings are length prefixed so field boundaries are part of the hash
+		struct Hasher {
+			unsigned long long Value = 0xcbf29ce484222325ull;
+
+			void Add(const void* data, size_t len) {
+				const unsigned char* bytes = (const unsigned char*)data;
+				for (size_t i = 0; i < len; i++) {
+					Value ^= bytes[i];
+					Value *= 0x100000001b3ull;
+				}
+			}
+
+			void Add(unsigned long long value) {
+				unsigned char bytes[8];
+				for (int i = 0; i < 8; i++)
+					bytes[i] = (unsigned char)(value >> (i * 8));
+				Add(bytes, 8);
+			}
+
+			void Add(const char* str, size_t len) {
+				Add((unsigned long long)len);
+				Add((const void*)str, len);
+			}
+
+			void Add(const mrks string& str) {
+				Add(str.data(), str.size());
+			}
+		};
+
+		void HashType(Hasher& hasher, const ModelType& type) {
+			hasher.Add((unsigned long long)type.Builtin);
+			hasher.Add(type.Name);
+		}
+
+		void HashForeign(Hasher& hasher, const mrks vector<ModelForeignBlock>& blocks) {
+			hasher.Add((unsigned long long)blocks.size());
+			for (const ModelForeignBlock& block : blocks) {
+				hasher.Add((unsigned long long)block.Target);
+				hasher.Add(block.Data, block.Length);
+			}
+		}
+
+		//pre-order with an explicit stack, bodies can nest deeper than the C stack allows
+		void HashExpression(Hasher& hasher, const ExprArena& arena, mrku32 root, mrks vector<mrku32>& stack) {
+			stack.assign(1, root);
+			while (!stack.empty()) {
+				mrku32 index = stack.back();
+				stack.pop_back();
+
+				const ExprNode& node = arena.Get(index);
+				unsigned long long shape = (unsigned long long)node.Kind | (unsigned long long)node.Op << 8 | (unsigned long long)node.Count << 16
+					| (unsigned long long)(node.Left != MRK_EXPR_NONE) << 32 | (unsigned long long)(node.Right != MRK_EXPR_NONE) << 33
+					| (unsigned long long)(node.Next != MRK_EXPR_NONE) << 34;
+				hasher.Add(shape);
+
+				switch (node.Kind) {
+
+				case ExprKind::Int:
+				case ExprKind::UInt:
+				case ExprKind::Bool:
+					hasher.Add(node.UInt);
+					break;
+
+				case ExprKind::String:
+				case ExprKind::Name:
+				case ExprKind::Member:
+					hasher.Add(node.Text, strlen(node.Text));
+					break;
+
+				default:
+					break;
+
+				}
+
+				for (mrku32 child : { node.Next, node.Right, node.Left })
+					if (child != MRK_EXPR_NONE)
+						stack.push_back(child);
+			}
+		}
+
+		void HashVar(Hasher& hasher, const ModelModule& module, const ModelVar& var, mrks vector<mrku32>& stack) {
+			hasher.Add(var.Name);
+			HashType(hasher, var.Type);
+
+			//a runtime default is emitted as its expression
+			const ModelConstant& constant = var.Constant;
+			hasher.Add((unsigned long long)constant.State);
+			if (constant.State == ConstantState::Runtime)
+				HashExpression(hasher, *module.Expressions, var.Default, stack);
+			if (constant.State != ConstantState::Folded)
+				return;
+
+			hasher.Add((unsigned long long)constant.Type);
+			if (constant.Type == BuiltinType::String)
+				hasher.Add(constant.String);
+			else if (constant.Type == BuiltinType::Bool)
+				hasher.Add((unsigned long long)constant.Bool);
+			else
+				hasher.Add(constant.UInt); //shares storage with Int and Float
+		}
+
+		void HashClass(Hasher& hasher, const ModelModule& module, const ModelClass& _class, mrks vector<mrku32>& stack) {
+			hasher.Add(_class.Name);
+
+			hasher.Add((unsigned long long)_class.Fields.size());
+			for (const ModelVar& field : _class.Fields)
+				HashVar(hasher, module, field, stack);
+
+			hasher.Add((unsigned long long)_class.Methods.size());
+			for (const ModelMethod& method : _class.Methods) {
+				hasher.Add(method.Name);
+				HashType(hasher, method.ReturnType);
+				hasher.Add((unsigned long long)method.IsCtor);
+
+				hasher.Add((unsigned long long)method.Params.size());
+				for (const ModelVar& param : method.Params)
+					HashVar(hasher, module, param, stack);
+
+				hasher.Add((unsigned long long)method.Locals.size());
+				for (const ModelVar& local : method.Locals)
+					HashVar(hasher, module, local, stack);
+
+				HashForeign(hasher, method.ForeignBlocks);
+
+				hasher.Add((unsigned long long)method.Body.size());
+				for (mrku32 statement : method.Body)
+					HashExpression(hasher, *module.Expressions, statement, stack);
+			}
+
+			HashForeign(hasher, _class.ForeignBlocks);
+
+			hasher.Add((unsigned long long)_class.Nested.size());
+			for (int nested : _class.Nested)
+				HashClass(hasher, module, module.Classes[nested], stack);
+		}
+	}
+
+	unsigned long long HashRoot(const ModelModule& module, const ModelClass& root) {
+		Hasher hasher;
+		hasher.Add(mrks string(MRK_VERSION));
+		hasher.Add(module.Filename);
+
+		hasher.Add((unsigned long long)root.Dependencies.size());
+		for (const mrks string& dependency : root.Dependencies)
+			hasher.Add(dependency);
+		hasher.Add((unsigned long long)root.BodyDependencies.size());
+		for (const mrks string& dependency : root.BodyDependencies)
+			hasher.Add(dependency);
+		hasher.Add((unsigned long long)root.BuiltinMask);
+
+		mrks vector<mrku32> stack;
+		HashClass(hasher, module, root, stack);
+		return hasher.Value;
+	}
+
+	mrks string EmitManifest::GetKey(const ModelModule& module, const ModelClass& root) {
+		return module.Filename + ':' + root.Name;
+	}
+
+	bool EmitManifest::Load(const mrks string& dir, EmitTarget target) {
+		Clear();
+
+		mrks ifstream stream(mrks filesystem::path(dir) / MRK_MANIFEST_NAME, mrks ios::binary);
+		mrks string line;
+		if (!stream || !mrks getline(stream, line))
+			return false;
+
+		//another format, version or target invalidates every entry
+		if (line != "mrk-manifest " + mrks to_string(MRK_MANIFEST_FORMAT) + ' ' + MRK_VERSION + ' ' + GetTargetName(target))
+			return false;
+
+		//<hash> <key>\t<file>\t<file>...
+		while (mrks getline(stream, line)) {
+			size_t space = line.find(' ');
+			if (space != 16)
+				continue;
+
+			ManifestEntry entry{ mrks strtoull(line.substr(0, 16).c_str(), 0, 16), {} };
+			size_t tab = line.find('\t', space);
+			mrks string key = line.substr(space + 1, tab == mrks string::npos ? mrks string::npos : tab - space - 1);
+
+			while (tab != mrks string::npos) {
+				size_t next = line.find('\t', tab + 1);
+				entry.Files.push_back(line.substr(tab + 1, next == mrks string::npos ? mrks string::npos : next - tab - 1));
+				tab = next;
+			}
+
+			m_Entries[key] = mrks move(entry);
+		}
+
+		//one listing instead of a stat per file, the names are all FindCurrent needs
+		mrks error_code ec;
+		for (mrks filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+			m_Present.insert(it->path().filename().string());
+
+		return true;
+	}
+
+	bool EmitManifest::Save(const mrks string& dir, EmitTarget target) const {
+		//sorted, the manifest is as reproducible as the output
+		mrks vector<const mrks pair<const mrks string, ManifestEntry>*> entries;
+		for (const auto& entry : m_Entries)
+			entries.push_back(&entry);
+
+		mrks sort(entries.begin(), entries.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+
+		mrks string text = "mrk-manifest " + mrks to_string(MRK_MANIFEST_FORMAT) + ' ' + MRK_VERSION + ' ' + GetTargetName(target) + '\n';
+		for (const auto* entry : entries) {
+			char hash[24];
+			snprintf(hash, sizeof(hash), "%016llx", entry->second.Hash);
+			text += mrks string(hash) + ' ' + entry->first;
+			for (const mrks string& file : entry->second.Files)
+				text += '\t' + file;
+			text += '\n';
+		}
+
+		//replaced in one step, an interrupted save leaves the previous manifest
+		mrks filesystem::path path = mrks filesystem::path(dir) / MRK_MANIFEST_NAME;
+		mrks filesystem::path temp = path;
+		temp += ".tmp";
+		{
+			mrks ofstream stream(temp, mrks ios::binary | mrks ios::trunc);
+			if (!stream.write(text.data(), text.size()))
+				return false;
+		}
+
+		mrks error_code ec;
+		mrks filesystem::rename(temp, path, ec);
+		return !ec;
+	}
+
+	const ManifestEntry* EmitManifest::FindCurrent(const mrks string& key, unsigned long long hash) const {
+		auto it = m_Entries.find(key);
+		if (it == m_Entries.end() || it->second.Hash != hash)
+			return 0;
+
+		for (const mrks string& file : it->second.Files)
+			if (!m_Present.count(file))
+				return 0;
+
+		return &it->second;
+	}
+}
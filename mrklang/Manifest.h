@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Common.h"
+#include "Model.h"
+
+#define MRK_MANIFEST_NAME ".mrkmanifest"
+#define MRK_MANIFEST_FORMAT 1
+
+namespace MRK {
+	//stable hash of everything the output of a top-level class depends on: its subtree with names,
+	//types as written, folded constants, foreign blocks and bodies, its dependencies, the source
+	//name and MRK_VERSION. IDs assigned at run time are left out
+	unsigned long long HashRoot(const ModelModule& module, const ModelClass& root);
+
+	struct ManifestEntry {
+		unsigned long long Hash;
+		mrks vector<mrks string> Files; //names inside the output directory
+	};
+
+	//per output directory record of the emitted roots, stored as text in MRK_MANIFEST_NAME
+	class EmitManifest {
+	private:
+		mrks unordered_map<mrks string, ManifestEntry> m_Entries;
+		mrks unordered_set<mrks string> m_Present; //names in the directory when loaded
+
+	public:
+		static mrks string GetKey(const ModelModule& module, const ModelClass& root);
+
+		//false and empty when missing, unreadable, or written by another version or target
+		bool Load(const mrks string& dir, EmitTarget target);
+		bool Save(const mrks string& dir, EmitTarget target) const;
+
+		//the entry when the hash matches and every file was there when loaded
+		const ManifestEntry* FindCurrent(const mrks string& key, unsigned long long hash) const;
+		void Set(const mrks string& key, ManifestEntry entry) { m_Entries[key] = mrks move(entry); }
+		void Clear() { m_Entries.clear(); m_Present.clear(); }
+		size_t GetCount() const { return m_Entries.size(); }
+	};
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Memory.h"
+#include "Parser.h"
+
+#include <unordered_set>
+#include <string_view>
+#include <cstring>
+#include <iomanip>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>
+#endif
+
+namespace MRK {
+	namespace {
+		template<typename T>
+		size_t VectorBytes(const mrks vector<T>& vec) {
+			return vec.capacity() * sizeof(T);
+		}
+
+		size_t VarHeapBytes(const mrks vector<ParseVar>& vars) {
+			size_t bytes = 0;
+			for (const ParseVar& var : vars)
+				bytes += GetHeapBytes(var.Name) + GetHeapBytes(var.Typename);
+
+			return bytes;
+		}
+
+		void PrintRow(mrks ostream& stream, const char* name, size_t bytes) {
+			stream << "    " << mrks left << mrks setw(38) << name << mrks right << mrks setw(12) << bytes << " B\n";
+		}
+	}
+
+	size_t SourceMemory::GetTokenTotal() const {
+		return TokenCapacityBytes + IdentifierBytes;
+	}
+
+	size_t SourceMemory::GetModelTotal() const {
+		return IncludeBytes + ScopeBytes + ClassBytes + MethodBytes + FieldBytes + ParamBytes + VarBytes + NameBytes + ExpressionBytes;
+	}
+
+	MemoryReport::MemoryReport() : LogBytes(0), ErrorBytes(0) {
+	}
+
+	void MemoryReport::Print(mrks ostream& stream) const {
+		size_t tokens = 0;
+		size_t model = 0;
+
+		for (const SourceMemory& src : Sources) {
+			stream << "  " << src.Filename << " (" << src.TokenCount << " tokens)\n";
+			PrintRow(stream, "tokens (size)", src.TokenBytes);
+			PrintRow(stream, "tokens (capacity)", src.TokenCapacityBytes);
+			PrintRow(stream, "identifier strings", src.IdentifierBytes);
+			PrintRow(stream, "  of which duplicates", src.IdentifierDuplicateBytes);
+			PrintRow(stream, "includes", src.IncludeBytes);
+			PrintRow(stream, "structural scopes", src.ScopeBytes);
+			PrintRow(stream, "classes", src.ClassBytes);
+			PrintRow(stream, "methods", src.MethodBytes);
+			PrintRow(stream, "fields", src.FieldBytes);
+			PrintRow(stream, "params", src.ParamBytes);
+			PrintRow(stream, "vars", src.VarBytes);
+			PrintRow(stream, "names", src.NameBytes);
+			PrintRow(stream, "expressions", src.ExpressionBytes);
+
+			for (mrku32 i = 0; i < MRK_PARSE_PHASE_COUNT; i++) {
+				mrks string name = mrks string("peak rss after ") + GetPhaseName((ParsePhase)i);
+				PrintRow(stream, name.c_str(), src.PeakRSS[i]);
+			}
+
+			tokens += src.GetTokenTotal();
+			model += src.GetModelTotal();
+		}
+
+		stream << "  total\n";
+		PrintRow(stream, "tokens", tokens);
+		PrintRow(stream, "parse model", model);
+		PrintRow(stream, "logs", LogBytes);
+		PrintRow(stream, "errors", ErrorBytes);
+	}
+
+	size_t GetPeakRSS() {
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.PeakWorkingSetSize;
+		return 0;
+#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#if defined(__APPLE__)
+		return (size_t)usage.ru_maxrss;
+#else
+		return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+	}
+
+	size_t GetHeapBytes(const mrks string& str) {
+		const char* data = str.data();
+		const char* self = (const char*)&str;
+
+		//small strings live inside the object itself
+		if (data >= self && data < self + sizeof(str))
+			return 0;
+
+		return str.capacity() + 1;
+	}
+
+	void AccountTokens(const TokenStore& tokens, SourceMemory& memory) {
+		memory.TokenCount = tokens.GetCount();
+		memory.TokenBytes = tokens.GetCount() * sizeof(Token);
+		memory.TokenCapacityBytes = tokens.GetReservedBytes();
+		memory.IdentifierBytes = 0;
+		memory.IdentifierDuplicateBytes = 0;
+
+		mrks unordered_set<mrks string_view> seen;
+		for (mrkpos i = 0; i < tokens.GetCount(); i++) {
+			const Token& token = tokens[i];
+			const char* value = 0;
+
+			switch (token.ContextualKind) {
+
+			case TOKEN_CONTEXTUAL_KIND_IDENTIFIER:
+				value = token.Value.IdentifierValue;
+				break;
+
+			case TOKEN_CONTEXTUAL_KIND_STRING:
+				value = token.Value.StringValue;
+				break;
+
+			default:
+				break;
+
+			}
+
+			if (!value)
+				continue;
+
+			size_t len = strlen(value);
+			memory.IdentifierBytes += len + 1;
+			if (!seen.insert(mrks string_view(value, len)).second)
+				memory.IdentifierDuplicateBytes += len + 1;
+		}
+	}
+
+	void AccountParseContext(const SourceParseContext& context, SourceMemory& memory) {
+		memory.IncludeBytes = VectorBytes(context.Includes);
+		for (const mrks string& include : context.Includes)
+			memory.IncludeBytes += GetHeapBytes(include);
+
+		memory.ScopeBytes = VectorBytes(context.StructuralScopes);
+		for (const StructuralScope& scope : context.StructuralScopes) {
+			switch (scope.Owner) {
+
+			case MRK_SCOPE_OWNER_CLASS:
+				memory.ScopeBytes += sizeof(mrkidx);
+				break;
+
+			case MRK_SCOPE_OWNER_METHOD:
+				memory.ScopeBytes += 2 * sizeof(mrkidx);
+				break;
+
+			}
+		}
+
+		memory.ClassBytes = VectorBytes(context.ParseClasses);
+		memory.MethodBytes = 0;
+		memory.FieldBytes = 0;
+		memory.ParamBytes = 0;
+		memory.VarBytes = 0;
+		memory.NameBytes = 0;
+		memory.ExpressionBytes = context.Expressions.GetBytes();
+
+		for (const ParseClass& _class : context.ParseClasses) {
+			memory.NameBytes += GetHeapBytes(_class.Name);
+			memory.MethodBytes += VectorBytes(_class.Methods);
+			memory.FieldBytes += VectorBytes(_class.Fields);
+			memory.NameBytes += VarHeapBytes(_class.Fields);
+
+			for (const ParseMethod& method : _class.Methods) {
+				memory.NameBytes += GetHeapBytes(method.Name) + GetHeapBytes(method.Typename);
+				memory.ParamBytes += VectorBytes(method.Params);
+				memory.VarBytes += VectorBytes(method.Vars);
+				memory.NameBytes += VarHeapBytes(method.Vars);
+				memory.ExpressionBytes += VectorBytes(method.Body);
+
+				for (const ParseParam& param : method.Params)
+					memory.NameBytes += GetHeapBytes(param.Name) + GetHeapBytes(param.Typename);
+			}
+		}
+	}
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "Common.h"
+#include "Phase.h"
+
+namespace MRK {
+	class TokenStore;
+	struct SourceParseContext;
+
+	//retained bytes of one parsed source, as requested from the allocator
+	//(allocator headers and fragmentation are not included)
+	struct SourceMemory {
+		mrks string Filename;
+
+		size_t TokenCount;
+		size_t TokenBytes; //size * sizeof(Token)
+		size_t TokenCapacityBytes; //allocated chunks
+		size_t IdentifierBytes; //identifier/string values owned by the tokens
+		size_t IdentifierDuplicateBytes; //part of IdentifierBytes repeating an earlier value
+
+		size_t IncludeBytes;
+		size_t ScopeBytes; //StructuralScopes storage + owner data
+		size_t ClassBytes;
+		size_t MethodBytes;
+		size_t FieldBytes;
+		size_t ParamBytes;
+		size_t VarBytes;
+		size_t NameBytes; //heap owned names and typenames of the parse model
+		size_t ExpressionBytes; //expression arena and statement lists
+
+		size_t PeakRSS[MRK_PARSE_PHASE_COUNT]; //process peak after each phase
+
+		size_t GetTokenTotal() const;
+		size_t GetModelTotal() const;
+	};
+
+	struct MemoryReport {
+		mrks vector<SourceMemory> Sources;
+		size_t LogBytes;
+		size_t ErrorBytes;
+
+		MemoryReport();
+
+		void Print(mrks ostream& stream) const;
+	};
+
+	//process peak resident set size in bytes, 0 if the platform can't tell
+	size_t GetPeakRSS();
+
+	//heap bytes owned by a string, 0 while it fits the small buffer
+	size_t GetHeapBytes(const mrks string& str);
+
+	void AccountTokens(const TokenStore& tokens, SourceMemory& memory);
+	void AccountParseContext(const SourceParseContext& context, SourceMemory& memory);
+}
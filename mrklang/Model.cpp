@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Model.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+namespace MRK {
+	namespace {
+		const char* g_BuiltinNames[MRK_BUILTIN_TYPE_COUNT] = {
+			"", "void", "bool", "byte", "char", "short", "ushort", "int", "uint", "long", "ulong", "float", "double", "string"
+		};
+
+		ModelType ResolveType(const mrks string& name) {
+			BuiltinType builtin = GetBuiltinType(name);
+			return ModelType{ builtin, name, (mrku32)builtin };
+		}
+
+		void ResolveForeign(const Source& src, const mrks vector<ParseForeignBlock>& blocks, mrks vector<ModelForeignBlock>& out) {
+			for (const ParseForeignBlock& block : blocks) {
+				EmitTarget target = block.Language == KeywordType::CS ? EmitTarget::Cs : (block.Language == KeywordType::JAVA ? EmitTarget::Java : EmitTarget::Cpp);
+				out.push_back(ModelForeignBlock{ target, src.Code.data() + block.Offset, block.Length });
+			}
+		}
+
+		ModelVar ResolveVar(const mrks string& name, mrkpos offset, const mrks string& type, mrku32 _default = MRK_EXPR_NONE) {
+			ModelConstant constant{ _default != MRK_EXPR_NONE ? ConstantState::Pending : ConstantState::None, BuiltinType::None };
+			constant.Int = 0;
+			return ModelVar{ name, offset, ResolveType(type), _default, constant };
+		}
+
+		bool DeclaresType(const ModelModule& module, const ModelClass& root, const mrks string& name) {
+			if (root.Name == name)
+				return true;
+
+			for (int nested : root.Nested)
+				if (DeclaresType(module, module.Classes[nested], name))
+					return true;
+
+			return false;
+		}
+
+		void CollectDependencies(const ModelModule& module, const ModelClass& _class, ModelClass& root, mrks vector<mrku32>& stack) {
+			auto add = [&](const ModelType& type, mrks vector<mrks string>& list) {
+				root.BuiltinMask |= 1u << (mrku32)type.Builtin;
+				if (type.IsUser() && !type.Name.empty() && !DeclaresType(module, root, type.Name)
+					&& mrks find(list.begin(), list.end(), type.Name) == list.end())
+					list.push_back(type.Name);
+			};
+
+			//type names in a runtime expression, an explicit stack as bodies nest deeper than the C stack allows
+			auto addExpression = [&](mrks vector<mrks string>& list, const ModelMethod* method, mrku32 expression) {
+				stack.assign(1, expression);
+				while (!stack.empty()) {
+					const ExprNode& node = module.Expressions->Get(stack.back());
+					stack.pop_back();
+
+					if (node.Kind == ExprKind::String)
+						root.BuiltinMask |= 1u << (mrku32)BuiltinType::String;
+					else if (node.Kind == ExprKind::Name && !IsValueName(module, _class, method, node.Text) && GetBuiltinType(node.Text) == BuiltinType::None
+						&& !DeclaresType(module, root, node.Text) && mrks find(list.begin(), list.end(), node.Text) == list.end())
+						list.push_back(node.Text);
+
+					for (mrku32 child : { node.Next, node.Right, node.Left })
+						if (child != MRK_EXPR_NONE)
+							stack.push_back(child);
+				}
+			};
+
+			for (const ModelVar& field : _class.Fields) {
+				add(field.Type, root.Dependencies);
+				if (!field.IsConstant() && field.Default != MRK_EXPR_NONE)
+					addExpression(root.Dependencies, 0, field.Default);
+			}
+
+			for (const ModelMethod& method : _class.Methods) {
+				if (!method.IsCtor)
+					add(method.ReturnType, root.Dependencies);
+
+				for (const ModelVar& param : method.Params)
+					add(param.Type, root.Dependencies);
+
+				for (const ModelVar& local : method.Locals) {
+					add(local.Type, root.BodyDependencies);
+					if (!local.IsConstant() && local.Default != MRK_EXPR_NONE)
+						addExpression(root.BodyDependencies, &method, local.Default);
+				}
+
+				for (mrku32 statement : method.Body)
+					addExpression(root.BodyDependencies, &method, statement);
+			}
+
+			for (int nested : _class.Nested)
+				CollectDependencies(module, module.Classes[nested], root, stack);
+		}
+	}
+
+	BuiltinType GetBuiltinType(const mrks string& name) {
+		for (mrku32 i = 1; i < MRK_BUILTIN_TYPE_COUNT; i++)
+			if (name == g_BuiltinNames[i])
+				return (BuiltinType)i;
+
+		return BuiltinType::None;
+	}
+
+	bool IsValueName(const ModelModule& module, const ModelClass& _class, const ModelMethod* method, const mrks string& name) {
+		auto declares = [&name](const mrks vector<ModelVar>& vars) {
+			for (const ModelVar& var : vars)
+				if (var.Name == name)
+					return true;
+			return false;
+		};
+
+		if (method && (declares(method->Params) || declares(method->Locals)))
+			return true;
+
+		for (const ModelClass* scope = &_class; scope; scope = scope->Parent >= 0 ? &module.Classes[scope->Parent] : 0) {
+			if (declares(scope->Fields))
+				return true;
+
+			for (const ModelMethod& member : scope->Methods)
+				if (!member.IsCtor && member.Name == name)
+					return true;
+
+			for (int nested : scope->Nested)
+				if (module.Classes[nested].Name == name)
+					return false;
+		}
+
+		return false;
+	}
+
+	void UpdateDependencies(ModelModule& module) {
+		mrks vector<mrku32> stack;
+		for (int root : module.Roots) {
+			ModelClass& _class = module.Classes[root];
+			_class.Dependencies.clear();
+			_class.BodyDependencies.clear();
+			_class.BuiltinMask = 0;
+			CollectDependencies(module, _class, _class, stack);
+
+			//the source includes its own header
+			auto header = [&_class](const mrks string& name) { return MRK_VEC_CONTAIN(_class.Dependencies, name); };
+			_class.BodyDependencies.erase(mrks remove_if(_class.BodyDependencies.begin(), _class.BodyDependencies.end(), header), _class.BodyDependencies.end());
+		}
+	}
+
+	void ResolveModel(Parser& parser, Model& model) {
+		for (Source& src : parser.GetSources()) {
+			const SourceParseContext* context = parser.GetParseContext(&src);
+			if (!context)
+				continue;
+
+			TraceSpan span("Resolve", src.Filename);
+
+			model.Modules.push_back(ModelModule{ src.Filename, &src, context->Includes });
+			ModelModule& module = model.Modules.back();
+			module.Expressions = &context->Expressions;
+			module.Classes.reserve(context->ParseClasses.size());
+
+			for (const ParseClass& parseClass : context->ParseClasses) {
+				module.Classes.push_back(ModelClass{ parseClass.Name, parseClass.Offset, (int)parseClass.Index, (int)parseClass.ParentIndex, MRK_TYPE_UNRESOLVED });
+				ModelClass& _class = module.Classes.back();
+
+				for (const ParseVar& field : parseClass.Fields)
+					_class.Fields.push_back(ResolveVar(field.Name, field.Offset, field.Typename, field.Default));
+
+				for (const ParseMethod& parseMethod : parseClass.Methods) {
+					//ctors are parsed as 'cx' with no typename
+					bool ctor = parseMethod.Typename.empty();
+					_class.Methods.push_back(ModelMethod{ parseMethod.Name, parseMethod.Offset, ResolveType(ctor ? "void" : parseMethod.Typename), ctor });
+					ModelMethod& method = _class.Methods.back();
+
+					for (const ParseParam& param : parseMethod.Params)
+						method.Params.push_back(ResolveVar(param.Name, param.Offset, param.Typename));
+
+					for (const ParseVar& local : parseMethod.Vars)
+						method.Locals.push_back(ResolveVar(local.Name, local.Offset, local.Typename, local.Default));
+
+					ResolveForeign(src, parseMethod.ForeignBlocks, method.ForeignBlocks);
+					method.Body = parseMethod.Body;
+				}
+
+				ResolveForeign(src, parseClass.ForeignBlocks, _class.ForeignBlocks);
+
+				if (parseClass.ParentIndex >= 0)
+					module.Classes[parseClass.ParentIndex].Nested.push_back((int)parseClass.Index);
+				else
+					module.Roots.push_back((int)parseClass.Index);
+			}
+
+			UpdateDependencies(module);
+
+			span.Arg("classes", module.Classes.size());
+		}
+	}
+}
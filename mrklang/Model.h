@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common.h"
+#include "Parser.h"
+
+namespace MRK {
+	enum class BuiltinType : mrku32 {
+		None, //user type
+		Void,
+		Bool,
+		Byte,
+		Char,
+		Short,
+		UShort,
+		Int,
+		UInt,
+		Long,
+		ULong,
+		Float,
+		Double,
+		String
+	};
+
+	#define MRK_BUILTIN_TYPE_COUNT 14
+
+	//mirrors KeywordType::CPP/CS/JAVA
+	enum class EmitTarget : mrku32 {
+		Cpp,
+		Cs,
+		Java
+	};
+
+	#define MRK_EMIT_TARGET_COUNT 3
+
+	#define MRK_TYPE_UNRESOLVED 0
+
+	struct ModelType {
+		BuiltinType Builtin;
+		mrks string Name; //as written in the source
+		mrku32 TypeId; //builtins are their BuiltinType, user types are set by Semantic
+
+		bool IsUser() const { return Builtin == BuiltinType::None; }
+	};
+
+	enum class ConstantState : mrku32 {
+		None, //no default value
+		Pending,
+		Evaluating, //on the evaluation stack, a reference back to it is a cycle
+		Folded,
+		Failed,
+		Runtime //not a compile-time constant, initialized when the object is built or the method runs
+	};
+
+	//compile-time value of a var default, ULong lives in UInt, every other integer in Int
+	struct ModelConstant {
+		ConstantState State;
+		BuiltinType Type;
+
+		union {
+			long long Int;
+			unsigned long long UInt;
+			double Float;
+			bool Bool;
+		};
+
+		mrks string String;
+	};
+
+	struct ModelVar {
+		mrks string Name;
+		mrkpos Offset; //name in ModelModule::Origin, where its errors point
+		ModelType Type;
+		mrku32 Default; //root in ModelModule::Expressions, MRK_EXPR_NONE without a default block
+		ModelConstant Constant; //folded by Semantic
+
+		bool IsConstant() const { return Constant.State == ConstantState::Folded; }
+	};
+
+	//__cpp/__cs/__java body, points into the parser's sources
+	struct ModelForeignBlock {
+		EmitTarget Target;
+		const char* Data;
+		size_t Length;
+	};
+
+	struct ModelMethod {
+		mrks string Name;
+		mrkpos Offset; //the same
+		ModelType ReturnType;
+		bool IsCtor;
+
+		mrks vector<ModelVar> Params;
+		mrks vector<ModelVar> Locals;
+		mrks vector<ModelForeignBlock> ForeignBlocks;
+		mrks vector<mrku32> Body; //statement roots in ModelModule::Expressions
+
+		mrku32 Scope; //params and locals, set by Semantic
+	};
+
+	struct ModelClass {
+		mrks string Name;
+		mrkpos Offset; //the same
+		int Index;
+		int Parent; //-1 for top-level classes
+		mrku32 TypeId; //set by Semantic
+
+		mrks vector<int> Nested;
+		mrks vector<ModelVar> Fields;
+		mrks vector<ModelMethod> Methods;
+		mrks vector<ModelForeignBlock> ForeignBlocks;
+		mrku32 Scope; //nested types, fields and methods, set by Semantic
+
+		//top-level classes only, covers the whole subtree
+		mrks vector<mrks string> Dependencies; //user types declared outside the subtree
+		mrks vector<mrks string> BodyDependencies; //the same, named only by locals and method bodies
+		mrku32 BuiltinMask; //1 << BuiltinType
+	};
+
+	struct ModelModule {
+		mrks string Filename;
+		Source* Origin;
+		mrks vector<mrks string> Includes;
+		mrks vector<ModelClass> Classes; //declaration order, same indices as ParseClass
+		mrks vector<int> Roots;
+		const ExprArena* Expressions; //var defaults and method bodies, owned by the parser
+	};
+
+	//target-neutral form of a parse, resolved once and shared by every backend
+	//foreign blocks are not copied, the parser has to outlive the model
+	struct Model {
+		mrks vector<ModelModule> Modules;
+	};
+
+	BuiltinType GetBuiltinType(const mrks string& name);
+	void ResolveModel(Parser& parser, Model& model);
+
+	//whether a name in a body or default is a param, local, field or method, looked up like the
+	//bytecode compiler does; anything else names a type
+	bool IsValueName(const ModelModule& module, const ModelClass& _class, const ModelMethod* method, const mrks string& name);
+
+	//Dependencies and BuiltinMask of every root, again once defaults are folded or after classes or members were removed
+	void UpdateDependencies(ModelModule& module);
+}
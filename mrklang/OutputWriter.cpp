@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "OutputWriter.h"
+
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+namespace MRK {
+	namespace {
+		long long Read(int fd, char* data, size_t len) {
+			for (;;) {
+#ifdef _WIN32
+				long long got = _read(fd, data, (unsigned int)len);
+#else
+				long long got = read(fd, data, len);
+#endif
+				if (got >= 0 || errno != EINTR)
+					return got;
+			}
+		}
+	}
+
+	OutputWriter::OutputWriter(size_t bufferSize) : m_Buffer(bufferSize), m_Used(0), m_Fd(-1), m_Failed(false), m_BytesWritten(0),
+		m_SkipUnchanged(false), m_Changed(true), m_Offset(0), m_FilesChanged(0), m_FilesUnchanged(0) {
+	}
+
+	OutputWriter::~OutputWriter() {
+		Close();
+	}
+
+	bool OutputWriter::Open(const mrks string& path) {
+		Close();
+
+		m_Path = path;
+		m_Used = 0;
+		m_Failed = false;
+
+		//skipping unchanged output reads the old file first, it is only truncated on close
+#ifdef _WIN32
+		m_Fd = _open(path.c_str(), (m_SkipUnchanged ? _O_RDWR : _O_WRONLY | _O_TRUNC) | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+		m_Fd = open(path.c_str(), (m_SkipUnchanged ? O_RDWR : O_WRONLY | O_TRUNC) | O_CREAT | O_CLOEXEC, 0644);
+#endif
+
+		m_Changed = !m_SkipUnchanged;
+		m_Offset = 0;
+		m_Failed = m_Fd < 0;
+		return !m_Failed;
+	}
+
+	bool OutputWriter::Close() {
+		if (m_Fd < 0)
+			return !m_Failed;
+
+		Flush();
+
+		if (m_SkipUnchanged && !m_Failed) {
+			//an old file with more bytes differs too
+			char extra;
+			if (!m_Changed && Read(m_Fd, &extra, 1) > 0)
+				m_Changed = true;
+
+#ifdef _WIN32
+			if (m_Changed && _chsize_s(m_Fd, (long long)m_Offset) != 0)
+				m_Failed = true;
+#else
+			if (m_Changed && ftruncate(m_Fd, (off_t)m_Offset) != 0)
+				m_Failed = true;
+#endif
+		}
+
+		if (m_Changed)
+			m_FilesChanged++;
+		else
+			m_FilesUnchanged++;
+
+#ifdef _WIN32
+		if (_close(m_Fd) != 0)
+			m_Failed = true;
+#else
+		if (close(m_Fd) != 0)
+			m_Failed = true;
+#endif
+
+		m_Fd = -1;
+		return !m_Failed;
+	}
+
+	bool OutputWriter::Flush() {
+		if (m_Used && m_Fd >= 0 && !m_Failed)
+			WriteFully(m_Buffer.data(), m_Used);
+
+		m_Used = 0;
+		return !m_Failed;
+	}
+
+	size_t OutputWriter::Compare(const char* data, size_t len) {
+		//bytes of data equal to the old file from the current position on
+		if (m_Existing.empty())
+			m_Existing.resize(64 * 1024);
+
+		size_t matched = 0;
+		while (matched < len) {
+			size_t want = len - matched < m_Existing.size() ? len - matched : m_Existing.size();
+			long long got = Read(m_Fd, m_Existing.data(), want);
+			if (got <= 0)
+				break;
+
+			if (memcmp(m_Existing.data(), data + matched, (size_t)got) == 0) {
+				matched += (size_t)got;
+				continue;
+			}
+
+			size_t same = 0;
+			while (m_Existing[same] == data[matched + same])
+				same++;
+
+			matched += same;
+			break;
+		}
+
+		return matched;
+	}
+
+	bool OutputWriter::WriteFully(const char* data, size_t len) {
+		if (!m_Changed) {
+			size_t same = Compare(data, len);
+			data += same;
+			len -= same;
+			m_Offset += same;
+			m_BytesWritten += same;
+
+			if (!len)
+				return !m_Failed;
+
+			//first difference, everything from here on is written over the old bytes
+			m_Changed = true;
+#ifdef _WIN32
+			if (_lseeki64(m_Fd, (long long)m_Offset, SEEK_SET) < 0)
+				m_Failed = true;
+#else
+			if (lseek(m_Fd, (off_t)m_Offset, SEEK_SET) < 0)
+				m_Failed = true;
+#endif
+		}
+
+		while (len && !m_Failed) {
+#ifdef _WIN32
+			int written = _write(m_Fd, data, (unsigned int)(len > 0x40000000 ? 0x40000000 : len));
+#else
+			ssize_t written = write(m_Fd, data, len);
+#endif
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+
+				m_Failed = true;
+				break;
+			}
+
+			data += written;
+			len -= written;
+			m_Offset += written;
+			m_BytesWritten += written;
+		}
+
+		return !m_Failed;
+	}
+
+	bool OutputWriter::WriteTwo(const char* first, size_t firstLen, const char* second, size_t secondLen) {
+		if (!m_Changed)
+			return WriteFully(first, firstLen) && WriteFully(second, secondLen);
+
+#ifdef _WIN32
+		return WriteFully(first, firstLen) && WriteFully(second, secondLen);
+#else
+		while ((firstLen || secondLen) && !m_Failed) {
+			struct iovec vec[2] = {
+				{ (void*)first, firstLen },
+				{ (void*)second, secondLen }
+			};
+
+			ssize_t written = writev(m_Fd, vec, 2);
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+
+				m_Failed = true;
+				break;
+			}
+
+			m_BytesWritten += written;
+			m_Offset += written;
+
+			//partial writes, advance through both vectors
+			size_t fromFirst = (size_t)written < firstLen ? (size_t)written : firstLen;
+			first += fromFirst;
+			firstLen -= fromFirst;
+			written -= fromFirst;
+			second += written;
+			secondLen -= written;
+		}
+
+		return !m_Failed;
+#endif
+	}
+
+	void OutputWriter::Write(const char* data, size_t len) {
+		if (m_Fd < 0 || m_Failed)
+			return;
+
+		size_t free = m_Buffer.size() - m_Used;
+		if (len <= free) {
+			memcpy(m_Buffer.data() + m_Used, data, len);
+			m_Used += len;
+			return;
+		}
+
+		//doesn't fit, if it's small refill the buffer else send both in one call
+		if (len < m_Buffer.size() / 2) {
+			memcpy(m_Buffer.data() + m_Used, data, free);
+			m_Used += free;
+			Flush();
+			memcpy(m_Buffer.data(), data + free, len - free);
+			m_Used = len - free;
+			return;
+		}
+
+		WriteTwo(m_Buffer.data(), m_Used, data, len);
+		m_Used = 0;
+	}
+
+	void OutputWriter::Write(const char* str) {
+		Write(str, strlen(str));
+	}
+
+	void OutputWriter::Write(char c) {
+		if (m_Used == m_Buffer.size())
+			Flush();
+
+		if (m_Fd < 0 || m_Failed)
+			return;
+
+		m_Buffer[m_Used++] = c;
+	}
+
+	void OutputWriter::WriteIndent(mrku32 depth) {
+		for (mrku32 i = 0; i < depth; i++)
+			Write('\t');
+	}
+
+	OutputWriter& OutputWriter::operator<<(long long value) {
+		char buf[24];
+		char* end = buf + sizeof(buf);
+		char* p = end;
+		unsigned long long abs = value < 0 ? 0ull - (unsigned long long)value : (unsigned long long)value;
+
+		do {
+			*--p = (char)('0' + abs % 10);
+			abs /= 10;
+		} while (abs);
+
+		if (value < 0)
+			*--p = '-';
+
+		Write(p, end - p);
+		return *this;
+	}
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common.h"
+
+#define MRK_OUTPUT_BUFFER_SIZE (256 * 1024)
+
+namespace MRK {
+	//buffered file writer for generated code
+	//The buffer is kept between files, so one writer can stream a whole output tree
+	//without reallocating; writes larger than the free space go out with writev
+	//next to the pending bytes instead of being copied
+	//With SetSkipUnchanged the existing file is read back instead: nothing is written while the
+	//output matches it, from the first differing byte on it is overwritten and cut to length,
+	//so regenerating an identical file leaves it (and its mtime) untouched
+	class OutputWriter {
+	private:
+		mrks vector<char> m_Buffer;
+		size_t m_Used;
+		int m_Fd;
+		mrks string m_Path;
+		bool m_Failed;
+		unsigned long long m_BytesWritten;
+
+		//skip unchanged mode, m_Offset is the file offset of the buffer start
+		bool m_SkipUnchanged;
+		bool m_Changed;
+		unsigned long long m_Offset;
+		mrks vector<char> m_Existing;
+		size_t m_FilesChanged;
+		size_t m_FilesUnchanged;
+
+		bool WriteFully(const char* data, size_t len);
+		bool WriteTwo(const char* first, size_t firstLen, const char* second, size_t secondLen);
+		size_t Compare(const char* data, size_t len);
+
+	public:
+		OutputWriter(size_t bufferSize = MRK_OUTPUT_BUFFER_SIZE);
+		~OutputWriter();
+
+		OutputWriter(const OutputWriter&) = delete;
+		OutputWriter& operator=(const OutputWriter&) = delete;
+
+		bool Open(const mrks string& path);
+		bool Close();
+		bool Flush();
+
+		void Write(const char* data, size_t len);
+		void Write(const mrks string& str) { Write(str.data(), str.size()); }
+		void Write(const char* str);
+		void Write(char c);
+		void WriteIndent(mrku32 depth);
+
+		OutputWriter& operator<<(const mrks string& str) { Write(str); return *this; }
+		OutputWriter& operator<<(const char* str) { Write(str); return *this; }
+		OutputWriter& operator<<(char c) { Write(c); return *this; }
+		OutputWriter& operator<<(long long value);
+
+		void SetSkipUnchanged(bool skip) { m_SkipUnchanged = skip; }
+
+		bool HasFailed() const { return m_Failed; }
+		const mrks string& GetPath() const { return m_Path; }
+		unsigned long long GetBytesWritten() const { return m_BytesWritten; } //generated, including bytes that matched
+		size_t GetFilesChanged() const { return m_FilesChanged; }
+		size_t GetFilesUnchanged() const { return m_FilesUnchanged; }
+	};
+}
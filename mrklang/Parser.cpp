@@ -26,8 +26,26 @@
 
 #include "Parser.h"
 #include "ObservedWhile.h"
+#include "Trace.h"
+#include "Unicode.h"
+
+#include <algorithm>
 
 namespace MRK {
+	namespace {
+		bool IsChar(const Token& token, char c) {
+			return token.ContextualKind == TOKEN_CONTEXTUAL_KIND_CHAR && token.Value.CharValue == c;
+		}
+
+		//literals, groups and prefix operators, identifiers are told apart by the caller
+		bool IsExpressionStart(const Token& token) {
+			if (token.Kind == TOKEN_KIND_NUMBER || token.ContextualKind == TOKEN_CONTEXTUAL_KIND_STRING)
+				return true;
+
+			return IsChar(token, '(') || IsChar(token, '-') || IsChar(token, '+') || IsChar(token, '!') || IsChar(token, '~');
+		}
+	}
+
 	mrks vector<Keyword> Parser::ms_Keywords = {
 		Keyword(KeywordType::Include, "i"),
 		Keyword(KeywordType::Class, "c"),
@@ -42,28 +60,32 @@ namespace MRK {
 		Keyword(KeywordType::JAVA, "__java")
 	};
 
-	void Parser::InitializeTokenStream(mrks vector<Token> tokens) {
-		m_Tokens = tokens;
+	void Parser::InitializeTokenStream(TokenStore& tokens) {
+		//the lexer gets the previous source's storage back
+		m_Tokens.Swap(tokens);
 		m_TokenPos = 0;
 	}
 
 	Token* Parser::PeekNext() {
-		mrku32 next = m_TokenPos + 1;
-		return next >= m_Tokens.size() ? 0 : &m_Tokens[next];
+		//MRK_TOKEN_NONE + 1 wraps to the first token
+		mrkpos next = m_TokenPos + 1;
+		return next >= m_Tokens.GetCount() ? 0 : &m_Tokens[next];
 	}
 
 	Token* Parser::PeekPrevious() {
-		mrku32 previous = m_TokenPos - 1;
-		return previous < 0 ? 0 : &m_Tokens[previous];
+		if (m_TokenPos == MRK_TOKEN_NONE || m_TokenPos == 0 || m_TokenPos > m_Tokens.GetCount())
+			return 0;
+
+		return &m_Tokens[m_TokenPos - 1];
 	}
 
-	Token* Parser::Advance(int steps = 1) {
-		mrku32 advance = m_TokenPos + steps;
+	Token* Parser::Advance(mrkpos steps = 1) {
+		mrkpos advance = m_TokenPos + steps;
 
-		if (m_VerityState & ParserVerityState::Structural && MRK_VEC_CONTAIN(m_SkippedIndices, advance))
+		if (m_VerityState & ParserVerityState::Structural && advance < m_SkippedIndices.GetCount() && m_SkippedIndices[advance])
 			advance++;
 
-		if (advance >= m_Tokens.size() || advance < 0)
+		if (advance >= m_Tokens.GetCount())
 			return 0;
 
 		Token* token = &m_Tokens[advance];
@@ -73,7 +95,8 @@ namespace MRK {
 	}
 
 	Token* Parser::Seek() {
-		if (m_TokenPos >= m_Tokens.size() || m_TokenPos < 0)
+		//MRK_TOKEN_NONE is past any count
+		if (m_TokenPos >= m_Tokens.GetCount())
 			return 0;
 
 		return &m_Tokens[m_TokenPos];
@@ -83,7 +106,7 @@ namespace MRK {
 		m_TokenPos = 0;
 	}
 
-	Keyword* Parser::ParseKeyword(mrks string identity) {
+	Keyword* Parser::ParseKeyword(const char* identity) {
 		for (Keyword& kw : ms_Keywords)
 			if (kw.Identity == identity)
 				return &kw;
@@ -91,6 +114,61 @@ namespace MRK {
 		return 0;
 	}
 
+	bool Parser::IsBodyDeclaration(const TokenStore& tokens, mrkpos pos) {
+		//i, c and m are plain names inside a method body and r always returns
+		//the other keywords declare something unless they're used as a name, v = 1, p.x
+		const Token& token = tokens[pos];
+		Keyword* keyword = token.ContextualKind == TOKEN_CONTEXTUAL_KIND_IDENTIFIER ? ParseKeyword(token.Value.IdentifierValue) : 0;
+		if (!keyword)
+			return false;
+
+		switch (keyword->Type) {
+
+		case KeywordType::Return:
+			return true;
+
+		case KeywordType::Var:
+		case KeywordType::Param:
+		case KeywordType::CPP:
+		case KeywordType::CS:
+		case KeywordType::JAVA:
+			break;
+
+		default:
+			return false;
+
+		}
+
+		const Token* next = pos + 1 < tokens.GetCount() ? &tokens[pos + 1] : 0;
+		if (!next || next->ContextualKind != TOKEN_CONTEXTUAL_KIND_CHAR)
+			return true;
+
+		switch (next->Value.CharValue) {
+
+		case '=':
+		case '.':
+		case '(':
+		case '[':
+			return false;
+
+		case '+':
+		case '-':
+		case '*':
+		case '/':
+		case '%':
+		case '&':
+		case '|':
+		case '^': {
+			//compound assignment
+			const Token* after = pos + 2 < tokens.GetCount() ? &tokens[pos + 2] : 0;
+			return !after || after->ContextualKind != TOKEN_CONTEXTUAL_KIND_CHAR || after->Value.CharValue != '=';
+		}
+
+		}
+
+		return true;
+	}
+
 	void Parser::FSMNone() {
 		Token* token = Seek();
 
@@ -100,6 +178,13 @@ namespace MRK {
 		}
 
 		if (token->ContextualKind == TOKEN_CONTEXTUAL_KIND_IDENTIFIER) {
+			//anything but a declaration is a statement inside a method body
+			ParseMethod* method = GetCurrentMethod();
+			if (method && !IsBodyDeclaration(m_Tokens, m_TokenPos)) {
+				HandleStatement(method);
+				return;
+			}
+
 			Keyword* keyword = ParseKeyword(token->Value.StringValue);
 
 			if (keyword) {
@@ -125,11 +210,26 @@ namespace MRK {
 					HandleParam();
 					break;
 
+				case KeywordType::CPP:
+				case KeywordType::CS:
+				case KeywordType::JAVA:
+					HandleForeign(keyword->Type);
+					break;
+
+				case KeywordType::Return:
+					if (method)
+						HandleStatement(method);
+					else
+						Error(ErrorCode::UnexpectedSymbol, true);
+					break;
+
 				}
 			}
 			else
-				Error(MRK_ERROR_UNEXPECTED_SYMBOL, true);
+				Error(ErrorCode::UnexpectedSymbol, true);
 		}
+		else if (IsExpressionStart(*token) && GetCurrentMethod())
+			HandleStatement(GetCurrentMethod());
 		else {
 			if (!Advance()) {
 				m_FSMState = FSMState::Exit;
@@ -139,8 +239,9 @@ namespace MRK {
 
 	void Parser::SetSource(Source* src) {
 		m_Source = src;
-		m_Text = src->Code;
-		m_TokenPos = -1;
+		m_Text = &src->Code;
+		m_TokenPos = MRK_TOKEN_NONE;
+		m_FSMState = FSMState::None;
 		m_VerityState = ParserVerityState::None;
 
 		//context
@@ -179,9 +280,9 @@ namespace MRK {
 			_token = Advance();
 			if (!_token) {
 				if (!identifier.empty())
-					Error(MRK_ERROR_EXPECTED_SEMICOLON);
+					Error(ErrorCode::ExpectedSemicolon);
 				else
-					Error(MRK_ERROR_EXPECTED_IDENTIFIER);
+					Error(ErrorCode::ExpectedIdentifier);
 
 				run = false;
 				return;
@@ -199,7 +300,7 @@ namespace MRK {
 				case '.':
 					if (!identifier.empty()) {
 						if (identifier[identifier.size() - 1] == '.') {
-							Error(MRK_ERROR_EXPECTED_IDENTIFIER);
+							Error(ErrorCode::ExpectedIdentifier);
 							run = false;
 							break;
 						}
@@ -210,19 +311,19 @@ namespace MRK {
 
 				case ';':
 					if (identifier.empty()) {
-						Error(MRK_ERROR_EXPECTED_IDENTIFIER);
+						Error(ErrorCode::ExpectedIdentifier);
 						run = false;
 						break;
 					}
 
 					if (identifier.size() == 1 && identifier[0] == '.') {
-						Error(MRK_ERROR_EXPECTED_IDENTIFIER);
+						Error(ErrorCode::ExpectedIdentifier);
 						run = false;
 						break;
 					}
 
 					if (identifier[identifier.size() - 1] == '.') {
-						Error(MRK_ERROR_EXPECTED_IDENTIFIER);
+						Error(ErrorCode::ExpectedIdentifier);
 						run = false;
 						break;
 					}
@@ -238,7 +339,7 @@ namespace MRK {
 					break;
 
 				default:
-					Error(MRK_ERROR_UNEXPECTED_SYMBOL);
+					Error(ErrorCode::UnexpectedSymbol);
 					run = false;
 					break;
 
@@ -253,7 +354,7 @@ namespace MRK {
 		//c name { }
 		Token* _token = Advance();
 		if (!_token || _token->ContextualKind != TOKEN_CONTEXTUAL_KIND_IDENTIFIER) {
-			Error(MRK_ERROR_EXPECTED_IDENTIFIER);
+			Error(ErrorCode::ExpectedIdentifier);
 			return;
 		}
 
@@ -264,21 +365,21 @@ namespace MRK {
 
 		StructuralScope* scope = GetStructuralScope();
 		if (!scope) {
-			Error(MRK_ERROR_EXPECTED_OPENBRACE);
+			Error(ErrorCode::ExpectedOpenBrace);
 			return;
 		}
 
 		ParseClass* parent = GetCurrentClass();
 
 		ParseClass _class = ParseClass {
-			(int)m_ParseContext->ParseClasses.size(),
+			{ (mrkidx)m_ParseContext->ParseClasses.size(), _token->Offset },
 			className,
 			parent ? parent->Index : -1,
 			scope->Index
 		};
 
 		scope->Owner = MRK_SCOPE_OWNER_CLASS;
-		scope->Data = new mrku32{ (mrku32)_class.Index };
+		scope->Data = new mrkidx[1] { _class.Index };
 
 		m_ParseContext->ParseClasses.push_back(_class);
 
@@ -288,14 +389,14 @@ namespace MRK {
 		});
 
 		m_TokenPos = scope->Open + 1;
-		m_SkippedIndices.push_back(scope->Close);
+		m_SkippedIndices[scope->Close] = true;
 	}
 
 	void Parser::HandleMethod() {
 		//m <type> name {}
 		Token* _token = Advance();
 		if (!_token) {
-			Error(MRK_ERROR_EXPECTED_TYPENAMEORIDENTIFIER);
+			Error(ErrorCode::ExpectedTypenameOrIdentifier);
 			return;
 		}
 
@@ -307,14 +408,14 @@ namespace MRK {
 				ctor = true;
 			}
 			else {
-				Error(MRK_ERROR_EXPECTED_TYPENAME);
+				Error(ErrorCode::ExpectedTypename);
 				return;
 			}
 		}
 
 		if (!ctor && ((_token->ContextualKind == TOKEN_CONTEXTUAL_KIND_CHAR && !IsValidIdentifier(_token->Value.CharValue))
 			|| _token->ContextualKind != TOKEN_CONTEXTUAL_KIND_IDENTIFIER)) {
-			Error(MRK_ERROR_EXPECTED_TYPENAME);
+			Error(ErrorCode::ExpectedTypename);
 			return;
 		}
 
@@ -324,35 +425,36 @@ namespace MRK {
 			_token = Advance();
 
 		if (!_token) {
-			Error(MRK_ERROR_EXPECTED_IDENTIFIER);
+			Error(ErrorCode::ExpectedIdentifier);
 			return;
 		}
 
 		if (!ctor && ((_token->ContextualKind == TOKEN_CONTEXTUAL_KIND_CHAR && !IsValidIdentifier(_token->Value.CharValue))
 			|| _token->ContextualKind != TOKEN_CONTEXTUAL_KIND_IDENTIFIER)) {
-			Error(MRK_ERROR_EXPECTED_IDENTIFIER);
+			Error(ErrorCode::ExpectedIdentifier);
 			return;
 		}
 
 		mrks string _methodname = ctor ? "cx" : _token->Value.IdentifierValue;
+		mrkpos nameOffset = _token->Offset;
 
 		Advance();
 
 		StructuralScope* scope = GetStructuralScope();
 		if (!scope) {
-			Error(MRK_ERROR_EXPECTED_OPENBRACE);
+			Error(ErrorCode::ExpectedOpenBrace);
 			return;
 		}
 
 		ParseClass* _class = GetCurrentClass();
 		if (!_class) {
 			//TODO: Add global class support
-			Error(MRK_ERROR_NO_CLASS_CXT);
+			Error(ErrorCode::NoClassContext);
 			return;
 		}
 		
 		ParseMethod method = ParseMethod{
-			(int)_class->Methods.size(),
+			{ (mrkidx)_class->Methods.size(), nameOffset },
 			_methodname,
 			_typename,
 			_class->Index,
@@ -360,7 +462,7 @@ namespace MRK {
 		};
 
 		scope->Owner = MRK_SCOPE_OWNER_METHOD;
-		scope->Data = new mrku32[2] { (mrku32)_class->Index, (mrku32)method.Index };
+		scope->Data = new mrkidx[2] { _class->Index, method.Index };
 
 		_class->Methods.push_back(method);
 
@@ -369,7 +471,7 @@ namespace MRK {
 		});
 
 		m_TokenPos = scope->Open + 1;
-		m_SkippedIndices.push_back(scope->Close);
+		m_SkippedIndices[scope->Close] = true;
 	}
 
 	void Parser::HandleParam() {
@@ -394,7 +496,7 @@ namespace MRK {
 			Token* _token = Advance();
 			mrks string buf;
 			if (!_token || !GetIdentifierOrCharValue(_token, &buf)) {
-				Error(pstack % 2 ? MRK_ERROR_EXPECTED_IDENTIFIER : MRK_ERROR_EXPECTED_TYPENAME);
+				Error(pstack % 2 ? ErrorCode::ExpectedIdentifier : ErrorCode::ExpectedTypename);
 				run = false;
 				SetError(true);
 				return;
@@ -402,7 +504,8 @@ namespace MRK {
 
 			if (pstack % 2) {
 				_param.Name = buf;
-				_param.Index = _method->Params.size();
+				_param.Offset = _token->Offset;
+				_param.Index = (mrkidx)_method->Params.size();
 				_param.MethodIndex = _method->Index;
 				_method->Params.push_back(_param);
 
@@ -426,13 +529,12 @@ namespace MRK {
 	void Parser::HandleVar() {
 		ParseClass* _class = GetCurrentClass();
 		if (!_class) {
-			Error(MRK_ERROR_NO_CLASS_CXT);
+			Error(ErrorCode::NoClassContext, true);
 			return;
 		}
 
-		mrks string* _buf = new mrks string[2] {
-			"", ""
-		};
+		mrks string _buf[2];
+		mrkpos nameOffset = 0;
 
 		for (mrku32 i = 0; i < 2; i++) {
 			//v type name {
@@ -440,81 +542,314 @@ namespace MRK {
 			//}
 			Token* _token = Advance();
 			if (!_token) {
-				Error(i ? MRK_ERROR_EXPECTED_IDENTIFIER : MRK_ERROR_EXPECTED_TYPENAME);
+				Error(i ? ErrorCode::ExpectedIdentifier : ErrorCode::ExpectedTypename);
 				return;
 			}
 
 			if (!GetIdentifierOrCharValue(_token, &_buf[i])) {
-				Error(i ? MRK_ERROR_EXPECTED_IDENTIFIER : MRK_ERROR_EXPECTED_TYPENAME);
+				Error(i ? ErrorCode::ExpectedIdentifier : ErrorCode::ExpectedTypename);
 				return;
 			}
+
+			nameOffset = _token->Offset;
 		}
 
 		ParseMethod* _method = GetCurrentMethod();
 		mrks vector<ParseVar>* varOwner = _method ? &_method->Vars : &_class->Fields;
 
 		ParseVar var = ParseVar{
-			(int)varOwner->size(),
-			_buf[0],
+			{ (mrkidx)varOwner->size(), nameOffset },
 			_buf[1],
+			_buf[0],
 			!_method,
 			_method ? -1 : _class->Index,
 			_method ? _method->Index : -1
 		};
 
-		varOwner->push_back(var);
-
-		Advance();
+		//last var of the source
+		if (!Advance()) {
+			varOwner->push_back(var);
+			m_FSMState = FSMState::Exit;
+			return;
+		}
 
-		//DEFAULT VALUES = LATER
-		/*StructuralScope* scope = GetStructuralScope();
+		//default value, { r expression }, folded later by the semantic pass
+		StructuralScope* scope = GetStructuralScope();
 		if (scope) {
+			scope->Owner = MRK_SCOPE_OWNER_VAR;
+
+			Token* _token = Advance();
+			Keyword* keyword = _token && _token->ContextualKind == TOKEN_CONTEXTUAL_KIND_IDENTIFIER ? ParseKeyword(_token->Value.IdentifierValue) : 0;
+			if (!keyword || keyword->Type != KeywordType::Return || m_TokenPos >= scope->Close)
+				Error(ErrorCode::ExpectedReturn);
+			else {
+				mrkpos next;
+				var.Default = m_ExpressionParser.Parse(m_ParseContext->Expressions, m_Tokens, m_TokenPos + 1, scope->Close, &next);
+				if (var.Default == MRK_EXPR_NONE)
+					Error(m_ExpressionParser.GetError());
+				else if (next < scope->Close && !(next + 1 == scope->Close && IsChar(m_Tokens[next], ';'))) {
+					var.Default = MRK_EXPR_NONE;
+					Error(ErrorCode::UnexpectedSymbol);
+				}
+			}
+
+			//the block is never walked by the FSM
+			m_TokenPos = scope->Close;
+			if (!Advance())
+				m_FSMState = FSMState::Exit;
+		}
+
+		Log([&](MRK_LOG_PARAM) {
+			stream << "Added var '" << var.Name << ':' << var.Typename << '\'' << (var.Default == MRK_EXPR_NONE ? "" : " with default");
+		});
 
-		}*/
+		varOwner->push_back(mrks move(var));
 	}
 
-	void Parser::Error(mrks string message, bool terminate) {
-		m_Errors->push_back(MRK::Error{
-			m_Source,
-			message
+	void Parser::HandleForeign(KeywordType language) {
+		//__cpp { raw }, the lexer has already captured the body
+		ParseClass* _class = GetCurrentClass();
+		if (!_class) {
+			Error(ErrorCode::NoClassContext, true);
+			return;
+		}
+
+		Token* _token = Advance();
+		if (!_token || _token->ContextualKind != TOKEN_CONTEXTUAL_KIND_RAW) {
+			Error(ErrorCode::ExpectedOpenBrace, true);
+			return;
+		}
+
+		if (_token->HasError) {
+			Error(ErrorCode::ExpectedCloseBrace, true);
+			return;
+		}
+
+		ParseMethod* _method = GetCurrentMethod();
+		ParseForeignBlock block = ParseForeignBlock{
+			language,
+			_token->Offset + 1,
+			_token->Value.RawValue.Length
+		};
+
+		(_method ? _method->ForeignBlocks : _class->ForeignBlocks).push_back(block);
+
+		Log([&](MRK_LOG_PARAM) {
+			stream << "Added foreign block [" << (_method ? _method->Name : _class->Name) << "] " << block.Length << " bytes";
 		});
 
+		if (!Advance())
+			m_FSMState = FSMState::Exit;
+	}
+
+	void Parser::HandleStatement(ParseMethod* method) {
+		//r [expression] or an expression, the statement ends where no operator continues it
+		StructuralScope* scope = GetEnclosingScope(MRK_SCOPE_OWNER_METHOD);
+		ExprArena& arena = m_ParseContext->Expressions;
+		mrkpos start = m_TokenPos;
+		mrkpos next = start;
+		mrku32 root;
+
+		const Token& token = m_Tokens[start];
+		Keyword* keyword = token.ContextualKind == TOKEN_CONTEXTUAL_KIND_IDENTIFIER ? ParseKeyword(token.Value.IdentifierValue) : 0;
+		if (keyword && keyword->Type == KeywordType::Return) {
+			mrku32 value = MRK_EXPR_NONE;
+			next = start + 1;
+
+			//a bare r is followed by the end of the body, a ';' or a declaration
+			bool bare = next >= scope->Close || IsChar(m_Tokens[next], ';') || IsChar(m_Tokens[next], '}') || IsBodyDeclaration(m_Tokens, next);
+			if (!bare)
+				value = m_ExpressionParser.Parse(arena, m_Tokens, next, scope->Close, &next);
+
+			root = bare || value != MRK_EXPR_NONE ? arena.Add(ExprKind::Return, ExprOp::None, value) : MRK_EXPR_NONE;
+		}
+		else
+			root = m_ExpressionParser.Parse(arena, m_Tokens, start, scope->Close, &next);
+
+		if (root == MRK_EXPR_NONE) {
+			Error(m_ExpressionParser.GetError());
+
+			//resume after the offending token
+			m_TokenPos = next > start ? next : start + 1;
+			return;
+		}
+
+		method->Body.push_back(root);
+
+		Log([&](MRK_LOG_PARAM) {
+			stream << "Added statement [" << method->Name << "] " << arena.GetCount() << " nodes";
+		});
+
+		if (next < m_Tokens.GetCount() && IsChar(m_Tokens[next], ';'))
+			next++;
+
+		m_TokenPos = next;
+	}
+
+	void Parser::Error(ErrorCode code, bool terminate) {
+		//at the token being looked at, the last one once the stream is exhausted
+		mrkpos offset = MRK_NO_OFFSET;
+		if (m_TokenPos != MRK_TOKEN_NONE && !m_Tokens.IsEmpty())
+			offset = m_Tokens[mrks min(m_TokenPos, m_Tokens.GetCount() - 1)].Offset;
+
+		m_Errors->push_back(MRK::Error{ m_Source, code, offset });
+
 		if (terminate)
 			m_FSMState = FSMState::Exit;
 	}
 
-	void Parser::Error(mrks string message) {
-		Error(message, false);
+	void Parser::Error(ErrorCode code) {
+		Error(code, false);
+	}
+
+	void Parser::NotifyPhase(ParsePhase phase, bool begin) {
+		if (m_PhaseCallback)
+			m_PhaseCallback(phase, begin);
+	}
+
+	ScopePass Parser::AssignStructuralScopes() {
+		ScopePass pass = m_ScopePass;
+		if (pass == ScopePass::Index && !MapStructuralIndex())
+			pass = ScopePass::Braces;
+
+		if (pass == ScopePass::Tokens)
+			AssignScopesFromTokens();
+		else
+			AssignScopesFromBraces(pass == ScopePass::Index ? m_BraceTokens : m_Lexer.GetBraceTokens());
+
+		m_VerityState |= ParserVerityState::Structural;
+		Reset();
+		return pass;
+	}
+
+	bool Parser::MapStructuralIndex() {
+		const mrks string& text = *m_Text;
+		BuildStructuralIndex(text.data(), text.size(), m_StructuralIndex);
+
+		//braces without a token at their offset are inside foreign blocks or inactive $PLATFORM regions
+		m_BraceTokens.clear();
+		mrkpos token = 0;
+		mrkpos count = m_Tokens.GetCount();
+		for (mrkpos offset : m_StructuralIndex.Positions) {
+			char c = text[offset];
+			if (c != '{' && c != '}')
+				continue;
+
+			//braces are a few tokens apart, step before searching
+			for (int step = 0; step < 8 && token < count && m_Tokens[token].Offset < offset; step++)
+				token++;
+
+			//lower bound of offset in [token, count)
+			for (mrkpos last = count; token < last;) {
+				mrkpos middle = token + (last - token) / 2;
+				if (m_Tokens[middle].Offset < offset)
+					token = middle + 1;
+				else
+					last = middle;
+			}
+
+			if (token == count)
+				break;
+
+			const Token& brace = m_Tokens[token];
+			if (brace.Offset == offset && brace.ContextualKind == TOKEN_CONTEXTUAL_KIND_CHAR && brace.Value.CharValue == c)
+				m_BraceTokens.push_back(token);
+		}
+
+		//a string or comment the index read differently from the lexer
+		return m_BraceTokens.size() == m_Lexer.GetBraceTokens().size();
 	}
 
-	void Parser::AssignStructuralScopes() {
+	void Parser::AssignScopesFromBraces(const mrks vector<mrkpos>& braces) {
+		//per token lookups, so scope queries don't have to scan every scope
+		m_SkippedIndices.Assign(m_Tokens.GetCount(), false);
+		m_ScopeAtToken.Assign(m_Tokens.GetCount(), -1);
+		m_EnclosingScope.Assign(m_Tokens.GetCount(), -1);
+
+		//tokens between two braces share their enclosing scope, filled a range at a time
+		mrks vector<StructuralScope> openedScopes;
+		mrkidx enclosing = -1;
+		mrkpos filled = 0;
+		for (mrkpos pos : braces) {
+			for (; filled < pos; filled++)
+				m_EnclosingScope[filled] = enclosing;
+
+			m_EnclosingScope[pos] = enclosing;
+			filled = pos + 1;
+
+			if (m_Tokens[pos].Value.CharValue == '{') {
+				openedScopes.push_back(StructuralScope {
+					pos
+				});
+				openedScopes.back().Parent = enclosing;
+				m_EnclosingScope[pos] = enclosing = (mrkidx)pos;
+				continue;
+			}
+
+			if (openedScopes.empty()) {
+				m_TokenPos = pos;
+				Error(ErrorCode::ExpectedOpenBrace);
+				continue;
+			}
+
+			StructuralScope scope = openedScopes.back();
+			openedScopes.pop_back();
+			scope.Close = pos;
+			scope.Index = (mrkidx)m_ParseContext->StructuralScopes.size();
+			m_ScopeAtToken[scope.Open] = scope.Index;
+			m_ParseContext->StructuralScopes.push_back(scope);
+			enclosing = scope.Parent;
+		}
+
+		for (; filled < m_Tokens.GetCount(); filled++)
+			m_EnclosingScope[filled] = enclosing;
+
+		//errors about unclosed scopes point at the last token, as in the token pass
+		if (!m_Tokens.IsEmpty())
+			m_TokenPos = m_Tokens.GetCount() - 1;
+
+		ResolveStructuralScopes(openedScopes);
+	}
+
+	void Parser::AssignScopesFromTokens() {
 		mrks vector<StructuralScope> openedScopes;
 		Token* token = 0;
 
+		//per token lookups, so scope queries don't have to scan every scope
+		m_SkippedIndices.Assign(m_Tokens.GetCount(), false);
+		m_ScopeAtToken.Assign(m_Tokens.GetCount(), -1);
+		m_EnclosingScope.Assign(m_Tokens.GetCount(), -1);
+
 		while (true) {
 			token = token ? Advance() : Seek();
 			if (!token)
 				break;
 
+			//open position of the innermost scope until the pass is done
+			m_EnclosingScope[m_TokenPos] = openedScopes.empty() ? -1 : openedScopes.back().Open;
+
 			if (token->ContextualKind == TOKEN_CONTEXTUAL_KIND_CHAR) {
 				switch (token->Value.CharValue) {
 
 				case '{':
 					openedScopes.push_back(StructuralScope {
-						(mrku32)m_TokenPos
+						m_TokenPos
 					});
+					openedScopes.back().Parent = m_EnclosingScope[m_TokenPos];
+					m_EnclosingScope[m_TokenPos] = (mrkidx)m_TokenPos;
 					break;
 
 				case '}':
 					if (openedScopes.empty()) {
-						Error(MRK_ERROR_EXPECTED_OPENBRACE);
+						Error(ErrorCode::ExpectedOpenBrace);
 						break;
 					}
 
 					StructuralScope scope = openedScopes.back();
 					openedScopes.pop_back();
 					scope.Close = m_TokenPos;
-					scope.Index = m_ParseContext->StructuralScopes.size();
+					scope.Index = (mrkidx)m_ParseContext->StructuralScopes.size();
+					m_ScopeAtToken[scope.Open] = scope.Index;
 					m_ParseContext->StructuralScopes.push_back(scope);
 					break;
 
@@ -522,23 +857,50 @@ namespace MRK {
 			}
 		}
 
-		if (!openedScopes.empty()) {
-			for (int i = 0; i < openedScopes.size(); i++)
-				Error(MRK_ERROR_EXPECTED_CLOSEBRACE);
-		}
-
-		m_VerityState |= ParserVerityState::Structural;
-		Reset();
+		ResolveStructuralScopes(openedScopes);
 	}
 
-	StructuralScope* Parser::GetStructuralScope(int pos) {
-		if (pos == -1)
-			pos = m_TokenPos;
+	void Parser::ResolveStructuralScopes(const mrks vector<StructuralScope>& unclosed) {
+		//scopes that never closed don't exist, innermost first so tokens end up in a real scope
+		for (auto scope = unclosed.rbegin(); scope != unclosed.rend(); scope++)
+			for (mrkpos pos = scope->Open; pos < m_Tokens.GetCount(); pos++)
+				if (m_EnclosingScope[pos] == (mrkidx)scope->Open)
+					m_EnclosingScope[pos] = scope->Parent;
+
+		//open positions -> scope indices
+		for (mrkpos pos = 0; pos < m_EnclosingScope.GetCount(); pos++)
+			if (m_EnclosingScope[pos] >= 0)
+				m_EnclosingScope[pos] = m_ScopeAtToken[m_EnclosingScope[pos]];
 
 		for (StructuralScope& scope : m_ParseContext->StructuralScopes)
-			if (scope.Open == (mrku32)pos)
+			if (scope.Parent >= 0)
+				scope.Parent = m_ScopeAtToken[scope.Parent];
+
+		for (size_t i = 0; i < unclosed.size(); i++)
+			Error(ErrorCode::ExpectedCloseBrace);
+	}
+
+	StructuralScope* Parser::GetStructuralScope() {
+		mrkpos pos = m_TokenPos;
+		if (pos >= m_ScopeAtToken.GetCount() || m_ScopeAtToken[pos] < 0)
+			return 0;
+
+		return &m_ParseContext->StructuralScopes[m_ScopeAtToken[pos]];
+	}
+
+	StructuralScope* Parser::GetEnclosingScope(mrku32 owner) {
+		//innermost scope around the current token owned by owner
+		if (m_TokenPos >= m_EnclosingScope.GetCount())
+			return 0;
+
+		for (mrkidx index = m_EnclosingScope[m_TokenPos]; index >= 0;) {
+			StructuralScope& scope = m_ParseContext->StructuralScopes[index];
+			if (scope.Owner == owner)
 				return &scope;
 
+			index = scope.Parent;
+		}
+
 		return 0;
 	}
 
@@ -549,7 +911,7 @@ namespace MRK {
 				return true;
 
 			default:
-				return isalpha(c);
+				return isalpha((unsigned char)c);
 
 		}
 
@@ -559,34 +921,19 @@ namespace MRK {
 	ParseClass* Parser::GetCurrentClass() {
 		//look up
 		//find first s_scope upwards belonging to a class
+		StructuralScope* scope = GetEnclosingScope(MRK_SCOPE_OWNER_CLASS);
+		if (!scope)
+			return 0;
 
-		for (int pos = m_TokenPos; pos > -1; pos--) {
-			StructuralScope* scope = GetStructuralScope(pos);
-			if (!scope || scope->Owner != MRK_SCOPE_OWNER_CLASS)
-				continue;
-
-			if (scope->Close < m_TokenPos)
-				continue;
-
-			return &*(m_ParseContext->ParseClasses.begin() + *scope->Data);
-		}
-
-		return 0;
+		return &*(m_ParseContext->ParseClasses.begin() + *scope->Data);
 	}
 
 	ParseMethod* Parser::GetCurrentMethod() {
-		for (int pos = m_TokenPos; pos > -1; pos--) {
-			StructuralScope* scope = GetStructuralScope(pos);
-			if (!scope || scope->Owner != MRK_SCOPE_OWNER_METHOD)
-				continue;
-
-			if (scope->Close < m_TokenPos)
-				continue;
-
-			return &*((m_ParseContext->ParseClasses.begin() + *scope->Data)->Methods.begin() + scope->Data[1]);
-		}
+		StructuralScope* scope = GetEnclosingScope(MRK_SCOPE_OWNER_METHOD);
+		if (!scope)
+			return 0;
 
-		return 0;
+		return &*((m_ParseContext->ParseClasses.begin() + *scope->Data)->Methods.begin() + scope->Data[1]);
 	}
 
 	bool Parser::GetIdentifierOrCharValue(Token* token, mrks string* val) {
@@ -625,7 +972,32 @@ namespace MRK {
 		return true;
 	}
 
-	Parser::Parser(mrks vector<Source> srcs) : m_Sources(srcs) {
+	Parser::Parser(mrks vector<Source> srcs) : m_Sources(mrks move(srcs)), m_Text(0), m_MemoryReport(0), m_ExpressionParser(IsBodyDeclaration), m_ScopePass(ScopePass::Braces) {
+	}
+
+	mrks vector<Source>& Parser::GetSources() {
+		return m_Sources;
+	}
+
+	const SourceParseContext* Parser::GetParseContext(const Source* src) const {
+		auto context = m_ParseContexts.find(src);
+		return context == m_ParseContexts.end() ? 0 : &context->second;
+	}
+
+	void Parser::SetMemoryReport(MemoryReport* report) {
+		m_MemoryReport = report;
+	}
+
+	void Parser::SetPhaseCallback(mrks function<void(ParsePhase, bool)> callback) {
+		m_PhaseCallback = callback;
+	}
+
+	void Parser::SetPlatforms(const PlatformSet& platforms) {
+		m_Platforms = platforms;
+	}
+
+	void Parser::SetScopePass(ScopePass pass) {
+		m_ScopePass = pass;
 	}
 
 	void Parser::Start(ParserResult& res) {
@@ -633,14 +1005,54 @@ namespace MRK {
 		m_Errors = &res.Errors;
 
 		for (Source& src : m_Sources) {
+			TraceSpan sourceSpan("Source", src.Filename);
+			sourceSpan.Arg("bytes", src.Code.size());
+
 			SetSource(&src);
 
+			SourceMemory* memory = 0;
+			if (m_MemoryReport) {
+				m_MemoryReport->Sources.push_back(SourceMemory{ src.Filename });
+				memory = &m_MemoryReport->Sources.back();
+			}
+
 			//tokenize
-			InitializeTokenStream(Tokens::Collect(m_Text, false));
+			{
+				TraceSpan span("Lex", src.Filename);
+				NotifyPhase(ParsePhase::Lex, true);
+
+				//reported once, the bytes from there on still lex as symbols
+				size_t invalid = ValidateUtf8(m_Text->data(), m_Text->size());
+				if (invalid != m_Text->size())
+					m_Errors->push_back(MRK::Error{ m_Source, ErrorCode::InvalidUtf8, invalid });
+
+				InitializeTokenStream(m_Lexer.Lex(*m_Text, false, &m_Platforms));
+				NotifyPhase(ParsePhase::Lex, false);
+				span.Arg("bytes", m_Text->size());
+				span.Arg("tokens", m_Tokens.GetCount());
+			}
+
+			if (memory) {
+				AccountTokens(m_Tokens, *memory);
+				memory->PeakRSS[(mrku32)ParsePhase::Lex] = GetPeakRSS();
+			}
 
 			//assign scopes
-			AssignStructuralScopes();
+			{
+				TraceSpan span("AssignStructuralScopes", src.Filename);
+				NotifyPhase(ParsePhase::Scopes, true);
+				ScopePass pass = AssignStructuralScopes();
+				NotifyPhase(ParsePhase::Scopes, false);
+				span.Arg("tokens", m_Tokens.GetCount());
+				span.Arg("pass", (mrku32)pass);
+				span.Arg("scopes", m_ParseContext->StructuralScopes.size());
+			}
+
+			if (memory)
+				memory->PeakRSS[(mrku32)ParsePhase::Scopes] = GetPeakRSS();
 
+			TraceSpan span("Parse", src.Filename);
+			NotifyPhase(ParsePhase::Parse, true);
 			while (m_FSMState != FSMState::Exit) {
 				switch (m_FSMState) {
 
@@ -650,6 +1062,20 @@ namespace MRK {
 
 				}
 			}
+			NotifyPhase(ParsePhase::Parse, false);
+			span.Arg("tokens", m_Tokens.GetCount());
+			span.Arg("classes", m_ParseContext->ParseClasses.size());
+			sourceSpan.Arg("tokens", m_Tokens.GetCount());
+
+			if (memory) {
+				AccountParseContext(*m_ParseContext, *memory);
+				memory->PeakRSS[(mrku32)ParsePhase::Parse] = GetPeakRSS();
+			}
+		}
+
+		if (m_MemoryReport) {
+			m_MemoryReport->LogBytes = (size_t)res.Logs.tellp();
+			m_MemoryReport->ErrorBytes = res.Errors.capacity() * sizeof(mrk Error);
 		}
 	}
 
@@ -666,6 +1092,6 @@ namespace MRK {
 
 	StructuralScope::~StructuralScope() {
 		if (Data)
-			delete Data;
+			delete[] Data;
 	}
 }
\ No newline at end of file
@@ -35,12 +35,16 @@
 #include "Tokens.h"
 #include "Source.h"
 #include "Error.h"
+#include "Memory.h"
+#include "Expression.h"
+#include "StructuralIndex.h"
 
 #define MRK_LOG_PARAM mrks stringstream& stream
 #define MRK_SCOPE_OWNER_CLASS 1
 #define MRK_SCOPE_OWNER_METHOD 2
 #define MRK_SCOPE_OWNER_PARAM 3
 #define MRK_SCOPE_OWNER_VAR 4 //default value
+#define MRK_TOKEN_NONE ((mrkpos)-1) //before the first token
 
 namespace MRK {
 	struct Keyword;
@@ -52,32 +56,52 @@ namespace MRK {
 	struct ParseMethod;
 	struct ParseParam;
 	struct ParseVar;
+	struct ParseForeignBlock;
+	enum class KeywordType;
 	enum class ParserVerityState : mrku32;
 
+	//how scopes are paired from braces, every pass builds the same scopes
+	enum class ScopePass {
+		Braces, //the brace tokens the lexer lists while tokenizing
+		Index, //the byte level StructuralIndex mapped onto the tokens, Braces if the two disagree
+		Tokens //a walk over every token
+	};
+
 	class Parser {
 
 	private:
 		static mrks vector<Keyword> ms_Keywords;
 		mrks vector<Source> m_Sources;
 		Source* m_Source;
-		mrks string m_Text;
-		mrks vector<Token> m_Tokens;
-		int m_TokenPos;
+		const mrks string* m_Text; //Source::Code of m_Source
+		Lexer m_Lexer;
+		TokenStore m_Tokens;
+		mrkpos m_TokenPos;
 		FSMState m_FSMState;
 		mrks stringstream* m_LogStream;
-		mrks vector<Error>* m_Errors;
-		mrks map<Source*, SourceParseContext> m_ParseContexts;
+		mrks vector<mrk Error>* m_Errors;
+		mrks map<const Source*, SourceParseContext> m_ParseContexts;
 		SourceParseContext* m_ParseContext;
-		mrks vector<mrku32> m_SkippedIndices;
+		TokenData<bool> m_SkippedIndices;
+		TokenData<mrkidx> m_ScopeAtToken; //scope opened at a token, -1 if none
+		TokenData<mrkidx> m_EnclosingScope; //innermost scope containing a token, -1 if none
 		ParserVerityState m_VerityState;
-
-		void InitializeTokenStream(mrks vector<Token> tokens);
+		MemoryReport* m_MemoryReport;
+		mrks function<void(ParsePhase, bool)> m_PhaseCallback;
+		PlatformSet m_Platforms;
+		ExpressionParser m_ExpressionParser;
+		StructuralIndex m_StructuralIndex;
+		mrks vector<mrkpos> m_BraceTokens;
+		ScopePass m_ScopePass;
+
+		void InitializeTokenStream(TokenStore& tokens);
 		Token* PeekNext();
 		Token* PeekPrevious();
-		Token* Advance(int steps);
+		Token* Advance(mrkpos steps);
 		Token* Seek();
 		void Reset();
-		Keyword* ParseKeyword(mrks string identity);
+		static Keyword* ParseKeyword(const char* identity);
+		static bool IsBodyDeclaration(const TokenStore& tokens, mrkpos pos);
 		void FSMNone();
 		void SetSource(Source* src);
 		void Log(mrks string log);
@@ -87,10 +111,18 @@ namespace MRK {
 		void HandleMethod();
 		void HandleParam();
 		void HandleVar();
-		void Error(mrks string message, bool terminate);
-		void Error(mrks string message);
-		void AssignStructuralScopes();
-		StructuralScope* GetStructuralScope(int pos = -1);
+		void HandleForeign(KeywordType language);
+		void HandleStatement(ParseMethod* method);
+		void Error(ErrorCode code, bool terminate);
+		void Error(ErrorCode code);
+		void NotifyPhase(ParsePhase phase, bool begin);
+		ScopePass AssignStructuralScopes();
+		bool MapStructuralIndex();
+		void AssignScopesFromBraces(const mrks vector<mrkpos>& braces);
+		void AssignScopesFromTokens();
+		void ResolveStructuralScopes(const mrks vector<StructuralScope>& unclosed);
+		StructuralScope* GetStructuralScope();
+		StructuralScope* GetEnclosingScope(mrku32 owner);
 		bool IsValidIdentifier(char& c);
 		ParseClass* GetCurrentClass();
 		ParseMethod* GetCurrentMethod();
@@ -98,7 +130,14 @@ namespace MRK {
 
 	public:
 		Parser(mrks vector<Source> srcs);
+		void SetMemoryReport(MemoryReport* report);
+		void SetPhaseCallback(mrks function<void(ParsePhase phase, bool begin)> callback);
+		void SetPlatforms(const PlatformSet& platforms);
+		void SetScopePass(ScopePass pass);
 		void Start(ParserResult& res);
+
+		mrks vector<Source>& GetSources();
+		const SourceParseContext* GetParseContext(const Source* src) const;
 	};
 
 	enum class FSMState {
@@ -138,7 +177,7 @@ namespace MRK {
 	};
 
 	struct ParserResult {
-		mrks vector<Error> Errors;
+		mrks vector<mrk Error> Errors;
 		mrks stringstream Logs;
 	};
 
@@ -146,50 +185,55 @@ namespace MRK {
 		mrks vector<mrks string> Includes;
 		mrks vector<StructuralScope> StructuralScopes;
 		mrks vector<ParseClass> ParseClasses;
+		ExprArena Expressions; //var defaults and method bodies
 	};
 
 	struct StructuralScope {
-		mrku32 Open;
-		mrku32 Close;
-		int Index;
-		int Parent;
+		mrkpos Open;
+		mrkpos Close;
+		mrkidx Index;
+		mrkidx Parent;
 
 		mrku32 Owner;
-		mrku32* Data;
+		mrkidx* Data;
 
 		~StructuralScope();
 	};
 
 	struct ParseBase {
-		int Index;
+		mrkidx Index;
+		mrkpos Offset; //name in Source::Code
 	};
 
 	struct ParseClass : public ParseBase {
 		mrks string Name;
-		int ParentIndex;
+		mrkidx ParentIndex;
 		
-		int ScopeIndex;
+		mrkidx ScopeIndex;
 
 		mrks vector<ParseMethod> Methods;
 		mrks vector<ParseVar> Fields;
+		mrks vector<ParseForeignBlock> ForeignBlocks;
 	};
 
 	struct ParseMethod : public ParseBase {
 		mrks string Name;
 		mrks string Typename;
 
-		int ClassIndex;
-		int ScopeIndex;
+		mrkidx ClassIndex;
+		mrkidx ScopeIndex;
 
 		mrks vector<ParseParam> Params;
 		mrks vector<ParseVar> Vars;
+		mrks vector<ParseForeignBlock> ForeignBlocks;
+		mrks vector<mrku32> Body; //statement roots in SourceParseContext::Expressions
 	};
 
 	struct ParseParam : public ParseBase {
 		mrks string Name;
 		mrks string Typename;
 
-		int MethodIndex;
+		mrkidx MethodIndex;
 	};
 
 	struct ParseVar : public ParseBase {
@@ -197,7 +241,16 @@ namespace MRK {
 		mrks string Typename;
 
 		bool IsMyOwnerSad; // if true, it means owner = class
-		int ClassIndex;
-		int MethodIndex;
+		mrkidx ClassIndex;
+		mrkidx MethodIndex;
+
+		mrku32 Default = MRK_EXPR_NONE; //'r' expression of the default block in SourceParseContext::Expressions
+	};
+
+	//body of a __cpp/__cs/__java block, a span of Source::Code
+	struct ParseForeignBlock {
+		KeywordType Language;
+		mrkpos Offset;
+		mrkpos Length;
 	};
 }
\ No newline at end of file
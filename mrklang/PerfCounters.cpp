@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PerfCounters.h"
+
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace MRK {
+	const char* GetPerfCounterName(PerfCounter counter) {
+		switch (counter) {
+
+		case PerfCounter::Cycles:
+			return "cycles";
+
+		case PerfCounter::Instructions:
+			return "instructions";
+
+		case PerfCounter::BranchMisses:
+			return "branch-misses";
+
+		case PerfCounter::L1dMisses:
+			return "L1d-misses";
+
+		case PerfCounter::LLCMisses:
+			return "LLC-misses";
+
+		}
+
+		return "";
+	}
+
+	PerfCounters::PerfCounters() {
+		for (int& fd : m_Fds)
+			fd = -1;
+	}
+
+	PerfCounters::~PerfCounters() {
+#ifdef __linux__
+		for (int fd : m_Fds)
+			if (fd >= 0)
+				close(fd);
+#endif
+	}
+
+	bool PerfCounters::Open() {
+#ifdef __linux__
+		struct { mrku32 Type; unsigned long long Config; } events[MRK_PERF_COUNTER_COUNT] = {
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+			{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES }
+		};
+
+		for (mrku32 i = 0; i < MRK_PERF_COUNTER_COUNT; i++) {
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = events[i].Type;
+			attr.config = events[i].Config;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+			m_Fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+			if (m_Fds[i] < 0 && m_Error.empty())
+				m_Error = mrks string(GetPerfCounterName((PerfCounter)i)) + ": " + strerror(errno);
+		}
+
+		if (!IsAvailable())
+			return false;
+
+		m_Error.clear();
+		return true;
+#else
+		m_Error = "perf_event_open is only available on Linux";
+		return false;
+#endif
+	}
+
+	bool PerfCounters::IsAvailable() const {
+		for (int fd : m_Fds)
+			if (fd >= 0)
+				return true;
+
+		return false;
+	}
+
+	bool PerfCounters::IsAvailable(PerfCounter counter) const {
+		return m_Fds[(mrku32)counter] >= 0;
+	}
+
+	const mrks string& PerfCounters::GetError() const {
+		return m_Error;
+	}
+
+	void PerfCounters::Read(unsigned long long values[MRK_PERF_COUNTER_COUNT]) const {
+		for (mrku32 i = 0; i < MRK_PERF_COUNTER_COUNT; i++) {
+			values[i] = 0;
+
+#ifdef __linux__
+			if (m_Fds[i] < 0)
+				continue;
+
+			//value, time enabled, time running
+			unsigned long long data[3];
+			if (read(m_Fds[i], data, sizeof(data)) != sizeof(data))
+				continue;
+
+			values[i] = data[2] && data[2] < data[1] ? (unsigned long long)((double)data[0] * data[1] / data[2]) : data[0];
+#endif
+		}
+	}
+}
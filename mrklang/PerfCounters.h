@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "Common.h"
+
+#define MRK_PERF_COUNTER_COUNT 5
+
+namespace MRK {
+	enum class PerfCounter : mrku32 {
+		Cycles,
+		Instructions,
+		BranchMisses,
+		L1dMisses,
+		LLCMisses
+	};
+
+	const char* GetPerfCounterName(PerfCounter counter);
+
+	//hardware counters of the calling thread (perf_event_open), user space only
+	//Counters the kernel, the VM or the container refuse are reported unavailable
+	//instead of failing, IsAvailable() is false when none could be opened
+	class PerfCounters {
+	private:
+		int m_Fds[MRK_PERF_COUNTER_COUNT];
+		mrks string m_Error;
+
+	public:
+		PerfCounters();
+		~PerfCounters();
+
+		PerfCounters(const PerfCounters&) = delete;
+		PerfCounters& operator=(const PerfCounters&) = delete;
+
+		bool Open();
+		bool IsAvailable() const;
+		bool IsAvailable(PerfCounter counter) const;
+		const mrks string& GetError() const;
+
+		//current values, scaled when the kernel had to multiplex the counters
+		void Read(unsigned long long values[MRK_PERF_COUNTER_COUNT]) const;
+	};
+}
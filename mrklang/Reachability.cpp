@@ -0,0 +1,569 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Reachability.h"
+#include "Trace.h"
+
+#include <cctype>
+
+namespace MRK {
+	namespace {
+		//user class of a type ID, false for builtins and unresolved types
+		bool GetClassOf(const Semantic& semantic, mrku32 typeId, int& module, int& _class) {
+			if (typeId == MRK_TYPE_UNRESOLVED || typeId >= semantic.GetTypeCount())
+				return false;
+
+			const TypeInfo& type = semantic.GetType(typeId);
+			module = type.Module;
+			_class = type.Class;
+			return module >= 0;
+		}
+
+		template<typename T>
+		void KeepMarked(mrks vector<T>& items, const mrks vector<bool>& marks) {
+			size_t kept = 0;
+			for (size_t i = 0; i < items.size(); i++) {
+				if (!marks[i])
+					continue;
+
+				if (kept != i)
+					items[kept] = mrks move(items[i]);
+				kept++;
+			}
+
+			items.erase(items.begin() + kept, items.end());
+		}
+
+		bool IsIdentifierByte(char c, bool first) {
+			//bytes of UTF-8 sequences are taken as part of a name
+			return c == '_' || (unsigned char)c >= 0x80 || isalpha((unsigned char)c) || (!first && isdigit((unsigned char)c));
+		}
+	}
+
+	Reachability::Reachability(const Semantic& semantic) : m_Semantic(semantic), m_Model(0) {
+	}
+
+	void Reachability::MarkClass(int module, int _class) {
+		ClassMarks& marks = m_Marks[module][_class];
+		if (marks.Kept)
+			return;
+
+		marks.Kept = true;
+		m_Kept.push_back({ module, _class });
+		m_Pending.push_back(Item{ ItemKind::Class, module, _class, -1 });
+	}
+
+	void Reachability::MarkField(int module, int _class, int field) {
+		MarkClass(module, _class);
+
+		mrks vector<bool>::reference marked = m_Marks[module][_class].Fields[field];
+		if (!marked) {
+			marked = true;
+			m_Pending.push_back(Item{ ItemKind::Field, module, _class, field });
+		}
+	}
+
+	void Reachability::MarkMethod(int module, int _class, int method) {
+		MarkClass(module, _class);
+
+		mrks vector<bool>::reference marked = m_Marks[module][_class].Methods[method];
+		if (!marked) {
+			marked = true;
+			m_Pending.push_back(Item{ ItemKind::Method, module, _class, method });
+		}
+	}
+
+	void Reachability::MarkType(const ModelType& type) {
+		int module, _class;
+		if (type.IsUser() && GetClassOf(m_Semantic, type.TypeId, module, _class))
+			MarkClass(module, _class);
+	}
+
+	void Reachability::MarkWhole(int module, int _class) {
+		//the class, every member and every nested class
+		mrks vector<int> classes{ _class };
+		while (!classes.empty()) {
+			int index = classes.back();
+			classes.pop_back();
+
+			const ModelClass& current = m_Model->Modules[module].Classes[index];
+			MarkClass(module, index);
+			for (size_t i = 0; i < current.Fields.size(); i++)
+				MarkField(module, index, (int)i);
+			for (size_t i = 0; i < current.Methods.size(); i++)
+				MarkMethod(module, index, (int)i);
+
+			classes.insert(classes.end(), current.Nested.begin(), current.Nested.end());
+		}
+	}
+
+	void Reachability::MarkLoose(int module, int _class) {
+		if (m_LooseNames.empty())
+			return;
+
+		const ModelClass& current = m_Model->Modules[module].Classes[_class];
+		for (size_t i = 0; i < current.Fields.size(); i++)
+			if (m_LooseNames.count(current.Fields[i].Name))
+				MarkField(module, _class, (int)i);
+
+		for (size_t i = 0; i < current.Methods.size(); i++)
+			if (!current.Methods[i].IsCtor && m_LooseNames.count(current.Methods[i].Name))
+				MarkMethod(module, _class, (int)i);
+	}
+
+	void Reachability::AddLooseName(const mrks string& name) {
+		if (!m_LooseNames.insert(name).second)
+			return;
+
+		//classes kept so far, the ones kept later check the name when they are processed
+		for (size_t i = 0; i < m_Kept.size(); i++) {
+			const ModelClass& current = m_Model->Modules[m_Kept[i].first].Classes[m_Kept[i].second];
+			const Symbol* symbol = m_Semantic.Lookup(current.Scope, name);
+			if (symbol && symbol->Kind == SymbolKind::Field)
+				MarkField(m_Kept[i].first, m_Kept[i].second, symbol->Member);
+			else if (symbol && symbol->Kind == SymbolKind::Method)
+				MarkMethod(m_Kept[i].first, m_Kept[i].second, symbol->Member);
+		}
+	}
+
+	void Reachability::Process(const Item& item) {
+		const ModelClass& _class = m_Model->Modules[item.Module].Classes[item.Class];
+		Context context{ item.Module, &_class, 0 };
+
+		switch (item.Kind) {
+
+		case ItemKind::Class:
+			if (_class.Parent >= 0)
+				MarkClass(item.Module, _class.Parent);
+
+			//objects are built by any of them
+			for (size_t i = 0; i < _class.Methods.size(); i++)
+				if (_class.Methods[i].IsCtor)
+					MarkMethod(item.Module, item.Class, (int)i);
+
+			ScanForeign(context, _class.ForeignBlocks);
+			MarkLoose(item.Module, item.Class);
+			break;
+
+		case ItemKind::Field: {
+			const ModelVar& field = _class.Fields[item.Member];
+			MarkType(field.Type);
+			if (!field.IsConstant() && field.Default != MRK_EXPR_NONE)
+				Walk(context, field.Default);
+			break;
+		}
+
+		case ItemKind::Method: {
+			const ModelMethod& method = _class.Methods[item.Member];
+			context.Method = &method;
+
+			if (!method.IsCtor)
+				MarkType(method.ReturnType);
+
+			for (const ModelVar& param : method.Params)
+				MarkType(param.Type);
+
+			for (const ModelVar& local : method.Locals) {
+				MarkType(local.Type);
+				if (!local.IsConstant() && local.Default != MRK_EXPR_NONE)
+					Walk(context, local.Default);
+			}
+
+			for (mrku32 statement : method.Body)
+				Walk(context, statement);
+
+			ScanForeign(context, method.ForeignBlocks);
+			break;
+		}
+
+		}
+	}
+
+	Reachability::Target Reachability::ResolveName(const Context& context, const char* name) {
+		//params and locals, members up the class chain, then types, as the bytecode compiler looks them up
+		const Target unknown{ Target::Unknown, MRK_TYPE_UNRESOLVED, -1, -1, -1 };
+		const ModelModule& module = m_Model->Modules[context.Module];
+
+		if (context.Method) {
+			const Symbol* symbol = m_Semantic.Lookup(context.Method->Scope, name);
+			if (symbol)
+				return Target{ Target::Value, symbol->TypeId, -1, -1, -1 };
+		}
+
+		for (const ModelClass* scope = context.Class; scope; scope = scope->Parent >= 0 ? &module.Classes[scope->Parent] : 0) {
+			const Symbol* symbol = m_Semantic.Lookup(scope->Scope, name);
+			if (!symbol)
+				continue;
+
+			Target owner{ Target::Type, scope->TypeId, context.Module, scope->Index, -1 };
+			return ResolveMember(owner, name);
+		}
+
+		mrku32 typeId = m_Semantic.FindType(module, *context.Class, name);
+		int typeModule, typeClass;
+		if (GetClassOf(m_Semantic, typeId, typeModule, typeClass))
+			return Target{ Target::Type, typeId, typeModule, typeClass, -1 };
+
+		return unknown;
+	}
+
+	Reachability::Target Reachability::ResolveMember(const Target& owner, const char* name) {
+		const Target unknown{ Target::Unknown, MRK_TYPE_UNRESOLVED, -1, -1, -1 };
+
+		int module = owner.Module;
+		int _class = owner.Class;
+		if (owner.Kind == Target::Value && !GetClassOf(m_Semantic, owner.TypeId, module, _class))
+			module = -1;
+
+		//no static type, every kept class keeps members of that name
+		if (module < 0 || (owner.Kind != Target::Type && owner.Kind != Target::Value)) {
+			AddLooseName(name);
+			return unknown;
+		}
+
+		const ModelClass& scope = m_Model->Modules[module].Classes[_class];
+		const Symbol* symbol = m_Semantic.Lookup(scope.Scope, name);
+		if (!symbol)
+			return unknown;
+
+		switch (symbol->Kind) {
+
+		case SymbolKind::Field:
+			return Target{ Target::Value, symbol->TypeId, module, _class, symbol->Member };
+
+		case SymbolKind::Method:
+			return Target{ Target::Method, scope.Methods[symbol->Member].ReturnType.TypeId, module, _class, symbol->Member };
+
+		case SymbolKind::Type: {
+			int typeModule, typeClass;
+			if (GetClassOf(m_Semantic, symbol->TypeId, typeModule, typeClass))
+				return Target{ Target::Type, symbol->TypeId, typeModule, typeClass, -1 };
+			return unknown;
+		}
+
+		default:
+			return unknown;
+
+		}
+	}
+
+	Reachability::Target Reachability::TypeOf(const Context& context, mrku32 node) {
+		//down the left spine of a.b().c, then back up resolving each step
+		const ExprArena& arena = *m_Model->Modules[context.Module].Expressions;
+		mrks vector<mrku32> spine;
+		for (; arena.Get(node).Kind == ExprKind::Member || arena.Get(node).Kind == ExprKind::Call; node = arena.Get(node).Left)
+			spine.push_back(node);
+
+		Target target{ Target::Unknown, MRK_TYPE_UNRESOLVED, -1, -1, -1 };
+		if (arena.Get(node).Kind == ExprKind::Name)
+			target = ResolveName(context, arena.Get(node).Text);
+
+		for (size_t i = spine.size(); i-- > 0;) {
+			const ExprNode& step = arena.Get(spine[i]);
+			if (step.Kind == ExprKind::Member)
+				target = ResolveMember(target, step.Text);
+			else if (target.Kind == Target::Method || target.Kind == Target::Type)
+				//a call returns the method's type, calling a type constructs one
+				target = Target{ Target::Value, target.TypeId, -1, -1, -1 };
+			else
+				target = Target{ Target::Unknown, MRK_TYPE_UNRESOLVED, -1, -1, -1 };
+		}
+
+		return target;
+	}
+
+	void Reachability::Use(const Target& target) {
+		if (target.Module < 0)
+			return;
+
+		switch (target.Kind) {
+
+		case Target::Type:
+			MarkClass(target.Module, target.Class);
+			break;
+
+		case Target::Value:
+			if (target.Member >= 0)
+				MarkField(target.Module, target.Class, target.Member);
+			break;
+
+		case Target::Method:
+			MarkMethod(target.Module, target.Class, target.Member);
+			break;
+
+		default:
+			break;
+
+		}
+	}
+
+	void Reachability::Walk(const Context& context, mrku32 root) {
+		//bodies can be arbitrarily deep, the walk keeps its own stack
+		const ExprArena& arena = *m_Model->Modules[context.Module].Expressions;
+		size_t base = m_Stack.size();
+		m_Stack.push_back(root);
+
+		while (m_Stack.size() > base) {
+			mrku32 node = m_Stack.back();
+			m_Stack.pop_back();
+			if (node == MRK_EXPR_NONE)
+				continue;
+
+			const ExprNode& expr = arena.Get(node);
+			switch (expr.Kind) {
+
+			case ExprKind::Name:
+				Use(ResolveName(context, expr.Text));
+				break;
+
+			case ExprKind::Member:
+				Use(ResolveMember(TypeOf(context, expr.Left), expr.Text));
+				m_Stack.push_back(expr.Left);
+				break;
+
+			case ExprKind::Call:
+				m_Stack.push_back(expr.Left);
+				for (mrku32 arg = expr.Right; arg != MRK_EXPR_NONE; arg = arena.Get(arg).Next)
+					m_Stack.push_back(arg);
+				break;
+
+			case ExprKind::Unary:
+			case ExprKind::Binary:
+			case ExprKind::Assign:
+			case ExprKind::Index:
+			case ExprKind::Return:
+				m_Stack.push_back(expr.Left);
+				m_Stack.push_back(expr.Right);
+				break;
+
+			default:
+				break;
+
+			}
+		}
+	}
+
+	void Reachability::ScanForeign(const Context& context, const mrks vector<ModelForeignBlock>& blocks) {
+		//the backend language is not parsed: a name after '.', '->' or '::' is a member of something
+		//unknown, any other name is looked up like a name in a body
+		mrks string name;
+		for (const ModelForeignBlock& block : blocks) {
+			const char* text = block.Data;
+			for (size_t i = 0; i < block.Length;) {
+				if (!IsIdentifierByte(text[i], true)) {
+					//numbers with their suffixes are skipped whole
+					if (isdigit((unsigned char)text[i]))
+						while (i < block.Length && IsIdentifierByte(text[i], false))
+							i++;
+					else
+						i++;
+					continue;
+				}
+
+				size_t start = i;
+				while (i < block.Length && IsIdentifierByte(text[i], false))
+					i++;
+				name.assign(text + start, i - start);
+
+				size_t before = start;
+				while (before > 0 && isspace((unsigned char)text[before - 1]))
+					before--;
+
+				bool member = before > 0 && (text[before - 1] == '.' || (before > 1 && (text[before - 1] == '>' || text[before - 1] == ':') && text[before - 2] == (text[before - 1] == '>' ? '-' : ':')));
+				if (member)
+					AddLooseName(name);
+				else
+					Use(ResolveName(context, name.c_str()));
+			}
+		}
+	}
+
+	bool Reachability::FindRoot(const mrks string& root, Item& item) const {
+		size_t separator = root.find("::");
+		mrks string path = root.substr(0, separator);
+		mrks string member = separator == mrks string::npos ? "" : root.substr(separator + 2);
+
+		//Outer.Inner, the first name is a global type
+		mrku32 typeId = MRK_TYPE_UNRESOLVED;
+		for (size_t start = 0; start <= path.size();) {
+			size_t end = mrks min(path.find('.', start), path.size());
+			mrks string name = path.substr(start, end - start);
+
+			if (!start)
+				typeId = m_Semantic.FindGlobalType(name);
+			else {
+				const TypeInfo& outer = m_Semantic.GetType(typeId);
+				const Symbol* symbol = m_Semantic.Lookup(m_Model->Modules[outer.Module].Classes[outer.Class].Scope, name);
+				typeId = symbol && symbol->Kind == SymbolKind::Type ? symbol->TypeId : MRK_TYPE_UNRESOLVED;
+			}
+
+			if (!GetClassOf(m_Semantic, typeId, item.Module, item.Class))
+				return false;
+
+			start = end + 1;
+		}
+
+		item.Kind = ItemKind::Class;
+		item.Member = -1;
+		if (member.empty())
+			return true;
+
+		//ctors are kept with their class
+		const ModelClass& _class = m_Model->Modules[item.Module].Classes[item.Class];
+		if (member == _class.Name)
+			return true;
+
+		const Symbol* symbol = m_Semantic.Lookup(_class.Scope, member);
+		if (!symbol || (symbol->Kind != SymbolKind::Field && symbol->Kind != SymbolKind::Method))
+			return false;
+
+		item.Kind = symbol->Kind == SymbolKind::Field ? ItemKind::Field : ItemKind::Method;
+		item.Member = symbol->Member;
+		return true;
+	}
+
+	void Reachability::Analyze(const Model& model, const mrks vector<mrks string>& roots, size_t inputModules, mrks vector<mrk Error>& errors) {
+		TraceSpan span("Reachability", "");
+
+		m_Model = &model;
+		m_Marks.assign(model.Modules.size(), {});
+		for (size_t m = 0; m < model.Modules.size(); m++)
+			for (const ModelClass& _class : model.Modules[m].Classes)
+				m_Marks[m].push_back(ClassMarks{ false, mrks vector<bool>(_class.Fields.size()), mrks vector<bool>(_class.Methods.size()) });
+
+		m_Pending.clear();
+		m_Kept.clear();
+		m_LooseNames.clear();
+
+		if (roots.empty()) {
+			for (size_t m = 0; m < mrks min(inputModules, model.Modules.size()); m++)
+				for (int root : model.Modules[m].Roots)
+					MarkWhole((int)m, root);
+		}
+
+		for (const mrks string& root : roots) {
+			Item item;
+			if (!FindRoot(root, item)) {
+				errors.push_back(MakeError(m_Semantic.GetErrorArgs(), 0, ErrorCode::UndefinedRoot, MRK_NO_OFFSET, root));
+				continue;
+			}
+
+			if (item.Kind == ItemKind::Class)
+				MarkWhole(item.Module, item.Class);
+			else if (item.Kind == ItemKind::Field)
+				MarkField(item.Module, item.Class, item.Member);
+			else
+				MarkMethod(item.Module, item.Class, item.Member);
+		}
+
+		while (!m_Pending.empty()) {
+			Item item = m_Pending.back();
+			m_Pending.pop_back();
+			Process(item);
+		}
+
+		span.Arg("classes", m_Kept.size());
+	}
+
+	ReachabilityCounts Reachability::GetTotal() const {
+		ReachabilityCounts counts{ 0, 0, 0 };
+		for (const mrks vector<ClassMarks>& module : m_Marks) {
+			counts.Classes += module.size();
+			for (const ClassMarks& marks : module) {
+				counts.Methods += marks.Methods.size();
+				counts.Fields += marks.Fields.size();
+			}
+		}
+
+		return counts;
+	}
+
+	ReachabilityCounts Reachability::GetKept() const {
+		ReachabilityCounts counts{ m_Kept.size(), 0, 0 };
+		for (const mrks vector<ClassMarks>& module : m_Marks) {
+			for (const ClassMarks& marks : module) {
+				counts.Methods += mrks count(marks.Methods.begin(), marks.Methods.end(), true);
+				counts.Fields += mrks count(marks.Fields.begin(), marks.Fields.end(), true);
+			}
+		}
+
+		return counts;
+	}
+
+	void Reachability::Prune(Model& model) const {
+		for (size_t m = 0; m < model.Modules.size(); m++) {
+			ModelModule& module = model.Modules[m];
+			const mrks vector<ClassMarks>& marks = m_Marks[m];
+			auto dropped = [&marks](int index) { return !marks[index].Kept; };
+
+			for (size_t c = 0; c < module.Classes.size(); c++) {
+				ModelClass& _class = module.Classes[c];
+				if (!marks[c].Kept)
+					continue;
+
+				//indices stay those of the model, only the member lists shrink
+				KeepMarked(_class.Fields, marks[c].Fields);
+				KeepMarked(_class.Methods, marks[c].Methods);
+				_class.Nested.erase(mrks remove_if(_class.Nested.begin(), _class.Nested.end(), dropped), _class.Nested.end());
+			}
+
+			module.Roots.erase(mrks remove_if(module.Roots.begin(), module.Roots.end(), dropped), module.Roots.end());
+			UpdateDependencies(module);
+		}
+	}
+
+	void Reachability::WriteReport(mrks ostream& stream) const {
+		for (size_t m = 0; m < m_Marks.size(); m++) {
+			const ModelModule& module = m_Model->Modules[m];
+			bool named = false;
+
+			for (size_t c = 0; c < module.Classes.size(); c++) {
+				const ModelClass& _class = module.Classes[c];
+				const ClassMarks& marks = m_Marks[m][c];
+				const mrks string& fullName = m_Semantic.GetType(_class.TypeId).FullName;
+
+				auto line = [&](const char* kind, const mrks string& name) {
+					if (!named)
+						stream << module.Filename << '\n';
+					named = true;
+					stream << '\t' << kind << ' ' << name << '\n';
+				};
+
+				if (!marks.Kept) {
+					line("class", fullName);
+					continue;
+				}
+
+				for (size_t i = 0; i < _class.Methods.size(); i++)
+					if (!marks.Methods[i])
+						line("method", fullName + "::" + _class.Methods[i].Name);
+
+				for (size_t i = 0; i < _class.Fields.size(); i++)
+					if (!marks.Fields[i])
+						line("field", fullName + "::" + _class.Fields[i].Name);
+			}
+		}
+	}
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <unordered_set>
+
+#include "Common.h"
+#include "Error.h"
+#include "Model.h"
+#include "Semantic.h"
+
+namespace MRK {
+	struct ReachabilityCounts {
+		size_t Classes;
+		size_t Methods; //ctors included
+		size_t Fields;
+	};
+
+	//whole-program reachability over an analyzed model
+	//From the roots it follows declared types (fields, params, locals, return types), names in
+	//method bodies and in var defaults that did not fold (folded ones are emitted as their value),
+	//and identifiers in foreign blocks. A kept class keeps its enclosing classes and its ctors.
+	//Members used on a value whose type is unknown are kept by name in every kept class
+	class Reachability {
+	private:
+		enum class ItemKind : unsigned char {
+			Class,
+			Field,
+			Method
+		};
+
+		struct Item {
+			ItemKind Kind;
+			int Module;
+			int Class;
+			int Member;
+		};
+
+		struct ClassMarks {
+			bool Kept;
+			mrks vector<bool> Fields;
+			mrks vector<bool> Methods;
+		};
+
+		//static type of an expression: a value of a class, the class itself, or a method of it
+		struct Target {
+			enum { Unknown, Value, Type, Method } Kind;
+			mrku32 TypeId; //return type for methods
+			int Module;
+			int Class;
+			int Member;
+		};
+
+		struct Context {
+			int Module;
+			const ModelClass* Class;
+			const ModelMethod* Method; //0 in field defaults and class foreign blocks
+		};
+
+		const Semantic& m_Semantic;
+		const Model* m_Model;
+		mrks vector<mrks vector<ClassMarks>> m_Marks; //by module then class
+		mrks vector<Item> m_Pending;
+		mrks vector<mrks pair<int, int>> m_Kept; //classes in the order they were reached
+		mrks unordered_set<mrks string> m_LooseNames;
+		mrks vector<mrku32> m_Stack; //expression walk
+
+		void MarkClass(int module, int _class);
+		void MarkField(int module, int _class, int field);
+		void MarkMethod(int module, int _class, int method);
+		void MarkType(const ModelType& type);
+		void MarkWhole(int module, int _class);
+		void MarkLoose(int module, int _class);
+		void AddLooseName(const mrks string& name);
+
+		void Process(const Item& item);
+		Target ResolveName(const Context& context, const char* name);
+		Target ResolveMember(const Target& owner, const char* name);
+		Target TypeOf(const Context& context, mrku32 node);
+		void Use(const Target& target);
+		void Walk(const Context& context, mrku32 root);
+		void ScanForeign(const Context& context, const mrks vector<ModelForeignBlock>& blocks);
+		bool FindRoot(const mrks string& root, Item& item) const;
+
+	public:
+		Reachability(const Semantic& semantic);
+
+		//roots are Class, Outer.Inner or Class::member, an empty list means every class of the
+		//first inputModules modules. A class root keeps its whole declaration
+		//Roots naming nothing are reported and ignored
+		void Analyze(const Model& model, const mrks vector<mrks string>& roots, size_t inputModules, mrks vector<mrk Error>& errors);
+
+		bool IsKept(int module, int _class) const { return m_Marks[module][_class].Kept; }
+		ReachabilityCounts GetTotal() const;
+		ReachabilityCounts GetKept() const;
+
+		//drops what was not reached from the model the analysis ran on or a copy of it, root dependencies
+		//are collected again. The marks are by index, a model is pruned once
+		void Prune(Model& model) const;
+
+		//what Prune drops, by module: "class Outer.Inner", "method Class::name", "field Class::name"
+		//members of dropped classes are not listed on their own
+		void WriteReport(mrks ostream& stream) const;
+	};
+}
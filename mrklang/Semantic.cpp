@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Semantic.h"
+#include "Constants.h"
+#include "Trace.h"
+
+namespace MRK {
+	namespace {
+		const char* g_BuiltinNames[MRK_BUILTIN_TYPE_COUNT] = {
+			"", "void", "bool", "byte", "char", "short", "ushort", "int", "uint", "long", "ulong", "float", "double", "string"
+		};
+	}
+
+	Semantic::Semantic() : m_GlobalScope(0), m_Model(0), m_Errors(0), m_KeepNames(false) {
+	}
+
+	void Semantic::Error(const ModelModule& module, mrkpos offset, ErrorCode code, mrku32 arg0, mrku32 arg1) {
+		m_Errors->push_back(MakeError(m_ErrorArgs, module.Origin, code, offset, arg0, arg1));
+	}
+
+	mrku32 Semantic::Qualify(const ModelClass& _class, const mrks string& member) {
+		//Outer.Inner::member, only joined when the error is formatted
+		return m_ErrorArgs.Join(m_ErrorArgs.Intern(m_Types[_class.TypeId].FullName), m_ErrorArgs.Intern(member));
+	}
+
+	mrku32 Semantic::AddSymbol(Symbol symbol) {
+		m_Symbols.push_back(symbol);
+		return (mrku32)m_Symbols.size() - 1;
+	}
+
+	void Semantic::DeclareModule(int moduleIndex) {
+		ModelModule& module = m_Model->Modules[moduleIndex];
+
+		//scopes first, nested classes are declared into their parent's
+		for (ModelClass& _class : module.Classes)
+			_class.Scope = m_Tables.Create((mrku32)(_class.Nested.size() + _class.Fields.size() + _class.Methods.size()));
+
+		for (ModelClass& _class : module.Classes) {
+			mrku32 name = m_Names.Intern(_class.Name);
+			_class.TypeId = (mrku32)m_Types.size();
+
+			mrks string fullName = _class.Name;
+			for (int parent = _class.Parent; parent >= 0; parent = module.Classes[parent].Parent)
+				fullName = module.Classes[parent].Name + '.' + fullName;
+
+			m_Types.push_back(TypeInfo{ name, fullName, BuiltinType::None, moduleIndex, _class.Index });
+
+			mrku32 symbol = AddSymbol(Symbol{ SymbolKind::Type, name, _class.TypeId, moduleIndex, _class.Index, -1 });
+			mrku32 scope = _class.Parent >= 0 ? module.Classes[_class.Parent].Scope : m_GlobalScope;
+			mrku32 existing;
+			if (!m_Tables.Insert(scope, name, symbol, &existing)) {
+				const Symbol& other = m_Symbols[existing];
+				Error(module, _class.Offset, other.Kind == SymbolKind::Type && _class.Parent < 0 ? ErrorCode::DuplicateType : ErrorCode::DuplicateMember,
+					m_ErrorArgs.Intern(fullName), m_ErrorArgs.Intern(other.Module >= 0 ? m_Model->Modules[other.Module].Filename : ""));
+			}
+		}
+
+		for (ModelClass& _class : module.Classes) {
+			for (size_t i = 0; i < _class.Fields.size(); i++) {
+				mrku32 name = m_Names.Intern(_class.Fields[i].Name);
+				if (!m_Tables.Insert(_class.Scope, name, AddSymbol(Symbol{ SymbolKind::Field, name, MRK_TYPE_UNRESOLVED, moduleIndex, _class.Index, (int)i })))
+					Error(module, _class.Fields[i].Offset, ErrorCode::DuplicateMember, Qualify(_class, _class.Fields[i].Name));
+			}
+
+			//ctors share a name, only one of each parameter count is allowed
+			mrks vector<size_t> ctorArities;
+			for (size_t i = 0; i < _class.Methods.size(); i++) {
+				ModelMethod& method = _class.Methods[i];
+				if (method.IsCtor) {
+					if (MRK_VEC_CONTAIN(ctorArities, method.Params.size()))
+						Error(module, method.Offset, ErrorCode::DuplicateConstructor, Qualify(_class, _class.Name), m_ErrorArgs.Intern(mrks to_string(method.Params.size())));
+					else
+						ctorArities.push_back(method.Params.size());
+					continue;
+				}
+
+				mrku32 name = m_Names.Intern(method.Name);
+				if (!m_Tables.Insert(_class.Scope, name, AddSymbol(Symbol{ SymbolKind::Method, name, MRK_TYPE_UNRESOLVED, moduleIndex, _class.Index, (int)i })))
+					Error(module, method.Offset, ErrorCode::DuplicateMember, Qualify(_class, method.Name));
+			}
+		}
+	}
+
+	void Semantic::DeclareIncludes(const ModelModule& module) {
+		//include names live next to the types, so 'v mrk x' can be told apart from a typo
+		//a type of the same name wins, whichever source declares it
+		for (const mrks string& include : module.Includes) {
+			mrku32 name = m_Names.Intern(include);
+			mrku32 existing;
+			if (!m_Tables.Find(m_GlobalScope, name, &existing))
+				m_Tables.Insert(m_GlobalScope, name, AddSymbol(Symbol{ SymbolKind::Module, name, MRK_TYPE_UNRESOLVED, -1, -1, -1 }));
+		}
+	}
+
+	mrku32 Semantic::FindGlobalType(const mrks string& name) const {
+		mrku32 id = m_Names.Find(name);
+		mrku32 symbol;
+		if (id == MRK_NAME_NONE || !m_Tables.Find(m_GlobalScope, id, &symbol) || m_Symbols[symbol].Kind != SymbolKind::Type)
+			return MRK_TYPE_UNRESOLVED;
+
+		return m_Symbols[symbol].TypeId;
+	}
+
+	mrku32 Semantic::FindType(const ModelModule& module, const ModelClass& _class, const mrks string& name) const {
+		//a name nobody declared is not in the interner, no table has to be probed
+		mrku32 id = m_Names.Find(name);
+		if (id == MRK_NAME_NONE)
+			return MRK_TYPE_UNRESOLVED;
+
+		mrku32 symbol;
+		for (const ModelClass* scope = &_class; scope; scope = scope->Parent >= 0 ? &module.Classes[scope->Parent] : 0)
+			if (m_Tables.Find(scope->Scope, id, &symbol) && m_Symbols[symbol].Kind == SymbolKind::Type)
+				return m_Symbols[symbol].TypeId;
+
+		if (m_Tables.Find(m_GlobalScope, id, &symbol) && m_Symbols[symbol].Kind == SymbolKind::Type)
+			return m_Symbols[symbol].TypeId;
+
+		return MRK_TYPE_UNRESOLVED;
+	}
+
+	const Symbol* Semantic::Lookup(mrku32 scope, const mrks string& name) const {
+		mrku32 id = m_Names.Find(name);
+		mrku32 symbol;
+		if (id == MRK_NAME_NONE || !m_Tables.Find(scope, id, &symbol))
+			return 0;
+
+		return &m_Symbols[symbol];
+	}
+
+	void Semantic::Resolve(const ModelModule& module, const ModelClass& _class, ModelType& type, mrkpos offset, const mrks string& member) {
+		if (!type.IsUser())
+			return;
+
+		type.TypeId = FindType(module, _class, type.Name);
+		if (type.TypeId != MRK_TYPE_UNRESOLVED)
+			return;
+
+		mrku32 symbol;
+		mrku32 id = m_Names.Find(type.Name);
+		bool isModule = id != MRK_NAME_NONE && m_Tables.Find(m_GlobalScope, id, &symbol) && m_Symbols[symbol].Kind == SymbolKind::Module;
+		Error(module, offset, isModule ? ErrorCode::NotAType : ErrorCode::UndefinedType, m_ErrorArgs.Intern(type.Name), Qualify(_class, member));
+	}
+
+	void Semantic::ResolveModule(int moduleIndex) {
+		ModelModule& module = m_Model->Modules[moduleIndex];
+
+		for (ModelClass& _class : module.Classes) {
+			for (size_t i = 0; i < _class.Fields.size(); i++) {
+				ModelVar& field = _class.Fields[i];
+				Resolve(module, _class, field.Type, field.Offset, field.Name);
+
+				//the field symbol carries its type for later lookups
+				mrku32 symbol;
+				if (m_Tables.Find(_class.Scope, m_Names.Find(field.Name), &symbol) && m_Symbols[symbol].Member == (int)i)
+					m_Symbols[symbol].TypeId = field.Type.TypeId;
+			}
+
+			for (size_t i = 0; i < _class.Methods.size(); i++) {
+				ModelMethod& method = _class.Methods[i];
+				const mrks string& member = method.IsCtor ? _class.Name : method.Name;
+
+				Resolve(module, _class, method.ReturnType, method.Offset, member);
+				method.Scope = m_Tables.Create((mrku32)(method.Params.size() + method.Locals.size()));
+
+				for (size_t p = 0; p < method.Params.size(); p++) {
+					ModelVar& param = method.Params[p];
+					Resolve(module, _class, param.Type, param.Offset, member);
+
+					mrku32 name = m_Names.Intern(param.Name);
+					if (!m_Tables.Insert(method.Scope, name, AddSymbol(Symbol{ SymbolKind::Param, name, param.Type.TypeId, moduleIndex, _class.Index, (int)p })))
+						Error(module, param.Offset, ErrorCode::DuplicateLocal, m_ErrorArgs.Intern(param.Name), Qualify(_class, member));
+				}
+
+				for (size_t l = 0; l < method.Locals.size(); l++) {
+					ModelVar& local = method.Locals[l];
+					Resolve(module, _class, local.Type, local.Offset, member);
+
+					mrku32 name = m_Names.Intern(local.Name);
+					if (!m_Tables.Insert(method.Scope, name, AddSymbol(Symbol{ SymbolKind::Local, name, local.Type.TypeId, moduleIndex, _class.Index, (int)l })))
+						Error(module, local.Offset, ErrorCode::DuplicateLocal, m_ErrorArgs.Intern(local.Name), Qualify(_class, member));
+				}
+			}
+		}
+	}
+
+	void Semantic::Analyze(Model& model, mrks vector<mrk Error>& errors) {
+		TraceSpan span("Semantic", "");
+
+		m_Model = &model;
+		m_Errors = &errors;
+		m_ErrorArgs.Clear();
+
+		size_t classes = 0;
+		size_t includes = 0;
+		for (ModelModule& module : model.Modules) {
+			classes += module.Classes.size();
+			includes += module.Includes.size();
+		}
+
+		if (!m_KeepNames || !m_Names.GetCount())
+			m_Names = StringInterner(classes * 8 + 64);
+		m_Tables = SymbolTables();
+		m_Symbols.clear();
+		m_Symbols.reserve(classes * 16);
+		m_Types.clear();
+		m_Types.reserve(MRK_BUILTIN_TYPE_COUNT + classes);
+		m_GlobalScope = m_Tables.Create((mrku32)(MRK_BUILTIN_TYPE_COUNT + includes + classes));
+
+		//type ID 0 is 'unresolved', builtins follow in BuiltinType order
+		m_Types.push_back(TypeInfo{ MRK_NAME_NONE, "", BuiltinType::None, -1, -1 });
+		for (mrku32 i = 1; i < MRK_BUILTIN_TYPE_COUNT; i++) {
+			mrku32 name = m_Names.Intern(g_BuiltinNames[i]);
+			m_Types.push_back(TypeInfo{ name, g_BuiltinNames[i], (BuiltinType)i, -1, -1 });
+			m_Tables.Insert(m_GlobalScope, name, AddSymbol(Symbol{ SymbolKind::Type, name, i, -1, -1, -1 }));
+		}
+
+		//every source is declared before anything is resolved, so order between sources doesn't matter
+		for (size_t i = 0; i < model.Modules.size(); i++)
+			DeclareModule((int)i);
+
+		for (const ModelModule& module : model.Modules)
+			DeclareIncludes(module);
+
+		for (size_t i = 0; i < model.Modules.size(); i++)
+			ResolveModule((int)i);
+
+		//defaults can reference constants anywhere, every scope has to exist first
+		Constants(*this).Evaluate(model, errors);
+
+		//folded defaults are emitted as values, only the others need their types
+		for (ModelModule& module : model.Modules)
+			UpdateDependencies(module);
+
+		span.Arg("types", m_Types.size());
+		span.Arg("symbols", m_Symbols.size());
+	}
+}
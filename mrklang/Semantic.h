@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common.h"
+#include "Error.h"
+#include "Model.h"
+#include "Symbols.h"
+
+namespace MRK {
+	enum class SymbolKind : mrku32 {
+		Type,
+		Module,
+		Field,
+		Method,
+		Param,
+		Local
+	};
+
+	struct Symbol {
+		SymbolKind Kind;
+		mrku32 Name;
+		mrku32 TypeId; //the type itself, or the declared type of a member
+		int Module; //-1 for builtins and include names
+		int Class;
+		int Member; //field, method, param or local index, -1 otherwise
+	};
+
+	struct TypeInfo {
+		mrku32 Name;
+		mrks string FullName; //Outer.Inner for nested classes
+		BuiltinType Builtin;
+		int Module;
+		int Class;
+	};
+
+	//semantic resolution of a model: one global type table for all sources and includes,
+	//one table per class (nested types, fields, methods) and per method (params, locals)
+	//Every type reference gets its type ID, undefined and duplicate symbols are reported and var defaults are folded
+	class Semantic {
+	private:
+		StringInterner m_Names;
+		SymbolTables m_Tables;
+		mrks vector<Symbol> m_Symbols;
+		mrks vector<TypeInfo> m_Types; //indexed by type ID
+		mrku32 m_GlobalScope;
+		Model* m_Model;
+		mrks vector<mrk Error>* m_Errors;
+		mutable ErrorArgs m_ErrorArgs; //passes holding a const Semantic report into it too
+		bool m_KeepNames;
+
+		void Error(const ModelModule& module, mrkpos offset, ErrorCode code, mrku32 arg0, mrku32 arg1 = MRK_ERROR_ARG_NONE);
+		mrku32 Qualify(const ModelClass& _class, const mrks string& member);
+		mrku32 AddSymbol(Symbol symbol);
+		void DeclareModule(int moduleIndex);
+		void DeclareIncludes(const ModelModule& module);
+		void ResolveModule(int moduleIndex);
+		void Resolve(const ModelModule& module, const ModelClass& _class, ModelType& type, mrkpos offset, const mrks string& member);
+
+	public:
+		Semantic();
+
+		//may be called again after the model changed, everything is rebuilt
+		//The arguments of the errors stay valid until the next call
+		void Analyze(Model& model, mrks vector<mrk Error>& errors);
+
+		//keep the interned names between analyses, for long-lived instances that see mostly the same names
+		void SetKeepNames(bool keep) { m_KeepNames = keep; }
+
+		//type visible from a class of a module (nested, enclosing, then global), MRK_TYPE_UNRESOLVED if none
+		mrku32 FindType(const ModelModule& module, const ModelClass& _class, const mrks string& name) const;
+		mrku32 FindGlobalType(const mrks string& name) const;
+		const Symbol* Lookup(mrku32 scope, const mrks string& name) const;
+
+		const TypeInfo& GetType(mrku32 id) const { return m_Types[id]; }
+		size_t GetTypeCount() const { return m_Types.size(); }
+		size_t GetSymbolCount() const { return m_Symbols.size(); }
+		const StringInterner& GetNames() const { return m_Names; }
+
+		//arguments of the errors of the last analysis and of the passes that ran on its results
+		ErrorArgs& GetErrorArgs() const { return m_ErrorArgs; }
+	};
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Common.h"
+
+#ifdef MRK_SERVER
+
+#include <string>
+#include <iostream>
+#include <cstring>
+
+#include "CompileServer.h"
+
+//mrk_server [--socket PATH]
+int main(int argc, char** argv) {
+	mrks string path, error;
+	bool found = mrk GetDefaultCompileSocket(path, error);
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--socket") && i + 1 < argc) {
+			path = argv[++i];
+			found = true;
+		}
+		else {
+			mrks cerr << "usage: mrk_server [--socket PATH]\n";
+			return 2;
+		}
+	}
+
+	if (!found) {
+		mrks cerr << "mrk_server: " << error << '\n';
+		return 2;
+	}
+
+	mrk CompileServer server(path);
+	if (!server.Listen(error)) {
+		mrks cerr << "mrk_server: " << error << '\n';
+		return 2;
+	}
+
+	mrks cout << "mrk_server listening on " << path << mrks endl;
+	server.Serve();
+	return 0;
+}
+
+#endif
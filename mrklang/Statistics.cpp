@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Statistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define MRK_MWU_EXACT_LIMIT 40
+
+namespace MRK {
+	namespace {
+		//P(U <= u) under H0, counting the orderings of i values of a and j values of b
+		//with U = s: appending a new largest value from a adds j, from b adds nothing
+		double ExactCdf(int n1, int n2, int u) {
+			int maxU = n1 * n2;
+			mrks vector<mrks vector<double>> prev((size_t)n2 + 1, mrks vector<double>((size_t)maxU + 1, 0));
+			mrks vector<mrks vector<double>> cur = prev;
+
+			//i = 0: only b elements, U = 0
+			for (int j = 0; j <= n2; j++)
+				prev[j][0] = 1;
+
+			for (int i = 1; i <= n1; i++) {
+				for (auto& row : cur)
+					mrks fill(row.begin(), row.end(), 0.0);
+
+				for (int j = 0; j <= n2; j++) {
+					for (int s = 0; s <= maxU; s++) {
+						double ways = s >= j ? prev[j][s - j] : 0;
+						if (j > 0)
+							ways += cur[j - 1][s];
+						cur[j][s] = ways;
+					}
+				}
+
+				mrks swap(prev, cur);
+			}
+
+			double total = 0, below = 0;
+			for (int s = 0; s <= maxU; s++) {
+				total += prev[n2][s];
+				if (s <= u)
+					below += prev[n2][s];
+			}
+
+			return total > 0 ? below / total : 1;
+		}
+
+		double NormalSf(double z) {
+			return 0.5 * erfc(z / sqrt(2.0));
+		}
+	}
+
+	double Median(mrks vector<double> values) {
+		if (values.empty())
+			return 0;
+
+		mrks sort(values.begin(), values.end());
+		size_t mid = values.size() / 2;
+		return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+	}
+
+	double Percentile(mrks vector<double> values, double p) {
+		if (values.empty())
+			return 0;
+
+		mrks sort(values.begin(), values.end());
+		size_t rank = (size_t)mrks ceil(p / 100 * values.size());
+		return values[mrks min(values.size(), mrks max<size_t>(rank, 1)) - 1];
+	}
+
+	MannWhitneyResult MannWhitneyU(const mrks vector<double>& a, const mrks vector<double>& b) {
+		MannWhitneyResult result = { 0, 1, 1, false };
+		size_t n1 = a.size(), n2 = b.size();
+		if (!n1 || !n2)
+			return result;
+
+		//midranks over the pooled sample
+		mrks vector<mrks pair<double, int>> pooled;
+		pooled.reserve(n1 + n2);
+		for (double v : a)
+			pooled.push_back(mrks make_pair(v, 0));
+		for (double v : b)
+			pooled.push_back(mrks make_pair(v, 1));
+		mrks sort(pooled.begin(), pooled.end());
+
+		double rankSumA = 0, tieTerm = 0;
+		bool ties = false;
+		for (size_t i = 0; i < pooled.size();) {
+			size_t j = i;
+			while (j < pooled.size() && pooled[j].first == pooled[i].first)
+				j++;
+
+			double rank = (i + 1 + j) / 2.0;
+			for (size_t k = i; k < j; k++)
+				if (pooled[k].second == 0)
+					rankSumA += rank;
+
+			double t = (double)(j - i);
+			if (t > 1) {
+				ties = true;
+				tieTerm += t * t * t - t;
+			}
+
+			i = j;
+		}
+
+		double u = rankSumA - n1 * (n1 + 1) / 2.0;
+		result.U = u;
+
+		double mean = n1 * n2 / 2.0;
+		if (!ties && n1 + n2 <= MRK_MWU_EXACT_LIMIT) {
+			//U is integral without ties
+			int ui = (int)llround(u);
+			result.PGreater = 1 - (ui > 0 ? ExactCdf((int)n1, (int)n2, ui - 1) : 0);
+			result.PTwoSided = mrks min(1.0, 2 * mrks min(result.PGreater, ExactCdf((int)n1, (int)n2, ui)));
+			result.Exact = true;
+			return result;
+		}
+
+		double n = (double)(n1 + n2);
+		double variance = n1 * n2 / 12.0 * ((n + 1) - tieTerm / (n * (n - 1)));
+		if (variance <= 0)
+			return result; //every value identical, no evidence either way
+
+		double sigma = sqrt(variance);
+		double zGreater = (u - mean - 0.5) / sigma;
+		double zAbs = (mrks fabs(u - mean) - 0.5) / sigma;
+		result.PGreater = NormalSf(zGreater);
+		result.PTwoSided = mrks min(1.0, 2 * NormalSf(mrks max(0.0, zAbs)));
+		return result;
+	}
+}
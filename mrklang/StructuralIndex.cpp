@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "StructuralIndex.h"
+
+#include <cstring>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MRK_STRUCTURAL_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define MRK_STRUCTURAL_BLOCK 64
+
+namespace MRK {
+	namespace {
+		const uint64_t g_EvenBits = 0x5555555555555555ull;
+
+		struct BlockMasks {
+			uint64_t Quote;
+			uint64_t Backslash;
+			uint64_t Braces;
+			uint64_t Semicolon;
+			uint64_t Slash;
+		};
+
+		inline unsigned LowestBit(uint64_t mask) {
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward64(&index, mask);
+			return (unsigned)index;
+#else
+			return (unsigned)__builtin_ctzll(mask);
+#endif
+		}
+
+		inline unsigned CountBits(uint64_t mask) {
+#ifdef _MSC_VER
+			return (unsigned)__popcnt64(mask);
+#else
+			return (unsigned)__builtin_popcountll(mask);
+#endif
+		}
+
+		//bit i becomes the xor of bits 0..i, ones from each opening quote up to its closing one
+		inline uint64_t PrefixXor(uint64_t bits) {
+			bits ^= bits << 1;
+			bits ^= bits << 2;
+			bits ^= bits << 4;
+			bits ^= bits << 8;
+			bits ^= bits << 16;
+			bits ^= bits << 32;
+			return bits;
+		}
+
+		//characters escaped by an odd run of backslashes, simdjson's find_escaped
+		inline uint64_t FindEscaped(uint64_t backslash, uint64_t& prevEscaped) {
+			backslash &= ~prevEscaped;
+			uint64_t followsEscape = backslash << 1 | prevEscaped;
+			uint64_t oddStarts = backslash & ~g_EvenBits & ~followsEscape;
+
+			uint64_t evenSequences = oddStarts + backslash;
+			prevEscaped = evenSequences < oddStarts ? 1 : 0;
+
+			uint64_t invert = evenSequences << 1;
+			return (g_EvenBits ^ invert) & followsEscape;
+		}
+
+#ifdef MRK_STRUCTURAL_SSE2
+		inline uint64_t ToMask(__m128i m0, __m128i m1, __m128i m2, __m128i m3) {
+			uint64_t low = (uint32_t)(_mm_movemask_epi8(m0) | _mm_movemask_epi8(m1) << 16);
+			uint64_t high = (uint32_t)(_mm_movemask_epi8(m2) | _mm_movemask_epi8(m3) << 16);
+			return low | high << 32;
+		}
+
+		inline uint64_t MatchBlock(const __m128i* chunks, char c) {
+			__m128i needle = _mm_set1_epi8(c);
+			return ToMask(_mm_cmpeq_epi8(chunks[0], needle), _mm_cmpeq_epi8(chunks[1], needle),
+				_mm_cmpeq_epi8(chunks[2], needle), _mm_cmpeq_epi8(chunks[3], needle));
+		}
+
+		//false when the block holds nothing that matters, the common case in indentation and names
+		bool ClassifyBlock(const char* block, BlockMasks& masks) {
+			__m128i chunks[4];
+			for (int i = 0; i < 4; i++)
+				chunks[i] = _mm_loadu_si128((const __m128i*)(block + i * 16));
+
+			//both braces in one mask, they are only told apart when pairing
+			__m128i open = _mm_set1_epi8('{');
+			__m128i close = _mm_set1_epi8('}');
+			__m128i braces[4];
+			for (int i = 0; i < 4; i++)
+				braces[i] = _mm_or_si128(_mm_cmpeq_epi8(chunks[i], open), _mm_cmpeq_epi8(chunks[i], close));
+
+			masks.Braces = ToMask(braces[0], braces[1], braces[2], braces[3]);
+			masks.Quote = MatchBlock(chunks, '"');
+			masks.Backslash = MatchBlock(chunks, '\\');
+			masks.Semicolon = MatchBlock(chunks, ';');
+			masks.Slash = MatchBlock(chunks, '/');
+			return (masks.Braces | masks.Quote | masks.Backslash | masks.Semicolon | masks.Slash) != 0;
+		}
+#else
+		bool ClassifyBlock(const char* block, BlockMasks& masks) {
+			memset(&masks, 0, sizeof(masks));
+			for (int i = 0; i < MRK_STRUCTURAL_BLOCK; i++) {
+				uint64_t bit = 1ull << i;
+				switch (block[i]) {
+				case '"': masks.Quote |= bit; break;
+				case '\\': masks.Backslash |= bit; break;
+				case '{': case '}': masks.Braces |= bit; break;
+				case ';': masks.Semicolon |= bit; break;
+				case '/': masks.Slash |= bit; break;
+				}
+			}
+
+			return (masks.Braces | masks.Quote | masks.Backslash | masks.Semicolon | masks.Slash) != 0;
+		}
+#endif
+
+		//a slash followed by / or * starts a comment, the last byte of the block can't tell so it counts
+		inline uint64_t FindCommentStarts(const char* block, uint64_t slash) {
+			if (!slash)
+				return 0;
+
+			uint64_t starts = 0;
+			for (uint64_t bits = slash; bits; bits &= bits - 1) {
+				unsigned bit = LowestBit(bits);
+				if (bit == 63 || block[bit + 1] == '/' || block[bit + 1] == '*')
+					starts |= 1ull << bit;
+			}
+
+			return starts;
+		}
+
+		void AppendPositions(mrks vector<mrkpos>& positions, size_t base, uint64_t bits) {
+			size_t count = positions.size();
+			positions.resize(count + CountBits(bits));
+
+			mrkpos* out = positions.data() + count;
+			while (bits) {
+				*out++ = base + LowestBit(bits);
+				bits &= bits - 1;
+			}
+		}
+	}
+
+	void BuildStructuralIndex(const char* text, size_t size, StructuralIndex& index) {
+		index.Positions.clear();
+		index.Braces = 0;
+
+		//blocks follow each other until a comment, the next one starts where the comment ends
+		uint64_t prevEscaped = 0;
+		uint64_t inString = 0;
+		for (size_t base = 0; base < size;) {
+			size_t count = mrks min((size_t)MRK_STRUCTURAL_BLOCK, size - base);
+
+			//the last partial block is padded with spaces, nothing structural
+			char padded[MRK_STRUCTURAL_BLOCK];
+			const char* block = text + base;
+			if (count < MRK_STRUCTURAL_BLOCK) {
+				memset(padded, ' ', sizeof(padded));
+				memcpy(padded, block, count);
+				block = padded;
+			}
+
+			//prevEscaped only matters when the block starts with a quote or a backslash
+			BlockMasks masks;
+			if (!ClassifyBlock(block, masks)) {
+				prevEscaped = 0;
+				base += MRK_STRUCTURAL_BLOCK;
+				continue;
+			}
+
+			uint64_t escaped = FindEscaped(masks.Backslash, prevEscaped);
+			uint64_t quotes = masks.Quote & ~escaped;
+			uint64_t strings = PrefixXor(quotes) ^ inString;
+			uint64_t structural = (masks.Braces | masks.Semicolon) & ~strings | (quotes & strings);
+
+			//everything up to the first comment outside strings is exact
+			uint64_t comments = FindCommentStarts(block, masks.Slash & ~strings);
+			if (!comments) {
+				index.Braces += CountBits(masks.Braces & ~strings);
+				AppendPositions(index.Positions, base, structural);
+
+				inString = (uint64_t)((int64_t)strings >> 63);
+				base += MRK_STRUCTURAL_BLOCK;
+				continue;
+			}
+
+			unsigned slash = LowestBit(comments);
+			uint64_t before = (1ull << slash) - 1;
+			index.Braces += CountBits(masks.Braces & ~strings & before);
+			AppendPositions(index.Positions, base, structural & before);
+
+			//outside any string at the slash, the same after the comment
+			prevEscaped = 0;
+			inString = 0;
+
+			size_t start = base + slash;
+			char next = start + 1 < size ? text[start + 1] : 0;
+			if (next == '/') {
+				const char* end = (const char*)memchr(text + start + 2, '\n', size - start - 2);
+				base = end ? end - text : size;
+			}
+			else if (next == '*') {
+				base = size;
+				for (const char* p = text + start + 2; p + 1 < text + size; p++) {
+					p = (const char*)memchr(p, '*', text + size - 1 - p);
+					if (!p)
+						break;
+
+					if (p[1] == '/') {
+						base = p + 2 - text;
+						break;
+					}
+				}
+			}
+			else
+				base = start + 1; //the last byte of the block, a plain slash
+		}
+	}
+
+	size_t MatchBraces(const char* text, const StructuralIndex& index, mrks vector<BracePair>& pairs) {
+		pairs.clear();
+
+		//open offsets with how many unparented pairs there were when they opened
+		struct Open { mrkpos Offset; size_t Pending; };
+		mrks vector<Open> opened;
+		mrks vector<mrkidx> pending;
+		size_t unpaired = 0;
+
+		for (mrkpos pos : index.Positions) {
+			char c = text[pos];
+			if (c == '{') {
+				opened.push_back(Open { pos, pending.size() });
+				continue;
+			}
+
+			if (c != '}')
+				continue;
+
+			if (opened.empty()) {
+				unpaired++;
+				continue;
+			}
+
+			//pairs closed since this one opened and still without a parent are its children
+			mrkidx current = (mrkidx)pairs.size();
+			for (size_t i = opened.back().Pending; i < pending.size(); i++)
+				pairs[pending[i]].Parent = current;
+
+			pending.resize(opened.back().Pending);
+			pending.push_back(current);
+
+			pairs.push_back(BracePair { opened.back().Offset, pos, -1 });
+			opened.pop_back();
+		}
+
+		return unpaired + opened.size();
+	}
+}
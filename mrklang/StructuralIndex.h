@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include "Common.h"
+
+namespace MRK {
+	//stage 1 of brace matching, after simdjson: every 64 byte block becomes bitmaps of its structural
+	//characters ({ } ; and the quote opening a string), masking out the ones inside string literals
+	//(prefix XOR of the unescaped quotes) and comments, then the bits are read back as offsets
+	struct StructuralIndex {
+		mrks vector<mrkpos> Positions; //ascending
+		size_t Braces; //how many of the positions are braces
+	};
+
+	//Positions keeps its capacity between calls
+	void BuildStructuralIndex(const char* text, size_t size, StructuralIndex& index);
+
+	struct BracePair {
+		mrkpos Open; //offsets of the braces
+		mrkpos Close;
+		mrkidx Parent; //index of the enclosing pair, -1 at the top level
+	};
+
+	//stage 2, pairs in closing order, innermost first. A '}' with nothing open is skipped, braces
+	//left open at the end have no pair. Returns how many braces were not paired
+	size_t MatchBraces(const char* text, const StructuralIndex& index, mrks vector<BracePair>& pairs);
+}
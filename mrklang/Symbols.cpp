@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Symbols.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace MRK {
+	namespace {
+		size_t NextPowerOfTwo(size_t value) {
+			size_t power = 8;
+			while (power < value)
+				power <<= 1;
+			return power;
+		}
+
+		//names are interned ids, a multiplicative hash spreads consecutive ids
+		inline mrku32 HashName(mrku32 name) {
+			return name * 0x9E3779B1u;
+		}
+	}
+
+	mrku32 StringInterner::Hash(const char* str, size_t len) {
+		//FNV-1a
+		mrku32 hash = 2166136261u;
+		for (size_t i = 0; i < len; i++) {
+			hash ^= (unsigned char)str[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	StringInterner::StringInterner(size_t expected) : m_Slots(NextPowerOfTwo(expected * 2), MRK_NAME_NONE) {
+		m_Strings.reserve(expected);
+		m_Hashes.reserve(expected);
+	}
+
+	void StringInterner::Grow() {
+		mrks vector<mrku32> slots(m_Slots.size() * 2, MRK_NAME_NONE);
+		size_t mask = slots.size() - 1;
+
+		for (mrku32 id = 1; id <= m_Strings.size(); id++) {
+			size_t slot = m_Hashes[id - 1] & mask;
+			while (slots[slot] != MRK_NAME_NONE)
+				slot = (slot + 1) & mask;
+			slots[slot] = id;
+		}
+
+		m_Slots.swap(slots);
+	}
+
+	mrku32 StringInterner::Intern(const char* str, size_t len) {
+		mrku32 hash = Hash(str, len);
+		size_t mask = m_Slots.size() - 1;
+
+		for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+			mrku32 id = m_Slots[slot];
+			if (id == MRK_NAME_NONE) {
+				m_Strings.emplace_back(str, len);
+				m_Hashes.push_back(hash);
+				m_Slots[slot] = (mrku32)m_Strings.size();
+
+				//keep the load under one half
+				if (m_Strings.size() * 2 > m_Slots.size())
+					Grow();
+
+				return (mrku32)m_Strings.size();
+			}
+
+			const mrks string& existing = m_Strings[id - 1];
+			if (m_Hashes[id - 1] == hash && existing.size() == len && memcmp(existing.data(), str, len) == 0)
+				return id;
+		}
+	}
+
+	void StringInterner::Clear() {
+		m_Strings.clear();
+		m_Hashes.clear();
+		mrks fill(m_Slots.begin(), m_Slots.end(), MRK_NAME_NONE);
+	}
+
+	mrku32 StringInterner::Find(const mrks string& str) const {
+		mrku32 hash = Hash(str.data(), str.size());
+		size_t mask = m_Slots.size() - 1;
+
+		for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+			mrku32 id = m_Slots[slot];
+			if (id == MRK_NAME_NONE)
+				return MRK_NAME_NONE;
+
+			if (m_Hashes[id - 1] == hash && m_Strings[id - 1] == str)
+				return id;
+		}
+	}
+
+	mrku32 SymbolTables::Create(mrku32 expected) {
+		size_t capacity = NextPowerOfTwo((size_t)expected * 2);
+		m_Tables.push_back(Table{ m_Slots.size(), (mrku32)(capacity - 1), 0 });
+		m_Slots.resize(m_Slots.size() + capacity, SymbolSlot{ MRK_NAME_NONE, 0 });
+		return (mrku32)m_Tables.size() - 1;
+	}
+
+	void SymbolTables::Grow(mrku32 table) {
+		//the old slots are abandoned, growing only happens when a table was sized too small
+		Table old = m_Tables[table];
+		size_t capacity = ((size_t)old.Mask + 1) * 2;
+		Table& grown = m_Tables[table];
+		grown = Table{ m_Slots.size(), (mrku32)(capacity - 1), 0 };
+		m_Slots.resize(m_Slots.size() + capacity, SymbolSlot{ MRK_NAME_NONE, 0 });
+
+		for (size_t i = 0; i <= old.Mask; i++) {
+			SymbolSlot slot = m_Slots[old.Offset + i];
+			if (slot.Name != MRK_NAME_NONE)
+				Insert(table, slot.Name, slot.Value);
+		}
+	}
+
+	bool SymbolTables::Insert(mrku32 table, mrku32 name, mrku32 value, mrku32* existing) {
+		if ((m_Tables[table].Count + 1) * 2 > m_Tables[table].Mask + 1)
+			Grow(table);
+
+		Table& t = m_Tables[table];
+		SymbolSlot* slots = m_Slots.data() + t.Offset;
+
+		for (mrku32 slot = HashName(name) & t.Mask;; slot = (slot + 1) & t.Mask) {
+			if (slots[slot].Name == MRK_NAME_NONE) {
+				slots[slot] = SymbolSlot{ name, value };
+				t.Count++;
+				return true;
+			}
+
+			if (slots[slot].Name == name) {
+				if (existing)
+					*existing = slots[slot].Value;
+				return false;
+			}
+		}
+	}
+
+	bool SymbolTables::Find(mrku32 table, mrku32 name, mrku32* value) const {
+		const Table& t = m_Tables[table];
+		const SymbolSlot* slots = m_Slots.data() + t.Offset;
+
+		for (mrku32 slot = HashName(name) & t.Mask;; slot = (slot + 1) & t.Mask) {
+			if (slots[slot].Name == MRK_NAME_NONE)
+				return false;
+
+			if (slots[slot].Name == name) {
+				*value = slots[slot].Value;
+				return true;
+			}
+		}
+	}
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common.h"
+
+#define MRK_NAME_NONE 0
+
+namespace MRK {
+	//open addressing (linear probing) string -> id map, ids are dense and start at 1
+	class StringInterner {
+	private:
+		mrks vector<mrks string> m_Strings;
+		mrks vector<mrku32> m_Slots; //id or MRK_NAME_NONE
+		mrks vector<mrku32> m_Hashes; //per id, rehashing never touches the strings
+
+		void Grow();
+
+	public:
+		StringInterner(size_t expected = 64);
+
+		mrku32 Intern(const char* str, size_t len);
+		mrku32 Intern(const mrks string& str) { return Intern(str.data(), str.size()); }
+		mrku32 Find(const mrks string& str) const; //MRK_NAME_NONE if never interned
+
+		const mrks string& GetString(mrku32 id) const { return m_Strings[id - 1]; }
+		size_t GetCount() const { return m_Strings.size(); }
+
+		static mrku32 Hash(const char* str, size_t len);
+
+		void Clear(); //ids start at 1 again, the slots keep their capacity
+	};
+
+	struct SymbolSlot {
+		mrku32 Name;
+		mrku32 Value;
+	};
+
+	//many small open addressing tables (interned name -> value) sharing one slot arena
+	//tables are sized up front from the number of declarations, so filling one never rehashes
+	class SymbolTables {
+	private:
+		struct Table {
+			size_t Offset;
+			mrku32 Mask;
+			mrku32 Count;
+		};
+
+		mrks vector<SymbolSlot> m_Slots;
+		mrks vector<Table> m_Tables;
+
+		void Grow(mrku32 table);
+
+	public:
+		mrku32 Create(mrku32 expected);
+
+		//false if the name is already there, existing receives its value
+		bool Insert(mrku32 table, mrku32 name, mrku32 value, mrku32* existing = 0);
+		bool Find(mrku32 table, mrku32 name, mrku32* value) const;
+
+		size_t GetTableCount() const { return m_Tables.size(); }
+		size_t GetSlotBytes() const { return m_Slots.capacity() * sizeof(SymbolSlot); }
+	};
+}
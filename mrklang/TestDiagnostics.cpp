@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Common.h"
+
+#ifdef MRK_TEST_DIAGNOSTICS
+
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include "Diagnostics.h"
+#include "Error.h"
+#include "Json.h"
+#include "TestCommon.h"
+
+namespace {
+	mrks vector<mrks string> Write(mrk DiagnosticFormat format, size_t limit, const mrks vector<mrk Error>& errors, const mrks string& path) {
+		mrks vector<mrks string> lines;
+		mrk DiagnosticWriter writer(format, limit, [&lines](const mrks string& line) { lines.push_back(line); });
+		for (const mrk Error& err : errors)
+			writer.Report(err, path);
+
+		writer.Note("1 error(s)");
+		writer.Finish();
+		return lines;
+	}
+}
+
+int main() {
+	mrks cout << "Diagnostics test\n";
+
+	//the text is built on demand, the error only holds its code, location and argument ids
+	static_assert(sizeof(mrk Error) <= 40, "errors stay small");
+	mrk Source source{ "A.mrk", "c A {\n\tv int x\n\tv int x\n}\n//\xC3\xA9\xC3\xA9 x\n" };
+
+	Check(mrk FormatError(mrk MakeError(&source, mrk ErrorCode::ExpectedSemicolon)) == "Expected ';'", "no arguments");
+	mrk ErrorArgs names;
+	Check(mrk FormatError(mrk MakeError(names, &source, mrk ErrorCode::UndefinedType, MRK_NO_OFFSET, "Missing", "A::m")) == "Undefined type 'Missing' in A::m", "quoted name and context");
+	Check(mrk FormatError(mrk MakeError(names, &source, mrk ErrorCode::DuplicateType, MRK_NO_OFFSET, "A", "B.mrk")) == "Duplicate type 'A' (first declared in B.mrk)", "first declaration");
+	mrku32 ctor = names.Join(names.Intern("A"), names.Intern("A"));
+	Check(mrk FormatError(mrk MakeError(names, &source, mrk ErrorCode::DuplicateConstructor, MRK_NO_OFFSET, ctor, names.Intern("2"))) == "Duplicate member 'A::A' with 2 parameter(s)", "constructor arity");
+	Check(names.Intern("A") == names.Intern(mrks string("A")) && names.Join(names.Intern("A"), names.Intern("A")) == ctor, "arguments interned once");
+	Check(names.Join(names.Join(names.Intern("A"), names.Intern("m")), names.Intern("x")) != ctor && names.GetString(names.Join(names.Join(names.Intern("A"), names.Intern("m")), names.Intern("x"))) == "A::m::x", "nested joins");
+	Check(mrk GetErrorRuleId(mrk ErrorCode::ExpectedIdentifier) == "MRK0001", "rule id");
+
+	//\u escapes decode to UTF-8, a surrogate without its pair to U+FFFD
+	mrk JsonValue decoded;
+	Check(mrk JsonValue::Parse("\"\\uD83D\\uDE00\\u00e9\"", decoded) && decoded.AsString() == "\xF0\x9F\x98\x80\xC3\xA9", "surrogate pair");
+	Check(mrk JsonValue::Parse("\"\\uD83D\\u0041\"", decoded) && decoded.AsString() == "\xEF\xBF\xBD" "A", "high surrogate before another escape");
+	Check(mrk JsonValue::Parse("\"\\uD83Dx\\uDE00\"", decoded) && decoded.AsString() == "\xEF\xBF\xBD" "x\xEF\xBF\xBD", "lone surrogates");
+	Check(mrk JsonValue::Parse("\"\\uD83D\\uD83D\\uDE00\"", decoded) && decoded.AsString() == "\xEF\xBF\xBD\xF0\x9F\x98\x80", "high surrogate before a pair");
+
+	//one error per location, unlocated ones by code and arguments
+	mrk DiagnosticLimiter limiter(3);
+	Check(limiter.Accept(mrk Error{ &source, mrk ErrorCode::ExpectedIdentifier, 4 }), "first at a location");
+	Check(!limiter.Accept(mrk Error{ &source, mrk ErrorCode::UnexpectedSymbol, 4 }), "follow-up at the same location");
+	Check(limiter.Accept(mrk MakeError(names, &source, mrk ErrorCode::UndefinedName, MRK_NO_OFFSET, "a")), "unlocated");
+	Check(!limiter.Accept(mrk MakeError(names, &source, mrk ErrorCode::UndefinedName, MRK_NO_OFFSET, "a")), "unlocated repeat");
+	Check(limiter.Accept(mrk MakeError(names, &source, mrk ErrorCode::UndefinedName, MRK_NO_OFFSET, "b")), "other arguments");
+	Check(!limiter.Accept(mrk Error{ &source, mrk ErrorCode::ExpectedIdentifier, 9 }) && limiter.GetSuppressed() == 1, "over the limit");
+
+	mrk Source other{ "B.mrk", "" };
+	Check(limiter.Accept(mrk Error{ &other, mrk ErrorCode::ExpectedIdentifier, 4 }), "the limit is per source");
+
+	mrk DiagnosticLimiter unlimited(0);
+	size_t accepted = 0;
+	for (mrku32 i = 0; i < 1000; i++)
+		accepted += unlimited.Accept(mrk Error{ &source, mrk ErrorCode::ExpectedIdentifier, i });
+	Check(accepted == 1000 && unlimited.GetSuppressed() == 0, "no limit");
+
+	mrks vector<mrk Error> errors{
+		mrk Error{ &source, mrk ErrorCode::DuplicateMember, 16 },
+		mrk Error{ &source, mrk ErrorCode::ExpectedIdentifier, 16 },
+		mrk Error{ &source, mrk ErrorCode::UnexpectedSymbol, 33 },
+		mrk MakeError(names, &source, mrk ErrorCode::UndefinedName, MRK_NO_OFFSET, "x", "A::m")
+	};
+
+	mrks vector<mrks string> text = Write(mrk DiagnosticFormat::Text, 0, errors, "/src/A.mrk");
+	Check(text.size() == 4 && text[0] == "/src/A.mrk:3:2: error: Duplicate member" && text[1] == "/src/A.mrk:5:6: error: Unexpected symbol"
+		&& text[2] == "/src/A.mrk: error: Undefined name 'x' in A::m" && text[3] == "1 error(s)", "text: " + (text.empty() ? "" : text[0]));
+
+	//lines and columns are 1 based, columns count code points
+	mrks vector<mrks string> jsonl = Write(mrk DiagnosticFormat::JsonLines, 0, errors, "/src/A.mrk");
+	mrk JsonValue first, second, third;
+	Check(jsonl.size() == 3 && mrk JsonValue::Parse(jsonl[0], first) && mrk JsonValue::Parse(jsonl[1], second) && mrk JsonValue::Parse(jsonl[2], third), "json lines");
+	Check(first.Get("line").AsInt() == 3 && first.Get("column").AsInt() == 2 && first.Get("offset").AsInt() == 16 && first.Get("code").AsString() == "MRK0018"
+		&& first.Get("severity").AsString() == "error", "located line: " + (jsonl.empty() ? "" : jsonl[0]));
+	Check(second.Get("line").AsInt() == 5 && second.Get("column").AsInt() == 6, "column after multibyte characters");
+	Check(!third.Has("line") && third.Get("message").AsString() == "Undefined name 'x' in A::m", "unlocated line");
+
+	mrks vector<mrks string> sarif = Write(mrk DiagnosticFormat::Sarif, 0, errors, "C:\\src dir\\A.mrk");
+	mrk JsonValue log;
+	Check(sarif.size() == 1 && mrk JsonValue::Parse(sarif[0], log) && log.Get("version").AsString() == "2.1.0", "one sarif log");
+
+	const mrk JsonValue& run = log.Get("runs")[0];
+	const mrk JsonValue& results = run.Get("results");
+	const mrk JsonValue& rules = run.Get("tool").Get("driver").Get("rules");
+	Check(results.Size() == 3 && run.Get("columnKind").AsString() == "unicodeCodePoints", "sarif results");
+	for (size_t i = 0; i < results.Size(); i++) {
+		const mrk JsonValue& item = results[i];
+		Check(rules[(size_t)item.Get("ruleIndex").AsInt()].Get("id").AsString() == item.Get("ruleId").AsString(), "rule index " + mrks to_string(i));
+	}
+
+	const mrk JsonValue& location = results[0].Get("locations")[0].Get("physicalLocation");
+	Check(location.Get("artifactLocation").Get("uri").AsString() == "file:///C:/src%20dir/A.mrk", "file uri");
+	Check(location.Get("region").Get("startLine").AsInt() == 3 && location.Get("region").Get("startColumn").AsInt() == 2, "sarif region");
+	Check(!results[2].Get("locations")[0].Get("physicalLocation").Has("region"), "unlocated result");
+
+	Check(Write(mrk DiagnosticFormat::Text, 1, errors, "A.mrk").size() == 2, "limit applied by the writer");
+
+	if (g_Failures) {
+		mrks cout << g_Failures << " failure(s)\n";
+		return 1;
+	}
+
+	mrks cout << "\tAll passed\n";
+	return 0;
+}
+
+#endif
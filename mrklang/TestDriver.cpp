@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Common.h"
+
+#ifdef MRK_TEST_DRIVER
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <filesystem>
+
+#include "Compiler.h"
+#include "Trace.h"
+#include "Json.h"
+#include "TestCommon.h"
+
+namespace {
+	void WriteFile(const mrks filesystem::path& path, const mrks string& text) {
+		mrks filesystem::create_directories(path.parent_path());
+		mrks ofstream(path, mrks ios::binary) << text;
+	}
+
+	mrks string ReadFile(const mrks filesystem::path& path) {
+		mrks ifstream stream(path, mrks ios::binary);
+		mrks stringstream buffer;
+		buffer << stream.rdbuf();
+		return buffer.str();
+	}
+
+	mrks string Relative(const mrks string& path, const mrks filesystem::path& dir) {
+		return mrks filesystem::path(path).lexically_relative(dir).generic_string();
+	}
+}
+
+int main(int argc, char** argv) {
+	mrks cout << "Driver test\n";
+
+	mrks filesystem::path dir = argc > 1 ? mrks filesystem::path(argv[1]) : mrks filesystem::temp_directory_path() / "mrk_test_driver";
+	mrks filesystem::remove_all(dir);
+
+	//40 sources in nested directories, each folding a constant of the previous one
+	for (int i = 0; i < 40; i++) {
+		mrks string name = "C" + mrks to_string(i);
+		mrks string value = i ? "C" + mrks to_string(i - 1) + ".value + 1" : "1";
+		WriteFile(dir / "src" / ("part" + mrks to_string(i % 4)) / (name + ".mrk"), "c " + name + " { v int value { r " + value + " } }");
+	}
+
+	WriteFile(dir / "src" / "notes.txt", "not a source");
+	WriteFile(dir / "extra dir" / "Extra.mrk", "c Extra { v int value { r C39.value } }");
+	WriteFile(dir / "more.rsp", "\"extra dir/Extra.mrk\" --target cpp");
+	WriteFile(dir / "build.rsp", "src @more.rsp\n-o out\n");
+	WriteFile(dir / "broken" / "Broken.mrk", "c Broken { v int value { r } }");
+
+	//directories expand to their sources in path order, response files nest
+	mrk CompileOptions options;
+	mrks string error;
+	Check(mrk ParseCompileArguments({ "@build.rsp", "src/part1/C1.mrk", "-j", "4" }, dir.string(), options, error), "arguments: " + error);
+	Check(options.Inputs.size() == 41, "inputs expanded and deduplicated: " + mrks to_string(options.Inputs.size()));
+	Check(!options.Inputs.empty() && Relative(options.Inputs.front(), dir) == "src/part0/C0.mrk", "directory sorted");
+	Check(!options.Inputs.empty() && Relative(options.Inputs.back(), dir) == "extra dir/Extra.mrk", "quoted path in a nested response file");
+	Check(options.Targets.size() == 1 && options.Threads == 4, "options from the response file");
+
+	mrk CompileOptions missing;
+	Check(!mrk ParseCompileArguments({ "@absent.rsp" }, dir.string(), missing, error) && error.find("absent.rsp") != mrks string::npos, "missing response file: " + error);
+
+	//four threads load and emit, the output matches a single threaded build
+	mrks vector<mrks string> lines;
+	auto sink = [&lines](const mrks string& line) { lines.push_back(line); };
+
+	mrk Compiler compiler;
+	Check(compiler.Compile(options, sink) == 0, "parallel build succeeds");
+	Check(compiler.GetStats().Parsed == 41, "every source parsed once");
+	mrks string parallel = ReadFile(dir / "out" / "cpp" / "Extra.h");
+	Check(parallel.find("40") != mrks string::npos, "constants folded across sources");
+
+	mrk CompileOptions single = options;
+	single.Threads = 1;
+	single.OutputDir = (dir / "single").string();
+	mrk Compiler serial;
+	Check(serial.Compile(single, sink) == 0 && ReadFile(dir / "single" / "cpp" / "Extra.h") == parallel, "same output with one thread");
+
+	Check(compiler.Compile(options, sink) == 0 && compiler.GetStats().Reused == 41, "second build reuses every parse");
+
+	//errors in a source give 1 and name the path, an unreadable one 2
+	lines.clear();
+	mrk CompileOptions broken;
+	Check(mrk ParseCompileArguments({ "src", "broken", "-o", "out", "-j", "4" }, dir.string(), broken, error), "arguments: " + error);
+	Check(compiler.Compile(broken, sink) == 1, "status 1 on a syntax error");
+	Check(!lines.empty() && lines.front().find((dir / "broken" / "Broken.mrk").string() + ":1:") == 0
+		&& lines.front().find(": error: ") != mrks string::npos, "diagnostic streamed with the path and line");
+
+	//the machine readable formats carry nothing but the diagnostics
+	lines.clear();
+	broken.Format = mrk DiagnosticFormat::JsonLines;
+	mrk JsonValue line;
+	Check(compiler.Compile(broken, sink) == 1, "status 1 with json lines");
+	Check(lines.size() == 1 && mrk JsonValue::Parse(lines.front(), line) && line.Get("file").AsString() == (dir / "broken" / "Broken.mrk").string()
+		&& line.Get("line").AsInt() == 1 && line.Get("column").AsInt() == 26 && line.Get("code").AsString() == "MRK0011", "json lines diagnostic: " + (lines.empty() ? "" : lines.front()));
+
+	lines.clear();
+	broken.Format = mrk DiagnosticFormat::Sarif;
+	mrk JsonValue log;
+	Check(compiler.Compile(broken, sink) == 1, "status 1 with sarif");
+	Check(lines.size() == 1 && mrk JsonValue::Parse(lines.front(), log) && log.Get("version").AsString() == "2.1.0"
+		&& log.Get("runs")[0].Get("results").Size() == 1, "one sarif log");
+
+	mrk CompileOptions format;
+	Check(mrk ParseCompileArguments({ "src", "--diagnostics-format", "sarif", "--error-limit", "5" }, dir.string(), format, error)
+		&& format.Format == mrk DiagnosticFormat::Sarif && format.ErrorLimit == 5, "diagnostic options: " + error);
+	Check(!mrk ParseCompileArguments({ "src", "--diagnostics-format", "xml" }, dir.string(), format, error) && error.find("xml") != mrks string::npos, "unknown format rejected");
+
+	lines.clear();
+	mrk CompileOptions absent;
+	Check(mrk ParseCompileArguments({ "src", "Absent.mrk", "-o", "out" }, dir.string(), absent, error), "arguments: " + error);
+	Check(compiler.Compile(absent, sink) == 2, "status 2 on an unreadable source");
+	Check(lines.size() == 1 && lines.front().find("Absent.mrk: error: cannot read") != mrks string::npos, "unreadable source reported");
+
+	//a shared module included whole, only the classes the program reaches are emitted
+	WriteFile(dir / "shared" / "mrk" / "geo.mrk", "c Point { v int x v int unused m .{ } } c Shape { v Point origin } c Unused { v int a }");
+	WriteFile(dir / "app" / "App.mrk", "i mrk.geo; c App { v Shape shape m int X { r shape.origin.x } }");
+
+	mrk CompileOptions whole;
+	Check(mrk ParseCompileArguments({ "app", "-I", "shared", "-o", "whole", "--target", "cpp" }, dir.string(), whole, error), "arguments: " + error);
+	Check(compiler.Compile(whole, sink) == 0 && mrks filesystem::exists(dir / "whole" / "cpp" / "Unused.h"), "included module emitted whole by default");
+
+	lines.clear();
+	mrk CompileOptions reachable;
+	Check(mrk ParseCompileArguments({ "app", "-I", "shared", "-o", "reach", "--target", "cpp", "--reachable-only", "--reachability-report", "reach/removed.txt" }, dir.string(), reachable, error)
+		&& reachable.ReachableOnly && reachable.Roots.empty(), "reachability arguments: " + error);
+	Check(compiler.Compile(reachable, sink) == 0, "reachable build succeeds");
+	Check(mrks filesystem::exists(dir / "reach" / "cpp" / "App.h") && mrks filesystem::exists(dir / "reach" / "cpp" / "Shape.h")
+		&& mrks filesystem::exists(dir / "reach" / "cpp" / "Point.h"), "reached classes emitted");
+	Check(!mrks filesystem::exists(dir / "reach" / "cpp" / "Unused.h"), "unreached class not emitted");
+	Check(ReadFile(dir / "reach" / "cpp" / "Point.h").find("unused") == mrks string::npos, "unreached field not emitted");
+	Check(ReadFile(dir / "reach" / "removed.txt") == (dir / "shared" / "mrk" / "geo.mrk").filename().string() + "\n\tfield Point::unused\n\tclass Unused\n", "report lists what was removed: " + ReadFile(dir / "reach" / "removed.txt"));
+
+	bool summary = false;
+	for (const mrks string& line : lines)
+		summary |= line.find("reachability: 3 of 4 classes") != mrks string::npos;
+	Check(summary, "reachability summary");
+
+	lines.clear();
+	reachable.Roots = { "App", "Missing" };
+	Check(compiler.Compile(reachable, sink) == 1, "status 1 on an undefined root");
+	Check(!lines.empty() && lines.front().find("Undefined reachability root 'Missing'") != mrks string::npos, "undefined root reported");
+
+	//-ftime-trace writes the Chrome trace of that compilation and stops recording afterwards
+	mrk CompileOptions traced;
+	Check(mrk ParseCompileArguments({ "app", "-I", "shared", "-o", "traced", "-ftime-trace", "traces/build.json" }, dir.string(), traced, error)
+		&& traced.TimeTrace == (dir / "traces" / "build.json").string(), "trace arguments: " + error);
+	Check(compiler.Compile(traced, sink) == 0, "traced build succeeds");
+
+	mrks string trace = ReadFile(dir / "traces" / "build.json");
+	Check(trace.find("\"traceEvents\"") != mrks string::npos && trace.find("\"name\":\"Compile\"") != mrks string::npos
+		&& trace.find("\"name\":\"EmitTargets\"") != mrks string::npos, "trace covers the compilation");
+	Check(!mrk Trace::IsEnabled(), "tracing off after the traced build");
+
+	if (g_Failures) {
+		mrks cout << g_Failures << " failure(s)\n";
+		return 1;
+	}
+
+	mrks cout << "\tAll passed\n";
+	return 0;
+}
+
+#endif
@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Common.h"
+
+#ifdef MRK_TEST_EMITTER
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <filesystem>
+#include <chrono>
+
+#include "Parser.h"
+#include "Model.h"
+#include "Semantic.h"
+#include "CppEmitter.h"
+#include "EmitPipeline.h"
+#include "Corpus.h"
+#include "TestCommon.h"
+
+namespace {
+	mrks string ReadFile(const mrks filesystem::path& path) {
+		mrks ifstream stream(path, mrks ios::binary);
+		mrks stringstream buffer;
+		buffer << stream.rdbuf();
+		return buffer.str();
+	}
+
+	void Expect(const mrks string& text, const mrks string& needle, const mrks string& file) {
+		if (text.find(needle) == mrks string::npos) {
+			mrks cout << "\tMissing in " << file << ": " << needle << '\n';
+			g_Failures++;
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	mrks cout << "Emitter test\n";
+
+	mrks filesystem::path dir = argc > 1 ? mrks filesystem::path(argv[1]) : mrks filesystem::temp_directory_path() / "mrk_test_emitter";
+	mrks filesystem::create_directories(dir);
+
+	mrk Parser parser(mrks vector<mrk Source> {
+		mrk Source{
+			"INTERNAL.mrk",
+			"i mrk; c Entity { v int id v string name v Vector3 position v int maxId { r 1 << 20 } v string tag { r \"ent\" + \"ity\" } v Vector3 origin { r Vector3() } "
+			"c Transform { v float scale v double unit { r 3 } m void Reset { } } "
+			"m .{ p { int id1 } id = id1 } m Transform GetTransform { p { bool local int depth } v Transform result } } c Vector3 { v float x "
+			"v double half { r Entity.Transform.unit / 2 } v ulong mask { r ~0UL } v int count { r Scale() + 1 } "
+			"m int Scale { v int limit { r Entity.maxId - 1 } v Entity owner { r Entity(limit) } owner.id += 1 r owner.id * 2 x = 1 } "
+			"m void Probe { p { int n } n > 0 && Scale() > n } "
+			"m void Log { __cpp { std::puts(\"}\"); } __cs { System.Console.WriteLine(\"}\"); } __java { System.out.println(\"}\"); } } }"
+		}
+	});
+
+	mrk ParserResult result;
+	parser.Start(result);
+	for (mrk Error& err : result.Errors)
+		mrks cout << "\tError: " << mrk FormatError(err) << '\n';
+
+	mrk Model model;
+	mrk ResolveModel(parser, model);
+
+	//folds the var defaults into constants
+	mrk Semantic semantic;
+	semantic.Analyze(model, result.Errors);
+	for (mrk Error& err : result.Errors)
+		mrks cout << "\tSemantic error: " << mrk FormatError(err) << '\n';
+
+	//all targets in one pass, each in its own tree
+	mrks vector<mrk EmitResult> emitted = mrk EmitTargets(model, {
+		mrk EmitRequest{ mrk EmitTarget::Cpp, (dir / "cpp").string() },
+		mrk EmitRequest{ mrk EmitTarget::Cs, (dir / "cs").string() },
+		mrk EmitRequest{ mrk EmitTarget::Java, (dir / "java").string() }
+	});
+
+	for (mrk EmitResult& res : emitted) {
+		mrks cout << '\t' << mrk GetTargetName(res.Target) << ": " << res.Files.size() << " files, " << res.Bytes << " bytes\n";
+		if (!res.Success) {
+			mrks cout << "\tEmit failed\n";
+			return 1;
+		}
+	}
+
+	//small buffer, exercises the writev path
+	mrk OutputWriter writer(64);
+	mrk CppEmitter emitter(writer, (dir / "cpp-small").string());
+	mrks filesystem::create_directories(dir / "cpp-small");
+	mrks vector<mrks string> files;
+	if (!emitter.Emit(model.Modules.front(), &files) || ReadFile(dir / "cpp-small" / "Entity.cpp") != ReadFile(dir / "cpp" / "Entity.cpp")) {
+		mrks cout << "\tSmall buffer output differs\n";
+		g_Failures++;
+	}
+
+	dir /= "cpp";
+
+	mrks string header = ReadFile(dir / "Entity.h");
+	Expect(header, "#pragma once", "Entity.h");
+	Expect(header, "#include <string>", "Entity.h");
+	Expect(header, "#include \"Vector3.h\"", "Entity.h");
+	Expect(header, "class Entity {", "Entity.h");
+	Expect(header, "\tclass Transform {", "Entity.h");
+	Expect(header, "\t\tvoid Reset();", "Entity.h");
+	Expect(header, "\tstd::string name;", "Entity.h");
+	Expect(header, "\tEntity() = default;\n\tEntity(int id1);", "Entity.h");
+	Expect(header, "\tTransform GetTransform(bool local, int depth);", "Entity.h");
+
+	mrks string source = ReadFile(dir / "Entity.cpp");
+	Expect(source, "#include \"Entity.h\"", "Entity.cpp");
+	Expect(source, "Entity::Entity(int id1) {\n\tid = id1;\n}", "Entity.cpp");
+	Expect(source, "Transform Entity::GetTransform(bool local, int depth) {\n\tTransform result{};\n\treturn {};\n}", "Entity.cpp");
+	Expect(source, "void Entity::Transform::Reset() {\n}", "Entity.cpp");
+
+	if (header.find("#include \"Transform.h\"") != mrks string::npos) {
+		mrks cout << "\tNested type included as a file\n";
+		g_Failures++;
+	}
+
+	Expect(ReadFile(dir / "Vector3.h"), "\tfloat x;", "Vector3.h");
+
+	//constants
+	Expect(header, "\tstatic constexpr int maxId = 1048576;", "Entity.h");
+	Expect(header, "\tstatic inline const std::string tag = \"entity\";", "Entity.h");
+	Expect(header, "\t\tstatic constexpr double unit = 3.0;", "Entity.h");
+	Expect(ReadFile(dir / "Vector3.h"), "\tstatic constexpr double half = 1.5;\n\tstatic constexpr unsigned long long mask = 18446744073709551615ull;", "Vector3.h");
+	Expect(ReadFile(dir / "Vector3.cpp"), "int Vector3::Scale() {\n\tconstexpr int limit = 1048575;\n\tEntity owner = Entity(limit);\n\towner.id += 1;\n\treturn owner.id * 2;\n}", "Vector3.cpp");
+	Expect(ReadFile(dir.parent_path() / "cs" / "Entity.cs"), "\tpublic const string tag = \"entity\";", "Entity.cs");
+	Expect(ReadFile(dir.parent_path() / "cs" / "Vector3.cs"), "\tpublic const ulong mask = 18446744073709551615UL;", "Vector3.cs");
+	Expect(ReadFile(dir.parent_path() / "cs" / "Vector3.cs"), "\t\tconst int limit = 1048575;", "Vector3.cs");
+	Expect(ReadFile(dir.parent_path() / "java" / "Entity.java"), "\t\tpublic static final double unit = 3.0;", "Entity.java");
+	Expect(ReadFile(dir.parent_path() / "java" / "Vector3.java"), "\tpublic static final long mask = 0xFFFFFFFFFFFFFFFFL;", "Vector3.java");
+	Expect(ReadFile(dir.parent_path() / "java" / "Vector3.java"), "\t\tfinal int limit = 1048575;", "Vector3.java");
+	Expect(ReadFile(dir / "Vector3.cpp"), "void Vector3::Log() {\nstd::puts(\"}\");\n}", "Vector3.cpp");
+	Expect(ReadFile(dir.parent_path() / "cs" / "Vector3.cs"), "\tpublic void Log() {\nSystem.Console.WriteLine(\"}\");\n\t}", "Vector3.cs");
+	Expect(ReadFile(dir.parent_path() / "java" / "Vector3.java"), "\tpublic void Log() {\nSystem.out.println(\"}\");\n\t}", "Vector3.java");
+
+	//defaults that do not fold run when the object is built or the method runs
+	Expect(header, "\tVector3 origin = Vector3();", "Entity.h");
+	Expect(ReadFile(dir / "Vector3.h"), "\tint count = Scale() + 1;", "Vector3.h");
+	Expect(ReadFile(dir / "Vector3.cpp"), "#include \"Vector3.h\"\n#include \"Entity.h\"", "Vector3.cpp");
+	Expect(ReadFile(dir.parent_path() / "cs" / "Entity.cs"), "\tpublic Entity(int id1) {\n\t\torigin = new Vector3();", "Entity.cs");
+	Expect(ReadFile(dir.parent_path() / "cs" / "Vector3.cs"), "\tpublic Vector3() {\n\t\tcount = Scale() + 1;\n\t}", "Vector3.cs");
+	Expect(ReadFile(dir.parent_path() / "cs" / "Vector3.cs"), "\t\tEntity owner = new Entity(limit);", "Vector3.cs");
+	Expect(ReadFile(dir.parent_path() / "java" / "Entity.java"), "\tpublic Vector3 origin = new Vector3();", "Entity.java");
+	Expect(ReadFile(dir.parent_path() / "java" / "Vector3.java"), "\tpublic int count = Scale() + 1;", "Vector3.java");
+
+	//statements up to the first return, values nothing reads are discarded the way each target allows
+	Expect(ReadFile(dir / "Vector3.cpp"), "void Vector3::Probe(int n) {\n\t(n > 0) && (Scale() > n);\n}", "Vector3.cpp");
+	Expect(ReadFile(dir.parent_path() / "cs" / "Vector3.cs"), "\t\towner.id += 1;\n\t\treturn owner.id * 2;\n\t}", "Vector3.cs");
+	Expect(ReadFile(dir.parent_path() / "cs" / "Vector3.cs"), "\t\t_ = (n > 0) && (Scale() > n);", "Vector3.cs");
+	Expect(ReadFile(dir.parent_path() / "java" / "Entity.java"), "\tpublic Entity(int id1) {\n\t\tid = id1;\n\t}", "Entity.java");
+	Expect(ReadFile(dir.parent_path() / "java" / "Vector3.java"), "\t\tjava.util.Objects.hashCode((n > 0) && (Scale() > n));", "Vector3.java");
+
+	mrks string cs = ReadFile(dir.parent_path() / "cs" / "Entity.cs");
+	Expect(cs, "public class Entity {", "Entity.cs");
+	Expect(cs, "\tpublic class Transform {", "Entity.cs");
+	Expect(cs, "\tpublic string name;", "Entity.cs");
+	Expect(cs, "\tpublic Transform GetTransform(bool local, int depth) {\n\t\tTransform result = default;\n\t\treturn default;\n\t}", "Entity.cs");
+
+	mrks string java = ReadFile(dir.parent_path() / "java" / "Entity.java");
+	Expect(java, "public class Entity {", "Entity.java");
+	Expect(java, "\tpublic static class Transform {", "Entity.java");
+	Expect(java, "\tpublic String name;", "Entity.java");
+	Expect(java, "\tpublic Transform GetTransform(boolean local, int depth) {\n\t\tTransform result = null;\n\t\treturn null;\n\t}", "Entity.java");
+
+	//one job per root on the pool, the trees must not depend on the thread count
+	mrk Parser corpusParser(mrks vector<mrk Source> { mrk Source{ "generated.mrk", mrk GenerateCorpus(300) } });
+	mrk ParserResult corpusResult;
+	corpusParser.Start(corpusResult);
+
+	mrk Model corpus;
+	mrk ResolveModel(corpusParser, corpus);
+	mrk Semantic().Analyze(corpus, corpusResult.Errors);
+
+	mrks vector<mrks vector<mrk EmitResult>> runs;
+	for (unsigned threads : { 1u, 4u }) {
+		mrks filesystem::path out = dir.parent_path() / ("threads-" + mrks to_string(threads));
+		mrks filesystem::remove_all(out);
+
+		mrk WorkPool pool(threads);
+		runs.push_back(mrk EmitTargets(corpus, {
+			mrk EmitRequest{ mrk EmitTarget::Cpp, (out / "cpp").string() },
+			mrk EmitRequest{ mrk EmitTarget::Cs, (out / "cs").string() },
+			mrk EmitRequest{ mrk EmitTarget::Java, (out / "java").string() }
+		}, pool));
+	}
+
+	for (size_t t = 0; t < runs[0].size(); t++) {
+		mrk EmitResult& serial = runs[0][t];
+		mrk EmitResult& parallel = runs[1][t];
+		if (!serial.Success || !parallel.Success || serial.Bytes != parallel.Bytes || serial.Files.size() != parallel.Files.size()) {
+			mrks cout << "	Parallel " << mrk GetTargetName(serial.Target) << " output differs in size\n";
+			g_Failures++;
+			continue;
+		}
+
+		for (size_t f = 0; f < serial.Files.size(); f++) {
+			mrks filesystem::path a = serial.Files[f], b = parallel.Files[f];
+			if (a.filename() != b.filename() || ReadFile(a) != ReadFile(b)) {
+				mrks cout << "	Parallel output differs: " << b.string() << '\n';
+				g_Failures++;
+				break;
+			}
+		}
+	}
+
+	mrks cout << runs[1][0].Files.size() + runs[1][1].Files.size() + runs[1][2].Files.size() << " files identical at 1 and 4 threads\n";
+
+	//incremental: unchanged roots are skipped by hash, regenerated files are only written when their bytes differ
+	{
+		mrks filesystem::path out = dir.parent_path() / "incremental";
+		mrks filesystem::remove_all(out);
+
+		const char* versions[] = {
+			"c A { v int x } c B { v int y v string label m void F { } } c C { v B b }",
+			"c A { v int x } c B { v int y v string label m void F { } } c C { v B b }", //same model again
+			"c A { v int x } c B { v int y m void F { } } c C { v B b }", //B.h gets shorter, B.cpp stays
+			"c A { v int x } c B { v int y m void F { __java { y = 2; } } } c C { v B b }" //new hash, same C++ and C# bytes
+		};
+
+		//written, unchanged, skipped for C++ then C#
+		size_t expected[][6] = {
+			{ 6, 0, 0, 3, 0, 0 },
+			{ 0, 0, 3, 0, 0, 3 },
+			{ 1, 1, 2, 1, 0, 2 },
+			{ 0, 2, 2, 0, 1, 2 }
+		};
+
+		auto old = mrks filesystem::file_time_type::clock::now() - mrks chrono::hours(1);
+
+		for (int v = 0; v < 4; v++) {
+			mrk Parser versionParser(mrks vector<mrk Source> { mrk Source{ "Incremental.mrk", versions[v] } });
+			mrk ParserResult versionResult;
+			versionParser.Start(versionResult);
+
+			mrk Model versionModel;
+			mrk ResolveModel(versionParser, versionModel);
+			mrk Semantic().Analyze(versionModel, versionResult.Errors);
+
+			//outputs written by earlier runs look old, a rewrite makes them new
+			if (mrks filesystem::exists(out / "cpp"))
+				for (auto& entry : mrks filesystem::directory_iterator(out / "cpp"))
+					mrks filesystem::last_write_time(entry.path(), old);
+
+			mrk EmitRequest cpp{ mrk EmitTarget::Cpp, (out / "cpp").string() };
+			mrk EmitRequest cs{ mrk EmitTarget::Cs, (out / "cs").string() };
+			cpp.Incremental = cs.Incremental = true;
+			mrks vector<mrk EmitResult> incremental = mrk EmitTargets(versionModel, { cpp, cs }, 2);
+
+			mrks string label = "incremental run " + mrks to_string(v + 1);
+			for (int t = 0; t < 2; t++) {
+				mrk EmitResult& res = incremental[t];
+				if (!res.Success || res.Written != expected[v][t * 3] || res.Unchanged != expected[v][t * 3 + 1] || res.Skipped != expected[v][t * 3 + 2]) {
+					mrks cout << "\t" << label << ' ' << mrk GetTargetName(res.Target) << ": " << res.Written << " written, "
+						<< res.Unchanged << " unchanged, " << res.Skipped << " skipped\n";
+					g_Failures++;
+				}
+			}
+
+			size_t touched = 0;
+			for (auto& entry : mrks filesystem::directory_iterator(out / "cpp"))
+				touched += entry.path().extension() != "" && mrks filesystem::last_write_time(entry.path()) != old;
+
+			if (touched != expected[v][0]) {
+				mrks cout << "\t" << label << ": " << touched << " C++ file(s) touched\n";
+				g_Failures++;
+			}
+
+			//same bytes as a clean build
+			mrk EmitRequest fresh{ mrk EmitTarget::Cpp, (out / "fresh").string() };
+			mrks filesystem::remove_all(out / "fresh");
+			mrks vector<mrk EmitResult> clean = mrk EmitTargets(versionModel, { fresh }, 1);
+			for (size_t f = 0; f < clean[0].Files.size(); f++) {
+				mrks filesystem::path name = mrks filesystem::path(clean[0].Files[f]).filename();
+				if (ReadFile(out / "cpp" / name) != ReadFile(clean[0].Files[f])) {
+					mrks cout << "\t" << label << ": " << name.string() << " differs from a clean build\n";
+					g_Failures++;
+				}
+			}
+		}
+	}
+
+	mrks cout << files.size() << " files, " << writer.GetBytesWritten() << " bytes, " << g_Failures << " failure(s)\n";
+	return result.Errors.empty() && !g_Failures && files.size() == 4 && emitted[1].Files.size() == 2 && emitted[2].Files.size() == 2 ? 0 : 1;
+}
+
+#endif
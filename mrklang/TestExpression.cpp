@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Common.h"
+
+#ifdef MRK_TEST_EXPRESSION
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+#include "Parser.h"
+#include "Model.h"
+#include "Semantic.h"
+#include "Corpus.h"
+#include "TestCommon.h"
+
+namespace {
+	//s-expression of a small tree, (op lhs rhs)
+	mrks string Print(const mrk ExprArena& arena, mrku32 index) {
+		if (index == MRK_EXPR_NONE)
+			return "";
+
+		const mrk ExprNode& node = arena.Get(index);
+		switch (node.Kind) {
+
+		case mrk ExprKind::Int: return mrks to_string(node.Int);
+		case mrk ExprKind::UInt: return mrks to_string(node.UInt) + "ul";
+		case mrk ExprKind::Bool: return node.Int ? "true" : "false";
+		case mrk ExprKind::String: return mrks string("\"") + node.Text + '"';
+		case mrk ExprKind::Name: return node.Text;
+		case mrk ExprKind::Unary: return mrks string("(") + mrk GetOperatorText(node.Op) + ' ' + Print(arena, node.Left) + ')';
+		case mrk ExprKind::Binary: return mrks string("(") + mrk GetOperatorText(node.Op) + ' ' + Print(arena, node.Left) + ' ' + Print(arena, node.Right) + ')';
+		case mrk ExprKind::Assign: return mrks string("(") + mrk GetOperatorText(node.Op) + "= " + Print(arena, node.Left) + ' ' + Print(arena, node.Right) + ')';
+		case mrk ExprKind::Member: return "(. " + Print(arena, node.Left) + ' ' + node.Text + ')';
+		case mrk ExprKind::Index: return "([] " + Print(arena, node.Left) + ' ' + Print(arena, node.Right) + ')';
+		case mrk ExprKind::Return: return node.Left == MRK_EXPR_NONE ? "(r)" : "(r " + Print(arena, node.Left) + ')';
+
+		case mrk ExprKind::Call: {
+			mrks string out = "(call " + Print(arena, node.Left);
+			for (mrku32 arg = node.Right; arg != MRK_EXPR_NONE; arg = arena.Get(arg).Next)
+				out += ' ' + Print(arena, arg);
+			return out + ')';
+		}
+
+		default: return "?";
+
+		}
+	}
+
+	struct Parsed {
+		mrk Parser Parser;
+		mrk ParserResult Result;
+		const mrk SourceParseContext* Context;
+
+		Parsed(const mrks string& code) : Parser(mrks vector<mrk Source> { mrk Source{ "Test.mrk", code } }) {
+			Parser.Start(Result);
+			Context = Parser.GetParseContext(&Parser.GetSources().front());
+		}
+
+		const mrk ParseMethod& Method(mrku32 _class, mrku32 method) const {
+			return Context->ParseClasses[_class].Methods[method];
+		}
+
+		mrks string Statement(mrku32 _class, mrku32 method, mrku32 statement) const {
+			const mrk ParseMethod& parsed = Method(_class, method);
+			return statement < parsed.Body.size() ? Print(Context->Expressions, parsed.Body[statement]) : "<none>";
+		}
+	};
+
+	double ParseSeconds(const mrks string& code) {
+		auto start = mrks chrono::steady_clock::now();
+		Parsed parsed(code);
+		return mrks chrono::duration<double>(mrks chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main() {
+	mrks cout << "Expression test\n";
+
+	//precedence, associativity, postfix chains and keywords used as names
+	Parsed shape(
+		"c Shape { v int a "
+		"m int Area { p { int x int y } x = a + y * 2 - -x << 1 "
+		"m = Math.Sqrt(x * x + y * y, 1)[0].w "
+		"a += !(x < y) && y != 2 || ~x == 3; v int local { r 2 * 3 } v = p = 1 r m } "
+		"m void Reset { r } m .{ p { int x1 } a = x1 } }"
+	);
+
+	for (mrk Error& err : shape.Result.Errors)
+		mrks cout << "\t" << mrk FormatError(err) << '\n';
+
+	Check(shape.Result.Errors.empty(), "bodies parse without errors");
+	Check(shape.Statement(0, 0, 0) == "(= x (<< (- (+ a (* y 2)) (- x)) 1))", "binary precedence and unary minus");
+	Check(shape.Statement(0, 0, 1) == "(= m (. ([] (call (. Math Sqrt) (+ (* x x) (* y y)) 1) 0) w))", "calls, indexing and members");
+	Check(shape.Statement(0, 0, 2) == "(+= a (|| (&& (! (< x y)) (!= y 2)) (== (~ x) 3)))", "compound assignment and logic");
+	Check(shape.Statement(0, 0, 3) == "(= v (= p 1))", "right associative assignment");
+	Check(shape.Statement(0, 0, 4) == "(r m)", "return value");
+	Check(shape.Method(0, 0).Body.size() == 5, "five statements");
+	Check(shape.Method(0, 0).Vars.size() == 1 && shape.Method(0, 0).Vars[0].Default != MRK_EXPR_NONE, "declaration between statements");
+	Check(shape.Statement(0, 1, 0) == "(r)", "bare return");
+	Check(shape.Statement(0, 2, 0) == "(= a x1)", "ctor body after params");
+
+	//errors are reported and parsing resumes with the next statement
+	Parsed broken("c E { m void F { x = (1 + 2 y = 3 1 = x z = f(1, ] w = 4 } }");
+	Check(broken.Result.Errors.size() == 3, "3 syntax errors");
+	Check(HasError(broken.Result.Errors, mrk ErrorCode::ExpectedCloseParen), "unclosed group");
+	Check(HasError(broken.Result.Errors, mrk ErrorCode::InvalidAssignment), "assignment to a literal");
+	Check(HasError(broken.Result.Errors, mrk ErrorCode::ExpectedExpression), "missing argument");
+	Check(broken.Method(0, 0).Body.size() == 2 && broken.Statement(0, 0, 1) == "(= w 4)", "recovery");
+
+	Parsed trailing("c E { v int a { r 1 2 } }");
+	Check(HasError(trailing.Result.Errors, mrk ErrorCode::UnexpectedSymbol) && trailing.Context->ParseClasses[0].Fields[0].Default == MRK_EXPR_NONE, "trailing tokens in a default");
+
+	//nesting is bounded by memory, not by the C stack
+	const mrku32 depth = 200000;
+	Parsed groups("c D { m int F { r " + mrks string(depth, '(') + "1" + mrks string(depth, ')') + " } }");
+	Check(groups.Result.Errors.empty() && groups.Statement(0, 0, 0) == "(r 1)" && groups.Context->Expressions.GetCount() == 2, "deep groups add no nodes");
+
+	mrks string assigns;
+	for (mrku32 i = 0; i < depth; i++)
+		assigns += "a = ";
+
+	Parsed chain("c D { m void F { " + assigns + "1 } }");
+	Check(chain.Result.Errors.empty() && chain.Context->Expressions.GetCount() == 2 * depth + 1, "deep right associative chain");
+
+	//folding walks the same trees without recursion
+	mrks string sum = "1";
+	for (mrku32 i = 1; i < depth; i++)
+		sum += " + 1";
+
+	mrk Parser folded(mrks vector<mrk Source> {
+		mrk Source{ "Fold.mrk", "c F { v long sum { r " + sum + " } v int neg { r " + mrks string(depth + 1, '-') + "1 } }" }
+	});
+
+	mrk ParserResult foldResult;
+	folded.Start(foldResult);
+
+	mrk Model model;
+	mrk ResolveModel(folded, model);
+	mrks vector<mrk Error> errors;
+	mrk Semantic().Analyze(model, errors);
+
+	mrks vector<mrk ModelVar>& fields = model.Modules[0].Classes[0].Fields;
+	Check(foldResult.Errors.empty() && errors.empty(), "deep constants without errors");
+	Check(fields[0].IsConstant() && fields[0].Constant.Int == depth, "left deep sum folds");
+	Check(fields[1].IsConstant() && fields[1].Constant.Int == -1, "deep unary chain folds");
+
+	//generated bodies, 8x the operands has to take about 8x the time
+	Parsed generated(mrk GenerateExpressions(256, 64));
+	Check(generated.Result.Errors.empty() && generated.Method(0, 0).Body.size() == 257, "generated body");
+	Check(generated.Context->Expressions.GetBytes() < generated.Context->Expressions.GetCount() * sizeof(mrk ExprNode) * 2 + (1 << 20), "arena overhead");
+
+	double small = ParseSeconds(mrk GenerateExpressions(500, 64));
+	double large = ParseSeconds(mrk GenerateExpressions(4000, 64));
+	mrks cout << "500 statements " << small * 1000 << " ms, 4000 statements " << large * 1000 << " ms\n";
+	Check(large < small * 32, "linear in the operand count");
+
+	mrks cout << generated.Context->Expressions.GetCount() << " generated nodes, " << g_Failures << " failure(s)\n";
+	return g_Failures ? 1 : 0;
+}
+
+#endif
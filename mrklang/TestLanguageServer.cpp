@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Common.h"
+
+#ifdef MRK_TEST_LSP
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <filesystem>
+
+#include "Json.h"
+#include "Error.h"
+#include "TestCommon.h"
+
+//drives mrk_lsp over its stdio with a fixed script, no editor involved
+namespace {
+	const char* g_GeometryUri = "file:///work/Geometry.mrk";
+	const char* g_ShapeUri = "file:///work/Shape.mrk";
+
+	const char* g_Geometry =
+		"c Geometry {\n"
+		"\tv int sides { r 4 }\n"
+		"\tm int Count { p { int extra } r sides + extra }\n"
+		"}\n";
+
+	//never closed
+	const char* g_Shape =
+		"c Shape {\n"
+		"\tv int corners { r Geometry.sides * 2 }\n"
+		"\tm void Draw { }\n";
+
+	class Script {
+	private:
+		mrks string m_Text;
+
+	public:
+		void Add(mrk JsonValue message) {
+			message.Set("jsonrpc", "2.0");
+			mrks string body = message.ToString();
+			m_Text += "Content-Length: " + mrks to_string(body.size()) + "\r\n\r\n" + body;
+		}
+
+		void Request(int id, const char* method, mrk JsonValue params) {
+			mrk JsonValue message = mrk JsonValue::MakeObject();
+			message.Set("id", id);
+			message.Set("method", method);
+			message.Set("params", mrks move(params));
+			Add(mrks move(message));
+		}
+
+		void Notify(const char* method, mrk JsonValue params) {
+			mrk JsonValue message = mrk JsonValue::MakeObject();
+			message.Set("method", method);
+			message.Set("params", mrks move(params));
+			Add(mrks move(message));
+		}
+
+		const mrks string& GetText() const { return m_Text; }
+	};
+
+	mrk JsonValue Position(int line, int character) {
+		mrk JsonValue position = mrk JsonValue::MakeObject();
+		position.Set("line", line);
+		position.Set("character", character);
+		return position;
+	}
+
+	mrk JsonValue Document(const char* uri, int version = -1) {
+		mrk JsonValue doc = mrk JsonValue::MakeObject();
+		doc.Set("uri", uri);
+		if (version >= 0)
+			doc.Set("version", version);
+		return doc;
+	}
+
+	mrk JsonValue Open(const char* uri, const char* text) {
+		mrk JsonValue doc = Document(uri, 1);
+		doc.Set("languageId", "mrk");
+		doc.Set("text", text);
+
+		mrk JsonValue params = mrk JsonValue::MakeObject();
+		params.Set("textDocument", mrks move(doc));
+		return params;
+	}
+
+	mrk JsonValue Change(const char* uri, int version, mrk JsonValue start, mrk JsonValue end, const char* text) {
+		mrk JsonValue range = mrk JsonValue::MakeObject();
+		range.Set("start", mrks move(start));
+		range.Set("end", mrks move(end));
+
+		mrk JsonValue change = mrk JsonValue::MakeObject();
+		change.Set("range", mrks move(range));
+		change.Set("text", text);
+
+		mrk JsonValue changes = mrk JsonValue::MakeArray();
+		changes.Push(mrks move(change));
+
+		mrk JsonValue params = mrk JsonValue::MakeObject();
+		params.Set("textDocument", Document(uri, version));
+		params.Set("contentChanges", mrks move(changes));
+		return params;
+	}
+
+	mrk JsonValue At(const char* uri, int line, int character) {
+		mrk JsonValue params = mrk JsonValue::MakeObject();
+		params.Set("textDocument", Document(uri));
+		if (line >= 0)
+			params.Set("position", Position(line, character));
+		return params;
+	}
+
+	bool IsAt(const mrk JsonValue& range, int line, int character) {
+		return range.Get("start").Get("line").AsInt(-1) == line && range.Get("start").Get("character").AsInt(-1) == character;
+	}
+
+	//every framed message of the output, parsed
+	mrks vector<mrk JsonValue> ReadMessages(const mrks string& text) {
+		mrks vector<mrk JsonValue> messages;
+		size_t pos = 0;
+		while ((pos = text.find("Content-Length: ", pos)) != mrks string::npos) {
+			size_t length = (size_t)strtoull(text.c_str() + pos + 16, 0, 10);
+			size_t body = text.find("\r\n\r\n", pos);
+			if (body == mrks string::npos || body + 4 + length > text.size())
+				break;
+
+			mrk JsonValue message;
+			if (mrk JsonValue::Parse(text.substr(body + 4, length), message))
+				messages.push_back(mrks move(message));
+			pos = body + 4 + length;
+		}
+
+		return messages;
+	}
+
+	const mrk JsonValue* FindChild(const mrk JsonValue& symbols, const mrks string& name) {
+		for (const mrk JsonValue& symbol : symbols.GetItems())
+			if (symbol.Get("name").AsString() == name)
+				return &symbol;
+
+		return 0;
+	}
+}
+
+int main(int argc, char** argv) {
+	mrks cout << "LSP test\n";
+	if (argc < 2) {
+		mrks cout << "usage: mrk_test_lsp <mrk_lsp> [dir]\n";
+		return 1;
+	}
+
+	mrks filesystem::path dir = argc > 2 ? mrks filesystem::path(argv[2]) : mrks filesystem::temp_directory_path() / "mrk_test_lsp";
+	mrks filesystem::create_directories(dir);
+
+	Script script;
+	script.Request(1, "initialize", mrk JsonValue::MakeObject());
+	script.Notify("initialized", mrk JsonValue::MakeObject());
+	script.Notify("textDocument/didOpen", Open(g_GeometryUri, g_Geometry));
+	script.Notify("textDocument/didOpen", Open(g_ShapeUri, g_Shape));
+
+	//a field behind a non ASCII comment, then renamed through UTF-16 positions
+	script.Notify("textDocument/didChange", Change(g_GeometryUri, 2, Position(1, 0), Position(1, 0), "\t/* \xC3\xA9 */ v int width\n"));
+	script.Notify("textDocument/didChange", Change(g_GeometryUri, 3, Position(1, 15), Position(1, 20), "depth"));
+
+	script.Request(2, "textDocument/documentSymbol", At(g_GeometryUri, -1, 0));
+	script.Request(3, "textDocument/definition", At(g_GeometryUri, 3, 35)); //sides in the body of Count
+	script.Request(4, "textDocument/definition", At(g_GeometryUri, 3, 42)); //extra
+	script.Request(5, "textDocument/definition", At(g_ShapeUri, 1, 29)); //Geometry.sides
+
+	//closing Shape clears its diagnostics
+	script.Notify("textDocument/didChange", Change(g_ShapeUri, 2, Position(3, 0), Position(3, 0), "}\n"));
+	script.Request(6, "textDocument/documentSymbol", At(g_ShapeUri, -1, 0));
+
+	//stale by the time it is read, unless the server already answered
+	script.Request(7, "textDocument/definition", At(g_GeometryUri, 3, 35));
+	mrk JsonValue cancel = mrk JsonValue::MakeObject();
+	cancel.Set("id", 7);
+	script.Notify("$/cancelRequest", mrks move(cancel));
+
+	//a cancel for a request that isn't queued is dropped, it doesn't linger for a later one
+	mrk JsonValue early = mrk JsonValue::MakeObject();
+	early.Set("id", 11);
+	script.Notify("$/cancelRequest", mrks move(early));
+	script.Request(11, "textDocument/definition", At(g_GeometryUri, 3, 35));
+
+	script.Request(8, "mrk/nothing", mrk JsonValue::MakeObject());
+	script.Request(9, "mrk/stats", mrk JsonValue::MakeObject());
+	script.Request(10, "shutdown", mrk JsonValue());
+	script.Notify("exit", mrk JsonValue());
+
+	mrks filesystem::path input = dir / "script.lsp";
+	mrks filesystem::path output = dir / "output.lsp";
+	mrks ofstream(input, mrks ios::binary) << script.GetText();
+
+	mrks string command = "\"" + mrks string(argv[1]) + "\" --stats < \"" + input.string() + "\" > \"" + output.string() + "\"";
+	int status = mrks system(command.c_str());
+	Check(status == 0, "exit status after shutdown");
+
+	mrks stringstream text;
+	text << mrks ifstream(output, mrks ios::binary).rdbuf();
+
+	mrks map<long long, mrk JsonValue> responses;
+	mrks vector<mrk JsonValue> diagnostics;
+	for (mrk JsonValue& message : ReadMessages(text.str())) {
+		if (message.Get("method").AsString() == "textDocument/publishDiagnostics")
+			diagnostics.push_back(message.Get("params"));
+		else if (message.Has("id"))
+			responses[message.Get("id").AsInt()] = message;
+	}
+
+	Check(responses.size() == 11, "one response per request, got " + mrks to_string(responses.size()));
+	Check(responses[1].Get("result").Get("capabilities").Get("textDocumentSync").Get("change").AsInt() == 2, "incremental sync");
+
+	const mrk JsonValue& symbols = responses[2].Get("result");
+	const mrk JsonValue* geometry = FindChild(symbols, "Geometry");
+	Check(symbols.Size() == 1 && geometry && geometry->Get("kind").AsInt() == 5, "class symbol");
+	if (geometry) {
+		const mrk JsonValue& members = geometry->Get("children");
+		const mrk JsonValue* depth = FindChild(members, "depth");
+		const mrk JsonValue* count = FindChild(members, "Count");
+		Check(members.Size() == 3 && depth && FindChild(members, "sides"), "field symbols after the edits: " + members.ToString());
+		Check(depth && depth->Get("kind").AsInt() == 8 && IsAt(depth->Get("selectionRange"), 1, 15), "field position in UTF-16");
+		Check(count && count->Get("kind").AsInt() == 6 && FindChild(count->Get("children"), "extra"), "method and param symbols");
+		Check(count && count->Get("range").Get("end").Get("line").AsInt() == 3 && IsAt(count->Get("range"), 3, 7), "method range");
+	}
+
+	Check(IsAt(responses[3].Get("result").Get("range"), 2, 7) && responses[3].Get("result").Get("uri").AsString() == g_GeometryUri, "field definition");
+	Check(IsAt(responses[4].Get("result").Get("range"), 3, 23), "param definition");
+	Check(IsAt(responses[5].Get("result").Get("range"), 2, 7) && responses[5].Get("result").Get("uri").AsString() == g_GeometryUri, "qualified definition in another document");
+
+	bool broken = false, fixed = false;
+	for (const mrk JsonValue& params : diagnostics) {
+		if (params.Get("uri").AsString() != g_ShapeUri)
+			continue;
+
+		const mrk JsonValue& items = params.Get("diagnostics");
+		if (params.Get("version").AsInt() == 1)
+			broken = items.Size() >= 1 && items[0].Get("message").AsString() == mrk GetErrorText(mrk ErrorCode::ExpectedCloseBrace) && IsAt(items[0].Get("range"), 2, 15);
+		else if (params.Get("version").AsInt() == 2)
+			fixed = items.Size() == 0;
+	}
+
+	Check(broken, "diagnostic of the unclosed class");
+	Check(fixed, "diagnostics cleared by the edit");
+	Check(FindChild(responses[6].Get("result"), "Shape") != 0, "symbols of the edited document");
+
+	long long cancelled = responses[7].Get("error").Get("code").AsInt();
+	Check(cancelled == -32800 || IsAt(responses[7].Get("result").Get("range"), 2, 7), "cancelled or served");
+	Check(IsAt(responses[11].Get("result").Get("range"), 2, 7), "cancel before the request ignored");
+	Check(responses[8].Get("error").Get("code").AsInt() == -32601, "unknown method");
+
+	const mrk JsonValue& stats = responses[9].Get("result");
+	Check(stats.Get("edits").AsInt() == 3 && stats.Get("parses").AsInt() >= 2 && stats.Get("parses").AsInt() <= 5, "parse count " + stats.ToString());
+	Check(responses[10].Has("result") && responses[10].Get("result").IsNull(), "shutdown");
+
+	for (const mrk JsonValue& method : stats.Get("methods").GetItems())
+		mrks cout << '\t' << method.Get("method").AsString() << ": " << method.Get("count").AsInt() << " served, "
+			<< method.Get("cancelled").AsInt() << " cancelled, p99 " << method.Get("p99").AsNumber() << " ms\n";
+
+	if (g_Failures) {
+		mrks cout << g_Failures << " failure(s)\n";
+		return 1;
+	}
+
+	mrks cout << "\tAll passed\n";
+	return 0;
+}
+
+#endif
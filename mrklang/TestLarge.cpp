@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Common.h"
+
+#ifdef MRK_TEST_LARGE
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+
+#include "Tokens.h"
+#include "Parser.h"
+#include "Memory.h"
+#include "TestCommon.h"
+
+#define MRK_LARGE_BYTES_PER_TOKEN 128 //token, scope tables, brace lists and the parse model around it
+#define MRK_LARGE_SLACK (64u << 20)
+
+namespace {
+	mrk Token MakeToken(mrkpos offset) {
+		mrk Token token{};
+		token.Kind = mrk TOKEN_KIND_SYMBOL;
+		token.ContextualKind = mrk TOKEN_CONTEXTUAL_KIND_CHAR;
+		token.Offset = offset;
+		return token;
+	}
+
+	//indexing across chunk boundaries, storage kept by Clear and handed over by Swap
+	void CheckTokenStore() {
+		const mrkpos chunk = (mrkpos)1 << MRK_TOKEN_CHUNK_SHIFT;
+		mrk TokenStore tokens;
+		for (mrkpos i = 0; i < chunk * 3 + 5; i++)
+			tokens.Add(MakeToken(i * 3));
+
+		bool indexed = tokens.GetCount() == chunk * 3 + 5 && tokens.Back().Offset == (chunk * 3 + 4) * 3;
+		for (mrkpos i = chunk - 2; indexed && i < chunk + 2; i++)
+			indexed = tokens[i].Offset == i * 3;
+		Check(indexed, "indexing across chunks");
+		Check(tokens.GetReservedBytes() >= 4 * chunk * sizeof(mrk Token) && tokens.GetReservedBytes() < 5 * chunk * sizeof(mrk Token), "one chunk per 2^MRK_TOKEN_CHUNK_SHIFT tokens");
+
+		size_t reserved = tokens.GetReservedBytes();
+		tokens.Clear();
+		tokens.Add(MakeToken(7));
+		Check(tokens.GetCount() == 1 && tokens[0].Offset == 7 && tokens.GetReservedBytes() == reserved, "Clear keeps the chunks");
+
+		mrk TokenStore other;
+		other.Swap(tokens);
+		Check(tokens.IsEmpty() && tokens.GetReservedBytes() == 0 && other.GetCount() == 1 && other.Back().Offset == 7, "Swap");
+
+		//offsets past 4 GB survive the store
+		mrkpos far = ((mrkpos)5 << 30) + 11;
+		other.Add(MakeToken(far));
+		Check(sizeof(mrkpos) < 8 || other[1].Offset == far, "64-bit offset");
+	}
+
+	//one class per block, padded with a comment so the offsets grow faster than the token count
+	struct LargeFile {
+		size_t Bytes = 0;
+		size_t Classes = 0;
+		mrkpos LastClassOffset = 0;
+		mrks string Block; //first block, lexed alone for the expected token count
+	};
+
+	bool WriteLargeFile(const mrks filesystem::path& path, size_t targetBytes, size_t padding, LargeFile& file) {
+		mrks ofstream stream(path, mrks ios::binary | mrks ios::trunc);
+		if (!stream)
+			return false;
+
+		mrks string pad = padding ? "//" + mrks string(padding, '.') + '\n' : "";
+		mrks string block;
+		while (file.Bytes < targetBytes) {
+			mrks string index = mrks to_string(file.Classes);
+			block = "c Dump" + index + " {\n\tv int Size {\n\t\tr " + index + " * 8 + 4\n\t}\n\tm int Read {\n\t\tp {\n\t\t\tint offset\n\t\t}\n\t}\n}\n";
+			if (file.Classes == 0)
+				file.Block = block;
+
+			file.LastClassOffset = file.Bytes + 2;
+			stream << block << pad;
+			file.Bytes += block.size() + pad.size();
+			file.Classes++;
+		}
+
+		return (bool)stream.flush();
+	}
+
+	//sized up front, a stringstream would double its buffer and copy it out
+	bool ReadLargeFile(const mrks filesystem::path& path, mrks string& code) {
+		mrks ifstream stream(path, mrks ios::binary);
+		if (!stream)
+			return false;
+
+		code.resize((size_t)mrks filesystem::file_size(path));
+		return (bool)stream.read(&code[0], (mrks streamsize)code.size());
+	}
+}
+
+int main(int argc, char** argv) {
+	mrks cout << "Large input test\n";
+
+	mrks filesystem::path dir = mrks filesystem::temp_directory_path() / "mrk_test_large";
+	size_t megabytes = 64;
+	size_t padding = 4096;
+	for (int i = 1; i < argc; i++) {
+		mrks string arg = argv[i];
+		if (arg == "--mb" && i + 1 < argc)
+			megabytes = mrks stoull(argv[++i]);
+		else if (arg == "--padding" && i + 1 < argc)
+			padding = mrks stoull(argv[++i]);
+		else
+			dir = arg;
+	}
+
+	CheckTokenStore();
+
+	mrks filesystem::create_directories(dir);
+	mrks filesystem::path path = dir / "Large.mrk";
+	LargeFile file;
+	if (!WriteLargeFile(path, megabytes << 20, padding, file)) {
+		mrks cout << "\tCannot write " << path.string() << '\n';
+		return 1;
+	}
+
+	mrk Lexer blockLexer;
+	size_t blockTokens = blockLexer.Lex(file.Block).GetCount();
+
+	mrks vector<mrk Source> sources(1);
+	sources[0].Filename = path.string();
+	Check(ReadLargeFile(path, sources[0].Code) && sources[0].Code.size() == file.Bytes, "read back");
+	mrks filesystem::remove(path);
+
+	size_t loaded = mrk GetPeakRSS();
+	mrks cout << "\t" << file.Bytes << " bytes, " << file.Classes << " classes, " << file.Classes * blockTokens << " tokens\n";
+
+	mrk MemoryReport report;
+	mrk ParserResult result;
+	mrk Parser parser(mrks move(sources));
+	parser.SetMemoryReport(&report);
+	parser.Start(result);
+
+	Check(result.Errors.empty(), mrks to_string(result.Errors.size()) + " error(s)" + (result.Errors.empty() ? "" : ", first " + mrk FormatError(result.Errors[0])));
+
+	const mrk SourceParseContext* context = parser.GetParseContext(&parser.GetSources().front());
+	Check(context && context->ParseClasses.size() == file.Classes, "class count");
+	if (context && !context->ParseClasses.empty()) {
+		const mrk ParseClass& last = context->ParseClasses.back();
+		Check(last.Name == "Dump" + mrks to_string(file.Classes - 1) && last.Offset == file.LastClassOffset, "last class name and offset");
+		Check(last.Index == (mrkidx)file.Classes - 1 && last.Methods.size() == 1 && last.Fields.size() == 1 && last.Fields[0].Default != MRK_EXPR_NONE, "last class members");
+		Check(context->StructuralScopes.size() == file.Classes * 4, "scope count");
+	}
+
+	const mrk SourceMemory& memory = report.Sources.front();
+	Check(memory.TokenCount == file.Classes * blockTokens, "token count " + mrks to_string(memory.TokenCount));
+	Check(memory.TokenCapacityBytes <= memory.TokenBytes + (sizeof(mrk Token) << MRK_TOKEN_CHUNK_SHIFT) + memory.TokenCount / 1024 + 4096, "token storage within one chunk of the tokens");
+
+	//growth past the loaded text scales with the tokens, not with the bytes
+	size_t peak = mrk GetPeakRSS();
+	size_t bound = memory.TokenCount * MRK_LARGE_BYTES_PER_TOKEN + MRK_LARGE_SLACK;
+	mrks cout << "\tpeak " << (peak >> 20) << " MB, " << ((peak - loaded) >> 20) << " MB over the loaded text, bound " << (bound >> 20) << " MB\n";
+	Check(!peak || peak - loaded <= bound, "peak memory");
+
+	if (g_Failures) {
+		mrks cout << g_Failures << " failure(s)\n";
+		return 1;
+	}
+
+	mrks cout << "\tAll passed\n";
+	return 0;
+}
+
+#endif
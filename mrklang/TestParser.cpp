@@ -53,14 +53,16 @@ int main() {
 		<< "Error count: " << parserResult.Errors.size() << '\n';
 
 	for (mrk Error& err : parserResult.Errors) {
-		mrks cout << "\tError: " << err.Message << '\n';
+		mrks cout << "\tError: " << mrk FormatError(err) << '\n';
 	}
 
 	mrks cout << "Logs:\n" << parserResult.Logs.str() << "\n\nDONE!\n";
 
+#ifdef _WIN32
 	system("pause");
+#endif
 
-	return 0;
+	return parserResult.Errors.empty() ? 0 : 1;
 }
 
 #endif
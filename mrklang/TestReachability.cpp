@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Common.h"
+
+#ifdef MRK_TEST_REACHABILITY
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "Parser.h"
+#include "Model.h"
+#include "Semantic.h"
+#include "Reachability.h"
+#include "TestCommon.h"
+
+namespace {
+	//the program, then the included library it uses a part of
+	const char* g_App =
+		"i lib;\n"
+		"c Game {\n"
+		"	v Vec pos\n"
+		"	m .{ }\n"
+		"	m float Run { v Vec a a = Vec() r a.Dot(pos) }\n"
+		"	m void Spin { v Quat q q.Normalize() }\n"
+		"	m void Poke { p { int n } n.Scale(1) }\n"
+		"}\n"
+		"c Tool { v int t }\n";
+
+	const char* g_Lib =
+		"c Vec {\n"
+		"	v float x\n"
+		"	v float y\n"
+		"	v int unused\n"
+		"	m .{ }\n"
+		"	m float Dot { p { Vec o } r x * o.x + y * o.y }\n"
+		"	m void Scale { p { float s } x = x * s }\n"
+		"	c Cache { v int size }\n"
+		"}\n"
+		"c Matrix { v Vec row v int rank { r 3 } m Vec Row { r row } }\n"
+		"c Quat { v float w v Helper helper m void Normalize { __cpp { w = sqrtf(w); helper->Reset(); } } }\n"
+		"c Helper { m void Reset { } m void Other { } }\n"
+		"c Unused { v int a }\n";
+
+	struct Analyzed {
+		mrk Parser Parser;
+		mrk Model Model;
+		mrk Semantic Semantic;
+		mrks vector<mrk Error> Errors;
+
+		Analyzed() : Parser(mrks vector<mrk Source> { mrk Source{ "App.mrk", g_App }, mrk Source{ "lib.mrk", g_Lib } }) {
+			mrk ParserResult result;
+			Parser.Start(result);
+			Errors = result.Errors;
+
+			mrk ResolveModel(Parser, Model);
+			Semantic.Analyze(Model, Errors);
+		}
+
+		bool IsKept(const mrk Reachability& reachability, const mrks string& name) const {
+			const mrk TypeInfo& type = Semantic.GetType(Semantic.FindGlobalType(name));
+			return reachability.IsKept(type.Module, type.Class);
+		}
+	};
+
+	bool HasMethod(const mrk ModelClass& _class, const mrks string& name) {
+		for (const mrk ModelMethod& method : _class.Methods)
+			if (method.Name == name)
+				return true;
+
+		return false;
+	}
+
+	bool HasField(const mrk ModelClass& _class, const mrks string& name) {
+		for (const mrk ModelVar& field : _class.Fields)
+			if (field.Name == name)
+				return true;
+
+		return false;
+	}
+}
+
+int main() {
+	mrks cout << "Reachability test\n";
+
+	//no roots, every class of the inputs
+	{
+		Analyzed analyzed;
+		for (mrk Error& err : analyzed.Errors)
+			mrks cout << "\t" << mrk FormatError(err) << '\n';
+		Check(analyzed.Errors.empty(), "analyzed without errors");
+
+		mrk Reachability reachability(analyzed.Semantic);
+		mrks vector<mrk Error> errors;
+		reachability.Analyze(analyzed.Model, {}, 1, errors);
+
+		Check(errors.empty(), "no root errors");
+		Check(analyzed.IsKept(reachability, "Game") && analyzed.IsKept(reachability, "Tool"), "inputs kept whole");
+		Check(analyzed.IsKept(reachability, "Vec") && analyzed.IsKept(reachability, "Quat"), "used library classes kept");
+		Check(analyzed.IsKept(reachability, "Helper"), "class of a field used in a foreign block kept");
+		Check(!analyzed.IsKept(reachability, "Matrix") && !analyzed.IsKept(reachability, "Unused"), "unused library classes dropped");
+
+		mrk ReachabilityCounts total = reachability.GetTotal();
+		mrk ReachabilityCounts kept = reachability.GetKept();
+		Check(total.Classes == 8 && total.Methods == 11 && total.Fields == 11, "totals");
+		Check(kept.Classes == 5, "5 classes kept");
+
+		mrks ostringstream report;
+		reachability.WriteReport(report);
+		mrks cout << report.str();
+		Check(report.str().find("lib.mrk\n") != mrks string::npos, "report names the module");
+		Check(report.str().find("\tclass Matrix\n") != mrks string::npos && report.str().find("\tclass Unused\n") != mrks string::npos, "report lists dropped classes");
+		Check(report.str().find("\tclass Vec.Cache\n") != mrks string::npos, "report lists dropped nested classes");
+		Check(report.str().find("\tfield Vec::unused\n") != mrks string::npos, "report lists dropped fields");
+		Check(report.str().find("\tmethod Helper::Other\n") != mrks string::npos, "report lists dropped methods");
+		Check(report.str().find("Matrix::row") == mrks string::npos, "members of dropped classes not listed");
+		Check(report.str().find("App.mrk") == mrks string::npos, "nothing dropped from the inputs");
+
+		reachability.Prune(analyzed.Model);
+		const mrk ModelModule& lib = analyzed.Model.Modules[1];
+		const mrk ModelClass& vec = lib.Classes[0];
+		Check(lib.Roots.size() == 3, "3 library roots emitted");
+		Check(vec.Nested.empty(), "nested class dropped");
+		Check(HasField(vec, "x") && HasField(vec, "y") && !HasField(vec, "unused"), "unused field dropped");
+		Check(HasMethod(vec, "Dot") && HasMethod(vec, "Scale") && vec.Methods.size() == 3, "used methods and the ctor kept");
+		Check(HasMethod(lib.Classes[4], "Reset") && !HasMethod(lib.Classes[4], "Other"), "member named after '->' kept");
+		const mrk ModelClass& game = analyzed.Model.Modules[0].Classes[0];
+		Check(game.Dependencies.size() == 1 && game.BodyDependencies.size() == 1, "dependencies collected again");
+	}
+
+	//member roots keep what they reach, not their whole class
+	{
+		Analyzed analyzed;
+		mrk Reachability reachability(analyzed.Semantic);
+		mrks vector<mrk Error> errors;
+		reachability.Analyze(analyzed.Model, { "Game::Run", "Matrix::Row", "Vec.Cache" }, 1, errors);
+		Check(errors.empty(), "member roots resolve");
+
+		Check(analyzed.IsKept(reachability, "Game") && analyzed.IsKept(reachability, "Vec") && analyzed.IsKept(reachability, "Matrix"), "classes of reached members kept");
+		Check(!analyzed.IsKept(reachability, "Quat") && !analyzed.IsKept(reachability, "Tool"), "classes only other members use dropped");
+
+		mrks ostringstream report;
+		reachability.WriteReport(report);
+		Check(report.str().find("\tmethod Game::Spin\n") != mrks string::npos, "unreached method of a root's class dropped");
+		Check(report.str().find("\tmethod Vec::Scale\n") != mrks string::npos, "method no one calls dropped");
+		Check(report.str().find("\tfield Matrix::rank\n") != mrks string::npos, "unread field dropped");
+		Check(report.str().find("Matrix::row") == mrks string::npos, "field read by a root kept");
+		Check(report.str().find("Vec.Cache") == mrks string::npos, "nested root kept");
+
+		//a member of an unknown receiver is kept by name everywhere
+		mrk Reachability loose(analyzed.Semantic);
+		loose.Analyze(analyzed.Model, { "Game::Run", "Game::Poke" }, 1, errors);
+		mrks ostringstream looseReport;
+		loose.WriteReport(looseReport);
+		Check(looseReport.str().find("Vec::Scale") == mrks string::npos, "member of an unknown receiver kept");
+	}
+
+	//roots naming nothing
+	{
+		Analyzed analyzed;
+		mrk Reachability reachability(analyzed.Semantic);
+		mrks vector<mrk Error> errors;
+		reachability.Analyze(analyzed.Model, { "Nope", "Game::nope", "Vec.Missing", "Game" }, 1, errors);
+		for (mrk Error& err : errors)
+			mrks cout << "\t" << mrk FormatError(err) << '\n';
+
+		Check(errors.size() == 3, "3 undefined roots");
+		Check(!errors.empty() && mrk FormatError(errors[0]).find("Undefined reachability root 'Nope'") != mrks string::npos, "undefined root message");
+		Check(analyzed.IsKept(reachability, "Game") && !analyzed.IsKept(reachability, "Tool"), "valid roots still analyzed");
+	}
+
+	if (g_Failures) {
+		mrks cout << "\t" << g_Failures << " failed\n";
+		return 1;
+	}
+
+	mrks cout << "\tAll passed\n";
+	return 0;
+}
+
+#endif
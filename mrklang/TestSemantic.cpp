@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Common.h"
+
+#ifdef MRK_TEST_SEMANTIC
+
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include "Parser.h"
+#include "Model.h"
+#include "Semantic.h"
+#include "Corpus.h"
+#include "TestCommon.h"
+
+int main() {
+	mrks cout << "Semantic test\n";
+
+	mrk Parser parser(mrks vector<mrk Source> {
+		mrk Source{
+			"Entity.mrk",
+			"i mrk; c Entity { v int id v Transform t v Missing m v string id c Transform { v Vector3 p } "
+			"m void Do { p { int a int a } v mrk bad } m void Do { } m .{ } m .{ } } c Vector3 { v float x }"
+		},
+		mrk Source{
+			"Player.mrk",
+			"c Player { v Entity e m Entity Get { p { Vector3 v } } } c Vector3 { }"
+		}
+	});
+
+	mrk ParserResult result;
+	parser.Start(result);
+	Check(result.Errors.empty(), "parse without errors");
+
+	mrk Model model;
+	mrk ResolveModel(parser, model);
+
+	mrk Semantic semantic;
+	mrks vector<mrk Error> errors;
+	semantic.Analyze(model, errors);
+
+	for (mrk Error& err : errors)
+		mrks cout << "\t" << err.Source->Filename << ": " << mrk FormatError(err) << '\n';
+
+	Check(errors.size() == 7, "7 errors");
+	Check(HasError(errors, "Undefined type 'Missing' in Entity::m"), "undefined type");
+	Check(HasError(errors, "Duplicate member 'Entity::id'"), "duplicate field");
+	Check(HasError(errors, "Duplicate member 'Entity::Do'"), "duplicate method");
+	Check(HasError(errors, "Duplicate member 'Entity::Entity' with 0 parameter(s)"), "duplicate ctor");
+	Check(HasError(errors, "Duplicate parameter or local 'a' in Entity::Do"), "duplicate param");
+	Check(HasError(errors, "Not a type 'mrk' in Entity::Do"), "module used as type");
+	Check(HasError(errors, "Duplicate type 'Vector3' (first declared in Entity.mrk)"), "duplicate type across sources");
+
+	bool located = true;
+	for (const mrk Error& err : errors)
+		located = located && err.Offset != MRK_NO_OFFSET && err.Offset < err.Source->Code.size();
+	Check(located, "every semantic error is located");
+
+	mrk ModelModule& entity = model.Modules[0];
+	mrk ModelClass& transform = entity.Classes[1];
+	Check(entity.Classes[0].Fields[1].Type.TypeId == transform.TypeId, "nested type resolved from the parent");
+	Check(semantic.GetType(transform.TypeId).FullName == "Entity.Transform", "nested full name");
+	Check(transform.Fields[0].Type.TypeId == semantic.FindGlobalType("Vector3"), "global type from a nested class");
+	Check(model.Modules[1].Classes[0].Fields[0].Type.TypeId == entity.Classes[0].TypeId, "type from another source");
+	Check(entity.Classes[0].Fields[0].Type.TypeId == (mrku32)mrk BuiltinType::Int, "builtin type id");
+
+	const mrk Symbol* field = semantic.Lookup(entity.Classes[0].Scope, "t");
+	Check(field && field->Kind == mrk SymbolKind::Field && field->TypeId == transform.TypeId, "field lookup");
+	const mrk Symbol* param = semantic.Lookup(entity.Classes[0].Methods[0].Scope, "a");
+	Check(param && param->Kind == mrk SymbolKind::Param, "param lookup");
+	Check(!semantic.Lookup(entity.Classes[0].Scope, "nothing"), "missing lookup");
+
+	//var defaults fold into constants
+	mrk Parser constParser(mrks vector<mrk Source> {
+		mrk Source{
+			"Constants.mrk",
+			"c Limits { v int a { r (1 + 2) * -3 << 4 } v int b { r a / 7 % 5 } v long c { r 9223372036854775807L } "
+			"v ulong d { r ~0UL } v bool e { r a < 0 && !false } v string f { r \"mrk\" + \"lang\" } v float g { r h / 4 } "
+			"v double h { r Other.Inner.k } v byte i { r 256 } v int j { r 2147483647 + 1 } v int k { r l } v int l { r k } "
+			"v int m { r 1 / 0 } v Other n { r 1 } v int o { r Run(1) } v int q m void Run { p { int x } v int y { r a + 1; } v int z { r x } } } "
+			"c Other { c Inner { v double k { r 6 } } } "
+			"c Shapes { v Point p { r Point() } v int q { r Compute() } v int s { r q + 1 } m int Compute { } } c Point { v int x }"
+		}
+	});
+
+	mrk ParserResult constResult;
+	constParser.Start(constResult);
+	Check(constResult.Errors.empty(), "default blocks parse without errors");
+
+	mrk Model constModel;
+	mrk ResolveModel(constParser, constModel);
+	mrks vector<mrk Error> constErrors;
+	semantic.Analyze(constModel, constErrors);
+
+	for (mrk Error& err : constErrors)
+		mrks cout << "\t" << mrk FormatError(err) << '\n';
+
+	mrks vector<mrk ModelVar>& limits = constModel.Modules[0].Classes[0].Fields;
+	Check(limits[0].IsConstant() && limits[0].Constant.Type == mrk BuiltinType::Int && limits[0].Constant.Int == -144, "arithmetic and shifts");
+	Check(limits[1].IsConstant() && limits[1].Constant.Int == 0, "reference to a constant");
+	Check(limits[2].IsConstant() && limits[2].Constant.Int == 9223372036854775807LL, "long literal");
+	Check(limits[3].IsConstant() && limits[3].Constant.UInt == ~0ULL, "unsigned complement");
+	Check(limits[4].IsConstant() && limits[4].Constant.Bool, "comparison and logic");
+	Check(limits[5].IsConstant() && limits[5].Constant.String == "mrklang", "string concatenation");
+	Check(limits[6].IsConstant() && limits[6].Constant.Float == 1.5, "qualified reference, folded out of order");
+	Check(!limits[15].IsConstant() && limits[15].Constant.State == mrk ConstantState::None, "var without default");
+
+	mrks vector<mrk ModelVar>& locals = constModel.Modules[0].Classes[0].Methods[0].Locals;
+	Check(locals[0].IsConstant() && locals[0].Constant.Int == -143, "local referencing a field");
+
+	Check(limits[14].Constant.State == mrk ConstantState::Runtime, "call default runs with the object");
+	Check(locals[1].Constant.State == mrk ConstantState::Runtime, "param default runs with the method");
+
+	mrks vector<mrk ModelVar>& shapes = constModel.Modules[0].Classes[3].Fields;
+	Check(shapes[0].Constant.State == mrk ConstantState::Runtime, "user-typed default");
+	Check(shapes[1].Constant.State == mrk ConstantState::Runtime, "call default");
+	Check(shapes[2].Constant.State == mrk ConstantState::Runtime, "default reading a runtime default");
+
+	//errors point at the name of the declaration they are about
+	const mrks string& constCode = constParser.GetSources()[0].Code;
+	for (const mrk Error& err : constErrors)
+		if (mrk FormatError(err).find("Limits::m") != mrks string::npos)
+			Check(err.Offset == constCode.find("v int m {") + 6, "constant error located at its var");
+
+	Check(constErrors.size() == 5, "5 constant errors");
+	Check(HasError(constErrors, "Constant overflow in Limits::i"), "byte range");
+	Check(HasError(constErrors, "Constant overflow in Limits::j"), "checked arithmetic");
+	Check(HasError(constErrors, "Circular constant"), "cycle");
+	Check(HasError(constErrors, "Division by zero in Limits::m"), "division by zero");
+	Check(HasError(constErrors, "Constant type mismatch in Limits::n"), "user type default");
+	Check(!HasError(constErrors, "Limits::o") && !HasError(constErrors, "Run::z") && !HasError(constErrors, "Shapes"), "runtime defaults are not errors");
+
+	//an include named like a type of another source, whichever comes first
+	mrk Source app{ "a.mrk", "i lib; c App { v lib x }" };
+	mrk Source lib{ "lib.mrk", "c lib { }" };
+	for (bool libFirst : { false, true }) {
+		mrk Parser orderParser(libFirst ? mrks vector<mrk Source> { lib, app } : mrks vector<mrk Source> { app, lib });
+		mrk ParserResult orderResult;
+		orderParser.Start(orderResult);
+
+		mrk Model orderModel;
+		mrk ResolveModel(orderParser, orderModel);
+		mrks vector<mrk Error> orderErrors;
+		semantic.Analyze(orderModel, orderErrors);
+		Check(orderResult.Errors.empty() && orderErrors.empty(), mrks string("include and type of one name, ") + (libFirst ? "type first" : "include first"));
+	}
+
+	//large generated project resolves cleanly
+	mrk Parser big(mrks vector<mrk Source> { mrk Source{ "generated.mrk", mrk GenerateCorpus(5000) } });
+	mrk ParserResult bigResult;
+	big.Start(bigResult);
+
+	mrk Model bigModel;
+	mrk ResolveModel(big, bigModel);
+	mrks vector<mrk Error> bigErrors;
+	semantic.Analyze(bigModel, bigErrors);
+	Check(bigResult.Errors.empty() && bigErrors.empty(), "generated corpus without errors");
+	Check(semantic.GetTypeCount() == MRK_BUILTIN_TYPE_COUNT + bigModel.Modules[0].Classes.size(), "one type per class");
+
+	mrks cout << semantic.GetSymbolCount() << " symbols, " << g_Failures << " failure(s)\n";
+	return g_Failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Common.h"
+
+#ifdef MRK_TEST_SERVER
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "CompileServer.h"
+#include "TestCommon.h"
+
+namespace {
+	void WriteSource(const mrks filesystem::path& path, const mrks string& code) {
+		mrks ofstream(path, mrks ios::binary) << code;
+	}
+
+	struct Reply {
+		int Status;
+		mrks string Text;
+		double Ms;
+	};
+
+	Reply Request(const mrks string& socket, const mrks string& command, const mrks string& cwd, const mrks vector<mrks string>& args) {
+		mrks ostringstream out;
+		auto start = mrks chrono::steady_clock::now();
+		int status = mrk RunCompileClient(socket, command, cwd, args, out);
+		return Reply{ status, out.str(), mrks chrono::duration<double, mrks milli>(mrks chrono::steady_clock::now() - start).count() };
+	}
+
+#ifndef _WIN32
+	//a connection that sends whatever the test wants
+	int ConnectRaw(const mrks string& path) {
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd >= 0 && connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+			close(fd);
+			return -1;
+		}
+
+		return fd;
+	}
+#endif
+
+	//the value of one "name value" line of a stats reply
+	long long Stat(const mrks string& socket, const mrks string& name) {
+		mrks istringstream lines(Request(socket, "stats", "", {}).Text);
+		mrks string key;
+		double value;
+		while (lines >> key >> value)
+			if (key == name)
+				return (long long)value;
+
+		return -1;
+	}
+}
+
+int main(int argc, char** argv) {
+	mrks cout << "Server test\n";
+
+#ifdef _WIN32
+	mrks cout << "\tskipped, no Unix domain sockets\n";
+	return 0;
+#else
+	mrks filesystem::path dir = argc > 1 ? mrks filesystem::path(argv[1]) : mrks filesystem::temp_directory_path() / "mrk_test_server";
+	mrks filesystem::remove_all(dir);
+	mrks filesystem::create_directories(dir);
+	mrks string cwd = dir.string();
+
+	//sun_path is short, the build tree may be deep
+	mrks string socket = (mrks filesystem::temp_directory_path() / ("mrk_test_server_" + mrks to_string(getpid()) + ".sock")).string();
+
+	mrk CompileServer server(socket);
+	mrks string error;
+	if (!server.Listen(error)) {
+		mrks cout << "\tCannot listen: " << error << '\n';
+		return 1;
+	}
+
+	//the default socket lives where only this user can reach it
+	{
+		mrks string path, reason;
+		unsetenv("MRK_SERVER_SOCKET");
+		setenv("XDG_RUNTIME_DIR", cwd.c_str(), 1);
+		Check(mrk GetDefaultCompileSocket(path, reason) && path == cwd + "/mrk-server.sock", "socket in the runtime dir");
+
+		unsetenv("XDG_RUNTIME_DIR");
+		mrks string fallback = "/tmp/mrk-" + mrks to_string(getuid());
+		Check(mrk GetDefaultCompileSocket(path, reason) && path == fallback + "/server.sock", "private directory in /tmp");
+
+		struct stat info;
+		Check(!lstat(fallback.c_str(), &info) && (info.st_mode & 0777) == 0700, "private directory is 0700");
+
+		chmod(fallback.c_str(), 0755);
+		Check(!mrk GetDefaultCompileSocket(path, reason) && reason.find("not a directory private") != mrks string::npos, "open directory refused");
+		chmod(fallback.c_str(), 0700);
+	}
+
+	mrk CompileServer second(socket);
+	Check(!second.Listen(error) && error.find("already listening") != mrks string::npos, "second server refused");
+
+	mrks thread serving([&server]() { server.Serve(); });
+
+	WriteSource(dir / "Geometry.mrk", "c Geometry { v int sides { r 4 } m int Count { r sides } }");
+	WriteSource(dir / "Shape.mrk", "c Shape { v int corners { r Geometry.sides * 2 } m void Draw { } }");
+	mrks vector<mrks string> args{ "Geometry.mrk", "Shape.mrk", "-o", "out", "--target", "cpp" };
+
+	Reply cold = Request(socket, "compile", cwd, args);
+	Check(cold.Status == 0, "cold compile: " + cold.Text);
+	Check(cold.Text.find("cpp: 4 written") != mrks string::npos, "cold compile writes both classes, header and source: " + cold.Text);
+	Check(mrks filesystem::exists(dir / "out" / "cpp" / "Shape.cpp"), "output tree");
+	Check(Stat(socket, "parsed") == 2, "both sources parsed");
+
+	//nothing changed, every source comes from the cache
+	Reply warm = Request(socket, "compile", cwd, args);
+	Check(warm.Status == 0 && warm.Text.find("cpp: 0 written, 0 unchanged, 2 skipped") != mrks string::npos, "warm compile skips: " + warm.Text);
+	Check(Stat(socket, "parsed") == 2 && Stat(socket, "reused") == 2, "warm compile reuses the cache");
+
+	//only the edited source is parsed again
+	WriteSource(dir / "Shape.mrk", "c Shape { v int corners { r Geometry.sides * 3 } m void Draw { } }");
+	Reply edit = Request(socket, "compile", cwd, args);
+	Check(edit.Status == 0 && edit.Text.find("cpp: 1 written") != mrks string::npos, "edited source rebuilt: " + edit.Text);
+	Check(Stat(socket, "parsed") == 3 && Stat(socket, "reused") == 3, "one source parsed after an edit");
+
+	//diagnostics name the path given by the client, nothing is emitted
+	WriteSource(dir / "Broken.mrk", "c Broken { v int x { r 1 / 0 } }");
+	Reply broken = Request(socket, "compile", cwd, { "Broken.mrk", "-o", "out" });
+	Check(broken.Status == 1, "errors give status 1");
+	Check(broken.Text.find((dir / "Broken.mrk").string() + ":1:") != mrks string::npos, "streamed diagnostic: " + broken.Text);
+	Check(!mrks filesystem::exists(dir / "out" / "cpp" / "Broken.cpp"), "nothing emitted on errors");
+	Check(Stat(socket, "cached") == 1, "sources outside the last closure dropped from the cache");
+
+	Reply missing = Request(socket, "compile", cwd, { "Missing.mrk" });
+	Check(missing.Status == 2 && missing.Text.find("cannot read") != mrks string::npos, "missing source: " + missing.Text);
+
+	Reply bad = Request(socket, "compile", cwd, { "--target", "cobol", "Geometry.mrk" });
+	Check(bad.Status == 2 && bad.Text.find("unknown target") != mrks string::npos, "bad arguments: " + bad.Text);
+
+	//a client that never finishes its request or claims a huge frame does not hold up the others
+	int stalled = ConnectRaw(socket);
+	int flood = ConnectRaw(socket);
+	unsigned char length[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+	char byte;
+	Check(stalled >= 0 && flood >= 0 && send(flood, length, 4, MSG_NOSIGNAL) == 4 && recv(flood, &byte, 1, 0) == 0, "oversized frame drops the connection");
+
+	Reply beside = Request(socket, "stats", "", {});
+	Check(beside.Status == 0 && beside.Ms < MRK_SERVER_TIMEOUT * 1000 / 2, "request served beside a stalled client");
+	close(flood);
+	close(stalled);
+
+	mrks cout << "\tcold " << cold.Ms << " ms, warm " << warm.Ms << " ms, one edit " << edit.Ms << " ms\n";
+
+	Check(Request(socket, "shutdown", "", {}).Status == 0, "shutdown");
+	serving.join();
+
+	Check(Request(socket, "stats", "", {}).Status == 2, "no server after shutdown");
+
+	if (g_Failures) {
+		mrks cout << g_Failures << " failure(s)\n";
+		return 1;
+	}
+
+	mrks cout << "\tAll passed\n";
+	return 0;
+#endif
+}
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Common.h"
+
+#ifdef MRK_TEST_STRUCTURAL
+
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include "StructuralIndex.h"
+#include "Parser.h"
+#include "Corpus.h"
+#include "TestCommon.h"
+
+namespace {
+	//byte at a time over the whole text, what the index has to agree with wherever the blocks fall
+	mrks vector<mrkpos> Reference(const mrks string& text) {
+		mrks vector<mrkpos> positions;
+		bool inString = false;
+		bool escaped = false;
+
+		for (size_t pos = 0; pos < text.size(); pos++) {
+			char c = text[pos];
+			if (escaped) {
+				escaped = false;
+				if (inString || c == '"' || c == '\\')
+					continue;
+			}
+
+			if (c == '\\')
+				escaped = true;
+			else if (inString)
+				inString = c != '"';
+			else if (c == '/' && pos + 1 < text.size() && (text[pos + 1] == '/' || text[pos + 1] == '*')) {
+				size_t end = text[pos + 1] == '/' ? text.find('\n', pos + 2) : text.find("*/", pos + 2);
+				pos = end == mrks string::npos ? text.size() : (text[pos + 1] == '/' ? end : end + 1);
+			}
+			else if (c == '{' || c == '}' || c == ';' || c == '"') {
+				inString = c == '"';
+				positions.push_back(pos);
+			}
+		}
+
+		return positions;
+	}
+
+	bool MatchesReference(const mrks string& text) {
+		mrk StructuralIndex index;
+		mrk BuildStructuralIndex(text.data(), text.size(), index);
+		return index.Positions == Reference(text);
+	}
+
+	//every piece at every offset across the first two block boundaries
+	void CheckEveryOffset(const mrks string& piece, const mrks string& what) {
+		for (size_t offset = 0; offset < 140; offset++) {
+			mrks string text = mrks string(offset, 'a') + piece + " { x; } \"}\" {";
+			if (!MatchesReference(text)) {
+				Check(false, what + " at " + mrks to_string(offset));
+				return;
+			}
+		}
+	}
+
+	struct ScopeResult {
+		mrks vector<mrks string> Scopes;
+		mrks vector<mrks string> Errors;
+		size_t Classes = 0;
+	};
+
+	ScopeResult ParseScopes(const mrks string& code, mrk ScopePass pass, const char* platform = 0) {
+		mrk Parser parser(mrks vector<mrk Source>{ mrk Source{ "scopes.mrk", code } });
+		parser.SetScopePass(pass);
+		if (platform) {
+			mrk PlatformSet platforms;
+			platforms.Enable(platform);
+			parser.SetPlatforms(platforms);
+		}
+
+		mrk ParserResult result;
+		parser.Start(result);
+
+		ScopeResult scopes;
+		const mrk SourceParseContext* context = parser.GetParseContext(&parser.GetSources().front());
+		for (const mrk StructuralScope& scope : context->StructuralScopes)
+			scopes.Scopes.push_back(mrks to_string(scope.Open) + "-" + mrks to_string(scope.Close) + " parent " + mrks to_string(scope.Parent)
+				+ " owner " + mrks to_string(scope.Owner));
+
+		for (const mrk Error& error : result.Errors)
+			scopes.Errors.push_back(mrk FormatError(error) + " @" + mrks to_string(error.Offset));
+
+		scopes.Classes = context->ParseClasses.size();
+		return scopes;
+	}
+
+	//every pass has to build the same scopes and report the same errors
+	void CheckSameScopes(const mrks string& code, const mrks string& what, const char* platform = 0) {
+		ScopeResult tokens = ParseScopes(code, mrk ScopePass::Tokens, platform);
+		for (mrk ScopePass pass : { mrk ScopePass::Braces, mrk ScopePass::Index }) {
+			ScopeResult scopes = ParseScopes(code, pass, platform);
+			Check(scopes.Scopes == tokens.Scopes && scopes.Errors == tokens.Errors && scopes.Classes == tokens.Classes,
+				what + (pass == mrk ScopePass::Braces ? ", lexer braces" : ", structural index"));
+		}
+	}
+}
+
+int main() {
+	mrks cout << "Structural index test\n";
+
+	//strings, escapes and both kinds of comment
+	mrks string code = "c A { v string s \"{\\\"}\" // }\n /* { */ ; }";
+	mrk StructuralIndex index;
+	mrk BuildStructuralIndex(code.data(), code.size(), index);
+	Check(index.Positions == mrks vector<mrkpos>({ 4, 17, 38, 40 }) && index.Braces == 2, "masked strings and comments");
+
+	CheckEveryOffset("\"a\\\"b{\"", "escaped quote");
+	CheckEveryOffset("\"\\\\\"{", "escaped backslash");
+	CheckEveryOffset("\\\"{", "escaped quote outside strings");
+	CheckEveryOffset("// { \"\n}", "line comment");
+	CheckEveryOffset("/* { \" */}", "block comment");
+	CheckEveryOffset("/**/{", "empty block comment");
+	CheckEveryOffset("a / b; {", "division");
+	CheckEveryOffset("\"// {\"}", "comment in a string");
+	CheckEveryOffset("/* unterminated {", "unterminated comment");
+
+	//random text of the characters that matter
+	const char alphabet[] = "{};\"\\/*\n ax";
+	mrku32 state = 7;
+	for (int run = 0; run < 3000; run++) {
+		mrks string text;
+		size_t length = run % 300;
+		for (size_t i = 0; i < length; i++) {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			text += alphabet[state % (sizeof(alphabet) - 1)];
+		}
+
+		if (!MatchesReference(text)) {
+			Check(false, "random text " + mrks to_string(run));
+			break;
+		}
+	}
+
+	//pairs close innermost first, strays are counted
+	code = "{ { } { { } } } } {";
+	mrks vector<mrk BracePair> pairs;
+	mrk BuildStructuralIndex(code.data(), code.size(), index);
+	Check(mrk MatchBraces(code.data(), index, pairs) == 2, "two unpaired braces");
+	Check(pairs.size() == 4 && pairs[0].Open == 2 && pairs[0].Close == 4 && pairs[0].Parent == 3
+		&& pairs[1].Open == 8 && pairs[1].Parent == 2 && pairs[2].Open == 6 && pairs[2].Parent == 3 && pairs[3].Parent == -1, "nesting");
+
+	//same scopes as the token pass, including braces only the lexer knows aren't tokens
+	CheckSameScopes(mrk GenerateCorpus(40), "generated corpus");
+	CheckSameScopes(mrk GenerateNestedCorpus(3, 40), "nested corpus");
+	CheckSameScopes("c A { m void F { __cpp { auto s = \"}\\\"\"; char c = '}'; } } v int x }", "foreign block");
+	CheckSameScopes("c A { $ANDROID m void F { v string s \"}\" } $IOS m void G { } v int y }", "inactive platform", "IOS");
+	CheckSameScopes("c A { $ANDROID v int a m void F { } $ANDROID __java { \"}\" } v int y }", "platform declaration without a block", "IOS");
+	CheckSameScopes("c A { m void F { } } } c B { m void G {", "stray and unclosed braces");
+	CheckSameScopes("c A { v string s \"}\\\\\" }", "backslash at the end of a string");
+
+	if (g_Failures) {
+		mrks cout << g_Failures << " failure(s)\n";
+		return 1;
+	}
+
+	mrks cout << "\tAll passed\n";
+	return 0;
+}
+
+#endif
@@ -31,26 +31,117 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
 
 #include "Tokens.h"
 
-int main()
+namespace
+{
+	//every thread lexes the text over and over on its own lexer, the tokens must match the first
+	//run and the lexer must stop growing after it
+	int LexConcurrently(const mrks string& text, const mrk PlatformSet& platforms, const mrks vector<mrks string>& expected, int threads)
+	{
+		mrks atomic<int> failures(0);
+		mrks vector<mrks thread> workers;
+		for (int t = 0; t < threads; t++)
+		{
+			workers.emplace_back([&]()
+			{
+				mrk Lexer lexer;
+				lexer.Lex(text, false, &platforms);
+				size_t reserved = lexer.GetReservedBytes();
+
+				for (int run = 0; run < 2000; run++)
+				{
+					mrk TokenStore& tokens = lexer.Lex(text, false, &platforms);
+					bool same = tokens.GetCount() == expected.size();
+					for (size_t i = 0; same && i < tokens.GetCount(); i++)
+						same = mrk Tokens::ToValueString(tokens[i]) == expected[i];
+
+					if (!same || lexer.GetReservedBytes() != reserved)
+					{
+						failures++;
+						return;
+					}
+				}
+			});
+		}
+
+		for (mrks thread& worker : workers)
+			worker.join();
+
+		return failures.load();
+	}
+}
+
+int main(int argc, char** argv)
 {
-	mrks cout << "Tokens test\nEnter text:";
 	mrks string intxt;
-	mrks getline(mrks cin, intxt);
+	mrk PlatformSet platforms;
+	int expected = -1;
+	int threads = 0;
+	if (argc > 1)
+	{
+		//non-interactive, text given on the command line
+		mrks cout << "Tokens test\n";
+		intxt = argv[1];
 
-	mrks vector<mrk Token> tokens = mrk Tokens::Collect(intxt, false);
+		for (int i = 2; i + 1 < argc; i += 2)
+		{
+			mrks string arg = argv[i];
+			if (arg == "--platform")
+				platforms.Enable(argv[i + 1]);
+			else if (arg == "--expect")
+				expected = atoi(argv[i + 1]);
+			else if (arg == "--threads")
+				threads = atoi(argv[i + 1]);
+		}
+	}
+	else
+	{
+		mrks cout << "Tokens test\nEnter text:";
+		mrks getline(mrks cin, intxt);
+	}
+
+	mrk Lexer lexer;
+	mrk TokenStore& tokens = lexer.Lex(intxt, false, &platforms);
 
-	mrks cout << "Tokens count: " << tokens.size() << "\n\n";
+	mrks cout << "Tokens count: " << tokens.GetCount() << "\n\n";
 	int idx = 0;
-	for (mrk Token& t : tokens)
+	int errors = 0;
+	mrks vector<mrks string> values;
+	for (mrkpos i = 0; i < tokens.GetCount(); i++)
 	{
-		_STD cout << idx << ' ' << mrk Tokens::ToValueString(t) << '\n';
+		mrk Token& t = tokens[i];
+		values.push_back(mrk Tokens::ToValueString(t));
+		_STD cout << idx << ' ' << values.back() << (t.HasError ? " (error)" : "") << '\n';
+		if (t.HasError)
+			errors++;
 		idx++;
 	}
 
-	system("pause");
+	if (threads > 0)
+	{
+		int failures = LexConcurrently(intxt, platforms, values, threads);
+		mrks cout << threads << " threads x 2000 runs: " << (failures ? "mismatch or growth" : "same tokens, no growth") << '\n';
+		if (failures)
+			return 1;
+	}
+
+#ifdef _WIN32
+	if (argc < 2)
+		system("pause");
+#endif
+
+	if (expected >= 0 && (int)tokens.GetCount() != expected)
+	{
+		mrks cout << "Expected " << expected << " tokens\n";
+		return 1;
+	}
+
+	return errors ? 1 : 0;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Common.h"
+
+#ifdef MRK_TEST_UNICODE
+
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include "Unicode.h"
+#include "Tokens.h"
+#include "Parser.h"
+#include "Model.h"
+#include "TestCommon.h"
+
+namespace {
+	size_t Validate(const mrks string& text) {
+		return mrk ValidateUtf8(text.data(), text.size());
+	}
+
+	//the malformed bytes at every offset of a 64 byte ASCII run, on both sides of each vector step
+	void CheckEveryOffset(const mrks string& bad, const mrks string& what) {
+		for (size_t offset = 0; offset < 80; offset++) {
+			mrks string text = mrks string(offset, 'a') + bad + mrks string(70, 'b');
+			if (Validate(text) != offset) {
+				Check(false, what + " at " + mrks to_string(offset));
+				return;
+			}
+		}
+	}
+}
+
+int main() {
+	mrks cout << "Unicode test\n";
+
+	//well formed, one to four bytes, all around the vector widths
+	mrks string mixed = "c \xd9\x85\xd8\xb1\xd8\xa8\xd8\xb9 { v int \xce\xb1\xce\xb2 \xe5\xbc\x95\xe6\x95\xb0 \xf0\x9d\x90\x80 }";
+	Check(Validate(mixed) == mixed.size(), "mixed scripts valid");
+	Check(Validate(mrks string(1000, 'x')) == 1000, "ASCII valid");
+	Check(Validate("") == 0, "empty valid");
+
+	CheckEveryOffset("\x80", "lone continuation byte");
+	CheckEveryOffset("\xc0\xaf", "overlong 2 bytes");
+	CheckEveryOffset("\xe0\x80\xaf", "overlong 3 bytes");
+	CheckEveryOffset("\xf0\x80\x80\xaf", "overlong 4 bytes");
+	CheckEveryOffset("\xed\xa0\x80", "surrogate");
+	CheckEveryOffset("\xf4\x90\x80\x80", "past U+10FFFF");
+	CheckEveryOffset("\xf5\x80\x80\x80", "invalid lead byte");
+	CheckEveryOffset("\xe2\x82 ", "truncated sequence");
+	Check(Validate("abc\xe2\x82") == 3, "sequence cut by the end");
+
+	size_t pos = 0;
+	mrks string euro = "\xe2\x82\xac!";
+	Check(mrk DecodeUtf8(euro.data(), euro.size(), pos) == 0x20AC && pos == 3, "decode 3 bytes");
+	pos = 0;
+	Check(mrk DecodeUtf8("\xff", 1, pos) == MRK_INVALID_CODEPOINT && pos == 1, "decode skips a bad byte");
+
+	//XID classes
+	Check(mrk IsXidStart('a') && mrk IsXidStart('Z') && !mrk IsXidStart('_') && !mrk IsXidStart('7'), "ASCII start");
+	Check(mrk IsXidContinue('7') && mrk IsXidContinue('_') && !mrk IsXidContinue('$'), "ASCII continue");
+	Check(mrk IsXidStart(0x0645) && mrk IsXidStart(0x03B1) && mrk IsXidStart(0x5F15) && mrk IsXidStart(0x1D400), "letters of other scripts");
+	Check(!mrk IsXidStart(0x0660) && mrk IsXidContinue(0x0660), "Arabic-Indic digit continues only");
+	Check(!mrk IsXidStart(0x0301) && mrk IsXidContinue(0x0301), "combining mark continues only");
+	Check(!mrk IsXidStart(0x00A0) && !mrk IsXidContinue(0x00A0) && !mrk IsXidStart(0x1F600) && !mrk IsXidContinue(0x2028), "spaces and symbols");
+	Check(mrk IsXidStart(0x4E00) && mrk IsXidStart(0x9FFF) && mrk IsXidStart(0x20000) && !mrk IsXidStart(0x110000), "long ranges and bounds");
+
+	mrks string name = "_\xd9\x85\xd8\xb1\xd8\xa8\xd8\xb9\xd9\xa2x\xcc\x81-";
+	Check(mrk ScanIdentifier(name.data(), name.size(), 0) == name.size() - 1, "identifier with marks and digits");
+	Check(mrk ScanIdentifier("\xd9\xa2x", 3, 0) == 0, "digit cannot start");
+
+	//multibyte identifiers are one token each
+	mrk Lexer lexer;
+	mrk TokenStore& tokens = lexer.Lex(mixed);
+	Check(tokens.GetCount() == 9, "token count " + mrks to_string(tokens.GetCount()));
+	if (tokens.GetCount() == 9) {
+		Check(mrks string(tokens[1].Value.IdentifierValue) == "\xd9\x85\xd8\xb1\xd8\xa8\xd8\xb9", "Arabic class name");
+		Check(mrks string(tokens[7].Value.IdentifierValue) == "\xf0\x9d\x90\x80" && tokens[7].Offset == mixed.size() - 6, "4 byte identifier and its offset");
+	}
+
+	//the parser reports malformed input where it starts
+	mrk Parser parser(mrks vector<mrk Source>{
+		mrk Source{ "good.mrk", "c \xd8\xb4\xd9\x83\xd9\x84 { v int \xd8\xb6\xd9\x84\xd8\xb9 }" },
+		mrk Source{ "bad.mrk", "c Bad { v int x\xff }" }
+	});
+
+	mrk ParserResult result;
+	parser.Start(result);
+	Check(!result.Errors.empty() && result.Errors.front().Code == mrk ErrorCode::InvalidUtf8 && result.Errors.front().Offset == 15
+		&& result.Errors.front().Source->Filename == "bad.mrk", "invalid UTF-8 reported at its offset");
+
+	mrk Model model;
+	mrk ResolveModel(parser, model);
+	Check(!model.Modules.empty() && !model.Modules.front().Classes.empty()
+		&& model.Modules.front().Classes.front().Name == "\xd8\xb4\xd9\x83\xd9\x84", "class named in Arabic resolved");
+
+	if (g_Failures) {
+		mrks cout << g_Failures << " failure(s)\n";
+		return 1;
+	}
+
+	mrks cout << "\tAll passed\n";
+	return 0;
+}
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Common.h"
+
+#ifdef MRK_TEST_VM
+
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include "Parser.h"
+#include "Model.h"
+#include "Semantic.h"
+#include "Bytecode.h"
+#include "VM.h"
+#include "TestCommon.h"
+
+namespace {
+	//parse, analyze and lower one source, the parser has to outlive the program
+	struct Compiled {
+		mrk Parser Parser;
+		mrk Model Model;
+		mrk Semantic Semantic;
+		mrk Program Program;
+		mrks vector<mrk Error> Errors;
+
+		Compiled(const char* code) : Parser(mrks vector<mrk Source> { mrk Source{ "Test.mrk", code } }) {
+			mrk ParserResult result;
+			Parser.Start(result);
+			Errors = result.Errors;
+
+			mrk ResolveModel(Parser, Model);
+			Semantic.Analyze(Model, Errors);
+			mrk BytecodeCompiler(Semantic).Compile(Model, Program, Errors);
+		}
+	};
+
+	const char* g_Program =
+		"c Math {\n"
+		"	v int base { r 40 }\n"
+		"	v long big { r 1L << 40 }\n"
+		"	v string name { r \"mrk\" }\n"
+		"	m long Arith { p { long a long b } r (a + b) * 3 - a / b % 5 + (a << 2) - (b >> 1) + (a ^ b) - ~a }\n"
+		"	m double Mixed { p { int a double b } r a / 2 + b * 3 / 4 }\n"
+		"	m bool Logic { p { int a } r a > 0 && a < 10 || a == 42 }\n"
+		"	m int Narrow { p { int a } v byte b v short s b = a s = a * 1000 r b + s }\n"
+		"	m ulong Unsigned { p { ulong a } r a / 3UL + (a >> 60) }\n"
+		"	m string Greet { p { string who } r name + \", \" + who }\n"
+		"	m bool Same { p { string a } r a == \"mrk\" }\n"
+		"	m int Divide { p { int a int b } r a / b }\n"
+		"	m long Fib { p { long n } v long result result = n n > 1 && (result = Fib(n - 1) + Fib(n - 2)) >= 0 r result }\n"
+		"	m int Constant { r base + Point.Origin + Point().Origin + 2 }\n"
+		"	m int Build { v Point p p = Point(3, 4) p.Move(1) r p.x * 10 + p.y + Point().x }\n"
+		"	m int Count { v Counter c c = Counter() c.Add(5) c.Add(7) c.total += 1 r c.total + c.calls }\n"
+		"	m int Defaults { p { int a } v int b { r a * 2 } v int c { r Divide(b, 2) + b } r c }\n"
+		"}\n"
+		"c Point {\n"
+		"	v int Origin { r 100 }\n"
+		"	v int x\n"
+		"	v int y\n"
+		"	m .{ p { int px int py } x = px y = py }\n"
+		"	m .{ }\n"
+		"	m void Move { p { int d } x += d y = y + d }\n"
+		"}\n"
+		"c Counter {\n"
+		"	v int total\n"
+		"	v int calls\n"
+		"	m void Add { p { int n } total += n calls = calls + 1 r }\n"
+		"}\n";
+
+	bool Run(mrk VM& vm, const mrk Program& program, const char* name, const mrks vector<mrk Value>& args, mrk Value& result) {
+		mrku32 math = program.FindClass("Math");
+		mrku32 method = program.FindMethod(math, name);
+		if (method == MRK_VM_NONE)
+			return false;
+
+		return vm.Invoke(method, vm.New(math), args.data(), &result);
+	}
+
+	mrk Value Int(long long value) {
+		mrk Value v;
+		v.Int = value;
+		return v;
+	}
+
+	mrk Value Float(double value) {
+		mrk Value v;
+		v.Float = value;
+		return v;
+	}
+
+	void CheckPrograms(mrk Dispatch dispatch, const char* label) {
+		Compiled compiled(g_Program);
+		for (mrk Error& err : compiled.Errors)
+			mrks cout << "\t" << mrk FormatError(err) << '\n';
+
+		Check(compiled.Errors.empty(), mrks string(label) + ": compiles without errors");
+
+		mrk VM vm(compiled.Program, 1 << 16);
+		vm.SetDispatch(dispatch);
+
+		mrk Value result;
+		mrks string what = mrks string(label) + ": ";
+
+		long long a = 17, b = 5;
+		Check(Run(vm, compiled.Program, "Arith", { Int(a), Int(b) }, result)
+			&& result.Int == (a + b) * 3 - a / b % 5 + (a << 2) - (b >> 1) + (a ^ b) - ~a, what + "arithmetic");
+
+		Check(Run(vm, compiled.Program, "Mixed", { Int(7), Float(2.0) }, result) && result.Float == 3 + 1.5, what + "int to double");
+
+		Check(Run(vm, compiled.Program, "Logic", { Int(5) }, result) && result.Int == 1, what + "&& true");
+		Check(Run(vm, compiled.Program, "Logic", { Int(12) }, result) && result.Int == 0, what + "&& false");
+		Check(Run(vm, compiled.Program, "Logic", { Int(42) }, result) && result.Int == 1, what + "|| short-circuit");
+
+		//byte wraps to 44, short keeps the low 16 bits of 300000
+		Check(Run(vm, compiled.Program, "Narrow", { Int(300) }, result) && result.Int == 44 + (short)300000, what + "narrowing stores");
+
+		mrk Value huge;
+		huge.UInt = 0xF000000000000000ull;
+		Check(Run(vm, compiled.Program, "Unsigned", { huge }, result) && result.UInt == 0xF000000000000000ull / 3 + 15, what + "unsigned division and shift");
+
+		mrks string who = "lang";
+		mrk Value str;
+		str.Ref = &who;
+		Check(Run(vm, compiled.Program, "Greet", { str }, result) && mrk VM::ToString(result) == "mrk, lang", what + "string concat");
+		Check(Run(vm, compiled.Program, "Same", { str }, result) && result.Int == 0, what + "string compare");
+
+		Check(Run(vm, compiled.Program, "Fib", { Int(20) }, result) && result.Int == 6765, what + "recursive calls");
+		Check(Run(vm, compiled.Program, "Constant", {}, result) && result.Int == 242, what + "folded constants");
+		Check(Run(vm, compiled.Program, "Build", {}, result) && result.Int == 45, what + "ctors, fields and instance calls");
+		Check(Run(vm, compiled.Program, "Count", {}, result) && result.Int == 15, what + "objects from default fields");
+
+		Check(Run(vm, compiled.Program, "Defaults", { Int(5) }, result) && result.Int == 15, what + "runtime local defaults");
+
+		Check(!Run(vm, compiled.Program, "Divide", { Int(1), Int(0) }, result)
+			&& vm.GetError() == "Division by zero in Math::Divide", what + "runtime error");
+		Check(Run(vm, compiled.Program, "Divide", { Int(-9), Int(2) }, result) && result.Int == -4, what + "vm usable after an error");
+	}
+}
+
+int main() {
+	mrks cout << "VM test\n";
+
+	CheckPrograms(mrk Dispatch::Threaded, "threaded");
+	CheckPrograms(mrk Dispatch::Switch, "switch");
+
+	//field layout table
+	{
+		Compiled compiled(g_Program);
+		const mrk ProgramClass& point = compiled.Program.Classes[compiled.Program.FindClass("Point")];
+		Check(point.Fields.size() == 3 && point.Fields[1].Name == "x" && point.Fields[1].Kind == mrk ValueKind::Int, "field layout");
+		Check(point.Fields[0].Constant && point.Defaults[0].Int == 100 && !point.Fields[1].Constant, "constant field");
+	}
+
+	//unbounded recursion hits the stack limit instead of the host stack
+	{
+		Compiled compiled("c A { m int F { p { int n } r F(n + 1) } }");
+		mrk VM vm(compiled.Program, 1024);
+		mrk Value arg;
+		arg.Int = 0;
+		Check(!vm.Invoke(compiled.Program.FindMethod(0, "F"), vm.New(0), &arg, 0) && vm.GetError() == "Stack overflow in A::F", "stack overflow");
+	}
+
+	//errors name the method and leave it without code
+	{
+		Compiled compiled(
+			"c A { v int f { r 1 } m int B { r missing } m int C { r \"s\" } m void D { f = 2 } m int E { r G(1) } m void G { } "
+			"m void H { v Other o o = Other(1) } m int I { r Other.y } m void J { r 1 } m int K { r 1 } }\n"
+			"c Other { v int y }");
+
+		for (mrk Error& err : compiled.Errors)
+			mrks cout << "\t" << mrk FormatError(err) << '\n';
+
+		Check(compiled.Errors.size() == 7, "7 compile errors");
+		Check(HasError(compiled.Errors, "Undefined name 'missing' in A::B"), "undefined name");
+		Check(HasError(compiled.Errors, "Type mismatch in A::C"), "return type");
+		Check(HasError(compiled.Errors, "Not assignable 'f' in A::D"), "constant assignment");
+		Check(HasError(compiled.Errors, "Wrong number of arguments 'G' in A::E"), "argument count");
+		Check(HasError(compiled.Errors, "No constructor 'Other with 1 argument(s)' in A::H"), "missing ctor");
+		Check(HasError(compiled.Errors, "Instance member used without an object 'y' in A::I"), "field through a type");
+		Check(HasError(compiled.Errors, "Type mismatch 'r' in A::J"), "value from void");
+
+		mrk VM vm(compiled.Program);
+		mrku32 b = compiled.Program.FindMethod(0, "B");
+		Check(compiled.Program.Methods[b].Code == MRK_VM_NONE, "failed method has no code");
+		Check(!vm.Invoke(b, vm.New(0), 0, 0) && vm.GetError() == "Method has no code in A::B", "invoking a failed method");
+
+		mrk Value result;
+		Check(vm.Invoke(compiled.Program.FindMethod(0, "K"), vm.New(0), 0, &result) && result.Int == 1, "other methods still run");
+	}
+
+	if (g_Failures) {
+		mrks cout << g_Failures << " check(s) failed\n";
+		return 1;
+	}
+
+	mrks cout << "All checks passed\n";
+	return 0;
+}
+
+#endif
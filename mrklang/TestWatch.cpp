@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Common.h"
+
+#ifdef MRK_TEST_WATCH
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+
+#include "Watcher.h"
+#include "TestCommon.h"
+
+namespace {
+	void WriteSource(const mrks filesystem::path& path, const mrks string& code) {
+		mrks ofstream(path, mrks ios::binary) << code;
+	}
+
+	mrks string ReadFile(const mrks filesystem::path& path) {
+		mrks ifstream stream(path, mrks ios::binary);
+		mrks stringstream buffer;
+		buffer << stream.rdbuf();
+		return buffer.str();
+	}
+
+	//lines of the watch loop, read from the test thread
+	class Log {
+	private:
+		mrks mutex m_Mutex;
+		mrks vector<mrks string> m_Lines;
+
+	public:
+		void Add(const mrks string& line) {
+			mrks lock_guard<mrks mutex> lock(m_Mutex);
+			m_Lines.push_back(line);
+		}
+
+		//the first line containing text, empty after a few seconds without one
+		mrks string WaitFor(const mrks string& text) {
+			for (int i = 0; i < 500; i++) {
+				{
+					mrks lock_guard<mrks mutex> lock(m_Mutex);
+					for (const mrks string& line : m_Lines)
+						if (line.find(text) != mrks string::npos)
+							return line;
+				}
+
+				mrks this_thread::sleep_for(mrks chrono::milliseconds(10));
+			}
+
+			return "";
+		}
+	};
+}
+
+int main(int argc, char** argv) {
+	mrks cout << "Watch test\n";
+
+#ifndef __linux__
+	mrks cout << "\tskipped, no inotify\n";
+	return 0;
+#else
+	mrks filesystem::path dir = argc > 1 ? mrks filesystem::path(argv[1]) : mrks filesystem::temp_directory_path() / "mrk_test_watch";
+	mrks filesystem::remove_all(dir);
+	mrks filesystem::create_directories(dir / "src");
+	mrks filesystem::create_directories(dir / "lib");
+
+	//Shape includes the geo module from the include directory and folds one of its constants
+	WriteSource(dir / "lib" / "geo.mrk", "c Geometry { v int sides { r 4 } }");
+	WriteSource(dir / "src" / "Shape.mrk", "i geo; c Shape { v int corners { r Geometry.sides * 2 } }");
+	WriteSource(dir / "src" / "Other.mrk", "c Other { v int unrelated { r 1 } }");
+
+	mrk CompileOptions options;
+	mrks string error;
+	bool parsed = mrk ParseCompileArguments({ "src/Shape.mrk", "src/Other.mrk", "-I", "lib", "-o", "out", "--target", "cpp" }, dir.string(), options, error);
+	Check(parsed, "arguments: " + error);
+
+	mrk WatchOptions watch;
+	watch.MaxRebuilds = 2;
+	watch.TimeoutMs = 5000;
+
+	Log log;
+	mrk Compiler compiler;
+	int status = -1;
+	mrks thread watching([&]() { status = mrk Watch(compiler, options, watch, [&log](const mrks string& line) { log.Add(line); }); });
+
+	mrks string built = log.WaitFor("watch: built");
+	Check(!built.empty(), "initial build");
+	Check(ReadFile(dir / "out" / "cpp" / "Shape.h").find("8") != mrks string::npos, "included module folded");
+	Check(compiler.GetLastSources().size() == 3, "include resolved through -I");
+
+	//the included module changes, the source including it is emitted again, the unrelated one is not
+	mrks error_code ec;
+	auto otherTime = mrks filesystem::last_write_time(dir / "out" / "cpp" / "Other.h", ec);
+	WriteSource(dir / "lib" / "geo.mrk", "c Geometry { v int sides { r 6 } }");
+	mrks string first = log.WaitFor("rebuild 1");
+	Check(first.find("geo.mrk") != mrks string::npos && first.find("(1 parsed)") != mrks string::npos, "one parse for the included module: " + first);
+	Check(ReadFile(dir / "out" / "cpp" / "Shape.h").find("12") != mrks string::npos, "dependent source emitted again");
+	Check(!ec && mrks filesystem::last_write_time(dir / "out" / "cpp" / "Other.h", ec) == otherTime, "unrelated output untouched");
+
+	//a burst of saves is one rebuild
+	for (int i = 0; i < 5; i++)
+		WriteSource(dir / "src" / "Other.mrk", "c Other { v int unrelated { r " + mrks to_string(i + 2) + " } }");
+
+	mrks string second = log.WaitFor("rebuild 2");
+	Check(second.find("1 change(s)") != mrks string::npos && second.find("(1 parsed)") != mrks string::npos, "debounced burst: " + second);
+
+	watching.join();
+	Check(status == 0, "status of the last rebuild");
+	Check(ReadFile(dir / "out" / "cpp" / "Other.h").find("6") != mrks string::npos, "last save of the burst emitted");
+
+	mrks cout << '\t' << first << "\n\t" << second << '\n';
+
+	if (g_Failures) {
+		mrks cout << g_Failures << " failure(s)\n";
+		return 1;
+	}
+
+	mrks cout << "\tAll passed\n";
+	return 0;
+#endif
+}
+
+#endif
@@ -25,85 +25,167 @@
  */
 
 #include "Tokens.h"
+#include "BlockScanner.h"
+#include "Unicode.h"
 
 #include <iostream>
+#include <cstring>
+#include <charconv>
+#include <string_view>
+
+#define MRK_LEXER_TEXT_CHUNK (64 * 1024)
 
 namespace MRK
 {
-	Tokens::TokenizerState* Tokens::ms_Target = 0;
+	TokenStore::TokenStore() : m_Base(0), m_ChunkStart(0), m_Next(0), m_ChunkEnd(0)
+	{
+	}
+
+	void TokenStore::NextChunk()
+	{
+		//chunks are filled in order, the one after the last in use may be left from a previous source
+		m_Base = GetCount();
+		mrkpos chunk = m_Base >> MRK_TOKEN_CHUNK_SHIFT;
+		if (chunk == m_Chunks.size())
+			m_Chunks.emplace_back(new Token[(size_t)1 << MRK_TOKEN_CHUNK_SHIFT]);
+
+		m_ChunkStart = m_Next = m_Chunks[chunk].get();
+		m_ChunkEnd = m_Next + ((size_t)1 << MRK_TOKEN_CHUNK_SHIFT);
+	}
+
+	size_t TokenStore::GetReservedBytes() const
+	{
+		return (m_Chunks.size() << MRK_TOKEN_CHUNK_SHIFT) * sizeof(Token) + m_Chunks.capacity() * sizeof(void*);
+	}
+
+	void TokenStore::Clear()
+	{
+		m_Base = 0;
+		m_ChunkStart = m_Next = m_ChunkEnd = 0;
+	}
+
+	void TokenStore::Swap(TokenStore& other)
+	{
+		_STD swap(m_Chunks, other.m_Chunks);
+		_STD swap(m_Base, other.m_Base);
+		_STD swap(m_ChunkStart, other.m_ChunkStart);
+		_STD swap(m_Next, other.m_Next);
+		_STD swap(m_ChunkEnd, other.m_ChunkEnd);
+	}
 
-	void Tokens::AssignNumber(Token& token, TokenizerState* state)
+	Lexer::Lexer() : m_State(TOKENIZER_STATE_NONE), m_TextChunk(0), m_TextUsed(0)
+	{
+	}
+
+	const char* Lexer::AddText(const char* text, size_t length)
+	{
+		//oversized text lives until the next call on its own, the chunks are kept
+		if (length + 1 > MRK_LEXER_TEXT_CHUNK)
+		{
+			m_LargeText.emplace_back(new char[length + 1]);
+			memcpy(m_LargeText.back().get(), text, length);
+			m_LargeText.back()[length] = 0;
+			return m_LargeText.back().get();
+		}
+
+		if (m_TextChunk < m_TextChunks.size() && m_TextUsed + length + 1 > MRK_LEXER_TEXT_CHUNK)
+		{
+			m_TextChunk++;
+			m_TextUsed = 0;
+		}
+
+		if (m_TextChunk == m_TextChunks.size())
+			m_TextChunks.emplace_back(new char[MRK_LEXER_TEXT_CHUNK]);
+
+		char* dest = m_TextChunks[m_TextChunk].get() + m_TextUsed;
+		memcpy(dest, text, length);
+		dest[length] = 0;
+		m_TextUsed += length + 1;
+		return dest;
+	}
+
+	size_t Lexer::GetReservedBytes() const
+	{
+		size_t bytes = m_Tokens.GetReservedBytes() + m_TextChunks.size() * MRK_LEXER_TEXT_CHUNK + m_Buffer.capacity();
+		bytes += m_BraceTokens.capacity() * sizeof(mrkpos);
+		return bytes + (m_TextChunks.capacity() + m_LargeText.capacity()) * sizeof(void*);
+	}
+
+	const _STD vector<mrkpos>& Lexer::GetBraceTokens() const
+	{
+		return m_BraceTokens;
+	}
+
+	void Lexer::AssignNumber(Token& token, TokenizerState* state)
 	{
 		token.Kind = TOKEN_KIND_NUMBER;
 		if (state)
 			* state = TOKENIZER_STATE_NUMBER;
 	}
 
-	void Tokens::AssignWord(Token& token, TokenizerState* state)
+	void Lexer::AssignWord(Token& token, TokenizerState* state)
 	{
 		token.Kind = TOKEN_KIND_WORD;
 		if (state)
 			* state = TOKENIZER_STATE_WORD;
 	}
 
-	void Tokens::AssignShort(Token& token, short num)
+	void Lexer::AssignShort(Token& token, short num)
 	{
 		token.Value.ShortValue = num;
 		token.ContextualKind = TOKEN_CONTEXTUAL_KIND_SHORT;
 	}
 
-	void Tokens::AssignUShort(Token& token, unsigned short num)
+	void Lexer::AssignUShort(Token& token, unsigned short num)
 	{
 		token.Value.UShortValue = num;
 		token.ContextualKind = TOKEN_CONTEXTUAL_KIND_USHORT;
 	}
 
-	void Tokens::AssignInt(Token& token, int num)
+	void Lexer::AssignInt(Token& token, int num)
 	{
 		token.Value.IntValue = num;
 		token.ContextualKind = TOKEN_CONTEXTUAL_KIND_INT;
 	}
 
-	void Tokens::AssignUInt(Token& token, unsigned int num)
+	void Lexer::AssignUInt(Token& token, unsigned int num)
 	{
 		token.Value.UIntValue = num;
 		token.ContextualKind = TOKEN_CONTEXTUAL_KIND_UINT;
 	}
 
-	void Tokens::AssignLong(Token& token, long num)
+	void Lexer::AssignLong(Token& token, long num)
 	{
 		token.Value.LongValue = num;
 		token.ContextualKind = TOKEN_CONTEXTUAL_KIND_LONG;
 	}
 
-	void Tokens::AssignULong(Token& token, unsigned long num)
+	void Lexer::AssignULong(Token& token, unsigned long num)
 	{
 		token.Value.ULongValue = num;
 		token.ContextualKind = TOKEN_CONTEXTUAL_KIND_ULONG;
 	}
 
-	void Tokens::AssignIdentifier(Token& token, _STD string val)
+	void Lexer::AssignIdentifier(Token& token, const char* text, size_t length)
 	{
-		token.Value.IdentifierValue = new char[val.length() + 1];
-		strcpy(token.Value.IdentifierValue, val.c_str());
+		token.Value.IdentifierValue = AddText(text, length);
 		token.ContextualKind = TOKEN_CONTEXTUAL_KIND_IDENTIFIER;
 	}
 
-	void Tokens::AssignString(Token& token, _STD string val)
+	void Lexer::AssignString(Token& token, const char* text, size_t length)
 	{
-		token.Value.StringValue = new char[val.length() + 1];
-		strcpy(token.Value.StringValue, val.c_str());
+		token.Value.StringValue = AddText(text, length);
 		token.ContextualKind = TOKEN_CONTEXTUAL_KIND_STRING;
 	}
 
-	void Tokens::AssignChar(Token& token, char val)
+	void Lexer::AssignChar(Token& token, char val)
 	{
 		token.Value.CharValue = val;
 		token.ContextualKind = TOKEN_CONTEXTUAL_KIND_CHAR;
 		token.Kind = TOKEN_KIND_SYMBOL;
 	}
 
-	bool Tokens::TestUInt(_STD string test, unsigned int* val)
+	bool Lexer::TestUInt(const _STD string& test, unsigned int* val)
 	{
 		unsigned long l;
 		unsigned int i;
@@ -114,37 +196,30 @@ namespace MRK
 		return true;
 	}
 
-	bool Tokens::TestULong(_STD string test, unsigned long* val)
+	bool Lexer::TestULong(const _STD string& test, unsigned long* val)
 	{
-		try
-		{
-			unsigned long l = _STD stoul(test);
-			if (val)
-				* val = l;
-			return true;
-		}
-		catch (...)
-		{
+		//digits only, no copy and no exception on overflow
+		unsigned long l;
+		_STD from_chars_result result = _STD from_chars(test.data(), test.data() + test.size(), l);
+		if (result.ec != _STD errc() || result.ptr != test.data() + test.size())
 			return false;
-		}
+		if (val)
+			* val = l;
+		return true;
 	}
 
-	bool Tokens::TestLong(_STD string test, long* val)
+	bool Lexer::TestLong(const _STD string& test, long* val)
 	{
-		try
-		{
-			long l = _STD stol(test);
-			if (val)
-				* val = l;
-			return true;
-		}
-		catch (...)
-		{
+		long l;
+		_STD from_chars_result result = _STD from_chars(test.data(), test.data() + test.size(), l);
+		if (result.ec != _STD errc() || result.ptr != test.data() + test.size())
 			return false;
-		}
+		if (val)
+			* val = l;
+		return true;
 	}
 
-	bool Tokens::TestInt(_STD string test, int* val)
+	bool Lexer::TestInt(const _STD string& test, int* val)
 	{
 		long l;
 		int i;
@@ -155,7 +230,7 @@ namespace MRK
 		return true;
 	}
 
-	bool Tokens::IsSkippableCharacter(char character, bool inclSp)
+	bool Lexer::IsSkippableCharacter(char character, bool inclSp)
 	{
 		switch (character)
 		{
@@ -169,48 +244,77 @@ namespace MRK
 		return false;
 	}
 
-	void Tokens::ResetState()
+	void Lexer::ResetState()
 	{
-		if (ms_Target)
-			* ms_Target = TOKENIZER_STATE_NONE;
+		m_State = TOKENIZER_STATE_NONE;
 	}
 
-	void Tokens::SetExecutor(TokenizerState* state)
+	//__cpp/__cs/__java { ... }, the body becomes one raw token spanning the source
+	//returns the index after the closing brace, npos if word is not a foreign keyword
+	size_t Lexer::CaptureForeign(const _STD string& text, size_t pos, const char* word, size_t length)
 	{
-		ms_Target = state;
+		_STD string_view name(word, length);
+		BlockSyntax syntax;
+		if (name == "__cpp")
+			syntax = BlockSyntax::Cpp;
+		else if (name == "__cs")
+			syntax = BlockSyntax::Cs;
+		else if (name == "__java")
+			syntax = BlockSyntax::Java;
+		else
+			return _STD string::npos;
+
+		while (pos < text.size() && (text[pos] == ' ' || IsSkippableCharacter(text[pos], false)))
+			pos++;
+
+		if (pos >= text.size() || text[pos] != '{')
+			return _STD string::npos;
+
+		bool closed;
+		size_t end = FindBlockEnd(text.data(), text.size(), pos, syntax, &closed);
+
+		Token raw = Token();
+		raw.Kind = TOKEN_KIND_RAW;
+		raw.ContextualKind = TOKEN_CONTEXTUAL_KIND_RAW;
+		raw.Value.RawValue.Length = (closed ? end - 1 : end) - pos - 1;
+		raw.HasError = !closed;
+		raw.Offset = pos;
+		m_Tokens.Add(raw);
+
+		return end;
 	}
 
-	_STD vector<Token> Tokens::Collect(_STD string& text, bool inclSp)
+	TokenStore& Lexer::Lex(const _STD string& text, bool inclSp, const PlatformSet* platforms)
 	{
-		_STD vector<Token> tokens;
+		//storage of the previous call is reused, not released
+		m_Tokens.Clear();
+		m_TextChunk = 0;
+		m_TextUsed = 0;
+		m_LargeText.clear();
+		m_BraceTokens.clear();
+		m_State = TOKENIZER_STATE_NONE;
+
 		size_t textpos = 0;
-		TokenizerState state = TOKENIZER_STATE_NONE;
-		SetExecutor(&state);
 		Token token;
-		_STD string buffer;
-		struct { int b; int e; int val() { return b - e; } } escapeStack;
+		struct { int b; int e; int val() { return b - e; } } escapeStack = { 0, 0 };
 		while (true)
 		{
 			bool eof = textpos >= text.size();
 			char currentCharacter = eof ? ' ' : text[textpos];
-			if ((IsSkippableCharacter(currentCharacter, inclSp) || eof) && state != TOKENIZER_STATE_STRING)
+			if ((IsSkippableCharacter(currentCharacter, inclSp) || eof) && m_State != TOKENIZER_STATE_STRING)
 			{
-				if (state != TOKENIZER_STATE_NONE)
+				if (m_State != TOKENIZER_STATE_NONE)
 				{
-					switch (state)
+					switch (m_State)
 					{
-					case TOKENIZER_STATE_WORD:
-						AssignIdentifier(token, buffer);
-						tokens.push_back(token);
-						break;
 					case TOKENIZER_STATE_NUMBER:
 						//int
 						int i;
-						if (TestInt(buffer, &i))
+						if (TestInt(m_Buffer, &i))
 							AssignInt(token, i);
 						else
 							token.HasError = true;
-						tokens.push_back(token);
+						m_Tokens.Add(token);
 						break;
 					}
 					ResetState();
@@ -222,41 +326,55 @@ namespace MRK
 			}
 			if (eof)
 				break;
-			switch (state)
+			switch (m_State)
 			{
 			case TOKENIZER_STATE_NONE:
-				buffer = ""; //clear buffer
+				m_Buffer.clear();
 				token = Token();
-				if (isdigit(currentCharacter))
+				token.Offset = textpos;
+				if (currentCharacter >= '0' && currentCharacter <= '9')
 				{
 					AssignNumber(token);
-					state = TOKENIZER_STATE_NUMBER;
+					m_State = TOKENIZER_STATE_NUMBER;
 				}
-				else if (isalpha(currentCharacter))
+				else if (size_t length = ScanIdentifier(text.data(), text.size(), textpos))
 				{
+					//the whole identifier at once, XID_Start or '_' then XID_Continue
 					AssignWord(token);
-					state = TOKENIZER_STATE_WORD;
+					AssignIdentifier(token, text.data() + textpos, length);
+					m_Tokens.Add(token);
+
+					size_t foreignEnd = CaptureForeign(text, textpos + length, text.data() + textpos, length);
+					textpos = (foreignEnd != _STD string::npos ? foreignEnd : textpos + length) - 1;
+					break;
 				}
-				else
-					state = TOKENIZER_STATE_SYMBOL;
-				textpos--;
-				break;
+				else if (currentCharacter == '$' && textpos + 1 < text.size() && isalpha((unsigned char)text[textpos + 1]))
+				{
+					//$PLATFORM directive, never a token itself
+					size_t nameEnd = textpos + 1;
+					while (nameEnd < text.size() && (isalnum((unsigned char)text[nameEnd]) || text[nameEnd] == '_'))
+						nameEnd++;
 
-			case TOKENIZER_STATE_WORD:
-				if (isalnum(currentCharacter) || currentCharacter == '_')
-					buffer += currentCharacter;
-				else
+					bool active = !platforms || platforms->IsActive(text.data() + textpos + 1, nameEnd - textpos - 1);
+					textpos = (active ? nameEnd : FindDirectiveEnd(text.data(), text.size(), nameEnd)) - 1;
+					break;
+				}
+				else if (currentCharacter == '/' && textpos + 1 < text.size() && (text[textpos + 1] == '/' || text[textpos + 1] == '*'))
 				{
-					AssignIdentifier(token, buffer);
-					tokens.push_back(token);
-					ResetState();
-					textpos--;
+					//comments never become tokens, textpos ends on their last character
+					bool line = text[textpos + 1] == '/';
+					size_t end = line ? text.find('\n', textpos + 2) : text.find("*/", textpos + 2);
+					textpos = end == _STD string::npos ? text.size() - 1 : (line ? end : end + 1);
+					break;
 				}
+				else
+					m_State = TOKENIZER_STATE_SYMBOL;
+				textpos--;
 				break;
 
 			case TOKENIZER_STATE_NUMBER:
-				if (isdigit(currentCharacter))
-					buffer += currentCharacter;
+				if (currentCharacter >= '0' && currentCharacter <= '9')
+					m_Buffer += currentCharacter;
 				else
 				{
 					switch (currentCharacter)
@@ -273,11 +391,11 @@ namespace MRK
 							case 'l': //ulong
 							case 'L': //ulong
 								unsigned long ul;
-								if (TestULong(buffer, &ul))
+								if (TestULong(m_Buffer, &ul))
 									AssignULong(token, ul);
 								else
 									token.HasError = true;
-								tokens.push_back(token);
+								m_Tokens.Add(token);
 								ResetState();
 								break;
 							default:
@@ -289,12 +407,12 @@ namespace MRK
 						{
 							//this is uint
 							unsigned int ui;
-							if (TestUInt(buffer, &ui))
+							if (TestUInt(m_Buffer, &ui))
 								AssignUInt(token, ui);
 							else
 								//out of range
 								token.HasError = true;
-							tokens.push_back(token);
+							m_Tokens.Add(token);
 							ResetState();
 						}
 						else
@@ -305,22 +423,22 @@ namespace MRK
 					case 'l': //long
 					case 'L': //long
 						long l;
-						if (TestLong(buffer, &l))
+						if (TestLong(m_Buffer, &l))
 							AssignLong(token, l);
 						else
 							token.HasError = true;
-						tokens.push_back(token);
+						m_Tokens.Add(token);
 						ResetState();
 						break;
 
 					default:
 						//this is int
 						int i;
-						if (TestInt(buffer, &i))
+						if (TestInt(m_Buffer, &i))
 							AssignInt(token, i);
 						else
 							token.HasError = true;
-						tokens.push_back(token);
+						m_Tokens.Add(token);
 						ResetState();
 						textpos--;
 						//unknown character so compensate it for the next token
@@ -333,15 +451,13 @@ namespace MRK
 				switch (currentCharacter)
 				{
 				case '"':
-					state = TOKENIZER_STATE_STRING;
-					break;
-				case '_':
-					state = TOKENIZER_STATE_WORD;
-					textpos--;
+					m_State = TOKENIZER_STATE_STRING;
 					break;
 				default:
+					if (currentCharacter == '{' || currentCharacter == '}')
+						m_BraceTokens.push_back(m_Tokens.GetCount());
 					AssignChar(token, currentCharacter);
-					tokens.push_back(token);
+					m_Tokens.Add(token);
 					ResetState();
 					//textpos--;
 					break;
@@ -361,13 +477,13 @@ namespace MRK
 					if (escapeStack.val() == 0)
 					{
 						//close string
-						AssignString(token, buffer);
-						tokens.push_back(token);
+						AssignString(token, m_Buffer.data(), m_Buffer.size());
+						m_Tokens.Add(token);
 						ResetState();
 						break;
 					}
 					escapeStack.e++;
-					buffer += "\"";
+					m_Buffer += "\"";
 					break;
 
 				case '\\':
@@ -377,7 +493,7 @@ namespace MRK
 						break;
 					}
 					escapeStack.e++;
-					buffer += '\\';
+					m_Buffer += '\\';
 					break;
 
 				default:
@@ -386,12 +502,28 @@ namespace MRK
 						switch (currentCharacter)
 						{
 						case 't':
+							escapeStack.e++;
+							m_Buffer += '\t';
+							break;
+
 						case 'n':
+							escapeStack.e++;
+							m_Buffer += '\n';
+							break;
+
 						case 'r':
+							escapeStack.e++;
+							m_Buffer += '\r';
+							break;
+
 						case 'b':
+							escapeStack.e++;
+							m_Buffer += '\b';
+							break;
+
 						case 'f':
 							escapeStack.e++;
-							buffer += _STD string("\\") + currentCharacter;
+							m_Buffer += '\f';
 							break;
 
 						default:
@@ -402,17 +534,17 @@ namespace MRK
 						break;
 					}
 					if (!token.HasError)
-						buffer += currentCharacter;
+						m_Buffer += currentCharacter;
 					break;
 				}
 				break;
 			}
 			textpos++;
 		}
-		return tokens;
+		return m_Tokens;
 	}
 
-	_STD string Tokens::ToValueString(Token& token)
+	_STD string Tokens::ToValueString(const Token& token)
 	{
 		switch (token.ContextualKind)
 		{
@@ -427,9 +559,11 @@ namespace MRK
 		case TOKEN_CONTEXTUAL_KIND_LONG:
 			return _STD to_string(token.Value.LongValue);
 		case TOKEN_CONTEXTUAL_KIND_STRING:
-			return '"' + token.Value.StringValue + '"';
+			return _STD string("\"") + token.Value.StringValue + '"';
 		case TOKEN_CONTEXTUAL_KIND_CHAR:
-			return _STD string(&token.Value.CharValue);
+			return _STD string(1, token.Value.CharValue);
+		case TOKEN_CONTEXTUAL_KIND_RAW:
+			return "{raw " + _STD to_string(token.Value.RawValue.Length) + " bytes}";
 		}
 		return "";
 	}
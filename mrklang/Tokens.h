@@ -26,20 +26,28 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <string>
+#include <memory>
+
+#include "Common.h"
+#include "Platform.h"
+
+#define MRK_TOKEN_CHUNK_SHIFT 12 //4096 tokens, 96 KB per chunk
 
 namespace MRK
 {
-	enum TokenKind
+	enum TokenKind : unsigned char
 	{
 		TOKEN_KIND_NONE,
 		TOKEN_KIND_WORD,
 		TOKEN_KIND_NUMBER,
-		TOKEN_KIND_SYMBOL
+		TOKEN_KIND_SYMBOL,
+		TOKEN_KIND_RAW
 	};
 
-	enum TokenContextualKind
+	enum TokenContextualKind : unsigned char
 	{
 		TOKEN_CONTEXTUAL_KIND_NONE,
 		TOKEN_CONTEXTUAL_KIND_SHORT,
@@ -50,13 +58,16 @@ namespace MRK
 		TOKEN_CONTEXTUAL_KIND_ULONG,
 		TOKEN_CONTEXTUAL_KIND_STRING,
 		TOKEN_CONTEXTUAL_KIND_IDENTIFIER,
-		TOKEN_CONTEXTUAL_KIND_CHAR
+		TOKEN_CONTEXTUAL_KIND_CHAR,
+		TOKEN_CONTEXTUAL_KIND_RAW //foreign block body, a span of the lexed text
 	};
 
+	//24 bytes, the kinds are a byte each so the offset can be 64 bit
 	struct Token
 	{
 		TokenKind Kind;
 		TokenContextualKind ContextualKind;
+		bool HasError; //temp
 
 		union
 		{
@@ -66,15 +77,96 @@ namespace MRK
 			unsigned int UIntValue;
 			long LongValue;
 			unsigned long ULongValue;
-			char *IdentifierValue;
-			char *StringValue;
+			const char *IdentifierValue; //owned by the lexer
+			const char *StringValue;
 			char CharValue;
+			struct
+			{
+				mrkpos Length; //the body starts after the '{' at Offset
+			} RawValue;
 		} Value;
 
-		bool HasError; //temp
+		mrkpos Offset; //first character in the lexed text
 	};
 
-	class Tokens
+	static_assert(sizeof(Token) <= 24 || sizeof(void*) < 8, "Token is meant to stay compact");
+
+	//tokens in fixed chunks: growing never moves the tokens already stored and a huge source
+	//never needs one contiguous allocation. Clear keeps the chunks for the next source
+	class TokenStore
+	{
+	private:
+		_STD vector<_STD unique_ptr<Token[]>> m_Chunks;
+		mrkpos m_Base; //tokens before the last chunk in use
+		Token* m_ChunkStart;
+		Token* m_Next; //free slot of the last chunk in use
+		Token* m_ChunkEnd;
+
+		void NextChunk();
+
+	public:
+		TokenStore();
+		TokenStore(const TokenStore&) = delete;
+		TokenStore& operator=(const TokenStore&) = delete;
+
+		void Add(const Token& token)
+		{
+			if (m_Next == m_ChunkEnd)
+				NextChunk();
+
+			*m_Next++ = token;
+		}
+
+		Token& operator[](mrkpos index) { return m_Chunks[index >> MRK_TOKEN_CHUNK_SHIFT][index & ((mrkpos(1) << MRK_TOKEN_CHUNK_SHIFT) - 1)]; }
+		const Token& operator[](mrkpos index) const { return m_Chunks[index >> MRK_TOKEN_CHUNK_SHIFT][index & ((mrkpos(1) << MRK_TOKEN_CHUNK_SHIFT) - 1)]; }
+		Token& Back() { return m_Next[-1]; }
+
+		mrkpos GetCount() const { return m_Base + (mrkpos)(m_Next - m_ChunkStart); }
+		bool IsEmpty() const { return m_Next == m_ChunkStart; }
+		size_t GetReservedBytes() const;
+
+		void Clear();
+		void Swap(TokenStore& other);
+	};
+
+	//a value per token in chunks of the same size as the TokenStore ones, so per token lookups
+	//don't need one contiguous allocation either. Assign keeps the chunks for the next source
+	template<typename T>
+	class TokenData
+	{
+	private:
+		_STD vector<_STD unique_ptr<T[]>> m_Chunks;
+		mrkpos m_Count;
+
+	public:
+		TokenData() : m_Count(0) {}
+		TokenData(const TokenData&) = delete;
+		TokenData& operator=(const TokenData&) = delete;
+
+		void Assign(mrkpos count, const T& value)
+		{
+			constexpr mrkpos size = mrkpos(1) << MRK_TOKEN_CHUNK_SHIFT;
+			mrkpos chunks = (count + size - 1) >> MRK_TOKEN_CHUNK_SHIFT;
+			while (m_Chunks.size() < chunks)
+				m_Chunks.emplace_back(new T[size]);
+
+			for (mrkpos chunk = 0; chunk < chunks; chunk++)
+				_STD fill(m_Chunks[chunk].get(), m_Chunks[chunk].get() + size, value);
+
+			m_Count = count;
+		}
+
+		T& operator[](mrkpos index) { return m_Chunks[index >> MRK_TOKEN_CHUNK_SHIFT][index & ((mrkpos(1) << MRK_TOKEN_CHUNK_SHIFT) - 1)]; }
+		const T& operator[](mrkpos index) const { return m_Chunks[index >> MRK_TOKEN_CHUNK_SHIFT][index & ((mrkpos(1) << MRK_TOKEN_CHUNK_SHIFT) - 1)]; }
+
+		mrkpos GetCount() const { return m_Count; }
+	};
+
+	//tokenizer with all of its state in the instance, any number can run on different threads
+	//Names and strings of the tokens point into text chunks owned by the lexer and stay valid until
+	//the next Lex call. Tokens, chunks and the scratch buffer keep their capacity between calls, so a
+	//lexer fed source after source stops allocating once it has seen the largest one
+	class Lexer
 	{
 	private:
 		enum TokenizerState
@@ -86,7 +178,20 @@ namespace MRK
 			TOKENIZER_STATE_STRING
 		};
 
-		static TokenizerState* ms_Target;
+		TokenizerState m_State;
+		TokenStore m_Tokens;
+		_STD vector<_STD unique_ptr<char[]>> m_TextChunks;
+		_STD vector<_STD unique_ptr<char[]>> m_LargeText; //longer than a chunk, freed every call
+		size_t m_TextChunk; //chunk being filled
+		size_t m_TextUsed; //bytes used of it
+		_STD vector<mrkpos> m_BraceTokens; //indices of the '{' and '}' tokens, in order
+		_STD string m_Buffer; //digits of a number, contents of a string
+
+		const char* AddText(const char* text, size_t length);
+		void AssignIdentifier(Token& token, const char* text, size_t length);
+		void AssignString(Token& token, const char* text, size_t length);
+		void ResetState();
+		size_t CaptureForeign(const _STD string& text, size_t pos, const char* word, size_t length);
 
 		static void AssignNumber(Token& token, TokenizerState* state = 0);
 		static void AssignWord(Token& token, TokenizerState* state = 0);
@@ -96,19 +201,34 @@ namespace MRK
 		static void AssignUInt(Token& token, unsigned int num);
 		static void AssignLong(Token& token, long num);
 		static void AssignULong(Token& token, unsigned long num);
-		static void AssignIdentifier(Token& token, _STD string val);
-		static void AssignString(Token& token, _STD string val);
 		static void AssignChar(Token& token, char val);
-		static bool TestUInt(_STD string test, unsigned int* val);
-		static bool TestULong(_STD string test, unsigned long* val);
-		static bool TestLong(_STD string test, long* val);
-		static bool TestInt(_STD string test, int* val);
+		static bool TestUInt(const _STD string& test, unsigned int* val);
+		static bool TestULong(const _STD string& test, unsigned long* val);
+		static bool TestLong(const _STD string& test, long* val);
+		static bool TestInt(const _STD string& test, int* val);
 		static bool IsSkippableCharacter(char character, bool inclSp);
-		static void ResetState();
-		static void SetExecutor(TokenizerState* state);
 
 	public:
-		static _STD vector<Token> Collect(_STD string& text, bool inclSp);
-		static _STD string ToValueString(Token& token);
+		Lexer();
+		Lexer(Lexer&&) = default;
+		Lexer& operator=(Lexer&&) = default;
+		Lexer(const Lexer&) = delete;
+		Lexer& operator=(const Lexer&) = delete;
+
+		//platforms = 0 keeps every $PLATFORM region
+		//the tokens may be swapped out, the lexer then reuses the capacity it gets back
+		TokenStore& Lex(const _STD string& text, bool inclSp = false, const PlatformSet* platforms = 0);
+
+		//bytes held between calls
+		size_t GetReservedBytes() const;
+
+		//filled while lexing, the parser pairs scopes from it without walking every token
+		const _STD vector<mrkpos>& GetBraceTokens() const;
+	};
+
+	class Tokens
+	{
+	public:
+		static _STD string ToValueString(const Token& token);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Trace.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+
+namespace MRK {
+	namespace {
+		struct TraceEvent {
+			const char* Name;
+			mrks string Detail;
+			unsigned long long Start;
+			unsigned long long Duration;
+			TraceArg Args[MRK_TRACE_MAX_ARGS];
+			int ArgCount;
+		};
+
+		struct TraceBuffer {
+			mrks mutex Lock; //the owning thread appends, Write and Clear read from any thread
+			mrku32 ThreadId;
+			mrks string ThreadName;
+			mrks vector<TraceEvent> Events;
+		};
+
+		//buffers are owned here rather than by their thread so they survive until Write()
+		mrks mutex g_BuffersLock;
+		mrks vector<mrks unique_ptr<TraceBuffer>> g_Buffers;
+		thread_local TraceBuffer* t_Buffer = 0;
+		mrks chrono::steady_clock::time_point g_Epoch = mrks chrono::steady_clock::now();
+
+		TraceBuffer* GetBuffer() {
+			if (!t_Buffer) {
+				mrks lock_guard<mrks mutex> lock(g_BuffersLock);
+				g_Buffers.push_back(mrks make_unique<TraceBuffer>());
+				t_Buffer = g_Buffers.back().get();
+				t_Buffer->ThreadId = (mrku32)g_Buffers.size();
+				t_Buffer->Events.reserve(1024);
+			}
+
+			return t_Buffer;
+		}
+
+		unsigned long long Now() {
+			return mrks chrono::duration_cast<mrks chrono::nanoseconds>(mrks chrono::steady_clock::now() - g_Epoch).count();
+		}
+
+		void WriteEscaped(FILE* file, const mrks string& str) {
+			for (char c : str) {
+				switch (c) {
+
+				case '"':
+					fputs("\\\"", file);
+					break;
+
+				case '\\':
+					fputs("\\\\", file);
+					break;
+
+				default:
+					if ((unsigned char)c < 0x20)
+						fprintf(file, "\\u%04x", c);
+					else
+						fputc(c, file);
+					break;
+
+				}
+			}
+		}
+	}
+
+	mrks atomic<bool> Trace::ms_Enabled(false);
+
+	void Trace::Enable() {
+		ms_Enabled.store(true);
+	}
+
+	void Trace::Disable() {
+		ms_Enabled.store(false);
+	}
+
+	void Trace::NameThread(mrks string name) {
+		if (!IsEnabled())
+			return;
+
+		TraceBuffer* buffer = GetBuffer();
+		mrks lock_guard<mrks mutex> lock(buffer->Lock);
+		buffer->ThreadName = mrks move(name);
+	}
+
+	void Trace::Clear() {
+		mrks lock_guard<mrks mutex> lock(g_BuffersLock);
+		for (auto& buffer : g_Buffers) {
+			mrks lock_guard<mrks mutex> bufferLock(buffer->Lock);
+			buffer->Events.clear();
+		}
+	}
+
+	bool Trace::Write(mrks string path) {
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file)
+			return false;
+
+		mrks lock_guard<mrks mutex> lock(g_BuffersLock);
+
+		fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+		bool first = true;
+
+		for (auto& buffer : g_Buffers) {
+			mrks lock_guard<mrks mutex> bufferLock(buffer->Lock);
+			if (!buffer->ThreadName.empty()) {
+				fprintf(file, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", first ? "" : ",", buffer->ThreadId);
+				WriteEscaped(file, buffer->ThreadName);
+				fputs("\"}}", file);
+				first = false;
+			}
+
+			for (TraceEvent& ev : buffer->Events) {
+				//ts and dur are microseconds, keep the nanosecond digits as fraction
+				fprintf(file, "%s\n{\"ph\":\"X\",\"cat\":\"mrk\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03llu,\"dur\":%llu.%03llu,\"name\":\"%s\",\"args\":{",
+					first ? "" : ",", buffer->ThreadId, ev.Start / 1000, ev.Start % 1000, ev.Duration / 1000, ev.Duration % 1000, ev.Name);
+				first = false;
+
+				fputs("\"detail\":\"", file);
+				WriteEscaped(file, ev.Detail);
+				fputc('"', file);
+
+				for (int i = 0; i < ev.ArgCount; i++)
+					fprintf(file, ",\"%s\":%llu", ev.Args[i].Key, ev.Args[i].Value);
+
+				fputs("}}", file);
+			}
+		}
+
+		fputs("\n]}\n", file);
+		return fclose(file) == 0;
+	}
+
+	TraceSpan::TraceSpan(const char* name, const mrks string& detail) : m_Name(name), m_ArgCount(0), m_Active(Trace::IsEnabled()) {
+		if (!m_Active)
+			return;
+
+		m_Detail = detail;
+		m_Start = Now();
+	}
+
+	TraceSpan::~TraceSpan() {
+		End();
+	}
+
+	void TraceSpan::End() {
+		if (!m_Active)
+			return;
+
+		m_Active = false;
+		unsigned long long end = Now();
+		TraceBuffer* buffer = GetBuffer();
+
+		//Write may be reading this buffer from another thread
+		mrks lock_guard<mrks mutex> lock(buffer->Lock);
+		buffer->Events.push_back(TraceEvent{ m_Name, mrks move(m_Detail), m_Start, end - m_Start });
+
+		TraceEvent& ev = buffer->Events.back();
+		for (int i = 0; i < m_ArgCount; i++)
+			ev.Args[i] = m_Args[i];
+		ev.ArgCount = m_ArgCount;
+	}
+
+	void TraceSpan::Arg(const char* key, unsigned long long value) {
+		if (!m_Active || m_ArgCount >= MRK_TRACE_MAX_ARGS)
+			return;
+
+		m_Args[m_ArgCount++] = TraceArg{ key, value };
+	}
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <atomic>
+
+#include "Common.h"
+
+#define MRK_TRACE_MAX_ARGS 3
+
+namespace MRK {
+	//Chrome trace-event recorder (chrome://tracing, Perfetto), the -ftime-trace equivalent
+	//Every thread appends to its own buffer, nothing is recorded unless Enable() was called
+	//A buffer's lock is only ever contended by Write and Clear, so appending stays cheap while
+	//a long running process writes the trace of one request and the pool keeps recording
+	class Trace {
+	private:
+		static mrks atomic<bool> ms_Enabled;
+
+	public:
+		static void Enable();
+		static void Disable(); //spans already open still record
+		static bool IsEnabled() { return ms_Enabled.load(mrks memory_order_relaxed); }
+		static void NameThread(mrks string name);
+		static bool Write(mrks string path);
+		static void Clear(); //drops the recorded events, thread names stay
+	};
+
+	struct TraceArg {
+		const char* Key;
+		unsigned long long Value;
+	};
+
+	//one complete ("X") event, from construction until destruction
+	class TraceSpan {
+	private:
+		const char* m_Name;
+		mrks string m_Detail;
+		unsigned long long m_Start;
+		TraceArg m_Args[MRK_TRACE_MAX_ARGS];
+		int m_ArgCount;
+		bool m_Active;
+
+	public:
+		TraceSpan(const char* name, const mrks string& detail);
+		~TraceSpan();
+
+		//records the event now instead of at destruction, so it can be in a trace written before
+		void End();
+
+		void Arg(const char* key, unsigned long long value);
+	};
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "Common.h"
+
+#define MRK_INVALID_CODEPOINT 0xFFFFFFFFu
+
+namespace MRK {
+	//offset of the first byte that does not belong to well formed UTF-8 (no overlongs, surrogates
+	//or code points past U+10FFFF), size when the whole text is valid
+	size_t ValidateUtf8(const char* text, size_t size);
+
+	//code point starting at pos, pos moves past it
+	//MRK_INVALID_CODEPOINT and one byte skipped on a malformed sequence
+	mrku32 DecodeUtf8(const char* text, size_t size, size_t& pos);
+
+	//Unicode 14 XID_Start/XID_Continue, '_' is not XID_Start
+	bool IsXidStart(mrku32 codepoint);
+	bool IsXidContinue(mrku32 codepoint);
+
+	//bytes of the identifier starting at pos, an XID_Start or '_' then XID_Continue, 0 if there is none
+	size_t ScanIdentifier(const char* text, size_t size, size_t pos);
+}
@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "VM.h"
+
+#include <climits>
+#include <cmath>
+
+namespace MRK {
+	namespace {
+		const mrks string g_Empty;
+	}
+
+	VM::VM(const Program& program, size_t stackSlots) : m_Program(program), m_Stack(stackSlots), m_HeapUsed(MRK_VM_HEAP_CHUNK),
+		m_HeapBytes(0), m_Dispatch(Dispatch::Threaded) {
+		m_Frames.reserve(64);
+	}
+
+	bool VM::Fail(ErrorCode code, mrku32 method) {
+		const ProgramMethod& target = m_Program.Methods[method];
+		const ProgramClass& _class = m_Program.Classes[target.Class];
+		m_Error = mrks string(GetErrorText(code)) + " in " + _class.Name + "::" + (target.IsCtor ? _class.Name : target.Name);
+		m_Frames.clear();
+		return false;
+	}
+
+	const mrks string& VM::ToString(Value value) {
+		return value.Ref ? *(const mrks string*)value.Ref : g_Empty;
+	}
+
+	Object* VM::New(mrku32 _class) {
+		const ProgramClass& layout = m_Program.Classes[_class];
+		size_t fields = layout.Fields.size();
+		size_t size = 1 + (fields ? fields : 1); //header, then the fields
+
+		//big objects get a chunk of their own, the next small one opens a new chunk
+		Value* memory;
+		if (size > MRK_VM_HEAP_CHUNK) {
+			m_Heap.emplace_back(new Value[size]);
+			m_HeapUsed = MRK_VM_HEAP_CHUNK;
+			memory = m_Heap.back().get();
+		}
+		else {
+			if (m_HeapUsed + size > MRK_VM_HEAP_CHUNK) {
+				m_Heap.emplace_back(new Value[MRK_VM_HEAP_CHUNK]);
+				m_HeapUsed = 0;
+			}
+
+			memory = m_Heap.back().get() + m_HeapUsed;
+			m_HeapUsed += size;
+		}
+
+		m_HeapBytes += size * sizeof(Value);
+
+		Object* object = (Object*)memory;
+		object->Class = _class;
+		object->FieldCount = (mrku32)fields;
+		for (size_t i = 0; i < fields; i++)
+			object->Fields[i] = layout.Defaults[i];
+
+		return object;
+	}
+
+	bool VM::Invoke(mrku32 method, Object* self, const Value* args, Value* result) {
+		m_Error.clear();
+
+		const ProgramMethod& target = m_Program.Methods[method];
+		if (target.Code == MRK_VM_NONE)
+			return Fail(ErrorCode::VMNotCompiled, method);
+
+		if (target.RegisterCount > m_Stack.size())
+			return Fail(ErrorCode::VMStackOverflow, method);
+
+		Value* window = m_Stack.data();
+		window[0].Ref = self;
+		for (mrku32 i = 0; i < target.ParamCount; i++)
+			window[1 + i] = args[i];
+
+		bool ok;
+#ifdef __GNUC__
+		if (m_Dispatch == Dispatch::Threaded)
+			ok = Execute<true>(method, window);
+		else
+#endif
+			ok = Execute<false>(method, window);
+
+		if (ok && result)
+			*result = window[0];
+
+		return ok;
+	}
+
+	template<bool Threaded>
+	bool VM::Execute(mrku32 method, Value* window) {
+		const Instruction* code = m_Program.Code.data();
+		const Value* constants = m_Program.Constants.data();
+		const ProgramMethod* methods = m_Program.Methods.data();
+		Value* stackEnd = m_Stack.data() + m_Stack.size();
+		size_t entryDepth = m_Frames.size();
+
+		const Instruction* ip = code + methods[method].Code;
+		const Instruction* ins;
+		Value* R = window;
+
+		//every handler ends with a jump of its own, threaded builds go straight to the next handler,
+		//switch builds go through one shared dispatch
+#ifdef __GNUC__
+		static void* labels[] = {
+#define MRK_VM_LABEL(name) &&L_##name,
+			MRK_VM_OPCODES(MRK_VM_LABEL)
+#undef MRK_VM_LABEL
+		};
+
+#define MRK_VM_NEXT() do { if (Threaded) { ins = ip++; goto *labels[(mrku32)ins->Op]; } goto dispatch; } while (0)
+#else
+#define MRK_VM_NEXT() goto dispatch
+#endif
+
+#define MRK_VM_CURRENT (m_Frames.size() > entryDepth ? m_Frames.back().Method : method)
+#define MRK_VM_OP(name) L_##name:
+#define MRK_VM_BINARY(name, field, expr) MRK_VM_OP(name) { R[ins->A].field = (expr); MRK_VM_NEXT(); }
+
+		MRK_VM_NEXT();
+
+	dispatch:
+		ins = ip++;
+		switch (ins->Op) {
+#define MRK_VM_CASE(name) case Opcode::name: goto L_##name;
+			MRK_VM_OPCODES(MRK_VM_CASE)
+#undef MRK_VM_CASE
+		default: return Fail(ErrorCode::VMUnsupported, method);
+		}
+
+		MRK_VM_OP(Move) { R[ins->A] = R[ins->B]; MRK_VM_NEXT(); }
+		MRK_VM_OP(LoadK) { R[ins->A] = constants[ins->GetBC()]; MRK_VM_NEXT(); }
+		MRK_VM_OP(LoadI) { R[ins->A].Int = ins->GetOffset(); MRK_VM_NEXT(); }
+		MRK_VM_BINARY(I2F, Float, (double)R[ins->B].Int)
+		MRK_VM_BINARY(U2F, Float, (double)R[ins->B].UInt)
+
+		MRK_VM_OP(Narrow) {
+			Value& value = R[ins->A];
+			switch ((BuiltinType)ins->B) {
+			case BuiltinType::Byte: value.Int = (unsigned char)value.Int; break;
+			case BuiltinType::Char: value.Int = (signed char)value.Int; break;
+			case BuiltinType::Short: value.Int = (short)value.Int; break;
+			case BuiltinType::UShort: value.Int = (unsigned short)value.Int; break;
+			case BuiltinType::Int: value.Int = (int)value.Int; break;
+			case BuiltinType::UInt: value.Int = (unsigned int)value.Int; break;
+			default: break;
+			}
+			MRK_VM_NEXT();
+		}
+
+		MRK_VM_BINARY(NarrowF, Float, (double)(float)R[ins->A].Float)
+
+		//integer arithmetic wraps like the targets, unsigned keeps the same bits
+		MRK_VM_BINARY(AddI, UInt, R[ins->B].UInt + R[ins->C].UInt)
+		MRK_VM_BINARY(SubI, UInt, R[ins->B].UInt - R[ins->C].UInt)
+		MRK_VM_BINARY(MulI, UInt, R[ins->B].UInt * R[ins->C].UInt)
+
+		MRK_VM_OP(DivI) {
+			long long a = R[ins->B].Int, b = R[ins->C].Int;
+			if (!b)
+				return Fail(ErrorCode::DivideByZero, MRK_VM_CURRENT);
+			R[ins->A].Int = b == -1 ? (long long)(0 - (unsigned long long)a) : a / b;
+			MRK_VM_NEXT();
+		}
+
+		MRK_VM_OP(ModI) {
+			long long a = R[ins->B].Int, b = R[ins->C].Int;
+			if (!b)
+				return Fail(ErrorCode::DivideByZero, MRK_VM_CURRENT);
+			R[ins->A].Int = b == -1 ? 0 : a % b;
+			MRK_VM_NEXT();
+		}
+
+		MRK_VM_OP(DivU) {
+			unsigned long long b = R[ins->C].UInt;
+			if (!b)
+				return Fail(ErrorCode::DivideByZero, MRK_VM_CURRENT);
+			R[ins->A].UInt = R[ins->B].UInt / b;
+			MRK_VM_NEXT();
+		}
+
+		MRK_VM_OP(ModU) {
+			unsigned long long b = R[ins->C].UInt;
+			if (!b)
+				return Fail(ErrorCode::DivideByZero, MRK_VM_CURRENT);
+			R[ins->A].UInt = R[ins->B].UInt % b;
+			MRK_VM_NEXT();
+		}
+
+		MRK_VM_BINARY(Shl, UInt, R[ins->B].UInt << (R[ins->C].UInt & 63))
+		MRK_VM_BINARY(Shr, Int, R[ins->B].Int >> (R[ins->C].UInt & 63))
+		MRK_VM_BINARY(ShrU, UInt, R[ins->B].UInt >> (R[ins->C].UInt & 63))
+		MRK_VM_BINARY(BitAnd, UInt, R[ins->B].UInt & R[ins->C].UInt)
+		MRK_VM_BINARY(BitOr, UInt, R[ins->B].UInt | R[ins->C].UInt)
+		MRK_VM_BINARY(Xor, UInt, R[ins->B].UInt ^ R[ins->C].UInt)
+
+		MRK_VM_BINARY(AddF, Float, R[ins->B].Float + R[ins->C].Float)
+		MRK_VM_BINARY(SubF, Float, R[ins->B].Float - R[ins->C].Float)
+		MRK_VM_BINARY(MulF, Float, R[ins->B].Float * R[ins->C].Float)
+		MRK_VM_BINARY(DivF, Float, R[ins->B].Float / R[ins->C].Float)
+		MRK_VM_BINARY(ModF, Float, mrks fmod(R[ins->B].Float, R[ins->C].Float))
+
+		MRK_VM_BINARY(NegI, UInt, 0 - R[ins->B].UInt)
+		MRK_VM_BINARY(NegF, Float, -R[ins->B].Float)
+		MRK_VM_BINARY(Not, Int, !R[ins->B].Int)
+		MRK_VM_BINARY(BitNot, UInt, ~R[ins->B].UInt)
+
+		MRK_VM_BINARY(EqI, Int, R[ins->B].Int == R[ins->C].Int)
+		MRK_VM_BINARY(NeI, Int, R[ins->B].Int != R[ins->C].Int)
+		MRK_VM_BINARY(LtI, Int, R[ins->B].Int < R[ins->C].Int)
+		MRK_VM_BINARY(LeI, Int, R[ins->B].Int <= R[ins->C].Int)
+		MRK_VM_BINARY(LtU, Int, R[ins->B].UInt < R[ins->C].UInt)
+		MRK_VM_BINARY(LeU, Int, R[ins->B].UInt <= R[ins->C].UInt)
+		MRK_VM_BINARY(EqF, Int, R[ins->B].Float == R[ins->C].Float)
+		MRK_VM_BINARY(NeF, Int, R[ins->B].Float != R[ins->C].Float)
+		MRK_VM_BINARY(LtF, Int, R[ins->B].Float < R[ins->C].Float)
+		MRK_VM_BINARY(LeF, Int, R[ins->B].Float <= R[ins->C].Float)
+		MRK_VM_BINARY(EqS, Int, ToString(R[ins->B]) == ToString(R[ins->C]))
+		MRK_VM_BINARY(NeS, Int, ToString(R[ins->B]) != ToString(R[ins->C]))
+
+		MRK_VM_OP(Concat) {
+			m_Strings.push_back(ToString(R[ins->B]) + ToString(R[ins->C]));
+			R[ins->A].Ref = &m_Strings.back();
+			MRK_VM_NEXT();
+		}
+
+		MRK_VM_OP(Jmp) { ip += ins->GetOffset(); MRK_VM_NEXT(); }
+		MRK_VM_OP(JmpIf) { if (R[ins->A].Int) ip += ins->GetOffset(); MRK_VM_NEXT(); }
+		MRK_VM_OP(JmpIfNot) { if (!R[ins->A].Int) ip += ins->GetOffset(); MRK_VM_NEXT(); }
+
+		MRK_VM_OP(GetField) {
+			const Object* object = (const Object*)R[ins->B].Ref;
+			if (!object)
+				return Fail(ErrorCode::VMNullReference, MRK_VM_CURRENT);
+			R[ins->A] = object->Fields[ins->C];
+			MRK_VM_NEXT();
+		}
+
+		MRK_VM_OP(SetField) {
+			Object* object = (Object*)R[ins->A].Ref;
+			if (!object)
+				return Fail(ErrorCode::VMNullReference, MRK_VM_CURRENT);
+			object->Fields[ins->B] = R[ins->C];
+			MRK_VM_NEXT();
+		}
+
+		MRK_VM_OP(New) { R[ins->A].Ref = New(ins->GetBC()); MRK_VM_NEXT(); }
+
+		MRK_VM_OP(Call) {
+			//the callee's window starts at the receiver, its params are the arguments already in place
+			mrku32 callee = ins->GetBC();
+			const ProgramMethod& target = methods[callee];
+			Value* next = R + ins->A;
+
+			if (!next[0].Ref)
+				return Fail(ErrorCode::VMNullReference, callee);
+
+			if (target.Code == MRK_VM_NONE)
+				return Fail(ErrorCode::VMNotCompiled, callee);
+
+			if (next + target.RegisterCount > stackEnd)
+				return Fail(ErrorCode::VMStackOverflow, callee);
+
+			m_Frames.push_back(Frame{ ip, R, callee });
+			R = next;
+			ip = code + target.Code;
+			MRK_VM_NEXT();
+		}
+
+		MRK_VM_OP(Ret) {
+			R[0] = R[ins->A];
+			if (m_Frames.size() == entryDepth)
+				return true;
+
+			ip = m_Frames.back().Return;
+			R = m_Frames.back().Window;
+			m_Frames.pop_back();
+			MRK_VM_NEXT();
+		}
+
+		MRK_VM_OP(RetVoid) {
+			if (m_Frames.size() == entryDepth)
+				return true;
+
+			ip = m_Frames.back().Return;
+			R = m_Frames.back().Window;
+			m_Frames.pop_back();
+			MRK_VM_NEXT();
+		}
+
+#undef MRK_VM_BINARY
+#undef MRK_VM_OP
+#undef MRK_VM_CURRENT
+#undef MRK_VM_NEXT
+	}
+
+	template bool VM::Execute<true>(mrku32 method, Value* window);
+	template bool VM::Execute<false>(mrku32 method, Value* window);
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+
+#include "Common.h"
+#include "Bytecode.h"
+
+#define MRK_VM_STACK_SLOTS (1 << 20)
+#define MRK_VM_HEAP_CHUNK 8192 //values
+
+namespace MRK {
+	//fields follow the header, the layout is Program::Classes[Class].Fields
+	struct Object {
+		mrku32 Class;
+		mrku32 FieldCount;
+		Value Fields[1];
+	};
+
+	enum class Dispatch : mrku32 {
+		Threaded, //computed goto, one indirect jump per handler (GCC and Clang)
+		Switch
+	};
+
+	//register machine for a Program, one value stack holds the windows of every frame
+	//Objects are bump allocated and live as long as the VM, strings made at runtime too
+	class VM {
+	private:
+		struct Frame {
+			const Instruction* Return;
+			Value* Window;
+			mrku32 Method;
+		};
+
+		const Program& m_Program;
+		mrks vector<Value> m_Stack;
+		mrks vector<Frame> m_Frames;
+		mrks vector<mrks unique_ptr<Value[]>> m_Heap;
+		size_t m_HeapUsed; //values used in the last chunk
+		size_t m_HeapBytes;
+		mrks deque<mrks string> m_Strings;
+		Dispatch m_Dispatch;
+		mrks string m_Error;
+
+		bool Fail(ErrorCode code, mrku32 method);
+
+		template<bool Threaded>
+		bool Execute(mrku32 method, Value* window);
+
+	public:
+		VM(const Program& program, size_t stackSlots = MRK_VM_STACK_SLOTS);
+
+		VM(const VM&) = delete;
+		VM& operator=(const VM&) = delete;
+
+		void SetDispatch(Dispatch dispatch) { m_Dispatch = dispatch; }
+		Dispatch GetDispatch() const { return m_Dispatch; }
+
+		//fields start at the class defaults
+		Object* New(mrku32 _class);
+
+		//self is register 0, ctors are invoked on an object from New
+		//false on a runtime error, see GetError, result receives the returned value
+		bool Invoke(mrku32 method, Object* self, const Value* args, Value* result);
+
+		const mrks string& GetError() const { return m_Error; }
+		size_t GetHeapBytes() const { return m_HeapBytes; }
+		//String values, null is the empty string
+		static const mrks string& ToString(Value value);
+	};
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Watcher.h"
+
+#include <set>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+namespace MRK {
+	namespace {
+		bool IsSource(const mrks string& name) {
+			return name.size() > 4 && name.compare(name.size() - 4, 4, ".mrk") == 0;
+		}
+
+		mrks string FormatMs(double ms) {
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%.1f ms", ms);
+			return buf;
+		}
+	}
+
+#ifdef __linux__
+	FileWatcher::FileWatcher() : m_Fd(inotify_init1(IN_CLOEXEC)) {
+	}
+
+	FileWatcher::~FileWatcher() {
+		if (m_Fd >= 0)
+			close(m_Fd);
+	}
+
+	bool FileWatcher::Add(const mrks string& dir) {
+		for (auto& entry : m_Dirs)
+			if (entry.second == dir)
+				return true;
+
+		//editors save in place or through a rename
+		int wd = inotify_add_watch(m_Fd, dir.c_str(), IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM);
+		if (wd < 0)
+			return false;
+
+		m_Dirs[wd] = dir;
+		return true;
+	}
+
+	bool FileWatcher::Wait(int timeoutMs, unsigned debounceMs, mrks vector<mrks string>& changed) {
+		changed.clear();
+		mrks set<mrks string> seen;
+		alignas(inotify_event) char buffer[16384];
+
+		for (int wait = timeoutMs;;) {
+			pollfd fd = { m_Fd, POLLIN, 0 };
+			int ready = poll(&fd, 1, wait);
+			if (ready < 0 && errno == EINTR)
+				continue;
+			if (ready <= 0)
+				return ready == 0 && !changed.empty();
+
+			long long len = read(m_Fd, buffer, sizeof(buffer));
+			if (len < 0 && errno == EINTR)
+				continue;
+			if (len <= 0)
+				return false;
+
+			for (char* pos = buffer; pos < buffer + len;) {
+				inotify_event* event = (inotify_event*)pos;
+				pos += sizeof(inotify_event) + event->len;
+
+				if (event->mask & IN_IGNORED) {
+					m_Dirs.erase(event->wd);
+					continue;
+				}
+
+				auto dir = m_Dirs.find(event->wd);
+				if (!event->len || dir == m_Dirs.end() || !IsSource(event->name))
+					continue;
+
+				mrks string path = (mrks filesystem::path(dir->second) / event->name).lexically_normal().string();
+				if (seen.insert(path).second)
+					changed.push_back(path);
+			}
+
+			//quiet for debounceMs ends the burst
+			if (!changed.empty())
+				wait = (int)debounceMs;
+		}
+	}
+#else
+	FileWatcher::FileWatcher() : m_Fd(-1) {
+	}
+
+	FileWatcher::~FileWatcher() {
+	}
+
+	bool FileWatcher::Add(const mrks string&) {
+		return false;
+	}
+
+	bool FileWatcher::Wait(int, unsigned, mrks vector<mrks string>&) {
+		return false;
+	}
+#endif
+
+	int Watch(Compiler& compiler, const CompileOptions& options, const WatchOptions& watch, const DiagnosticSink& sink) {
+		FileWatcher watcher;
+		if (!watcher.IsValid()) {
+			sink("mrk: error: cannot watch files on this system");
+			return 2;
+		}
+
+		//sources can appear and includes resolve to new places after any rebuild
+		auto watchSources = [&]() {
+			for (const mrks string& dir : options.IncludeDirs)
+				watcher.Add(dir);
+			for (const mrks string& path : options.Inputs)
+				watcher.Add(mrks filesystem::path(path).parent_path().string());
+			for (const mrks string& path : compiler.GetLastSources())
+				watcher.Add(mrks filesystem::path(path).parent_path().string());
+		};
+
+		int status = compiler.Compile(options, sink);
+		watchSources();
+		sink("watch: built in " + FormatMs(compiler.GetStats().LastMs) + ", watching " + mrks to_string(watcher.GetCount()) + " directories");
+
+		mrks vector<mrks string> changed;
+		for (size_t rebuild = 1; !watch.MaxRebuilds || rebuild <= watch.MaxRebuilds; rebuild++) {
+			if (!watcher.Wait(watch.TimeoutMs, watch.DebounceMs, changed))
+				break;
+
+			//an edit within the timestamp resolution keeps the size and time
+			for (const mrks string& path : changed)
+				compiler.Invalidate(path);
+
+			size_t parsed = compiler.GetStats().Parsed;
+			status = compiler.Compile(options, sink);
+			watchSources();
+
+			const CompileStats& stats = compiler.GetStats();
+			sink("watch: rebuild " + mrks to_string(rebuild) + " after " + mrks to_string(changed.size()) + " change(s) to "
+				+ mrks filesystem::path(changed.front()).filename().string() + (changed.size() > 1 ? "..." : "") + " in " + FormatMs(stats.LastMs)
+				+ ": parse " + FormatMs(stats.ParseMs) + " (" + mrks to_string(stats.Parsed - parsed) + " parsed), analyze "
+				+ FormatMs(stats.AnalyzeMs) + ", emit " + FormatMs(stats.EmitMs));
+		}
+
+		return status;
+	}
+}
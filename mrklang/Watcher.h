@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Compiler.h"
+
+namespace MRK {
+	//inotify on a set of directories (Linux), reports the .mrk files written, created, moved or deleted in them
+	class FileWatcher {
+	private:
+		int m_Fd;
+		mrks map<int, mrks string> m_Dirs; //watch descriptor -> directory
+
+	public:
+		FileWatcher();
+		~FileWatcher();
+
+		bool IsValid() const { return m_Fd >= 0; }
+
+		//directories already watched are ignored
+		bool Add(const mrks string& dir);
+		size_t GetCount() const { return m_Dirs.size(); }
+
+		//waits up to timeoutMs (-1 forever) for a first change, then until debounceMs pass without another one
+		//changed lists every path seen once, false on timeout or error
+		bool Wait(int timeoutMs, unsigned debounceMs, mrks vector<mrks string>& changed);
+	};
+
+	struct WatchOptions {
+		unsigned DebounceMs = 15;
+		size_t MaxRebuilds = 0; //0 = until stopped
+		int TimeoutMs = -1; //for the first change of a rebuild, -1 = forever
+	};
+
+	//compiles, then compiles again after every burst of changes to the sources, the modules they
+	//include or the include directories. The compiler keeps every unchanged source parsed and the
+	//manifest leaves the output of unaffected classes alone. One timing line per rebuild
+	//Returns the status of the last compilation, 2 when files cannot be watched
+	int Watch(Compiler& compiler, const CompileOptions& options, const WatchOptions& watch, const DiagnosticSink& sink);
+}
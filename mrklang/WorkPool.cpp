@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "WorkPool.h"
+#include "Trace.h"
+
+#include <string>
+
+namespace MRK {
+	WorkPool::WorkPool(unsigned threads) : m_Job(0), m_Generation(0), m_Running(0), m_Stop(false), m_Steals(0) {
+		if (!threads)
+			threads = mrks thread::hardware_concurrency();
+
+		m_WorkerCount = threads ? threads : 1;
+		m_Queues.reset(new Queue[m_WorkerCount]);
+
+		for (unsigned i = 1; i < m_WorkerCount; i++)
+			m_Threads.emplace_back(&WorkPool::Loop, this, i);
+	}
+
+	WorkPool::~WorkPool() {
+		{
+			mrks lock_guard<mrks mutex> lock(m_Lock);
+			m_Stop = true;
+		}
+
+		m_Wake.notify_all();
+		for (mrks thread& thread : m_Threads)
+			thread.join();
+	}
+
+	bool WorkPool::Take(unsigned worker, size_t& job) {
+		//own slice first, from the back
+		{
+			Queue& own = m_Queues[worker];
+			mrks lock_guard<mrks mutex> lock(own.Lock);
+			if (!own.Jobs.empty()) {
+				job = own.Jobs.back();
+				own.Jobs.pop_back();
+				return true;
+			}
+		}
+
+		//then the front of the next worker's slice, the one furthest from where its owner works
+		for (unsigned i = 1; i < m_WorkerCount; i++) {
+			Queue& victim = m_Queues[(worker + i) % m_WorkerCount];
+			mrks lock_guard<mrks mutex> lock(victim.Lock);
+			if (!victim.Jobs.empty()) {
+				job = victim.Jobs.front();
+				victim.Jobs.pop_front();
+				m_Steals.fetch_add(1, mrks memory_order_relaxed);
+				return true;
+			}
+		}
+
+		//no job is added during a batch, empty queues stay empty
+		return false;
+	}
+
+	void WorkPool::Work(unsigned worker) {
+		size_t job;
+		while (Take(worker, job))
+			(*m_Job)(job, worker);
+	}
+
+	void WorkPool::Loop(unsigned worker) {
+		Trace::NameThread("worker " + mrks to_string(worker));
+
+		unsigned long long seen = 0;
+		for (;;) {
+			{
+				mrks unique_lock<mrks mutex> lock(m_Lock);
+				m_Wake.wait(lock, [&]() { return m_Stop || m_Generation != seen; });
+				if (m_Stop)
+					return;
+
+				seen = m_Generation;
+			}
+
+			Work(worker);
+
+			mrks lock_guard<mrks mutex> lock(m_Lock);
+			if (--m_Running == 0)
+				m_Done.notify_one();
+		}
+	}
+
+	void WorkPool::Run(size_t count, const Job& job) {
+		if (!count)
+			return;
+
+		//one worker, or not enough jobs to share, stays on this thread
+		if (m_WorkerCount == 1 || count == 1) {
+			for (size_t i = 0; i < count; i++)
+				job(i, 0);
+			return;
+		}
+
+		//contiguous slices, taken from the back so the front is left to thieves
+		for (unsigned w = 0; w < m_WorkerCount; w++) {
+			Queue& queue = m_Queues[w];
+			mrks lock_guard<mrks mutex> lock(queue.Lock);
+			for (size_t i = count * w / m_WorkerCount; i < count * (w + 1) / m_WorkerCount; i++)
+				queue.Jobs.push_front(i);
+		}
+
+		{
+			mrks lock_guard<mrks mutex> lock(m_Lock);
+			m_Job = &job;
+			m_Running = m_WorkerCount - 1;
+			m_Generation++;
+		}
+
+		m_Wake.notify_all();
+		Work(0);
+
+		mrks unique_lock<mrks mutex> lock(m_Lock);
+		m_Done.wait(lock, [&]() { return m_Running == 0; });
+		m_Job = 0;
+	}
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2020, Mohamed Ammar <mamar452@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <atomic>
+
+#include "Common.h"
+
+namespace MRK {
+	//fixed set of threads running batches of independent jobs
+	//Every worker starts on its own contiguous slice of the batch and takes jobs from the back of it,
+	//once empty it steals from the front of the other slices, so neighbouring jobs stay on one thread
+	//and a few slow jobs do not hold the batch back. The calling thread is worker 0.
+	class WorkPool {
+	public:
+		typedef mrks function<void(size_t job, unsigned worker)> Job;
+
+	private:
+		struct Queue {
+			mrks mutex Lock;
+			mrks deque<size_t> Jobs;
+		};
+
+		mrks vector<mrks thread> m_Threads;
+		mrks unique_ptr<Queue[]> m_Queues;
+		unsigned m_WorkerCount;
+
+		mrks mutex m_Lock;
+		mrks condition_variable m_Wake;
+		mrks condition_variable m_Done;
+		const Job* m_Job;
+		unsigned long long m_Generation;
+		unsigned m_Running;
+		bool m_Stop;
+		mrks atomic<size_t> m_Steals;
+
+		bool Take(unsigned worker, size_t& job);
+		void Work(unsigned worker);
+		void Loop(unsigned worker);
+
+	public:
+		//0 threads = one per hardware thread
+		explicit WorkPool(unsigned threads = 0);
+		~WorkPool();
+
+		WorkPool(const WorkPool&) = delete;
+		WorkPool& operator=(const WorkPool&) = delete;
+
+		//runs job(i, worker) for every i below count and returns when all are done, not reentrant
+		void Run(size_t count, const Job& job);
+
+		unsigned GetWorkerCount() const { return m_WorkerCount; }
+		size_t GetSteals() const { return m_Steals.load(); }
+	};
+}
@@ -28,21 +28,43 @@
 
 #ifdef MRK_MAIN
 
+#include <string>
 #include <vector>
 #include <iostream>
-#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+
+#include "Compiler.h"
+#include "Watcher.h"
+
+//mrkc [--watch [--debounce MS]] files|dirs|@file [--target NAME] [-o DIR] [-I DIR] [-j N] [--full] [--platform NAME] [--diagnostics-format text|jsonl|sarif] [--error-limit N] [--root NAME] [--reachable-only] [--reachability-report FILE] [-ftime-trace FILE]
+//exits with 0 when everything was emitted, 1 on errors in the sources, 2 on unreadable input or unwritable output
+int main(int argc, char** argv) {
+	mrks vector<mrks string> args;
+	bool watch = false;
+	mrk WatchOptions watchOptions;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--watch"))
+			watch = true;
+		else if (!strcmp(argv[i], "--debounce") && i + 1 < argc)
+			watchOptions.DebounceMs = (unsigned)atoi(argv[++i]);
+		else
+			args.push_back(argv[i]);
+	}
+
+	mrk CompileOptions options;
+	mrks string error;
+	if (!mrk ParseCompileArguments(args, mrks filesystem::current_path().string(), options, error)) {
+		mrks cerr << "mrkc: " << error << "\nusage: mrkc [--watch [--debounce MS]] files|dirs|@file [--target NAME] [-o DIR] [-I DIR] [-j N] [--full] [--platform NAME] [--diagnostics-format text|jsonl|sarif] [--error-limit N] [--root NAME] [--reachable-only] [--reachability-report FILE] [-ftime-trace FILE]\n";
+		return 2;
+	}
+
+	auto sink = [](const mrks string& line) { mrks cout << line << mrks endl; };
 
-int main()
-{
-	mrks cout << "ملوك الشر اهلا\nالشوكة رقم 9\nادخل رقم الشر:";
-	int دخول_الشر;
-	mrks cin >> دخول_الشر;
-
-	for (int الاندكس = 0; الاندكس < دخول_الشر; ++الاندكس)
-		mrks cout << "نحن الاشرار, الشوكة رقم " << الاندكس + 1 << '\n';
-	
-	system("pause");
-	return 0;
+	mrk Compiler compiler;
+	return watch ? mrk Watch(compiler, options, watchOptions, sink) : compiler.Compile(options, sink);
 }
 
-#endif
\ No newline at end of file
+#endif